@@ -9,7 +9,7 @@
 namespace ML {
 
 struct Spinlock {
-    Spinlock(bool yield = true)
+    constexpr Spinlock(bool yield = true)
         : value(0), yield(yield)
     {
     }
@@ -15,6 +15,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/mman.h>
 
 #include <boost/bind.hpp>
 #include <boost/crc.hpp>
@@ -376,6 +377,62 @@ dump(std::ostream & stream) const
 }
 
 
+/*****************************************************************************/
+/* HUGE PAGES                                                                */
+/*****************************************************************************/
+
+void * allocate_huge_pages(size_t bytes, Huge_Page_Mode mode)
+{
+    size_t rounded = huge_page_round(bytes);
+    if (rounded == 0) return 0;
+
+#ifdef MAP_HUGETLB
+    if (mode == HP_EXPLICIT) {
+        void * res = mmap(0, rounded, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (res != MAP_FAILED) return res;
+        // No huge pages reserved (or not permitted); use transparent ones
+        mode = HP_TRANSPARENT;
+    }
+#endif
+
+    // Over-allocate by a huge page so that we can trim the mapping down to
+    // one that is aligned on a huge page boundary; the kernel can only back
+    // aligned regions with transparent huge pages.
+    size_t to_map = rounded + huge_page_size;
+    char * mem = (char *)mmap(0, to_map, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        throw Exception(errno, format("mapping %zd bytes", rounded),
+                        "allocate_huge_pages()");
+
+    char * aligned
+        = (char *)(((size_t)mem + huge_page_size - 1)
+                   & ~(size_t)(huge_page_size - 1));
+    if (aligned != mem)
+        munmap(mem, aligned - mem);
+    char * end = aligned + rounded;
+    if (end != mem + to_map)
+        munmap(end, mem + to_map - end);
+
+#ifdef MADV_HUGEPAGE
+    // Failure here just means no transparent huge page support, which is
+    // not an error
+    if (mode != HP_NONE)
+        madvise(aligned, rounded, MADV_HUGEPAGE);
+#endif
+
+    return aligned;
+}
+
+void free_huge_pages(void * mem, size_t bytes)
+{
+    if (!mem) return;
+    int res = munmap(mem, huge_page_round(bytes));
+    if (res == -1)
+        throw Exception(errno, "munmap", "free_huge_pages()");
+}
+
 } // namespace ML
 
 
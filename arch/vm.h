@@ -172,6 +172,38 @@ inline ssize_t to_page_num(ssize_t val)
 void dump_maps(std::ostream & stream = std::cerr);
 
 
+/*****************************************************************************/
+/* HUGE PAGES                                                                */
+/*****************************************************************************/
+
+enum {
+    huge_page_shift  = 21,
+    huge_page_size   = 1 << huge_page_shift   ///< 2MB on x86_64
+};
+
+enum Huge_Page_Mode {
+    HP_NONE,         ///< Plain mmap; no huge page hints
+    HP_TRANSPARENT,  ///< madvise(MADV_HUGEPAGE) for transparent huge pages
+    HP_EXPLICIT      ///< MAP_HUGETLB; falls back to transparent if none free
+};
+
+/** Round the given number of bytes up to a whole number of huge pages. */
+inline size_t huge_page_round(size_t bytes)
+{
+    return (bytes + huge_page_size - 1) & ~(size_t)(huge_page_size - 1);
+}
+
+/** Allocate memory directly from the kernel, aligned to and rounded up to
+    a huge page boundary and backed by huge pages if possible.  The memory
+    is zero filled.  Must be freed with free_huge_pages() with the same
+    number of bytes.
+*/
+void * allocate_huge_pages(size_t bytes, Huge_Page_Mode mode = HP_TRANSPARENT);
+
+/** Free memory that was allocated with allocate_huge_pages(). */
+void free_huge_pages(void * mem, size_t bytes);
+
+
 /*****************************************************************************/
 /* PAGEMAP_READER                                                            */
 /*****************************************************************************/
@@ -30,7 +30,6 @@
 // and some tools on some platforms.
 
 
-#include <memory>
 
 
 // PLATFORM-SPECIFIC
@@ -246,9 +245,16 @@ extern int      Judy1FirstEmpty( Pcvoid_t  PArray, Word_t * PIndex,  P_JE);
 extern int      Judy1NextEmpty(  Pcvoid_t  PArray, Word_t * PIndex,  P_JE);
 extern int      Judy1LastEmpty(  Pcvoid_t  PArray, Word_t * PIndex,  P_JE);
 extern int      Judy1PrevEmpty(  Pcvoid_t  PArray, Word_t * PIndex,  P_JE);
+extern int      Judy1Union(      PPvoid_t PPArray, Pcvoid_t PArray1,
+                                                   Pcvoid_t PArray2, P_JE);
+extern int      Judy1Intersect(  PPvoid_t PPArray, Pcvoid_t PArray1,
+                                                   Pcvoid_t PArray2, P_JE);
 
 extern PPvoid_t j__udyLGet(      Pvoid_t   Pjpm,   Word_t    Index);
 extern PPvoid_t JudyLGet(        Pcvoid_t  PArray, Word_t    Index,  P_JE);
+extern Word_t   JudyLGetBatch(   Pcvoid_t  PArray, const Word_t * PIndex,
+                                 Word_t    Count,  PPvoid_t * PPValue,
+                                                                     P_JE);
 extern PPvoid_t JudyLIns(        PPvoid_t PPArray, Word_t    Index,  P_JE);
 extern int      JudyLInsArray(   PPvoid_t PPArray, Word_t    Count,
                                              const Word_t * const PIndex,
@@ -257,6 +263,18 @@ extern int      JudyLInsArray(   PPvoid_t PPArray, Word_t    Count,
 // ****************************************************************************
 // JUDYL FUNCTIONS:
                                                                      P_JE);
+
+// Streaming equivalent of JudyLInsArray(), for indexes given one at a time in
+// ascending order:
+
+typedef struct J_UDY_L_BUILD * PJudyLBuild_t;
+
+extern PJudyLBuild_t JudyLBuildInit(                                 P_JE);
+extern int      JudyLBuildIns(   PJudyLBuild_t PBuild, Word_t Index,
+                                                   Word_t    Value,  P_JE);
+extern int      JudyLBuildFinish(PJudyLBuild_t PBuild,
+                                                   PPvoid_t PPArray, P_JE);
+
 extern int      JudyLDel(        PPvoid_t PPArray, Word_t    Index,  P_JE);
 extern Word_t   JudyLCount(      Pcvoid_t  PArray, Word_t    Index1,
                                                    Word_t    Index2, P_JE);
@@ -286,6 +304,7 @@ extern PPvoid_t JudySLFirst(     Pcvoid_t,       uint8_t * Index, P_JE);
 extern PPvoid_t JudySLNext(      Pcvoid_t,       uint8_t * Index, P_JE);
 extern PPvoid_t JudySLLast(      Pcvoid_t,       uint8_t * Index, P_JE);
 extern PPvoid_t JudySLPrev(      Pcvoid_t,       uint8_t * Index, P_JE);
+extern Word_t   JudySLMemUsed(   Pcvoid_t);
 
 // ****************************************************************************
 // JUDYHSL FUNCTIONS:
@@ -300,63 +319,40 @@ extern const char *JudyLMallocSizes;
 
 // ****************************************************************************
 // JUDY memory interface to malloc() FUNCTIONS:
-#if 0
+//
+// These are implemented in judy_malloc_allocator.cc by a size-class slab
+// allocator, as Judy only ever asks for a small number of distinct sizes.
 
 extern Word_t JudyMalloc(Word_t);               // words reqd => words allocd.
 extern Word_t JudyMallocVirtual(Word_t);        // words reqd => words allocd.
 extern void   JudyFree(Pvoid_t, Word_t);        // free, size in words.
 extern void   JudyFreeVirtual(Pvoid_t, Word_t); // free, size in words.
 
-#endif
-
-inline Word_t JudyMalloc(
-	Word_t Words)
-{
-    static std::allocator<Word_t> judy_allocator;
-    return (Word_t)judy_allocator.allocate(Words);
-} // JudyMalloc()
-
-
-// ****************************************************************************
-// J U D Y   F R E E
+// Statistics for the memory that the slab allocator holds, across all Judy
+// arrays (JudyLMemUsed() gives the memory used by a single array).
 
-inline void JudyFree(
-	void * PWord,
-	Word_t Words)
+typedef struct J_UDY_MALLOC_STATS
 {
-    static std::allocator<Word_t> judy_allocator;
-    return judy_allocator.deallocate((Word_t *)PWord, Words);
-} // JudyFree()
-
-
-// ****************************************************************************
-// J U D Y   M A L L O C
-//
-// Higher-level "wrapper" for allocating objects that need not be in RAM,
-// although at this time they are in fact only in RAM.  Later we hope that some
-// entire subtrees (at a JPM or branch) can be "virtual", so their allocations
-// and frees should go through this level.
+        Word_t jms_BytesReserved;       // obtained from malloc() for slabs.
+        Word_t jms_BytesInUse;          // in slab blocks given to arrays.
+        Word_t jms_BytesCached;         // reserved but not in use.
+        Word_t jms_BytesLarge;          // in blocks too big for a slab.
+        Word_t jms_NumThreadCaches;     // threads with a private cache.
+} JudyMallocStats_t, * PJudyMallocStats_t;
 
-inline Word_t JudyMallocVirtual(
-	Word_t Words)
-{
-	return(JudyMalloc(Words));
+extern void   JudyMallocStats(PJudyMallocStats_t);
 
-} // JudyMallocVirtual()
-
-
-// ****************************************************************************
-// J U D Y   F R E E
-
-inline void JudyFreeVirtual(
-	void * PWord,
-	Word_t Words)
-{
-        JudyFree(PWord, Words);
+// Turn the per-thread block caches on (the default) or off.  With them off
+// every allocation and free takes the lock for its size class.
 
-} // JudyFreeVirtual()
+extern void   JudyMallocSetPerThread(int);
 
+// Between these calls, the calling thread's frees are accumulated privately
+// and released to the shared free lists in one batch at the end.  Used by
+// JudyLFreeArray(); calls may be nested.
 
+extern void   JudyMallocBeginBulkFree(void);
+extern void   JudyMallocEndBulkFree(void);
 
 
 #define JLAP_INVALID    0x1     /* flag to mark pointer "not a Judy array" */
@@ -0,0 +1,487 @@
+/* Judy1.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Judy1: sets of words (one bit per possible index), built on a JudyL
+   array.
+
+   The index space is cut into blocks of cJU_BITSPERWORD indexes.  The JudyL
+   array is indexed by block number, and the value for each block is a
+   bitmap of which of its indexes are in the set; a block with no bits set
+   is removed from the JudyL array.  Dense or clustered sets so cost a
+   fraction of a byte per index.  An index that is alone in its block
+   costs a JudyL entry plus a whole bitmap word, so sets of indexes that
+   are scattered over the whole word are bigger than a hash table of them.
+
+   The sets are ordered, so union and intersection walk the two arrays
+   together and build the result with JudyLBuildIns() rather than inserting
+   into it one index at a time.
+*/
+
+#include "config.h"
+#include "JudyL.h"
+#include "JudyPrivate1L.h"
+
+
+#ifdef JU_64BIT
+#define cJU_1_BLOCKSHIFT        6
+#else
+#define cJU_1_BLOCKSHIFT        5
+#endif
+
+#define JU_1_BLOCK(Index)       ((Index) >> cJU_1_BLOCKSHIFT)
+#define JU_1_OFFSET(Index)      ((Index) & (cJU_BITSPERWORD - 1))
+#define JU_1_BIT(Index)         ((Word_t) 1 << JU_1_OFFSET(Index))
+
+// Bits in a block at or above, or at or below, the offset of Index:
+
+#define JU_1_MASKABOVE(Index)   (cJU_ALLONES << JU_1_OFFSET(Index))
+#define JU_1_MASKBELOW(Index) \
+        (cJU_ALLONES >> (cJU_BITSPERWORD - 1 - JU_1_OFFSET(Index)))
+
+
+// ****************************************************************************
+// J U D Y   1   T E S T
+
+FUNCTION int Judy1Test
+        (
+        Pcvoid_t        PArray,         // to search.
+        Word_t          Index,          // to look for.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        PPvoid_t PValue = JudyLGet(PArray, JU_1_BLOCK(Index), PJError);
+
+        if (PValue == PPJERR) return(JERRI);
+        if (PValue == (PPvoid_t) NULL) return(0);
+        return((*(PWord_t) PValue & JU_1_BIT(Index)) != 0);
+
+} // Judy1Test()
+
+
+// ****************************************************************************
+// J U D Y   1   S E T
+//
+// Returns 1 if Index was added, 0 if it was already in the set.
+
+FUNCTION int Judy1Set
+        (
+        PPvoid_t        PPArray,        // in which to set.
+        Word_t          Index,          // to add.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        PPvoid_t PValue = JudyLIns(PPArray, JU_1_BLOCK(Index), PJError);
+
+        if (PValue == PPJERR) return(JERRI);
+        if (*(PWord_t) PValue & JU_1_BIT(Index)) return(0);
+
+        *(PWord_t) PValue |= JU_1_BIT(Index);
+        return(1);
+
+} // Judy1Set()
+
+
+// ****************************************************************************
+// J U D Y   1   U N S E T
+//
+// Returns 1 if Index was removed, 0 if it wasnt in the set.
+
+FUNCTION int Judy1Unset
+        (
+        PPvoid_t        PPArray,        // in which to unset.
+        Word_t          Index,          // to remove.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        PPvoid_t PValue;
+
+        if (PPArray == (PPvoid_t) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPPARRAY);
+            return(JERRI);
+        }
+
+        PValue = JudyLGet(*PPArray, JU_1_BLOCK(Index), PJError);
+
+        if (PValue == PPJERR) return(JERRI);
+        if (PValue == (PPvoid_t) NULL) return(0);
+        if ((*(PWord_t) PValue & JU_1_BIT(Index)) == 0) return(0);
+
+        *(PWord_t) PValue &= ~JU_1_BIT(Index);
+
+// Last index in the block; the block goes too:
+
+        if (*(PWord_t) PValue == 0
+         && JudyLDel(PPArray, JU_1_BLOCK(Index), PJError) == JERRI)
+        {
+            return(JERRI);
+        }
+        return(1);
+
+} // Judy1Unset()
+
+
+// ****************************************************************************
+// J U D Y   1   C O U N T
+//
+// Number of indexes in the set from Index1 to Index2 inclusive.  This walks
+// the blocks in the range, so is O(number of blocks), not O(1) as in the
+// original Judy1.  A full array
+// (2^64 indexes) counts as 0.
+
+FUNCTION Word_t Judy1Count
+        (
+        Pcvoid_t        PArray,         // to count.
+        Word_t          Index1,         // start of range.
+        Word_t          Index2,         // end of range, inclusive.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        Word_t   Block1 = JU_1_BLOCK(Index1);
+        Word_t   Block2 = JU_1_BLOCK(Index2);
+        Word_t   Block  = Block1;
+        Word_t   Count  = 0;
+        PPvoid_t PValue;
+
+        if (Index1 > Index2) return(0);
+
+        for (PValue = JudyLFirst(PArray, &Block, PJError);
+             PValue != (PPvoid_t) NULL && Block <= Block2;
+             PValue = JudyLNext(PArray, &Block, PJError))
+        {
+            Word_t Bits;
+
+            if (PValue == PPJERR) return(JERR);
+
+            Bits = *(PWord_t) PValue;
+            if (Block == Block1) Bits &= JU_1_MASKABOVE(Index1);
+            if (Block == Block2) Bits &= JU_1_MASKBELOW(Index2);
+            Count += __builtin_popcountl(Bits);
+        }
+
+        if (PValue == PPJERR) return(JERR);
+        return(Count);
+
+} // Judy1Count()
+
+
+// ****************************************************************************
+// J U D Y   1   F I R S T ,   N E X T ,   L A S T ,   P R E V
+//
+// Search from *PIndex (inclusive) up or down for an index in the set.  Only
+// the first block looked at can have no bits in range, so this is at most
+// two JudyL searches.
+
+static int j__udy1Search(Pcvoid_t PArray, PWord_t PIndex, int Up,
+                         PJError_t PJError)
+{
+        Word_t   Start = JU_1_BLOCK(*PIndex);
+        Word_t   Block = Start;
+        PPvoid_t PValue;
+
+        PValue = Up ? JudyLFirst(PArray, &Block, PJError)
+                    : JudyLLast(PArray, &Block, PJError);
+
+        while (PValue != (PPvoid_t) NULL)
+        {
+            Word_t Bits;
+
+            if (PValue == PPJERR) return(JERRI);
+
+            Bits = *(PWord_t) PValue;
+            if (Block == Start)
+                Bits &= Up ? JU_1_MASKABOVE(*PIndex) : JU_1_MASKBELOW(*PIndex);
+
+            if (Bits)
+            {
+                *PIndex = (Block << cJU_1_BLOCKSHIFT)
+                        | (Up ? __builtin_ctzl(Bits)
+                              : cJU_BITSPERWORD - 1 - __builtin_clzl(Bits));
+                return(1);
+            }
+
+            PValue = Up ? JudyLNext(PArray, &Block, PJError)
+                        : JudyLPrev(PArray, &Block, PJError);
+        }
+        return(0);
+
+} // j__udy1Search()
+
+
+FUNCTION int Judy1First
+        (
+        Pcvoid_t        PArray,         // to search.
+        Word_t *        PIndex,         // start, and the index found.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        if (PIndex == (PWord_t) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPINDEX);
+            return(JERRI);
+        }
+        return(j__udy1Search(PArray, PIndex, TRUE, PJError));
+
+} // Judy1First()
+
+
+FUNCTION int Judy1Next
+        (
+        Pcvoid_t        PArray,         // to search.
+        Word_t *        PIndex,         // start (exclusive), and index found.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        Word_t Index;
+        int    Rc;
+
+        if (PIndex == (PWord_t) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPINDEX);
+            return(JERRI);
+        }
+        if (*PIndex == cJU_ALLONES) return(0);
+
+        Index = *PIndex + 1;
+        if ((Rc = j__udy1Search(PArray, &Index, TRUE, PJError)) == 1)
+            *PIndex = Index;
+        return(Rc);
+
+} // Judy1Next()
+
+
+FUNCTION int Judy1Last
+        (
+        Pcvoid_t        PArray,         // to search.
+        Word_t *        PIndex,         // start, and the index found.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        if (PIndex == (PWord_t) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPINDEX);
+            return(JERRI);
+        }
+        return(j__udy1Search(PArray, PIndex, FALSE, PJError));
+
+} // Judy1Last()
+
+
+FUNCTION int Judy1Prev
+        (
+        Pcvoid_t        PArray,         // to search.
+        Word_t *        PIndex,         // start (exclusive), and index found.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        Word_t Index;
+        int    Rc;
+
+        if (PIndex == (PWord_t) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPINDEX);
+            return(JERRI);
+        }
+        if (*PIndex == 0) return(0);
+
+        Index = *PIndex - 1;
+        if ((Rc = j__udy1Search(PArray, &Index, FALSE, PJError)) == 1)
+            *PIndex = Index;
+        return(Rc);
+
+} // Judy1Prev()
+
+
+// ****************************************************************************
+// J U D Y   1   F R E E   A R R A Y ,   M E M   U S E D
+
+FUNCTION Word_t Judy1FreeArray
+        (
+        PPvoid_t        PPArray,        // array to free.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        return(JudyLFreeArray(PPArray, PJError));
+
+} // Judy1FreeArray()
+
+
+FUNCTION Word_t Judy1MemUsed(Pcvoid_t PArray)
+{
+        return(JudyLMemUsed(PArray));
+
+} // Judy1MemUsed()
+
+
+// ****************************************************************************
+// J U D Y   1   U N I O N ,   I N T E R S E C T
+//
+// Put the union or intersection of two sets into *PPArray, which must be
+// empty.  Nothing is stored on error.
+
+static int j__udy1CheckDest(PPvoid_t PPArray, PJError_t PJError)
+{
+        if (PPArray == (PPvoid_t) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPPARRAY);
+            return(FALSE);
+        }
+        if (*PPArray != (Pvoid_t) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NONNULLPARRAY);
+            return(FALSE);
+        }
+        return(TRUE);
+
+} // j__udy1CheckDest()
+
+
+static int j__udy1BuildFinish(PJudyLBuild_t PBuild, int Failed,
+                              PPvoid_t PPArray, PJError_t PJError)
+{
+        Pvoid_t PArray = (Pvoid_t) NULL;
+
+        if (JudyLBuildFinish(PBuild, &PArray, Failed ? PJE0 : PJError)
+         == JERRI)
+        {
+            Failed = TRUE;
+        }
+
+        if (Failed)
+        {
+            JudyLFreeArray(&PArray, PJE0);
+            return(JERRI);
+        }
+
+        *PPArray = PArray;
+        return(1);
+
+} // j__udy1BuildFinish()
+
+
+FUNCTION int Judy1Union
+        (
+        PPvoid_t        PPArray,        // where to put the result.
+        Pcvoid_t        PArray1,        // sets to combine.
+        Pcvoid_t        PArray2,
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        PJudyLBuild_t PBuild;
+        Word_t        Block1 = 0;
+        Word_t        Block2 = 0;
+        PPvoid_t      PValue1;
+        PPvoid_t      PValue2;
+        int           Failed = FALSE;
+
+        if (! j__udy1CheckDest(PPArray, PJError)) return(JERRI);
+        if ((PBuild = JudyLBuildInit(PJError)) == (PJudyLBuild_t) NULL)
+            return(JERRI);
+
+        PValue1 = JudyLFirst(PArray1, &Block1, PJError);
+        PValue2 = JudyLFirst(PArray2, &Block2, PJError);
+
+// Merge the blocks in order; blocks in both are ORed together:
+
+        while (PValue1 != (PPvoid_t) NULL || PValue2 != (PPvoid_t) NULL)
+        {
+            Word_t Block;
+            Word_t Bits;
+
+            if (PValue1 == PPJERR || PValue2 == PPJERR)
+            {
+                Failed = TRUE;
+                break;
+            }
+
+            if (PValue2 == (PPvoid_t) NULL
+             || (PValue1 != (PPvoid_t) NULL && Block1 < Block2))
+            {
+                Block   = Block1;
+                Bits    = *(PWord_t) PValue1;
+                PValue1 = JudyLNext(PArray1, &Block1, PJError);
+            }
+            else if (PValue1 == (PPvoid_t) NULL || Block2 < Block1)
+            {
+                Block   = Block2;
+                Bits    = *(PWord_t) PValue2;
+                PValue2 = JudyLNext(PArray2, &Block2, PJError);
+            }
+            else
+            {
+                Block   = Block1;
+                Bits    = *(PWord_t) PValue1 | *(PWord_t) PValue2;
+                PValue1 = JudyLNext(PArray1, &Block1, PJError);
+                PValue2 = JudyLNext(PArray2, &Block2, PJError);
+            }
+
+            if (JudyLBuildIns(PBuild, Block, Bits, PJError) == JERRI)
+            {
+                Failed = TRUE;
+                break;
+            }
+        }
+
+        return(j__udy1BuildFinish(PBuild, Failed, PPArray, PJError));
+
+} // Judy1Union()
+
+
+FUNCTION int Judy1Intersect
+        (
+        PPvoid_t        PPArray,        // where to put the result.
+        Pcvoid_t        PArray1,        // sets to intersect.
+        Pcvoid_t        PArray2,
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        PJudyLBuild_t PBuild;
+        Word_t        Block1 = 0;
+        Word_t        Block2;
+        PPvoid_t      PValue1;
+        PPvoid_t      PValue2;
+        int           Failed = FALSE;
+
+        if (! j__udy1CheckDest(PPArray, PJError)) return(JERRI);
+        if ((PBuild = JudyLBuildInit(PJError)) == (PJudyLBuild_t) NULL)
+            return(JERRI);
+
+// Leapfrog: each array is searched from the others current block, so runs
+// of blocks that are only in one of them are skipped over:
+
+        PValue1 = JudyLFirst(PArray1, &Block1, PJError);
+
+        while (PValue1 != (PPvoid_t) NULL)
+        {
+            Word_t Bits;
+
+            if (PValue1 == PPJERR) { Failed = TRUE; break; }
+
+            Block2  = Block1;
+            PValue2 = JudyLFirst(PArray2, &Block2, PJError);
+
+            if (PValue2 == (PPvoid_t) NULL) break;
+            if (PValue2 == PPJERR) { Failed = TRUE; break; }
+
+            if (Block2 != Block1)
+            {
+                Block1  = Block2;
+                PValue1 = JudyLFirst(PArray1, &Block1, PJError);
+                continue;
+            }
+
+            Bits = *(PWord_t) PValue1 & *(PWord_t) PValue2;
+
+            if (Bits && JudyLBuildIns(PBuild, Block1, Bits, PJError) == JERRI)
+            {
+                Failed = TRUE;
+                break;
+            }
+
+            PValue1 = JudyLNext(PArray1, &Block1, PJError);
+        }
+
+        return(j__udy1BuildFinish(PBuild, Failed, PPArray, PJError));
+
+} // Judy1Intersect()
@@ -104,8 +104,13 @@ FUNCTION Word_t JudyLFreeArray
 	    Pjpm_t Pjpm	    = P_JPM(*PPArray);
 	    Word_t TotalMem = Pjpm->jpm_TotalMemWords;
 
+// Free the nodes into this thread's cache and give them back to the shared
+// slab free lists in one batch at the end:
+
+	    JudyMallocBeginBulkFree();
 	    j__udyFreeSM(&(Pjpm->jpm_JP), &jpm);  // recurse through tree.
 	    j__udyFreeJPM(Pjpm, &jpm);
+	    JudyMallocEndBulkFree();
 
 // Verify the array was not corrupt.  This means that amount of memory freed
 // (which is negative) is equal to the initial amount:
@@ -58,7 +58,9 @@ FUNCTION int Judy1Test
 
 #else  // JUDYL
 
-#ifdef JUDYGETINLINE
+#ifdef JUDYGETSTEP
+static inline PPvoid_t j__udyLGetStep
+#elif defined(JUDYGETINLINE)
 FUNCTION PPvoid_t j__udyLGet
 #else
 FUNCTION PPvoid_t JudyLGet
@@ -66,7 +68,11 @@ FUNCTION PPvoid_t JudyLGet
 
 #endif // JUDYL
         (
-#ifdef JUDYGETINLINE
+#ifdef JUDYGETSTEP
+        Pjp_t     Pjp,          // JP to take one step from.
+        Word_t    Index,        // to retrieve.
+        Pjp_t *   PPjpNext      // set to the next JP if not finished.
+#elif defined(JUDYGETINLINE)
         Pvoid_t   PArray,       // from which to retrieve.
         Word_t    Index         // to retrieve.
 #else
@@ -76,8 +82,10 @@ FUNCTION PPvoid_t JudyLGet
 #endif
         )
 {
+#ifndef JUDYGETSTEP
         Pjp_t     Pjp;          // current JP while walking the tree.
         Pjpm_t    Pjpm;         // for global accounting.
+#endif
         uint8_t   Digit;        // byte just decoded from Index.
         Word_t    Pop1;         // leaf population (number of indexes).
         Pjll_t    Pjll;         // pointer to LeafL.
@@ -113,13 +121,30 @@ FUNCTION PPvoid_t JudyLGet
 
 #endif // ! JUDYGETINLINE
 
+#ifndef JUDYGETSTEP
         Pjpm = P_JPM(PArray);
         Pjp = &(Pjpm->jpm_JP);  // top branch is below JPM.
+#endif
+
+// In step mode (for JudyLGetBatch()), instead of going down to the next level
+// return with it in *PPjpNext so that the caller can prefetch it and do some
+// other lookups while it arrives.
+
+#ifdef JUDYGETSTEP
+#define JU_CONTINUEWALK { *PPjpNext = Pjp; return((PPvoid_t) NULL); }
+#define JU_CONTINUEWALKUNLESS(cJPType) JU_CONTINUEWALK
+#else
+#define JU_CONTINUEWALK goto ContinueWalk
+#define JU_CONTINUEWALKUNLESS(cJPType) \
+        if (JU_JPTYPE(Pjp) != (cJPType)) goto ContinueWalk
+#endif
 
 // ****************************************************************************
 // WALK THE JUDY TREE USING A STATE MACHINE:
 
+#ifndef JUDYGETSTEP
 ContinueWalk:           // for going down one level; come here with Pjp set.
+#endif
 
 #ifdef TRACEJPR
         JudyPrintJP(Pjp, "g", __LINE__);
@@ -221,7 +246,7 @@ JudyBranchL:
                 {                       // found Digit; continue traversal:
                     DBGCODE(ParentJPType = JU_JPTYPE(Pjp);)
                     Pjp = Pjbl->jbl_jp + posidx;
-                    goto ContinueWalk;
+                    JU_CONTINUEWALK;
                 }
             } while (++posidx != Pjbl->jbl_NumJPs);
 
@@ -303,7 +328,7 @@ JudyBranchB:
 
             Pjp += j__udyCountBitsB(BitMap & (BitMask - 1));
 
-            goto ContinueWalk;
+            JU_CONTINUEWALK;
 
         } // case cJU_JPBRANCH_B*
 
@@ -324,9 +349,9 @@ JudyBranchB:
 // when branches are already in the cache, such as for prev/next:
 
 #ifndef JU_64BIT
-            if (JU_JPTYPE(Pjp) != cJU_JPBRANCH_U3) goto ContinueWalk;
+            JU_CONTINUEWALKUNLESS(cJU_JPBRANCH_U3);
 #else
-            if (JU_JPTYPE(Pjp) != cJU_JPBRANCH_U7) goto ContinueWalk;
+            JU_CONTINUEWALKUNLESS(cJU_JPBRANCH_U7);
 #endif
 
 #ifdef JU_64BIT
@@ -336,7 +361,7 @@ JudyBranchB:
             DBGCODE(ParentJPType = JU_JPTYPE(Pjp);)
             Pjp = JU_JBU_PJP(Pjp, Index, 7);
 
-            if (JU_JPTYPE(Pjp) != cJU_JPBRANCH_U6) goto ContinueWalk;
+            JU_CONTINUEWALKUNLESS(cJU_JPBRANCH_U6);
             // and fall through.
 
         case cJU_JPBRANCH_U6:
@@ -345,7 +370,7 @@ JudyBranchB:
             DBGCODE(ParentJPType = JU_JPTYPE(Pjp);)
             Pjp = JU_JBU_PJP(Pjp, Index, 6);
 
-            if (JU_JPTYPE(Pjp) != cJU_JPBRANCH_U5) goto ContinueWalk;
+            JU_CONTINUEWALKUNLESS(cJU_JPBRANCH_U5);
             // and fall through.
 
         case cJU_JPBRANCH_U5:
@@ -354,7 +379,7 @@ JudyBranchB:
             DBGCODE(ParentJPType = JU_JPTYPE(Pjp);)
             Pjp = JU_JBU_PJP(Pjp, Index, 5);
 
-            if (JU_JPTYPE(Pjp) != cJU_JPBRANCH_U4) goto ContinueWalk;
+            JU_CONTINUEWALKUNLESS(cJU_JPBRANCH_U4);
             // and fall through.
 
         case cJU_JPBRANCH_U4:
@@ -363,7 +388,7 @@ JudyBranchB:
             DBGCODE(ParentJPType = JU_JPTYPE(Pjp);)
             Pjp = JU_JBU_PJP(Pjp, Index, 4);
 
-            if (JU_JPTYPE(Pjp) != cJU_JPBRANCH_U3) goto ContinueWalk;
+            JU_CONTINUEWALKUNLESS(cJU_JPBRANCH_U3);
             // and fall through.
 
 #endif // JU_64BIT
@@ -376,7 +401,7 @@ JudyBranchB:
             DBGCODE(ParentJPType = JU_JPTYPE(Pjp);)
             Pjp = JU_JBU_PJP(Pjp, Index, 3);
 
-            if (JU_JPTYPE(Pjp) != cJU_JPBRANCH_U2) goto ContinueWalk;
+            JU_CONTINUEWALKUNLESS(cJU_JPBRANCH_U2);
             // and fall through.
 
         case cJU_JPBRANCH_U2:
@@ -388,7 +413,7 @@ JudyBranchB:
 // Note:  BranchU2 is a special case that must continue traversal to a leaf,
 // immed, full, or null type:
 
-            goto ContinueWalk;
+            JU_CONTINUEWALK;
 
 
 // ****************************************************************************
@@ -748,7 +773,8 @@ if (((LEAF_T *)((PJP)->jp_LIndex))[(IDX) - 1] == (LEAF_T)(INDEX))       \
 
 ReturnCorrupt:
 
-#ifdef JUDYGETINLINE    // Pjpm is known to be non-null:
+#ifdef JUDYGETSTEP      // caller sets the error.
+#elif defined(JUDYGETINLINE)    // Pjpm is known to be non-null:
             JU_SET_ERRNO_NONNULL(Pjpm, JU_ERRNO_CORRUPT);
 #else
             JU_SET_ERRNO(PJError, JU_ERRNO_CORRUPT);
@@ -761,6 +787,9 @@ ReturnCorrupt:
 JUDY1CODE(return(0);)
 JUDYLCODE(return((PPvoid_t) NULL);)
 
+#undef JU_CONTINUEWALK
+#undef JU_CONTINUEWALKUNLESS
+
 } // Judy1Test() / JudyLGet()
 
 
@@ -0,0 +1,245 @@
+/* JudyLGetBatch.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   JudyLGetBatch(): look up many indexes in a JudyL array at once.
+
+   A single JudyLGet() walks down the tree one dependent load at a time, so
+   on a big array it spends most of its time waiting for cache misses.  Here
+   we keep a number of lookups in flight and advance them one level each in
+   turn, prefetching the node that each one will read at its next level.
+   By the time we come back around to a lookup its node has (hopefully)
+   arrived.
+
+   Each lookup also remembers the JPs it went through.  When the next index
+   given to the same lookup shares its high bytes with the previous one (as
+   happens when the indexes are sorted), it starts from the deepest JP that
+   covers the shared prefix instead of from the top of the tree.
+*/
+
+#define JUDYGETINLINE 1
+#define JUDYGETSTEP 1
+#include "JudyLGet.cc"      // defines j__udyLGetStep()
+
+
+// Number of lookups in flight at once.  Enough to cover memory latency, and
+// few enough that their nodes don't push each other out of the L1 cache.
+
+#define cJU_GETBATCHLANES 16
+
+// Below this size (1MB) an array is likely to be in the cache anyway, and
+// interleaving the lookups only adds overhead.
+
+#define cJU_GETBATCHMINWORDS (1024 * 1024 / cJU_BYTESPERWORD)
+
+typedef struct J__UDY_GET_BATCH_LANE
+{
+        Pjp_t  jgbl_Pjp;                // next JP to step from; NULL = idle.
+        Word_t jgbl_Index;              // index being looked up.
+        Word_t jgbl_Offset;             // where it is in PIndex.
+        Word_t jgbl_End;                // end of its run, for sorted indexes.
+        Word_t jgbl_PathIndex;          // index that Path is valid for.
+        Word_t jgbl_PathLen;            // number of JPs in Path.
+        Pjp_t  jgbl_Path[cJU_ROOTSTATE * 2];  // JPs walked through, in order.
+
+} jgbl_t, * Pjgbl_t;
+
+
+// Level of a branch JP (the state of the digit it decodes), or 0 if it isn't
+// a branch.  The root branches decode the top digit.
+
+static inline int j__udyBranchLevel(uint8_t Type)
+{
+        if (Type >= cJU_JPBRANCH_L2 && Type <= cJU_JPBRANCH_L)
+            return(Type - cJU_JPBRANCH_L2 + 2);
+        if (Type >= cJU_JPBRANCH_B2 && Type <= cJU_JPBRANCH_B)
+            return(Type - cJU_JPBRANCH_B2 + 2);
+        if (Type >= cJU_JPBRANCH_U2 && Type <= cJU_JPBRANCH_U)
+            return(Type - cJU_JPBRANCH_U2 + 2);
+        return(0);
+
+} // j__udyBranchLevel()
+
+
+// Prefetch what the next step from Pjp will read.  Pjp itself is in the node
+// we just read, so it's the node it points to that matters.  For an immediate
+// jp_Addr isn't a pointer, but a prefetch of a bad address is harmless.
+
+static inline void j__udyPrefetchJP(Pjp_t Pjp, Word_t Index)
+{
+        int level = j__udyBranchLevel(JU_JPTYPE(Pjp));
+
+        if (level && JU_JPTYPE(Pjp) >= cJU_JPBRANCH_U2)
+        {
+            __builtin_prefetch(JU_JBU_PJP(Pjp, Index, level));
+            return;
+        }
+
+        __builtin_prefetch((void *) (Pjp->jp_Addr));
+        __builtin_prefetch((char *) (Pjp->jp_Addr) + 64);
+
+} // j__udyPrefetchJP()
+
+
+// Start a lane on a new index, from the deepest JP on its path so far that
+// the new index shares with the previous one.
+
+static inline void j__udyLaneStart(Pjgbl_t Plane, Word_t Index, Word_t Offset)
+{
+        Word_t diff   = Index ^ Plane->jgbl_PathIndex;
+        int    common = diff ? __builtin_clzl(diff) / cJU_BITSPERBYTE
+                             : cJU_ROOTSTATE;
+        int    needed = cJU_ROOTSTATE - common;
+        Word_t len    = Plane->jgbl_PathLen;
+
+// A JP at level L is reached by decoding the digits above L, so it's the same
+// JP for any index that has the same top (cJU_ROOTSTATE - L) bytes.  The
+// first JP on the path is the root, which is always good.
+
+        while (len > 1)
+        {
+            int level = j__udyBranchLevel(JU_JPTYPE(Plane->jgbl_Path[len - 1]));
+            if (level && level >= needed) break;
+            --len;
+        }
+
+        Plane->jgbl_PathLen   = len;
+        Plane->jgbl_Pjp       = Plane->jgbl_Path[len - 1];
+        Plane->jgbl_Index     = Index;
+        Plane->jgbl_Offset    = Offset;
+        Plane->jgbl_PathIndex = Index;
+
+        j__udyPrefetchJP(Plane->jgbl_Pjp, Index);
+
+} // j__udyLaneStart()
+
+
+// ****************************************************************************
+// J U D Y   L   G E T   B A T C H
+//
+// Look up Count indexes from PIndex, setting PPValue[i] to the value area for
+// PIndex[i] or NULL if it's not in the array.  Returns the number of indexes
+// that were found, or JERR.
+
+FUNCTION Word_t JudyLGetBatch
+        (
+        Pcvoid_t        PArray,         // from which to retrieve.
+        const Word_t *  PIndex,         // indexes to retrieve.
+        Word_t          Count,          // number of indexes.
+        PPvoid_t *      PPValue,        // value area for each index.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        jgbl_t  lanes[cJU_GETBATCHLANES];
+        Word_t  numLanes;
+        Word_t  next;                   // next index in PIndex to start.
+        Word_t  active;                 // lanes still working.
+        Word_t  found = 0;
+        Word_t  offset;
+        Pjpm_t  Pjpm;
+        bool_t  sorted = TRUE;
+
+        if ((Count && PIndex == (Word_t *) NULL)
+         || (Count && PPValue == (PPvoid_t *) NULL))
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPINDEX);
+            return(JERR);
+        }
+
+// Empty arrays, root-level leaves and arrays small enough to stay in the cache
+// aren't worth the trouble:
+
+        if (PArray == (Pcvoid_t) NULL
+         || JU_LEAFW_POP0(PArray) < cJU_LEAFW_MAXPOP1
+         || P_JPM(PArray)->jpm_TotalMemWords < cJU_GETBATCHMINWORDS)
+        {
+            for (offset = 0; offset < Count; ++offset)
+            {
+                PPvoid_t PValue = JudyLGet(PArray, PIndex[offset], PJError);
+                if (PValue == PPJERR) return(JERR);
+                PPValue[offset] = PValue;
+                found += (PValue != (PPvoid_t) NULL);
+            }
+            return(found);
+        }
+
+        Pjpm = P_JPM(PArray);
+
+// Sorted indexes are split into one contiguous run per lane, so that each
+// lane's indexes follow on from each other and it can re-use its path.
+// Otherwise lanes take the next index whenever they finish.
+
+        for (offset = 1; offset < Count; ++offset)
+        {
+            if (PIndex[offset] < PIndex[offset - 1]) { sorted = FALSE; break; }
+        }
+
+        numLanes = (Count < cJU_GETBATCHLANES) ? Count : cJU_GETBATCHLANES;
+
+        for (offset = 0; offset < numLanes; ++offset)
+        {
+            Pjgbl_t Plane = lanes + offset;
+            Word_t  start = sorted ? (Count * offset / numLanes) : offset;
+
+            Plane->jgbl_Path[0]   = &(Pjpm->jpm_JP);
+            Plane->jgbl_PathLen   = 1;
+            Plane->jgbl_PathIndex = PIndex[start];
+            Plane->jgbl_End = sorted ? (Count * (offset + 1) / numLanes) : 0;
+
+            j__udyLaneStart(Plane, PIndex[start], start);
+        }
+
+        next   = numLanes;
+        active = numLanes;
+
+// Take one step in each lane in turn until they've all finished:
+
+        while (active)
+        {
+            for (offset = 0; offset < numLanes; ++offset)
+            {
+                Pjgbl_t  Plane = lanes + offset;
+                Pjp_t    PjpNext = (Pjp_t) NULL;
+                PPvoid_t PValue;
+                Word_t   start;
+
+                if (Plane->jgbl_Pjp == (Pjp_t) NULL) continue;
+
+                PValue = j__udyLGetStep(Plane->jgbl_Pjp, Plane->jgbl_Index,
+                                        &PjpNext);
+
+                if (PjpNext != (Pjp_t) NULL)    // went down a level.
+                {
+                    Plane->jgbl_Path[Plane->jgbl_PathLen++] = PjpNext;
+                    Plane->jgbl_Pjp = PjpNext;
+                    j__udyPrefetchJP(PjpNext, Plane->jgbl_Index);
+                    continue;
+                }
+
+                if (PValue == PPJERR)
+                {
+                    JU_SET_ERRNO(PJError, JU_ERRNO_CORRUPT);
+                    return(JERR);
+                }
+
+                PPValue[Plane->jgbl_Offset] = PValue;
+                found += (PValue != (PPvoid_t) NULL);
+
+                if (sorted) start = Plane->jgbl_Offset + 1;
+                else        start = next++;
+
+                if (start < (sorted ? Plane->jgbl_End : Count))
+                {
+                    j__udyLaneStart(Plane, PIndex[start], start);
+                }
+                else
+                {
+                    Plane->jgbl_Pjp = (Pjp_t) NULL;
+                    --active;
+                }
+            }
+        }
+
+        return(found);
+
+} // JudyLGetBatch()
@@ -151,6 +151,9 @@ static bool_t j__udyInsArray(Pjp_t PjpParent, int Level, PWord_t PPop1,
                              Pjv_t   PValue,
 #endif
                              Pjpm_t  Pjpm);
+static void   j__udyFinishBranchU(Pjp_t PjpParent, int Level, int levelsub,
+                                  Pjbu_t PjbuRaw, int numJPs, Word_t pop1,
+                                  Word_t Index, Pjpm_t Pjpm);
 
 
 // ****************************************************************************
@@ -283,7 +286,7 @@ const   Word_t *  const PValue, // list of corresponding values.
         if (Count == 0) return(1);              // *PPArray remains null.
 
         {
-            Pjlw      = j__udyAllocJLW(Count + 1);
+            Pjlw      = j__udyAllocJLW(Count);
                         JU_CHECKALLOC(Pjlw_t, Pjlw, JERRI);
             *PPArray  = (Pvoid_t) Pjlw;
             Pjlw[0]   = Count - 1;              // set pop0.
@@ -345,11 +348,9 @@ FUNCTION static bool_t j__udyInsArray(
         Pjpm_t  Pjpm)                   // for memory and errors.
 {
         Pjp_t   Pjp;                    // lower-level JP.
-        Word_t  Pjbany;                 // any type of branch.
         int     levelsub;               // actual, of Pjps node, <= Level.
         Word_t  pop1 = *PPop1;          // fast local value.
         Word_t  pop1sub;                // population of one subexpanse.
-        uint8_t JPtype;                 // current JP type.
         uint8_t JPtype_null;            // precomputed value for new branch.
         jp_t    JPnull;                 // precomputed for speed.
         Pjbu_t  PjbuRaw;                // constructed BranchU.
@@ -983,9 +984,6 @@ ClearBranch:
 // Pjpm.  Either way, PIndex points to an index within the expanse just
 // handled.
 
-        Pjbany = (Word_t) PjbuRaw;              // default = use this BranchU.
-        JPtype = branchU_JPtype[levelsub];
-
 // Check for complete failure above:
 
         assert((! retval) || *PPop1);           // sanity check.
@@ -1013,6 +1011,40 @@ ClearBranch:
         }
         assert(*PPop1 != 0);            // branch (still) cannot be empty.
 
+        j__udyFinishBranchU(PjpParent, Level, levelsub, PjbuRaw, numJPs,
+                            *PPop1, *PIndex, Pjpm);
+        return(retval);
+
+} // j__udyInsArray()
+
+
+// ****************************************************************************
+// __ J U D Y   F I N I S H   B R A N C H   U
+//
+// Given a BranchU at levelsub with numJPs non-null JPs and pop1 indexes under
+// it, compress it to a BranchL or BranchB if appropriate and attach it to
+// PjpParent, which is at Level.  Index is any index in the branch's expanse,
+// for the decode bytes.
+
+FUNCTION static void j__udyFinishBranchU(
+        Pjp_t   PjpParent,              // parent JP to point at the branch.
+        int     Level,                  // digits remaining to decode.
+        int     levelsub,               // actual level of the branch.
+        Pjbu_t  PjbuRaw,                // BranchU to attach.
+        int     numJPs,                 // non-null JPs in the BranchU.
+        Word_t  pop1,                   // indexes under the BranchU.
+        Word_t  Index,                  // any index under the BranchU.
+        Pjpm_t  Pjpm)                   // for memory and errors.
+{
+        Pjbu_t  Pjbu = P_JBU(PjbuRaw);
+        Word_t  Pjbany;                 // any type of branch.
+        uint8_t JPtype;                 // current JP type.
+        uint8_t JPtype_null = cJU_JPNULL1 + levelsub - 2;  // in the BranchU.
+        int     digit;                  // in BranchU.
+        int     offset;                 // in a bitmap subexpanse.
+
+        Pjbany = (Word_t) PjbuRaw;              // default = use this BranchU.
+        JPtype = branchU_JPtype[levelsub];
 
 // OPTIONALLY COMPRESS JPBRANCH_U*:
 //
@@ -1039,7 +1071,7 @@ ClearBranch:
             Pjbl_t PjblRaw = (Pjbl_t) NULL;     // new BranchL; init for cc.
             Pjbl_t Pjbl;
 
-            if ((*PPop1 > JU_BRANCHL_MAX_POP)   // pop too high.
+            if ((pop1 > JU_BRANCHL_MAX_POP)    // pop too high.
              || ((PjblRaw = j__udyAllocJBL(Pjpm)) == (Pjbl_t) NULL))
             {                                   // cant alloc BranchL.
                 goto SetParent;                 // just keep BranchU.
@@ -1087,7 +1119,7 @@ ClearBranch:
             Pjbb_t Pjbb;
             Pjp_t  Pjp2;                        // in BranchU.
 
-            if ((*PPop1 > JU_BRANCHB_MAX_POP)   // pop too high.
+            if ((pop1 > JU_BRANCHB_MAX_POP)    // pop too high.
              || ((PjbbRaw = j__udyAllocJBB(Pjpm)) == (Pjbb_t) NULL))
             {                                   // cant alloc BranchB.
                 goto SetParent;                 // just keep BranchU.
@@ -1161,7 +1193,7 @@ ClearBranch:
 
 // COMPLETE OR PARTIAL SUCCESS:
 //
-// Attach new branch (under Pjp, with JPtype) to parent JP; note use of *PPop1,
+// Attach new branch (under Pjp, with JPtype) to parent JP; note use of pop1,
 // possibly reduced due to partial failure.
 
 SetParent:
@@ -1170,11 +1202,484 @@ SetParent:
 
         if (Level < cJU_ROOTSTATE)              // PjpParent not in JPM:
         {
-            Word_t DcdP0 = (*PIndex & cJU_DCDMASK(levelsub)) | (*PPop1 - 1);
+            Word_t DcdP0 = (Index & cJU_DCDMASK(levelsub)) | (pop1 - 1);
 
             JU_JPSETADT(PjpParent ,Pjbany, DcdP0, JPtype);
         }
 
+} // j__udyFinishBranchU()
+
+
+#ifdef JUDYL
+
+// ****************************************************************************
+// J U D Y   L   B U I L D
+//
+// Build a JudyL array from indexes given one at a time in ascending order,
+// without having them all in memory at once as JudyLInsArray() needs.
+//
+// The tree is built bottom-up along its right edge.  Indexes are buffered
+// until there are enough of them to know where the branches go; every
+// subexpanse that is known to be complete (because a later index has moved
+// past it) is built with j__udyInsArray() and its JP saved in the open branch
+// above it.  The open branches (at most one per level) are kept as BranchUs,
+// and compressed and attached to their parents as each is completed.
+//
+// Since the buffer holds more indexes than fit in any leaf, any expanse that
+// overflows it must be under a branch at the highest level at which its
+// indexes differ, exactly as j__udyInsArray() would build it.
+
+// Number of indexes to buffer; must be more than fit in any leaf (including a
+// LeafB1, which holds up to 256):
+
+#define cJU_BUILDBUFFER 1024
+
+typedef struct J__UDY_BUILD_FRAME
+{
+        Pjbu_t  jbf_PjbuRaw;            // open branch, with finished JPs.
+        Word_t  jbf_Index;              // any index in its expanse.
+        Word_t  jbf_Pop1;               // indexes under its finished JPs.
+        int     jbf_NumJPs;             // finished (non-null) JPs.
+        int     jbf_Level;              // digit it decodes.
+
+} jbf_t, * Pjbf_t;
+
+struct J_UDY_L_BUILD
+{
+        Pjpm_t     jlb_Pjpm;            // null until past a root-level leaf.
+        Word_t     jlb_Count;           // indexes given so far.
+        Word_t     jlb_Last;            // last index given.
+        Word_t     jlb_Start;           // first buffered index.
+        Word_t     jlb_End;             // one past last buffered index.
+        int        jlb_Errno;           // first error, if any.
+        int        jlb_NumFrames;       // open branches, root first.
+        jbf_t      jlb_Frame[cJU_ROOTSTATE];
+        Word_t     jlb_Index[cJU_BUILDBUFFER];
+        Word_t     jlb_Value[cJU_BUILDBUFFER];
+};
+
+
+// Highest level at which two (different) indexes have different digits:
+
+static inline int j__udyDiffLevel(Word_t Index1, Word_t Index2)
+{
+        return(cJU_ROOTSTATE
+             - __builtin_clzl(Index1 ^ Index2) / cJU_BITSPERBYTE);
+
+} // j__udyDiffLevel()
+
+
+// Allocate a BranchU for an open branch at Level, with all JPs null:
+
+static Pjbu_t j__udyBuildAllocJBU(PJudyLBuild_t PBuild, int Level)
+{
+        Pjbu_t PjbuRaw;
+        Pjp_t  Pjp;
+        int    digit;
+
+        if ((PjbuRaw = j__udyAllocJBU(PBuild->jlb_Pjpm)) == (Pjbu_t) NULL)
+            return((Pjbu_t) NULL);      // error is set in the JPM.
+
+        Pjp = P_JBU(PjbuRaw)->jbu_jp;
+
+        for (digit = 0; digit < cJU_BRANCHUNUMJPS; ++digit, ++Pjp)
+            JU_JPSETADT(Pjp, 0, 0, cJU_JPNULL1 + Level - 2);
+
+        return(PjbuRaw);
+
+} // j__udyBuildAllocJBU()
+
+
+// Open a new (empty) branch at Level, below the deepest open one:
+
+static bool_t j__udyBuildPush(PJudyLBuild_t PBuild, int Level, Word_t Index)
+{
+        Pjbf_t Pframe = PBuild->jlb_Frame + PBuild->jlb_NumFrames;
+
+        Pframe->jbf_PjbuRaw = j__udyBuildAllocJBU(PBuild, Level);
+        if (Pframe->jbf_PjbuRaw == (Pjbu_t) NULL) return(FALSE);
+
+        Pframe->jbf_Index  = Index;
+        Pframe->jbf_Pop1   = 0;
+        Pframe->jbf_NumJPs = 0;
+        Pframe->jbf_Level  = Level;
+
+        ++(PBuild->jlb_NumFrames);
+        return(TRUE);
+
+} // j__udyBuildPush()
+
+
+// Build subtrees for the buffered indexes up to End, which must all be in
+// complete subexpanses of the deepest open branch, and save their JPs in it:
+
+static bool_t j__udyBuildEmit(PJudyLBuild_t PBuild, Word_t End)
+{
+        Pjbf_t  Pframe = PBuild->jlb_Frame + PBuild->jlb_NumFrames - 1;
+        int     level  = Pframe->jbf_Level;
+        Pjp_t   Pjp;
+        Word_t  start  = PBuild->jlb_Start;
+        Word_t  stop;
+        Word_t  pop1;
+        bool_t  retval = TRUE;
+        uint8_t digit;
+
+        while (start < End)
+        {
+            digit = JU_DIGITATSTATE(PBuild->jlb_Index[start], level);
+
+            for (stop = start + 1; stop < End; ++stop)
+                if (JU_DIGITATSTATE(PBuild->jlb_Index[stop], level) != digit)
+                    break;
+
+            Pjp  = P_JBU(Pframe->jbf_PjbuRaw)->jbu_jp + digit;
+            pop1 = stop - start;
+
+            if (pop1 == 1)              // JPIMMED_*_01, as j__udyInsArray().
+            {
+                JU_JPSETADT(Pjp, PBuild->jlb_Value[start],
+                            PBuild->jlb_Index[start],
+                            cJU_JPIMMED_1_01 + level - 2);
+            }
+            else
+            {
+                retval = j__udyInsArray(Pjp, level - 1, &pop1,
+                                        PBuild->jlb_Index + start,
+                                        (Pjv_t) (PBuild->jlb_Value + start),
+                                        PBuild->jlb_Pjpm);
+            }
+
+            if (pop1)                   // some or all stored.
+            {
+                ++(Pframe->jbf_NumJPs);
+                Pframe->jbf_Pop1 += pop1;
+            }
+
+            start = stop;
+            if (! retval) break;
+        }
+
+        PBuild->jlb_Start = End;        // anything not stored is dropped.
         return(retval);
 
-} // j__udyInsArray()
+} // j__udyBuildEmit()
+
+
+// Close the deepest open branch and save it in its parent (or for the root,
+// in the JPM).  If Index, the next index to store, is under the same JP of the
+// parent, a new branch goes between them at the level where they differ.
+
+static bool_t j__udyBuildClose(PJudyLBuild_t PBuild, bool_t Final,
+                               Word_t Index)
+{
+        Pjbf_t Pframe  = PBuild->jlb_Frame + PBuild->jlb_NumFrames - 1;
+        Pjbf_t Pparent = Pframe - 1;
+        Pjpm_t Pjpm    = PBuild->jlb_Pjpm;
+        Pjbu_t PjbuRaw;
+        int    level;
+
+        if (Pframe->jbf_Pop1 == 0)              // nothing stored (error).
+        {
+            j__udyFreeJBU(Pframe->jbf_PjbuRaw, Pjpm);
+            --(PBuild->jlb_NumFrames);
+            return(TRUE);
+        }
+
+        if (PBuild->jlb_NumFrames == 1)         // root:
+        {
+            j__udyFinishBranchU(&(Pjpm->jpm_JP), cJU_ROOTSTATE, cJU_ROOTSTATE,
+                                Pframe->jbf_PjbuRaw, Pframe->jbf_NumJPs,
+                                Pframe->jbf_Pop1, Pframe->jbf_Index, Pjpm);
+            Pjpm->jpm_Pop0 = Pframe->jbf_Pop1 - 1;
+            --(PBuild->jlb_NumFrames);
+            return(TRUE);
+        }
+
+        level = Final ? Pparent->jbf_Level
+                      : j__udyDiffLevel(Index, Pframe->jbf_Index);
+
+// Index is under the same JP of the parent; replace the closed branch with a
+// new one at a higher level, holding the closed one and with room for Index:
+
+        if (level < Pparent->jbf_Level)
+        {
+            if ((PjbuRaw = j__udyBuildAllocJBU(PBuild, level)) == (Pjbu_t) NULL)
+                return(FALSE);
+
+            j__udyFinishBranchU(P_JBU(PjbuRaw)->jbu_jp
+                              + JU_DIGITATSTATE(Pframe->jbf_Index, level),
+                                level - 1, Pframe->jbf_Level,
+                                Pframe->jbf_PjbuRaw, Pframe->jbf_NumJPs,
+                                Pframe->jbf_Pop1, Pframe->jbf_Index, Pjpm);
+
+            Pframe->jbf_PjbuRaw = PjbuRaw;
+            Pframe->jbf_NumJPs  = 1;
+            Pframe->jbf_Level   = level;
+            return(TRUE);
+        }
+
+// Otherwise its the parents last JP:
+
+        j__udyFinishBranchU(P_JBU(Pparent->jbf_PjbuRaw)->jbu_jp
+                          + JU_DIGITATSTATE(Pframe->jbf_Index,
+                                            Pparent->jbf_Level),
+                            Pparent->jbf_Level - 1, Pframe->jbf_Level,
+                            Pframe->jbf_PjbuRaw, Pframe->jbf_NumJPs,
+                            Pframe->jbf_Pop1, Pframe->jbf_Index, Pjpm);
+
+        ++(Pparent->jbf_NumJPs);
+        Pparent->jbf_Pop1 += Pframe->jbf_Pop1;
+        --(PBuild->jlb_NumFrames);
+        return(TRUE);
+
+} // j__udyBuildClose()
+
+
+// Store subtrees from a full buffer, until it's at most half full:
+
+static bool_t j__udyBuildFlush(PJudyLBuild_t PBuild)
+{
+        Pjbf_t Pframe;
+        Word_t first, last, end;
+        int    level;
+
+        if (PBuild->jlb_Pjpm == (Pjpm_t) NULL)  // too big for root leaf now.
+        {
+            Pjpm_t Pjpm = j__udyAllocJPM();
+
+            if ((Word_t) Pjpm <= sizeof(Word_t)) return(FALSE);
+
+            PBuild->jlb_Pjpm = Pjpm;
+
+            if (! j__udyBuildPush(PBuild, cJU_ROOTSTATE, 0)) return(FALSE);
+        }
+
+        while (PBuild->jlb_End - PBuild->jlb_Start > cJU_BUILDBUFFER / 2)
+        {
+            Pframe = PBuild->jlb_Frame + PBuild->jlb_NumFrames - 1;
+            first  = PBuild->jlb_Index[PBuild->jlb_Start];
+            last   = PBuild->jlb_Index[PBuild->jlb_End - 1];
+            level  = j__udyDiffLevel(first, last);
+
+// All buffered indexes are under one JP of the deepest open branch, and there
+// are too many for a leaf, so that JP must be a branch:
+
+            if (level < Pframe->jbf_Level)
+            {
+                assert(level >= 2);
+                if (! j__udyBuildPush(PBuild, level, first)) return(FALSE);
+            }
+
+// Everything before the last index's subexpanse is complete:
+
+            for (end = PBuild->jlb_End - 1; end > PBuild->jlb_Start; --end)
+            {
+                if (JU_DIGITATSTATE(PBuild->jlb_Index[end - 1], level)
+                 != JU_DIGITATSTATE(last, level)) break;
+            }
+
+            if (! j__udyBuildEmit(PBuild, end)) return(FALSE);
+        }
+
+        JU_COPYMEM(PBuild->jlb_Index, PBuild->jlb_Index + PBuild->jlb_Start,
+                   PBuild->jlb_End - PBuild->jlb_Start);
+        JU_COPYMEM(PBuild->jlb_Value, PBuild->jlb_Value + PBuild->jlb_Start,
+                   PBuild->jlb_End - PBuild->jlb_Start);
+        PBuild->jlb_End  -= PBuild->jlb_Start;
+        PBuild->jlb_Start = 0;
+        return(TRUE);
+
+} // j__udyBuildFlush()
+
+
+// Record the first error in the builder, and pass it on:
+
+static int j__udyBuildError(PJudyLBuild_t PBuild, int Errno,
+                            PJError_t PJError)
+{
+        if (PBuild->jlb_Errno == JU_ERRNO_NONE) PBuild->jlb_Errno = Errno;
+
+        JU_SET_ERRNO(PJError, PBuild->jlb_Errno);
+        return(JERRI);
+
+} // j__udyBuildError()
+
+
+// ****************************************************************************
+// J U D Y   L   B U I L D   I N I T
+//
+// Start building a new array.  Returns NULL if out of memory.
+
+FUNCTION PJudyLBuild_t JudyLBuildInit(PJError_t PJError)
+{
+        PJudyLBuild_t PBuild;
+
+        PBuild = (PJudyLBuild_t) JudyMalloc(
+            (sizeof(struct J_UDY_L_BUILD) + cJU_BYTESPERWORD - 1)
+            / cJU_BYTESPERWORD);
+
+        if (PBuild == (PJudyLBuild_t) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NOMEM);
+            return((PJudyLBuild_t) NULL);
+        }
+
+        PBuild->jlb_Pjpm      = (Pjpm_t) NULL;
+        PBuild->jlb_Count     = 0;
+        PBuild->jlb_Last      = 0;
+        PBuild->jlb_Start     = 0;
+        PBuild->jlb_End       = 0;
+        PBuild->jlb_Errno     = JU_ERRNO_NONE;
+        PBuild->jlb_NumFrames = 0;
+
+        return(PBuild);
+
+} // JudyLBuildInit()
+
+
+// ****************************************************************************
+// J U D Y   L   B U I L D   I N S
+//
+// Add the next index (which must be greater than all before it) and its value.
+// Returns 1, or JERRI if the index is out of order or memory ran out, after
+// which the builder accepts no more indexes.
+
+FUNCTION int JudyLBuildIns(
+        PJudyLBuild_t PBuild,           // from JudyLBuildInit().
+        Word_t        Index,            // to insert.
+        Word_t        Value,            // value for Index.
+        PJError_t     PJError)          // optional, for returning error info.
+{
+        Pjbf_t Pframe;
+
+        if (PBuild == (PJudyLBuild_t) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPPARRAY);
+            return(JERRI);
+        }
+
+        if (PBuild->jlb_Errno != JU_ERRNO_NONE)
+            return(j__udyBuildError(PBuild, PBuild->jlb_Errno, PJError));
+
+        if (PBuild->jlb_Count && (Index <= PBuild->jlb_Last))
+            return(j__udyBuildError(PBuild, JU_ERRNO_UNSORTED, PJError));
+
+// Close any open branches that Index is past the end of:
+
+        while (PBuild->jlb_NumFrames > 1)
+        {
+            Pframe = PBuild->jlb_Frame + PBuild->jlb_NumFrames - 1;
+
+            if (j__udyDiffLevel(Index, Pframe->jbf_Index) <= Pframe->jbf_Level)
+                break;
+
+            if (! j__udyBuildEmit(PBuild, PBuild->jlb_End)
+             || ! j__udyBuildClose(PBuild, FALSE, Index))
+            {
+                return(j__udyBuildError(PBuild, JU_ERRNO(PBuild->jlb_Pjpm),
+                                        PJError));
+            }
+        }
+
+        PBuild->jlb_Index[PBuild->jlb_End] = Index;
+        PBuild->jlb_Value[PBuild->jlb_End] = Value;
+        ++(PBuild->jlb_End);
+        ++(PBuild->jlb_Count);
+        PBuild->jlb_Last = Index;
+
+        if ((PBuild->jlb_End == cJU_BUILDBUFFER) && ! j__udyBuildFlush(PBuild))
+        {
+            return(j__udyBuildError(PBuild, PBuild->jlb_Pjpm
+                                    ? (int) JU_ERRNO(PBuild->jlb_Pjpm)
+                                    : (int) JU_ERRNO_NOMEM, PJError));
+        }
+
+        return(1);
+
+} // JudyLBuildIns()
+
+
+// ****************************************************************************
+// J U D Y   L   B U I L D   F I N I S H
+//
+// Finish the array and store it in *PPArray, which must be empty, and free the
+// builder.  Returns 1, or JERRI if there was an error at any point, in which
+// case *PPArray holds the indexes before the error (as for JudyLInsArray(),
+// use JudyLCount() to find out how many).
+
+FUNCTION int JudyLBuildFinish(
+        PJudyLBuild_t PBuild,           // from JudyLBuildInit().
+        PPvoid_t      PPArray,          // where to put the new array.
+        PJError_t     PJError)          // optional, for returning error info.
+{
+        Pvoid_t    PArray = (Pvoid_t) NULL;
+        int        Errno;
+        int        retval = 1;
+
+        if (PBuild == (PJudyLBuild_t) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPPARRAY);
+            return(JERRI);
+        }
+
+        Errno = PBuild->jlb_Errno;
+
+// Small enough for JudyLInsArray(), which makes a root-level leaf:
+
+        if (PBuild->jlb_Pjpm == (Pjpm_t) NULL)
+        {
+            JError_t JError;
+
+            if (JudyLInsArray(&PArray, PBuild->jlb_End - PBuild->jlb_Start,
+                              PBuild->jlb_Index + PBuild->jlb_Start,
+                              PBuild->jlb_Value + PBuild->jlb_Start, &JError)
+             == JERRI && Errno == JU_ERRNO_NONE)
+            {
+                Errno = JU_ERRNO(&JError);
+            }
+        }
+
+// Otherwise store the rest of the buffer and close the open branches:
+
+        else
+        {
+            Pjpm_t Pjpm = PBuild->jlb_Pjpm;
+
+            if (! j__udyBuildEmit(PBuild, PBuild->jlb_End)
+             && Errno == JU_ERRNO_NONE)
+            {
+                Errno = JU_ERRNO(Pjpm);
+            }
+
+            while (PBuild->jlb_NumFrames)
+                j__udyBuildClose(PBuild, TRUE, 0);
+
+            if (Pjpm->jpm_JP.jp_Type == 0)      // nothing stored.
+                j__udyFreeJPM(Pjpm, (Pjpm_t) NULL);
+            else PArray = (Pvoid_t) Pjpm;
+        }
+
+        JudyFree((Pvoid_t) PBuild, (sizeof(struct J_UDY_L_BUILD)
+                                    + cJU_BYTESPERWORD - 1)
+                                   / cJU_BYTESPERWORD);
+
+        if (PPArray == (PPvoid_t) NULL || *PPArray != (Pvoid_t) NULL)
+        {
+            JudyLFreeArray(&PArray, PJE0);
+            Errno = (PPArray == (PPvoid_t) NULL) ? JU_ERRNO_NULLPPARRAY
+                                                 : JU_ERRNO_NONNULLPARRAY;
+        }
+        else *PPArray = PArray;
+
+        if (Errno != JU_ERRNO_NONE)
+        {
+            JU_SET_ERRNO(PJError, Errno);
+            retval = JERRI;
+        }
+
+        DBGCODE(if (retval == 1) JudyCheckPop(*PPArray);)
+        return(retval);
+
+} // JudyLBuildFinish()
+
+#endif // JUDYL
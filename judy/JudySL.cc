@@ -0,0 +1,522 @@
+/* JudySL.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   JudySL: ordered map from null terminated strings to words, built out of
+   JudyL arrays.
+
+   Each level of the tree is a JudyL array indexed by the next
+   cJU_BYTESPERWORD bytes of the string, packed most significant byte first
+   so that the JudyL order is the same as the string order.  A word whose
+   last byte is zero holds the end of the string, and its JudyL value is the
+   user's value; any other word's value points to the next level down.
+
+   Where only one string is left under a JP it is stored in a shortcut leaf
+   (SCL) instead: the rest of the string and its value in one block, tagged
+   by setting the low bit of the pointer to it.  This keeps unique suffixes
+   (the usual case for URLs and the like) from needing a JudyL array for
+   every word.
+*/
+
+#include "config.h"
+#include "JudyL.h"
+#include "JudyPrivate1L.h"
+#include <string.h>
+
+
+// SHORTCUT LEAVES:
+
+typedef struct J__UDY_SL_SHORTCUT
+{
+        Word_t  scl_Value;              // users value.
+        uint8_t scl_Index[cJU_BYTESPERWORD];  // rest of string, null ended.
+
+} scl_t, * Pscl_t;
+
+#define JU_SL_ISSCL(PArray)     ((Word_t) (PArray) & 1)
+#define P_SCL(PArray)           ((Pscl_t) ((Word_t) (PArray) & ~1UL))
+#define JU_SL_SETSCL(Pscl)      ((Pvoid_t) ((Word_t) (Pscl) | 1))
+
+// Words needed for a shortcut leaf holding Len bytes (including the null):
+
+#define JU_SL_SCLWORDS(Len) \
+        (1 + ((Len) + cJU_BYTESPERWORD - 1) / cJU_BYTESPERWORD)
+
+// A word is the last of its string if its last byte is the null (or after it):
+
+#define JU_SL_ISLAST(Word)      (((Word) & 0xff) == 0)
+
+
+// Pack the next word of a string, most significant byte first, stopping at
+// the null:
+
+static inline Word_t j__udySLWord(const uint8_t * Index)
+{
+        Word_t Word = 0;
+        int    byte;
+
+        for (byte = 0; byte < cJU_BYTESPERWORD; ++byte)
+        {
+            Word = (Word << cJU_BITSPERBYTE) | Index[byte];
+            if (Index[byte] == 0)
+            {
+                Word <<= cJU_BITSPERBYTE * (cJU_BYTESPERWORD - 1 - byte);
+                break;
+            }
+        }
+        return(Word);
+
+} // j__udySLWord()
+
+
+// Unpack a word into a string, up to and including the null if there is one:
+
+static inline void j__udySLUnpack(uint8_t * Index, Word_t Word)
+{
+        int byte;
+
+        for (byte = 0; byte < cJU_BYTESPERWORD; ++byte)
+        {
+            Index[byte] = Word >> (cJU_BITSPERBYTE
+                                   * (cJU_BYTESPERWORD - 1 - byte));
+            if (Index[byte] == 0) break;
+        }
+
+} // j__udySLUnpack()
+
+
+static Pscl_t j__udySLAllocSCL(const uint8_t * Index, Word_t Value)
+{
+        Word_t len  = strlen((const char *) Index) + 1;
+        Pscl_t Pscl = (Pscl_t) JudyMalloc(JU_SL_SCLWORDS(len));
+
+        if (Pscl == (Pscl_t) NULL) return((Pscl_t) NULL);
+
+        Pscl->scl_Value = Value;
+        memcpy(Pscl->scl_Index, Index, len);
+        return(Pscl);
+
+} // j__udySLAllocSCL()
+
+
+static Word_t j__udySLFreeSCL(Pscl_t Pscl)
+{
+        Word_t words
+            = JU_SL_SCLWORDS(strlen((const char *) Pscl->scl_Index) + 1);
+
+        JudyFree((Pvoid_t) Pscl, words);
+        return(words * cJU_BYTESPERWORD);
+
+} // j__udySLFreeSCL()
+
+
+// ****************************************************************************
+// J U D Y   S L   G E T
+
+FUNCTION PPvoid_t JudySLGet
+        (
+        Pcvoid_t        PArray,         // from which to retrieve.
+        const uint8_t * Index,          // to retrieve.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        PPvoid_t        PPValue;
+        Word_t          word;
+
+        if (Index == (const uint8_t *) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPINDEX);
+            return(PPJERR);
+        }
+
+        for (;;)
+        {
+            if (PArray == (Pcvoid_t) NULL) return((PPvoid_t) NULL);
+
+            if (JU_SL_ISSCL(PArray))
+            {
+                Pscl_t Pscl = P_SCL(PArray);
+
+                if (strcmp((const char *) Pscl->scl_Index,
+                           (const char *) Index))
+                    return((PPvoid_t) NULL);
+
+                return((PPvoid_t) &(Pscl->scl_Value));
+            }
+
+            word    = j__udySLWord(Index);
+            PPValue = JudyLGet(PArray, word, PJError);
+
+            if (PPValue == (PPvoid_t) NULL || PPValue == PPJERR)
+                return(PPValue);
+
+            if (JU_SL_ISLAST(word)) return(PPValue);
+
+            PArray = *PPValue;
+            Index += cJU_BYTESPERWORD;
+        }
+
+} // JudySLGet()
+
+
+// ****************************************************************************
+// J U D Y   S L   I N S
+
+FUNCTION PPvoid_t JudySLIns
+        (
+        PPvoid_t        PPArray,        // in which to insert.
+        const uint8_t * Index,          // to insert.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        PPvoid_t        PPValue;
+        Word_t          word;
+
+        if (PPArray == (PPvoid_t) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPPARRAY);
+            return(PPJERR);
+        }
+        if (Index == (const uint8_t *) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPINDEX);
+            return(PPJERR);
+        }
+
+        for (;;)
+        {
+
+// Empty subtree; the rest of the string goes in a shortcut leaf:
+
+            if (*PPArray == (Pvoid_t) NULL)
+            {
+                Pscl_t Pscl = j__udySLAllocSCL(Index, 0);
+
+                if (Pscl == (Pscl_t) NULL)
+                {
+                    JU_SET_ERRNO(PJError, JU_ERRNO_NOMEM);
+                    return(PPJERR);
+                }
+
+                *PPArray = JU_SL_SETSCL(Pscl);
+                return((PPvoid_t) &(Pscl->scl_Value));
+            }
+
+// Shortcut leaf; either its the same string, or it needs to be pushed down a
+// level to make room for the new one:
+
+            if (JU_SL_ISSCL(*PPArray))
+            {
+                Pscl_t Pscl = P_SCL(*PPArray);
+                Pvoid_t PArray = (Pvoid_t) NULL;
+
+                if (! strcmp((const char *) Pscl->scl_Index,
+                             (const char *) Index))
+                    return((PPvoid_t) &(Pscl->scl_Value));
+
+                word    = j__udySLWord(Pscl->scl_Index);
+                PPValue = JudyLIns(&PArray, word, PJError);
+                if (PPValue == PPJERR) return(PPJERR);
+
+                if (JU_SL_ISLAST(word))
+                {
+                    *((PWord_t) PPValue) = Pscl->scl_Value;
+                }
+                else
+                {
+                    Pscl_t Pscl2
+                        = j__udySLAllocSCL(Pscl->scl_Index + cJU_BYTESPERWORD,
+                                           Pscl->scl_Value);
+
+                    if (Pscl2 == (Pscl_t) NULL)
+                    {
+                        JudyLFreeArray(&PArray, PJE0);
+                        JU_SET_ERRNO(PJError, JU_ERRNO_NOMEM);
+                        return(PPJERR);
+                    }
+
+                    *PPValue = JU_SL_SETSCL(Pscl2);
+                }
+
+                j__udySLFreeSCL(Pscl);
+                *PPArray = PArray;
+            }
+
+// JudyL level:
+
+            word    = j__udySLWord(Index);
+            PPValue = JudyLIns(PPArray, word, PJError);
+
+            if (PPValue == PPJERR || JU_SL_ISLAST(word)) return(PPValue);
+
+            PPArray = PPValue;
+            Index  += cJU_BYTESPERWORD;
+        }
+
+} // JudySLIns()
+
+
+// ****************************************************************************
+// J U D Y   S L   D E L
+//
+// Returns 1 if Index was deleted, 0 if it wasn't there, or JERRI.  Levels
+// that become empty are deleted on the way back up.
+
+static int j__udySLDel(PPvoid_t PPArray, const uint8_t * Index,
+                       PJError_t PJError)
+{
+        PPvoid_t PPValue;
+        Word_t   word;
+        int      retval;
+
+        if (*PPArray == (Pvoid_t) NULL) return(0);
+
+        if (JU_SL_ISSCL(*PPArray))
+        {
+            Pscl_t Pscl = P_SCL(*PPArray);
+
+            if (strcmp((const char *) Pscl->scl_Index, (const char *) Index))
+                return(0);
+
+            j__udySLFreeSCL(Pscl);
+            *PPArray = (Pvoid_t) NULL;
+            return(1);
+        }
+
+        word    = j__udySLWord(Index);
+        PPValue = JudyLGet(*PPArray, word, PJError);
+
+        if (PPValue == PPJERR) return(JERRI);
+        if (PPValue == (PPvoid_t) NULL) return(0);
+
+        if (! JU_SL_ISLAST(word))
+        {
+            retval = j__udySLDel(PPValue, Index + cJU_BYTESPERWORD, PJError);
+            if (retval != 1 || *PPValue != (Pvoid_t) NULL) return(retval);
+        }
+
+        return(JudyLDel(PPArray, word, PJError));
+
+} // j__udySLDel()
+
+
+FUNCTION int JudySLDel
+        (
+        PPvoid_t        PPArray,        // in which to delete.
+        const uint8_t * Index,          // to delete.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        if (PPArray == (PPvoid_t) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPPARRAY);
+            return(JERRI);
+        }
+        if (Index == (const uint8_t *) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPINDEX);
+            return(JERRI);
+        }
+
+        return(j__udySLDel(PPArray, Index, PJError));
+
+} // JudySLDel()
+
+
+// ****************************************************************************
+// J U D Y   S L   F I R S T / N E X T / L A S T / P R E V
+//
+// All four search from the string in Index (which must be big enough for the
+// longest string in the array) and replace it with the string found.
+
+// Find the first (Dir > 0) or last string in a non-empty subtree:
+
+static PPvoid_t j__udySLEnd(Pcvoid_t PArray, uint8_t * Index, int Dir)
+{
+        PPvoid_t PPValue;
+        Word_t   word;
+
+        for (;;)
+        {
+            if (JU_SL_ISSCL(PArray))
+            {
+                Pscl_t Pscl = P_SCL(PArray);
+
+                strcpy((char *) Index, (const char *) Pscl->scl_Index);
+                return((PPvoid_t) &(Pscl->scl_Value));
+            }
+
+            word    = (Dir > 0) ? 0 : cJU_ALLONES;
+            PPValue = (Dir > 0) ? JudyLFirst(PArray, &word, PJE0)
+                                : JudyLLast(PArray, &word, PJE0);
+
+            j__udySLUnpack(Index, word);
+            if (JU_SL_ISLAST(word)) return(PPValue);
+
+            PArray = *PPValue;
+            Index += cJU_BYTESPERWORD;
+        }
+
+} // j__udySLEnd()
+
+
+// Find the first string after (Dir > 0) or last string before the one in
+// Index, or equal to it if Inclusive:
+
+static PPvoid_t j__udySLSearch(Pcvoid_t PArray, uint8_t * Index,
+                               bool_t Inclusive, int Dir)
+{
+        PPvoid_t PPValue;
+        Word_t   word;
+
+        if (PArray == (Pcvoid_t) NULL) return((PPvoid_t) NULL);
+
+        if (JU_SL_ISSCL(PArray))
+        {
+            Pscl_t Pscl = P_SCL(PArray);
+            int    cmp  = strcmp((const char *) Pscl->scl_Index,
+                                 (const char *) Index) * Dir;
+
+            if ((cmp < 0) || ((cmp == 0) && ! Inclusive))
+                return((PPvoid_t) NULL);
+
+            strcpy((char *) Index, (const char *) Pscl->scl_Index);
+            return((PPvoid_t) &(Pscl->scl_Value));
+        }
+
+// Strings with the same word here:
+
+        word    = j__udySLWord(Index);
+        PPValue = JudyLGet(PArray, word, PJE0);
+
+        if (PPValue != (PPvoid_t) NULL)
+        {
+            if (JU_SL_ISLAST(word))
+            {
+                if (Inclusive) return(PPValue);
+            }
+            else
+            {
+                PPValue = j__udySLSearch(*PPValue, Index + cJU_BYTESPERWORD,
+                                         Inclusive, Dir);
+                if (PPValue != (PPvoid_t) NULL) return(PPValue);
+            }
+        }
+
+// Otherwise the first or last string under the next word along:
+
+        PPValue = (Dir > 0) ? JudyLNext(PArray, &word, PJE0)
+                            : JudyLPrev(PArray, &word, PJE0);
+
+        if (PPValue == (PPvoid_t) NULL) return((PPvoid_t) NULL);
+
+        j__udySLUnpack(Index, word);
+        if (JU_SL_ISLAST(word)) return(PPValue);
+
+        return(j__udySLEnd(*PPValue, Index + cJU_BYTESPERWORD, Dir));
+
+} // j__udySLSearch()
+
+
+#define JU_SL_SEARCH(Inclusive, Dir)                            \
+        if (Index == (uint8_t *) NULL)                          \
+        {                                                       \
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPINDEX);         \
+            return(PPJERR);                                     \
+        }                                                       \
+        return(j__udySLSearch(PArray, Index, Inclusive, Dir))
+
+FUNCTION PPvoid_t JudySLFirst(Pcvoid_t PArray, uint8_t * Index,
+                              PJError_t PJError)
+{
+        JU_SL_SEARCH(TRUE, 1);
+
+} // JudySLFirst()
+
+FUNCTION PPvoid_t JudySLNext(Pcvoid_t PArray, uint8_t * Index,
+                             PJError_t PJError)
+{
+        JU_SL_SEARCH(FALSE, 1);
+
+} // JudySLNext()
+
+FUNCTION PPvoid_t JudySLLast(Pcvoid_t PArray, uint8_t * Index,
+                             PJError_t PJError)
+{
+        JU_SL_SEARCH(TRUE, -1);
+
+} // JudySLLast()
+
+FUNCTION PPvoid_t JudySLPrev(Pcvoid_t PArray, uint8_t * Index,
+                             PJError_t PJError)
+{
+        JU_SL_SEARCH(FALSE, -1);
+
+} // JudySLPrev()
+
+
+// ****************************************************************************
+// J U D Y   S L   F R E E   A R R A Y   /   M E M   U S E D
+//
+// Both walk the whole tree; FreeArray() returns the bytes freed, like
+// JudyLFreeArray().
+
+static Word_t j__udySLWalk(PPvoid_t PPArray, bool_t Free)
+{
+        Pvoid_t  PArray = *PPArray;
+        PPvoid_t PPValue;
+        Word_t   word  = 0;
+        Word_t   bytes = 0;
+
+        if (PArray == (Pvoid_t) NULL) return(0);
+
+        if (JU_SL_ISSCL(PArray))
+        {
+            Pscl_t Pscl = P_SCL(PArray);
+
+            if (Free)
+            {
+                *PPArray = (Pvoid_t) NULL;
+                return(j__udySLFreeSCL(Pscl));
+            }
+            return(JU_SL_SCLWORDS(strlen((const char *) Pscl->scl_Index) + 1)
+                   * cJU_BYTESPERWORD);
+        }
+
+        for (PPValue = JudyLFirst(PArray, &word, PJE0);
+             PPValue != (PPvoid_t) NULL;
+             PPValue = JudyLNext(PArray, &word, PJE0))
+        {
+            if (! JU_SL_ISLAST(word)) bytes += j__udySLWalk(PPValue, Free);
+        }
+
+        if (Free) bytes += JudyLFreeArray(PPArray, PJE0);
+        else      bytes += JudyLMemUsed(PArray);
+
+        return(bytes);
+
+} // j__udySLWalk()
+
+
+FUNCTION Word_t JudySLFreeArray
+        (
+        PPvoid_t        PPArray,        // array to free.
+        PJError_t       PJError         // optional, for returning error info.
+        )
+{
+        if (PPArray == (PPvoid_t) NULL)
+        {
+            JU_SET_ERRNO(PJError, JU_ERRNO_NULLPPARRAY);
+            return(JERR);
+        }
+
+        return(j__udySLWalk(PPArray, TRUE));
+
+} // JudySLFreeArray()
+
+
+FUNCTION Word_t JudySLMemUsed(Pcvoid_t PArray)
+{
+        return(j__udySLWalk((PPvoid_t) &PArray, FALSE));
+
+} // JudySLMemUsed()
@@ -0,0 +1,517 @@
+/* concurrent_judyl.h                                              -*- C++ -*-
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Read-mostly concurrent JudyL map with lock-free readers.
+*/
+
+#ifndef __jml__judy__concurrent_judyl_h__
+#define __jml__judy__concurrent_judyl_h__
+
+#include "jml/judy/judyl_map.h"
+#include "jml/arch/atomic_ops.h"
+#include "jml/compiler/compiler.h"
+#include <boost/static_assert.hpp>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <sched.h>
+#include <stdlib.h>
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* CONCURRENT JUDYL                                                          */
+/*****************************************************************************/
+
+/** Map from words to values that any number of threads can read from
+    without locking while a writer modifies it.
+
+    A JudyL array is updated in place, so it can't be read while it's being
+    modified.  Instead, the key space is split into ranges, each held in its
+    own small JudyL array (a shard), and a root lists the ranges.  Published
+    roots and shards are never modified.  The writer copies the shards that
+    a change touches (splitting any that get too big), makes a new root that
+    points to the new shards and the untouched old ones, and publishes it
+    with a single pointer store.  This is path copying on a two level tree,
+    but the root is always copied whole: a commit costs the size of the
+    shards it touches plus the number of shards (for the root's shard list
+    and the JudyL index over it), not the size of the map.
+
+    Readers announce themselves in one of a set of counters (one per cache
+    line, spread over threads) for the current epoch before loading the
+    root.  After publishing a new root, the writer flips the epoch twice and
+    waits each time for the counters of the previous epoch to drain; once
+    that's done no reader can be looking at the old root or shards and
+    they're freed.  So readers never block, and while there are no more
+    threads than slots they only write to their own cache line; lookups
+    scale with the number of threads.  The writer does block
+    until readers are out, so Snapshot objects should be short lived.
+
+    Writes are serialized by a mutex.  Batching changes with update() gives
+    one copy and grace period for all of them.
+
+    Shards are split but never merged: a shard that empties is dropped, but
+    one that shrinks stays as a shard of its own however small it gets.
+    Under churn that moves the keys around (inserting in new ranges while
+    erasing from old ones), the number of shards, and so the cost of every
+    commit, can keep growing.  Such maps are better rebuilt from time to
+    time (copying the entries into a new map) than kept forever.
+
+    Values must be stored inline (trivially copyable, and no bigger than a
+    word) as shards share them when copied.
+*/
+
+template<typename Value>
+struct ConcurrentJudyL {
+
+    typedef JudyLValueOps<Value> ValueOps;
+
+    BOOST_STATIC_ASSERT(sizeof(Value) <= sizeof(Word_t)
+                        && boost::has_trivial_copy<Value>::value
+                        && boost::has_trivial_destructor<Value>::value);
+
+    /** Create.  Shards are split once they have more than twice
+        shardSize entries; smaller shards make single changes cheaper. */
+    explicit ConcurrentJudyL(size_t shardSize = 1024, int numReaderSlots = 64)
+        : root(0), epoch(0), shardSize(std::max<size_t>(shardSize, 1)),
+          numReaderSlots(std::max(numReaderSlots, 1)), readerSlots(0)
+    {
+        void * mem = 0;
+        int res = posix_memalign(&mem, 64,
+                                 this->numReaderSlots * sizeof(ReaderSlot));
+        if (res != 0)
+            throw Exception("ConcurrentJudyL: couldn't allocate reader slots");
+        readerSlots = reinterpret_cast<ReaderSlot *>(mem);
+        for (int i = 0;  i < this->numReaderSlots;  ++i)
+            new (readerSlots + i) ReaderSlot();
+
+        std::unique_ptr<Root> newRoot(new Root());
+        std::unique_ptr<Shard> newShard(new Shard());
+        newRoot->lowKeys.push_back(0);
+        newRoot->shards.push_back(newShard.get());
+        newShard.release();
+        newRoot->finish();
+        root = newRoot.release();
+    }
+
+    ~ConcurrentJudyL()
+    {
+        for (Shard * shard: root->shards)
+            delete shard;
+        delete root;
+        free(readerSlots);
+    }
+
+    ConcurrentJudyL(const ConcurrentJudyL & other) = delete;
+    void operator = (const ConcurrentJudyL & other) = delete;
+
+    /** Changes to apply together, in the order they were added. */
+    struct Batch {
+        void insert(Word_t key, const Value & value)
+        {
+            Word_t slot;
+            ValueOps::init(slot, value);
+            ops.push_back(Op(key, slot, false));
+        }
+
+        void erase(Word_t key)
+        {
+            ops.push_back(Op(key, 0, true));
+        }
+
+        bool empty() const { return ops.empty(); }
+
+    private:
+        friend class ConcurrentJudyL;
+
+        struct Op {
+            Op(Word_t key, Word_t slot, bool isErase)
+                : key(key), slot(slot), isErase(isErase)
+            {
+            }
+
+            Word_t key;
+            Word_t slot;
+            bool isErase;
+
+            bool operator < (const Op & other) const
+            {
+                return key < other.key;
+            }
+        };
+
+        std::vector<Op> ops;
+    };
+
+    /** Insert or replace the value for the key. */
+    void insert(Word_t key, const Value & value)
+    {
+        Batch batch;
+        batch.insert(key, value);
+        update(batch);
+    }
+
+    void erase(Word_t key)
+    {
+        Batch batch;
+        batch.erase(key);
+        update(batch);
+    }
+
+    /** Apply the changes and publish them all at once. */
+    void update(Batch & batch)
+    {
+        if (batch.empty()) return;
+
+        // Sorted by key, keeping the last change to each key
+        std::stable_sort(batch.ops.begin(), batch.ops.end());
+        std::vector<typename Batch::Op> ops;
+        for (unsigned i = 0;  i < batch.ops.size();  ++i) {
+            if (i + 1 < batch.ops.size()
+                && batch.ops[i + 1].key == batch.ops[i].key)
+                continue;
+            ops.push_back(batch.ops[i]);
+        }
+
+        std::unique_lock<std::mutex> guard(writeLock);
+        commit(ops);
+    }
+
+    size_t size() const
+    {
+        ReadGuard guard(this);
+        return guard.root->size;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    /** Copy the value for the key into value.  Returns false if it isn't
+        there. */
+    bool find(Word_t key, Value & value) const
+    {
+        ReadGuard guard(this);
+        return find(guard.root, key, value);
+    }
+
+    size_t count(Word_t key) const
+    {
+        Value value;
+        return find(key, value);
+    }
+
+    struct Snapshot;
+
+    /** Take a snapshot of the map as it is now. */
+    Snapshot snapshot() const { return Snapshot(this); }
+
+    /** Number of shards, for testing. */
+    size_t numShards() const
+    {
+        ReadGuard guard(this);
+        return guard.root->shards.size();
+    }
+
+private:
+    /** A JudyL array over part of the key space; immutable once
+        published. */
+    struct Shard {
+        Shard()
+            : array(0), size(0)
+        {
+        }
+
+        ~Shard()
+        {
+            JudyLFreeArray(&array, PJE0);
+        }
+
+        Pvoid_t array;
+        size_t size;
+    };
+
+    /** Shard i holds the keys from lowKeys[i] up to lowKeys[i + 1].  The
+        index maps each lowKey to its shard; a JudyL lookup is much cheaper
+        than a binary search over the low keys, whose branches can't be
+        predicted. */
+    struct Root {
+        Root()
+            : size(0), index(0)
+        {
+        }
+
+        ~Root()
+        {
+            JudyLFreeArray(&index, PJE0);
+        }
+
+        std::vector<Word_t> lowKeys;
+        std::vector<Shard *> shards;
+        size_t size;
+        Pvoid_t index;
+
+        /** Build the index once the shards are all there. */
+        void finish()
+        {
+            JError_t error;
+            if (JudyLInsArray(&index, lowKeys.size(), &lowKeys[0],
+                              (const Word_t *)&shards[0], &error)
+                == (int)JERR)
+                throw Exception("JudyLInsArray: error %d", JU_ERRNO(&error));
+        }
+
+        const Shard * shardFor(Word_t key) const
+        {
+            PPvoid_t val = JudyLLast(index, &key, PJE0);
+            return *(const Shard **)val;
+        }
+
+        size_t shardNumFor(Word_t key) const
+        {
+            return std::upper_bound(lowKeys.begin(), lowKeys.end(), key)
+                - lowKeys.begin() - 1;
+        }
+    };
+
+    struct ReaderSlot {
+        ReaderSlot()
+        {
+            count[0] = count[1] = 0;
+        }
+
+        volatile ssize_t count[2];
+    } JML_ALIGNED(64);
+
+    /** Counts a reader in for the current epoch while it exists. */
+    struct ReadGuard {
+        ReadGuard(const ConcurrentJudyL * owner)
+        {
+            slot = owner->readerSlots + threadSlot(owner->numReaderSlots);
+            parity = owner->epoch & 1;
+            __sync_fetch_and_add(&slot->count[parity], 1);
+            root = owner->root;
+        }
+
+        ReadGuard(ReadGuard && other)
+            : slot(other.slot), parity(other.parity), root(other.root)
+        {
+            other.slot = 0;
+        }
+
+        ~ReadGuard()
+        {
+            if (slot)
+                __sync_fetch_and_sub(&slot->count[parity], 1);
+        }
+
+        ReadGuard(const ReadGuard & other) = delete;
+        void operator = (const ReadGuard & other) = delete;
+
+        ReaderSlot * slot;
+        int parity;
+        const Root * root;
+    };
+
+    const Root * volatile root;
+    volatile int epoch;
+    size_t shardSize;
+    int numReaderSlots;
+    ReaderSlot * readerSlots;
+    std::mutex writeLock;
+
+    /** Threads are numbered in the order that they first read, so that
+        they get their own reader slot until there are more threads than
+        slots. */
+    static int threadSlot(int numSlots)
+    {
+        static int numThreads = 0;
+        static __thread int threadNum = -1;
+        if (JML_UNLIKELY(threadNum == -1))
+            threadNum = __sync_fetch_and_add(&numThreads, 1);
+        return threadNum % numSlots;
+    }
+
+    static bool find(const Root * root, Word_t key, Value & value)
+    {
+        const Shard * shard = root->shardFor(key);
+        Word_t * slot = (Word_t *)JudyLGet(shard->array, key, PJE0);
+        if (!slot) return false;
+        value = ValueOps::get(*slot);
+        return true;
+    }
+
+    /** Wait until no reader can still be using something that was
+        reachable before the last root was published.  Flipping once isn't
+        enough: a reader that read the old epoch before the flip may only
+        count itself in after the wait, and would then be missed by the
+        following grace period. */
+    void synchronize()
+    {
+        for (int phase = 0;  phase < 2;  ++phase) {
+            int old = epoch & 1;
+            epoch = epoch + 1;
+            memory_barrier();
+            for (int i = 0;  i < numReaderSlots;  ++i)
+                while (readerSlots[i].count[old] != 0)
+                    sched_yield();
+        }
+    }
+
+    typedef typename Batch::Op Op;
+
+    /** Make shards holding the entries of the given shard with the sorted
+        ops applied, splitting if it gets too big. */
+    void rebuild(const Shard * shard, Word_t lowKey,
+                 const Op * first, const Op * last,
+                 std::vector<Word_t> & lowKeys, std::vector<Shard *> & shards)
+    {
+        std::vector<Word_t> keys, slots;
+        keys.reserve(shard->size + (last - first));
+        slots.reserve(shard->size + (last - first));
+
+        Word_t key = 0;
+        PPvoid_t val = JudyLFirst(shard->array, &key, PJE0);
+        while (val || first != last) {
+            if (first == last || (val && key < first->key)) {
+                keys.push_back(key);
+                slots.push_back(*(Word_t *)val);
+                val = JudyLNext(shard->array, &key, PJE0);
+                continue;
+            }
+            if (val && key == first->key)
+                val = JudyLNext(shard->array, &key, PJE0);
+            if (!first->isErase) {
+                keys.push_back(first->key);
+                slots.push_back(first->slot);
+            }
+            ++first;
+        }
+
+        size_t n = keys.size();
+        size_t numParts = n > 2 * shardSize ? n / shardSize : 1;
+
+        for (size_t part = 0;  part < numParts && n > 0;  ++part) {
+            size_t start = n * part / numParts, end = n * (part + 1) / numParts;
+            std::unique_ptr<Shard> newShard(new Shard());
+            newShard->size = end - start;
+            JError_t error;
+            if (JudyLInsArray(&newShard->array, end - start, &keys[start],
+                              &slots[start], &error) == (int)JERR)
+                throw Exception("JudyLInsArray: error %d", JU_ERRNO(&error));
+            lowKeys.push_back(part == 0 ? lowKey : keys[start]);
+            shards.push_back(newShard.get());
+            newShard.release();
+        }
+    }
+
+    void commit(const std::vector<Op> & ops)
+    {
+        const Root * oldRoot = root;
+        std::unique_ptr<Root> newRoot(new Root());
+        std::vector<Shard *> replaced;
+
+        try {
+            size_t i = 0;
+            for (size_t s = 0;  s < oldRoot->shards.size();  ++s) {
+                Shard * shard = oldRoot->shards[s];
+                bool isLast = s + 1 == oldRoot->shards.size();
+                size_t j = i;
+                while (j < ops.size()
+                       && (isLast || ops[j].key < oldRoot->lowKeys[s + 1]))
+                    ++j;
+
+                if (i == j) {
+                    newRoot->lowKeys.push_back(oldRoot->lowKeys[s]);
+                    newRoot->shards.push_back(shard);
+                }
+                else {
+                    rebuild(shard, oldRoot->lowKeys[s], &ops[i], &ops[0] + j,
+                            newRoot->lowKeys, newRoot->shards);
+                    replaced.push_back(shard);
+                }
+                i = j;
+            }
+
+            // The first shard always starts at zero, and there's always one
+            if (newRoot->shards.empty()) {
+                std::unique_ptr<Shard> newShard(new Shard());
+                newRoot->lowKeys.push_back(0);
+                newRoot->shards.push_back(newShard.get());
+                newShard.release();
+            }
+            newRoot->lowKeys[0] = 0;
+
+            for (const Shard * shard: newRoot->shards)
+                newRoot->size += shard->size;
+
+            newRoot->finish();
+        } catch (...) {
+            for (Shard * shard: newRoot->shards)
+                if (std::find(oldRoot->shards.begin(), oldRoot->shards.end(),
+                              shard) == oldRoot->shards.end())
+                    delete shard;
+            throw;
+        }
+
+        memory_barrier();
+        root = newRoot.release();
+
+        synchronize();
+
+        for (Shard * shard: replaced)
+            delete shard;
+        delete oldRoot;
+    }
+
+public:
+    /** Consistent read-only view of the map as it was when it was taken.
+        The writer can't free anything while a snapshot exists, so it will
+        wait for it to be destroyed before its next change completes; a
+        thread must not modify the map while it holds one itself. */
+    struct Snapshot {
+        Snapshot(const ConcurrentJudyL * owner)
+            : guard(owner)
+        {
+        }
+
+        size_t size() const { return guard.root->size; }
+
+        bool find(Word_t key, Value & value) const
+        {
+            return ConcurrentJudyL::find(guard.root, key, value);
+        }
+
+        size_t count(Word_t key) const
+        {
+            Value value;
+            return find(key, value);
+        }
+
+        /** Call fn(key, value) for each entry with key in [lo, hi], in key
+            order. */
+        template<typename Fn>
+        void forEach(Fn fn, Word_t lo = 0, Word_t hi = -1) const
+        {
+            const Root * root = guard.root;
+            size_t i = root->shardNumFor(lo);
+            for (;  i < root->shards.size();  ++i) {
+                if (root->lowKeys[i] > hi) break;
+                Pvoid_t array = root->shards[i]->array;
+                Word_t key = lo;
+                for (PPvoid_t val = JudyLFirst(array, &key, PJE0);
+                     val && key <= hi;  val = JudyLNext(array, &key, PJE0))
+                    fn(key, ValueOps::get(*(Word_t *)val));
+            }
+        }
+
+    private:
+        ReadGuard guard;
+    };
+
+};
+
+} // namespace ML
+
+#endif /* __jml__judy__concurrent_judyl_h__ */
@@ -1,4 +1,5 @@
 LIBJUDY_SOURCES := \
+        Judy1.cc \
         JudyLByCount.cc \
         JudyLCreateBranch.cc \
         JudyLCascade.cc \
@@ -9,6 +10,7 @@ LIBJUDY_SOURCES := \
         JudyLFirst.cc \
         JudyLFreeArray.cc \
         JudyLGet.cc \
+        JudyLGetBatch.cc \
         JudyLIns.cc \
         JudyLInsArray.cc \
         JudyLInsertBranch.cc \
@@ -21,10 +23,13 @@ LIBJUDY_SOURCES := \
         JudyLPrevEmpty.cc \
         JudyLTables.cc \
         JudyLTablesGen.cc \
+        JudySL.cc \
         j__udyLGet.cc
 
-LIBJUDY_LINK :=
+LIBJUDY_LINK := pthread
 
 $(eval $(call set_compile_option,$(LIBJUDY_SOURCES),-fno-strict-aliasing))
 
 $(eval $(call library,judy,$(LIBJUDY_SOURCES),$(LIBJUDY_LINK)))
+
+$(eval $(call include_sub_make,judy_testing,testing))
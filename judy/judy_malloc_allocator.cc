@@ -1,17 +1,411 @@
-#include <memory>
+/* judy_malloc_allocator.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Size-class slab allocator behind JudyMalloc() and JudyFree().
+
+   Judy only ever allocates a few dozen distinct node sizes (see the
+   *PopToWords tables in JudyLTables.cc), and always tells us the size when
+   it frees.  So each word count up to MAX_SLAB_WORDS is its own size class,
+   whose blocks are cut out of aligned chunks with no per-block header.  A
+   block's chunk is found by masking its address, and each chunk keeps its
+   own free list and count of blocks in use.  Chunks are cut out of large
+   mmap()ed regions.  When a chunk becomes empty it goes into a pool that
+   any size class can take from, which stops memory from getting stuck in
+   size classes that an array has grown out of.
+
+   Each thread also keeps a small private cache of blocks per size class so
+   that the common case takes no lock; blocks move between the thread caches
+   and the chunks in batches.
+*/
+
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
 #include "Judy.h"
+#include "jml/arch/spinlock.h"
+#include "jml/compiler/compiler.h"
+#include <atomic>
+#include <mutex>
+
+
+using namespace std;
+using namespace ML;
+
+
+namespace {
+
+enum {
+    MAX_SLAB_WORDS = 256,        ///< Largest size class; bigger use malloc()
+    CHUNK_BYTES = 16 * 1024,     ///< Size and alignment of chunks
+    REGION_BYTES = 4 * 1024 * 1024, ///< Chunks are mapped this many at once
+    MAX_EMPTY_CHUNKS = 64,       ///< Empty chunks kept before decommitting
+    CACHE_BYTES = 16 * 1024      ///< Max bytes per thread per size class
+};
+
+struct Free_Block {
+    Free_Block * next;
+};
+
+/** Singly linked list of free blocks. */
+struct Block_List {
+    Block_List()
+        : head(0), count(0)
+    {
+    }
+
+    Free_Block * head;
+    size_t count;
+
+    void push(void * mem)
+    {
+        Free_Block * block = (Free_Block *)mem;
+        block->next = head;
+        head = block;
+        ++count;
+    }
+
+    void * pop()
+    {
+        Free_Block * block = head;
+        head = block->next;
+        --count;
+        return block;
+    }
+};
+
+/** Header at the start of each chunk.  The rest of the chunk is blocks of
+    a single size class. */
+struct Chunk {
+    void init(size_t words)
+    {
+        this->words = words;
+        capacity = (CHUNK_BYTES - sizeof(Chunk)) / (words * sizeof(Word_t));
+        used = 0;
+        bump = (char *)(this + 1);
+        free = 0;
+        prev = next = 0;
+    }
+
+    Free_Block * free;        ///< Blocks that were given back
+    char * bump;              ///< Next block that has never been used
+    unsigned words;           ///< Size class
+    unsigned capacity;        ///< Number of blocks that fit
+    unsigned used;            ///< Number of blocks given out
+    Chunk * prev;             ///< Links in the class's list of partial chunks
+    Chunk * next;
+} JML_ALIGNED(64);
+
+inline Chunk * chunkOf(void * block)
+{
+    return (Chunk *)((size_t)block & ~(size_t)(CHUNK_BYTES - 1));
+}
+
+/** A size class, with its list of chunks that have free blocks.  The
+    constructor is constexpr so that classes[] is initialized before any
+    code runs: JudyMalloc() may be called from static constructors in
+    other files, and a dynamic initializer running after them would wipe
+    out their chunks. */
+struct Size_Class {
+    constexpr Size_Class()
+        : partial(0), used(0)
+    {
+    }
+
+    Spinlock lock;
+    Chunk * partial;
+    size_t used;              ///< Blocks given out, including thread caches
+};
+
+Size_Class classes[MAX_SLAB_WORDS + 1];
+
+Spinlock emptyLock;
+Chunk * emptyChunks = 0;            ///< Empty chunks with memory behind them
+size_t numEmptyChunks = 0;
+Chunk * decommittedChunks = 0;      ///< Empty chunks given back to the OS
+char * regionPos = 0;               ///< Chunks not yet used in the region
+char * regionEnd = 0;
+
+size_t bytesReserved = 0;           ///< Updated atomically
+size_t bytesLarge = 0;              ///< Updated atomically
+
+/** Map a new region of chunks, aligned to the chunk size.  Called with
+    emptyLock held. */
+bool newRegion()
+{
+    size_t bytes = REGION_BYTES + CHUNK_BYTES;
+    void * mem = mmap(0, bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return false;
+
+    // Trim to alignment
+    char * start = (char *)mem;
+    char * aligned = (char *)(((size_t)start + CHUNK_BYTES - 1)
+                              & ~(size_t)(CHUNK_BYTES - 1));
+    if (aligned != start)
+        munmap(start, aligned - start);
+    char * end = aligned + REGION_BYTES;
+    if (end != start + bytes)
+        munmap(end, start + bytes - end);
+
+    regionPos = aligned;
+    regionEnd = end;
+    return true;
+}
+
+/** Get an empty chunk: one that was recently emptied if possible, or
+    otherwise one that's been given back to the OS, or otherwise a new
+    one. */
+Chunk * getChunk()
+{
+    std::lock_guard<Spinlock> guard(emptyLock);
+
+    Chunk * chunk = emptyChunks;
+    if (chunk) {
+        emptyChunks = chunk->next;
+        --numEmptyChunks;
+        return chunk;
+    }
+
+    if (decommittedChunks) {
+        chunk = decommittedChunks;
+        decommittedChunks = chunk->next;
+    }
+    else {
+        if (regionPos == regionEnd && !newRegion())
+            return 0;
+        chunk = (Chunk *)regionPos;
+        regionPos += CHUNK_BYTES;
+    }
+
+    __sync_fetch_and_add(&bytesReserved, (size_t)CHUNK_BYTES);
+    return chunk;
+}
+
+/** Put an empty chunk back in the pool, giving its memory back to the OS
+    if the pool is full. */
+void putChunk(Chunk * chunk)
+{
+    std::lock_guard<Spinlock> guard(emptyLock);
+
+    if (numEmptyChunks < MAX_EMPTY_CHUNKS) {
+        chunk->next = emptyChunks;
+        emptyChunks = chunk;
+        ++numEmptyChunks;
+        return;
+    }
+
+    // The chunk keeps its address space so that we only need to remember
+    // it in the list, which touches the first page again.
+    madvise(chunk, CHUNK_BYTES, MADV_DONTNEED);
+    chunk->next = decommittedChunks;
+    decommittedChunks = chunk;
+    __sync_fetch_and_add(&bytesReserved, -(size_t)CHUNK_BYTES);
+}
+
+void unlinkChunk(Size_Class & sc, Chunk * chunk)
+{
+    if (chunk->prev) chunk->prev->next = chunk->next;
+    else sc.partial = chunk->next;
+    if (chunk->next) chunk->next->prev = chunk->prev;
+    chunk->prev = chunk->next = 0;
+}
+
+void linkChunk(Size_Class & sc, Chunk * chunk)
+{
+    chunk->prev = 0;
+    chunk->next = sc.partial;
+    if (sc.partial) sc.partial->prev = chunk;
+    sc.partial = chunk;
+}
+
+/** Allocate up to n blocks of the size class onto the list.  Returns
+    false if there is no memory. */
+bool allocBlocks(size_t words, Block_List & list, size_t n)
+{
+    Size_Class & sc = classes[words];
+    std::lock_guard<Spinlock> guard(sc.lock);
+
+    for (size_t i = 0;  i < n;  ++i) {
+        Chunk * chunk = sc.partial;
+        if (!chunk) {
+            // Don't fail if we already got some
+            if (!(chunk = getChunk()))
+                return i > 0;
+            chunk->init(words);
+            linkChunk(sc, chunk);
+        }
+
+        if (chunk->free) {
+            Free_Block * block = chunk->free;
+            chunk->free = block->next;
+            list.push(block);
+        }
+        else {
+            list.push(chunk->bump);
+            chunk->bump += words * sizeof(Word_t);
+        }
+
+        ++sc.used;
+        if (++chunk->used == chunk->capacity)
+            unlinkChunk(sc, chunk);
+    }
+
+    return true;
+}
+
+/** Give all of the blocks on the list back to their chunks. */
+void freeBlocks(size_t words, Block_List & list)
+{
+    if (!list.head) return;
+
+    Size_Class & sc = classes[words];
+    std::lock_guard<Spinlock> guard(sc.lock);
+
+    while (list.head) {
+        Free_Block * block = (Free_Block *)list.pop();
+        Chunk * chunk = chunkOf(block);
+
+        block->next = chunk->free;
+        chunk->free = block;
+
+        --sc.used;
+        if (chunk->used-- == chunk->capacity)
+            linkChunk(sc, chunk);
+
+        // Empty chunks go back to the pool, unless it's the only one left
+        // in the class (so that a single block going back and forth
+        // doesn't keep on moving it).
+        if (chunk->used == 0 && (chunk->prev || chunk->next)) {
+            unlinkChunk(sc, chunk);
+            putChunk(chunk);
+        }
+    }
+}
+
+/** Number of blocks moved from the chunks to a thread cache at once; the
+    cache gives everything back once it holds twice this many. */
+inline size_t batchSize(size_t words)
+{
+    size_t result = CACHE_BYTES / 2 / (words * sizeof(Word_t));
+    return result ? result : 1;
+}
+
+inline size_t cacheLimit(size_t words)
+{
+    return 2 * batchSize(words);
+}
+
+/** Thread private cache of free blocks. */
+struct Thread_Cache {
+    Thread_Cache()
+        : prev(0), next(0)
+    {
+    }
+
+    Block_List free[MAX_SLAB_WORDS + 1];
 
-#if 0
+    Thread_Cache * prev;
+    Thread_Cache * next;
+};
+
+/** Set by JudyMallocSetPerThread(), which can be called at any time;
+    each call to JudyMalloc() or JudyFree() sees one value or the other. */
+std::atomic<bool> perThread(true);
+
+Spinlock cachesLock;
+Thread_Cache * caches = 0;          ///< All live thread caches, for stats
+size_t numCaches = 0;
+
+__thread Thread_Cache * threadCache = 0;
+__thread int bulkFreeDepth = 0;
+
+pthread_key_t cacheKey;
+pthread_once_t cacheKeyOnce = PTHREAD_ONCE_INIT;
+
+void destroyCache(void * arg)
+{
+    Thread_Cache * cache = reinterpret_cast<Thread_Cache *>(arg);
+
+    for (unsigned words = 1;  words <= MAX_SLAB_WORDS;  ++words)
+        freeBlocks(words, cache->free[words]);
+
+    {
+        std::lock_guard<Spinlock> guard(cachesLock);
+        if (cache->prev) cache->prev->next = cache->next;
+        else caches = cache->next;
+        if (cache->next) cache->next->prev = cache->prev;
+        --numCaches;
+    }
+
+    if (threadCache == cache)
+        threadCache = 0;
+    delete cache;
+}
+
+void createCacheKey()
+{
+    pthread_key_create(&cacheKey, destroyCache);
+}
+
+Thread_Cache * getThreadCache()
+{
+    if (JML_LIKELY(threadCache != 0))
+        return threadCache;
+
+    Thread_Cache * cache = new (std::nothrow) Thread_Cache();
+    if (!cache) return 0;
+
+    pthread_once(&cacheKeyOnce, createCacheKey);
+    pthread_setspecific(cacheKey, cache);
+
+    {
+        std::lock_guard<Spinlock> guard(cachesLock);
+        cache->next = caches;
+        if (caches) caches->prev = cache;
+        caches = cache;
+        ++numCaches;
+    }
+
+    return threadCache = cache;
+}
+
+} // file scope
 
-static std::allocator<Word_t> judy_allocator;
 
 extern "C" {
-    
+
+// ****************************************************************************
+// J U D Y   M A L L O C
+//
+// Returns 0 when out of memory; Judy turns that into JU_ERRNO_NOMEM.
+
 Word_t JudyMalloc(
 	Word_t Words)
 {
-    return (Word_t)judy_allocator.allocate(Words);
+    if (JML_UNLIKELY(Words > MAX_SLAB_WORDS || Words == 0)) {
+        Word_t Addr = (Word_t) malloc(Words * sizeof(Word_t));
+        if (Addr) __sync_fetch_and_add(&bytesLarge, Words * sizeof(Word_t));
+        return Addr;
+    }
+
+    Thread_Cache * cache
+        = perThread.load(std::memory_order_relaxed) ? getThreadCache() : 0;
+
+    if (!cache) {
+        Block_List list;
+        if (!allocBlocks(Words, list, 1)) return 0;
+        return (Word_t) list.pop();
+    }
+
+    Block_List & list = cache->free[Words];
+    if (JML_UNLIKELY(!list.head)
+        && !allocBlocks(Words, list, batchSize(Words)))
+        return 0;
+
+    return (Word_t) list.pop();
+
 } // JudyMalloc()
 
 
@@ -22,7 +416,30 @@ void JudyFree(
 	void * PWord,
 	Word_t Words)
 {
-    return judy_allocator.deallocate((Word_t *)PWord, Words);
+    if (JML_UNLIKELY(Words > MAX_SLAB_WORDS || Words == 0)) {
+        __sync_fetch_and_add(&bytesLarge, -(Words * sizeof(Word_t)));
+        free(PWord);
+        return;
+    }
+
+    Thread_Cache * cache
+        = (perThread.load(std::memory_order_relaxed) || bulkFreeDepth)
+        ? getThreadCache() : 0;
+
+    if (!cache) {
+        Block_List list;
+        list.push(PWord);
+        freeBlocks(Words, list);
+        return;
+    }
+
+    Block_List & list = cache->free[Words];
+    list.push(PWord);
+
+    // In bulk mode, the whole lot goes back at the end
+    if (JML_UNLIKELY(list.count > cacheLimit(Words)) && !bulkFreeDepth)
+        freeBlocks(Words, list);
+
 } // JudyFree()
 
 
@@ -53,8 +470,81 @@ void JudyFreeVirtual(
 
 } // JudyFreeVirtual()
 
-} // extern "C"
 
-#endif
+// ****************************************************************************
+// B U L K   F R E E
+
+void JudyMallocBeginBulkFree(void)
+{
+    ++bulkFreeDepth;
+
+} // JudyMallocBeginBulkFree()
+
+
+void JudyMallocEndBulkFree(void)
+{
+    if (--bulkFreeDepth > 0) return;
+
+    Thread_Cache * cache = threadCache;
+    if (!cache) return;
+
+    // Give back everything that went over the thread's normal cache size
+    // (or everything if there are no thread caches) in one go per size
+    // class.
+    for (unsigned words = 1;  words <= MAX_SLAB_WORDS;  ++words) {
+        Block_List & list = cache->free[words];
+        if (!perThread.load(std::memory_order_relaxed)
+            || list.count > cacheLimit(words))
+            freeBlocks(words, list);
+    }
+
+} // JudyMallocEndBulkFree()
 
 
+// ****************************************************************************
+// S T A T I S T I C S
+
+void JudyMallocStats(
+	PJudyMallocStats_t PStats)
+{
+    Word_t usedWords = 0;
+
+    for (unsigned words = 1;  words <= MAX_SLAB_WORDS;  ++words) {
+        std::lock_guard<Spinlock> guard(classes[words].lock);
+        usedWords += classes[words].used * words;
+    }
+
+    // Reading other threads' counts is racy, but only gives an approximate
+    // answer and not a crash.
+    size_t numThreads = 0;
+    {
+        std::lock_guard<Spinlock> guard(cachesLock);
+        for (Thread_Cache * c = caches;  c;  c = c->next) {
+            for (unsigned words = 1;  words <= MAX_SLAB_WORDS;  ++words)
+                usedWords -= c->free[words].count * words;
+        }
+        numThreads = numCaches;
+    }
+
+    PStats->jms_BytesReserved = bytesReserved;
+    PStats->jms_BytesInUse = usedWords * sizeof(Word_t);
+    PStats->jms_BytesCached = bytesReserved - PStats->jms_BytesInUse;
+    PStats->jms_BytesLarge = bytesLarge;
+    PStats->jms_NumThreadCaches = numThreads;
+
+} // JudyMallocStats()
+
+
+void JudyMallocSetPerThread(
+	int Enable)
+{
+    perThread.store(Enable, std::memory_order_relaxed);
+
+    if (!Enable && threadCache) {
+        pthread_setspecific(cacheKey, 0);
+        destroyCache(threadCache);
+    }
+
+} // JudyMallocSetPerThread()
+
+} // extern "C"
@@ -0,0 +1,277 @@
+/* judy_set.h                                                      -*- C++ -*-
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   C++ ordered set interface to a Judy1 array.
+*/
+
+#ifndef __jml__judy__judy_set_h__
+#define __jml__judy__judy_set_h__
+
+#include "jml/judy/Judy.h"
+#include "jml/arch/exception.h"
+#include <boost/iterator/iterator_facade.hpp>
+#include <utility>
+
+namespace ML {
+
+struct JudySet;
+
+
+/*****************************************************************************/
+/* JUDY SET ITERATOR                                                         */
+/*****************************************************************************/
+
+struct JudySetIterator
+    : public boost::iterator_facade<JudySetIterator,
+                                    const Word_t,
+                                    boost::bidirectional_traversal_tag,
+                                    Word_t> {
+
+    JudySetIterator()
+        : set(0), key(0), atEnd(true)
+    {
+    }
+
+    JudySetIterator(const JudySet * set, Word_t key, bool atEnd)
+        : set(set), key(key), atEnd(atEnd)
+    {
+    }
+
+private:
+    friend class boost::iterator_core_access;
+
+    const JudySet * set;
+    Word_t key;
+    bool atEnd;
+
+    bool equal(const JudySetIterator & other) const
+    {
+        if (set != other.set)
+            throw Exception("comparing JudySet iterators from different sets");
+        if (atEnd || other.atEnd)
+            return atEnd == other.atEnd;
+        return key == other.key;
+    }
+
+    Word_t dereference() const
+    {
+        if (atEnd)
+            throw Exception("dereferencing JudySet end iterator");
+        return key;
+    }
+
+    inline void increment();
+    inline void decrement();
+};
+
+
+/*****************************************************************************/
+/* JUDY SET                                                                  */
+/*****************************************************************************/
+
+/** Ordered set of words (eg 64 bit ids), implemented with a Judy1 array.
+    Costs a fraction of a byte per element for dense or clustered ids,
+    such as ids allocated sequentially or in ranges.
+
+    It is not a replacement for a hash set of ids scattered over the whole
+    64 bits.  Each key that is alone in its block of 64 costs a JudyL entry
+    and a whole bitmap word, which is about 22 bytes against 13 or so for
+    Lightweight_Hash_Set<uint64_t>, and it's about twice as slow (see
+    judy_set_benchmark).  Use it when most keys have neighbours.
+
+    Iterators are invalidated by any insertion or deletion.
+*/
+
+struct JudySet {
+
+    typedef Word_t key_type;
+    typedef Word_t value_type;
+    typedef JudySetIterator iterator;
+    typedef JudySetIterator const_iterator;
+
+    JudySet()
+        : array(0), size_(0)
+    {
+    }
+
+    JudySet(const JudySet & other)
+        : array(0), size_(other.size_)
+    {
+        // The union with an empty set copies it without inserting each key.
+        // The destructor won't run if we throw, so free anything built.
+        try {
+            JError_t error;
+            if (Judy1Union(&array, other.array, 0, &error) == (int)JERR)
+                throw Exception("Judy1Union: error %d", JU_ERRNO(&error));
+        } catch (...) {
+            Judy1FreeArray(&array, PJE0);
+            throw;
+        }
+    }
+
+    JudySet(JudySet && other)
+        : array(other.array), size_(other.size_)
+    {
+        other.array = 0;
+        other.size_ = 0;
+    }
+
+    ~JudySet()
+    {
+        clear();
+    }
+
+    JudySet & operator = (const JudySet & other)
+    {
+        JudySet new_me(other);
+        swap(new_me);
+        return *this;
+    }
+
+    JudySet & operator = (JudySet && other)
+    {
+        JudySet new_me(std::move(other));
+        swap(new_me);
+        return *this;
+    }
+
+    void swap(JudySet & other)
+    {
+        std::swap(array, other.array);
+        std::swap(size_, other.size_);
+    }
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    void clear()
+    {
+        Judy1FreeArray(&array, PJE0);
+        size_ = 0;
+    }
+
+    /** Number of bytes of memory used by the array. */
+    size_t memusage() const
+    {
+        return Judy1MemUsed(array);
+    }
+
+    /** Insert the key.  Returns an iterator to it and whether it was
+        added. */
+    std::pair<iterator, bool> insert(Word_t key)
+    {
+        JError_t error;
+        int res = Judy1Set(&array, key, &error);
+        if (res == (int)JERR)
+            throw Exception("Judy1Set: error %d", JU_ERRNO(&error));
+        size_ += res;
+        return std::make_pair(iterator(this, key, false), res == 1);
+    }
+
+    /** Remove the key.  Returns the number of keys removed. */
+    size_t erase(Word_t key)
+    {
+        JError_t error;
+        int res = Judy1Unset(&array, key, &error);
+        if (res == (int)JERR)
+            throw Exception("Judy1Unset: error %d", JU_ERRNO(&error));
+        size_ -= res;
+        return res;
+    }
+
+    void erase(const iterator & it)
+    {
+        erase(*it);
+    }
+
+    size_t count(Word_t key) const
+    {
+        return Judy1Test(array, key, PJE0);
+    }
+
+    /** Number of keys from lo to hi inclusive.  Walks the blocks of 64
+        keys in the range, so takes time linear in their number. */
+    size_t count_range(Word_t lo, Word_t hi) const
+    {
+        return Judy1Count(array, lo, hi, PJE0);
+    }
+
+    iterator find(Word_t key) const
+    {
+        return iterator(this, key, !count(key));
+    }
+
+    iterator begin() const { return lower_bound(0); }
+    iterator end() const { return iterator(this, 0, true); }
+
+    /** First key greater than or equal to the given key. */
+    iterator lower_bound(Word_t key) const
+    {
+        bool found = Judy1First(array, &key, PJE0) == 1;
+        return iterator(this, key, !found);
+    }
+
+    /** First key greater than the given key. */
+    iterator upper_bound(Word_t key) const
+    {
+        bool found = Judy1Next(array, &key, PJE0) == 1;
+        return iterator(this, key, !found);
+    }
+
+    /** The underlying Judy1 array, for passing to the C interface. */
+    Pvoid_t judy() const { return array; }
+
+    friend JudySet set_union(const JudySet & set1, const JudySet & set2)
+    {
+        JudySet result;
+        JError_t error;
+        if (Judy1Union(&result.array, set1.array, set2.array, &error)
+            == (int)JERR)
+            throw Exception("Judy1Union: error %d", JU_ERRNO(&error));
+        result.size_ = Judy1Count(result.array, 0, -1, PJE0);
+        return result;
+    }
+
+    friend JudySet set_intersection(const JudySet & set1, const JudySet & set2)
+    {
+        JudySet result;
+        JError_t error;
+        if (Judy1Intersect(&result.array, set1.array, set2.array, &error)
+            == (int)JERR)
+            throw Exception("Judy1Intersect: error %d", JU_ERRNO(&error));
+        result.size_ = Judy1Count(result.array, 0, -1, PJE0);
+        return result;
+    }
+
+private:
+    friend class JudySetIterator;
+
+    Pvoid_t array;
+    size_t size_;
+};
+
+void JudySetIterator::increment()
+{
+    if (atEnd)
+        throw Exception("incrementing JudySet end iterator");
+    atEnd = Judy1Next(set->judy(), &key, PJE0) != 1;
+}
+
+void JudySetIterator::decrement()
+{
+    if (atEnd) {
+        key = -1;
+        atEnd = Judy1Last(set->judy(), &key, PJE0) != 1;
+    }
+    else if (Judy1Prev(set->judy(), &key, PJE0) != 1)
+        atEnd = true;
+
+    if (atEnd)
+        throw Exception("decrementing JudySet begin iterator");
+}
+
+} // namespace ML
+
+#endif /* __jml__judy__judy_set_h__ */
@@ -0,0 +1,265 @@
+/* judyl_flat_image.h                                              -*- C++ -*-
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Flat, read-only image of a JudyL array that can be mapped from a file.
+*/
+
+#ifndef __jml__judy__judyl_flat_image_h__
+#define __jml__judy__judyl_flat_image_h__
+
+#include "jml/judy/judyl_map.h"
+#include "jml/utils/file_functions.h"
+#include <boost/static_assert.hpp>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <string.h>
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* JUDYL FLAT IMAGE                                                          */
+/*****************************************************************************/
+
+/** Read-only image of a JudyL array, laid out so that it can be used
+    straight out of a memory mapped file without loading it.
+
+    The Judy tree itself is full of absolute pointers, so the image instead
+    holds the keys and value words in sorted order, along with the first key
+    of every block of keys.  Lookups binary search that index (which is
+    small enough to stay in cache) and then a single block.  There are no
+    pointers in the image, so it can be mapped anywhere.
+
+    The words are stored in native byte order; opening an image written on
+    a machine with a different word size or byte order throws.
+
+    Only JudyL arrays (or JudyLMaps with values stored inline in the word)
+    can be imaged, as the value words are copied as they are.
+*/
+
+struct JudyLFlatImage {
+
+    enum {
+        BLOCK_SIZE = 64       ///< Keys per block of the index
+    };
+
+    /** Header at the start of the image. */
+    struct Header {
+        char magic[8];        ///< "JUDYLIMG"
+        uint64_t byteOrder;   ///< BYTE_ORDER_MARK when read correctly
+        uint64_t wordSize;    ///< sizeof(Word_t)
+        uint64_t version;
+        uint64_t size;        ///< Number of entries
+        uint64_t indexSize;   ///< Number of blocks
+    };
+
+    static constexpr uint64_t BYTE_ORDER_MARK = 0x0102030405060708ULL;
+
+    JudyLFlatImage()
+        : size_(0), indexSize(0), index(0), keys(0), values(0)
+    {
+    }
+
+    JudyLFlatImage(const std::string & filename)
+    {
+        open(filename);
+    }
+
+    JudyLFlatImage(const File_Read_Buffer & buffer)
+    {
+        open(buffer);
+    }
+
+    /** Memory map the given file. */
+    void open(const std::string & filename)
+    {
+        open(File_Read_Buffer(filename));
+    }
+
+    /** Use the image in the buffer, which is kept open while this object
+        is. */
+    void open(const File_Read_Buffer & buffer)
+    {
+        if (buffer.size() < sizeof(Header))
+            throw Exception("JudyL image %s is truncated",
+                            buffer.filename().c_str());
+        if ((size_t)buffer.start() % sizeof(Word_t) != 0)
+            throw Exception("JudyL image %s is not aligned",
+                            buffer.filename().c_str());
+
+        const Header * header = (const Header *)buffer.start();
+        if (strncmp(header->magic, "JUDYLIMG", 8) != 0)
+            throw Exception("%s is not a JudyL image",
+                            buffer.filename().c_str());
+        if (header->byteOrder != BYTE_ORDER_MARK
+            || header->wordSize != sizeof(Word_t))
+            throw Exception("JudyL image %s is from an incompatible machine",
+                            buffer.filename().c_str());
+        if (header->version != 1)
+            throw Exception("JudyL image %s has unknown version %lld",
+                            buffer.filename().c_str(),
+                            (long long)header->version);
+
+        // The header is untrusted: bound each count by the number of words
+        // in the buffer before doing any arithmetic that could overflow
+        size_t words = (buffer.size() - sizeof(Header)) / sizeof(Word_t);
+        if (header->size > words / 2 || header->indexSize > words)
+            throw Exception("JudyL image %s is corrupt or truncated",
+                            buffer.filename().c_str());
+
+        size_t indexSize = (header->size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        if (header->indexSize != indexSize
+            || buffer.size() != sizeof(Header)
+               + (indexSize + 2 * header->size) * sizeof(Word_t))
+            throw Exception("JudyL image %s is corrupt or truncated",
+                            buffer.filename().c_str());
+
+        this->buffer = buffer;
+        this->size_ = header->size;
+        this->indexSize = indexSize;
+        this->index = (const Word_t *)(header + 1);
+        this->keys = index + indexSize;
+        this->values = keys + size_;
+    }
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    /** Position of the first key greater than or equal to the given key;
+        size() if there is none. */
+    size_t lower_bound(Word_t key) const
+    {
+        // Last block whose first key is <= key; it or the next one has it
+        const Word_t * block = std::upper_bound(index, index + indexSize, key);
+        if (block == index) return 0;
+        size_t start = (block - index - 1) * BLOCK_SIZE;
+        size_t end = std::min<size_t>(start + BLOCK_SIZE, size_);
+        return std::lower_bound(keys + start, keys + end, key) - keys;
+    }
+
+    /** Pointer to the value word for the key, or null if it's not there. */
+    const Word_t * find(Word_t key) const
+    {
+        size_t pos = lower_bound(key);
+        if (pos == size_ || keys[pos] != key) return 0;
+        return values + pos;
+    }
+
+    size_t count(Word_t key) const
+    {
+        return find(key) != 0;
+    }
+
+    /** Key and value word at the given position in key order. */
+    Word_t key(size_t pos) const { return keys[pos]; }
+    Word_t value(size_t pos) const { return values[pos]; }
+
+    /** Load the image into a map, building it in one pass. */
+    template<typename Value>
+    void load(JudyLMap<Value> & map) const
+    {
+        checkInline<Value>();
+        map.assign_sorted(LoadIterator<Value>(keys, values),
+                          LoadIterator<Value>(keys + size_, values + size_));
+    }
+
+    /** Write an image of the given JudyL array to the stream. */
+    static void write(std::ostream & stream, Pcvoid_t array)
+    {
+        Header header;
+        memcpy(header.magic, "JUDYLIMG", 8);
+        header.byteOrder = BYTE_ORDER_MARK;
+        header.wordSize = sizeof(Word_t);
+        header.version = 1;
+        header.size = JudyLCount(array, 0, -1, PJE0);
+        header.indexSize = (header.size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+        std::vector<Word_t> index;
+        index.reserve(header.indexSize);
+        Word_t key = 0;
+        size_t n = 0;
+        for (PPvoid_t val = JudyLFirst(array, &key, PJE0);  val;
+             val = JudyLNext(array, &key, PJE0), ++n)
+            if (n % BLOCK_SIZE == 0)
+                index.push_back(key);
+
+        stream.write((const char *)&header, sizeof(header));
+        stream.write((const char *)index.data(),
+                     index.size() * sizeof(Word_t));
+
+        // Keys, then values
+        for (int pass = 0;  pass < 2;  ++pass) {
+            key = 0;
+            for (PPvoid_t val = JudyLFirst(array, &key, PJE0);  val;
+                 val = JudyLNext(array, &key, PJE0))
+                stream.write((const char *)(pass == 0 ? &key : (Word_t *)val),
+                             sizeof(Word_t));
+        }
+
+        if (!stream)
+            throw Exception("error writing JudyL image");
+    }
+
+    template<typename Value>
+    static void write(std::ostream & stream, const JudyLMap<Value> & map)
+    {
+        checkInline<Value>();
+        write(stream, map.judy());
+    }
+
+private:
+    File_Read_Buffer buffer;
+    size_t size_;
+    size_t indexSize;
+    const Word_t * index;
+    const Word_t * keys;
+    const Word_t * values;
+
+    /** The value words are only meaningful outside of the process if the
+        value is stored in them directly. */
+    template<typename Value>
+    static void checkInline()
+    {
+        BOOST_STATIC_ASSERT(sizeof(Value) <= sizeof(Word_t)
+                            && boost::has_trivial_copy<Value>::value
+                            && boost::has_trivial_destructor<Value>::value);
+    }
+
+    template<typename Value>
+    struct LoadIterator {
+        LoadIterator(const Word_t * key, const Word_t * value)
+            : key(key), value(value)
+        {
+        }
+
+        const std::pair<Word_t, Value> * operator -> ()
+        {
+            entry.first = *key;
+            memcpy(&entry.second, value, sizeof(Value));
+            return &entry;
+        }
+
+        LoadIterator & operator ++ ()
+        {
+            ++key;
+            ++value;
+            return *this;
+        }
+
+        bool operator != (const LoadIterator & other) const
+        {
+            return key != other.key;
+        }
+
+        const Word_t * key;
+        const Word_t * value;
+        std::pair<Word_t, Value> entry;
+    };
+};
+
+} // namespace ML
+
+#endif /* __jml__judy__judyl_flat_image_h__ */
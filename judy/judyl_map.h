@@ -0,0 +1,450 @@
+/* judyl_map.h                                                     -*- C++ -*-
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   C++ ordered map interface to a JudyL array.
+*/
+
+#ifndef __jml__judy__judyl_map_h__
+#define __jml__judy__judyl_map_h__
+
+#include "jml/judy/Judy.h"
+#include "jml/arch/exception.h"
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/type_traits/has_trivial_copy.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
+#include <utility>
+#include <new>
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* JUDYL VALUE OPS                                                           */
+/*****************************************************************************/
+
+/** How values are stored in the word that JudyL keeps for each key.  Values
+    that are trivially copyable and fit in a word are stored directly;
+    anything else is allocated on the heap with a pointer to it stored. */
+
+template<typename Value,
+         bool Inline = (sizeof(Value) <= sizeof(Word_t)
+                        && boost::has_trivial_copy<Value>::value
+                        && boost::has_trivial_destructor<Value>::value)>
+struct JudyLValueOps {
+    static Value & get(Word_t & slot)
+    {
+        return reinterpret_cast<Value &>(slot);
+    }
+
+    static void init(Word_t & slot, const Value & value)
+    {
+        new (&slot) Value(value);
+    }
+
+    static void destroy(Word_t & slot)
+    {
+    }
+};
+
+template<typename Value>
+struct JudyLValueOps<Value, false> {
+    static Value & get(Word_t & slot)
+    {
+        return *reinterpret_cast<Value *>(slot);
+    }
+
+    static void init(Word_t & slot, const Value & value)
+    {
+        slot = reinterpret_cast<Word_t>(new Value(value));
+    }
+
+    static void destroy(Word_t & slot)
+    {
+        delete reinterpret_cast<Value *>(slot);
+        slot = 0;
+    }
+};
+
+
+/*****************************************************************************/
+/* JUDYL MAP ITERATOR                                                        */
+/*****************************************************************************/
+
+/** Entry that a JudyLMap iterator points to.  The key is a copy (JudyL
+    doesn't store keys explicitly) and the value is a reference into the
+    array. */
+template<typename Value>
+struct JudyLMapEntry {
+    JudyLMapEntry(Word_t first, Value & second)
+        : first(first), second(second)
+    {
+    }
+
+    Word_t first;
+    Value & second;
+};
+
+template<typename Value, typename Map>
+struct JudyLMapIterator
+    : public boost::iterator_facade<JudyLMapIterator<Value, Map>,
+                                    JudyLMapEntry<Value>,
+                                    boost::bidirectional_traversal_tag,
+                                    JudyLMapEntry<Value> > {
+
+    JudyLMapIterator()
+        : map(0), key(0), slot(0)
+    {
+    }
+
+    JudyLMapIterator(Map * map, Word_t key, Word_t * slot)
+        : map(map), key(key), slot(slot)
+    {
+    }
+
+    template<typename V2, typename M2>
+    JudyLMapIterator(const JudyLMapIterator<V2, M2> & other)
+        : map(other.map), key(other.key), slot(other.slot)
+    {
+    }
+
+    Word_t getKey() const { return key; }
+
+    /** Pointer to the value slot; null means the end. */
+    Word_t * getSlot() const { return slot; }
+
+private:
+    friend class boost::iterator_core_access;
+    template<typename V2, typename M2> friend class JudyLMapIterator;
+
+    Map * map;
+    Word_t key;
+    Word_t * slot;
+
+    template<typename V2, typename M2>
+    bool equal(const JudyLMapIterator<V2, M2> & other) const
+    {
+        if (map != other.map)
+            throw Exception("comparing JudyLMap iterators from different maps");
+        if (!slot || !other.slot)
+            return slot == other.slot;
+        return key == other.key;
+    }
+
+    JudyLMapEntry<Value> dereference() const
+    {
+        if (!slot)
+            throw Exception("dereferencing JudyLMap end iterator");
+        return JudyLMapEntry<Value>(key, Map::ValueOps::get(*slot));
+    }
+
+    void increment()
+    {
+        if (!slot)
+            throw Exception("incrementing JudyLMap end iterator");
+        slot = (Word_t *)JudyLNext(map->array, &key, PJE0);
+    }
+
+    void decrement()
+    {
+        if (!slot) {
+            key = -1;
+            slot = (Word_t *)JudyLLast(map->array, &key, PJE0);
+        }
+        else slot = (Word_t *)JudyLPrev(map->array, &key, PJE0);
+
+        if (!slot)
+            throw Exception("decrementing JudyLMap begin iterator");
+    }
+};
+
+
+/*****************************************************************************/
+/* JUDYL MAP                                                                 */
+/*****************************************************************************/
+
+/** Ordered map from words (eg 64 bit integers) to values, implemented with
+    a JudyL array.  Very memory efficient for sparse integer keys, and
+    iteration is in key order.
+
+    Iterators point to a (key, value reference) entry, and are invalidated
+    by any insertion or deletion.
+*/
+
+template<typename Value>
+struct JudyLMap {
+
+    typedef JudyLValueOps<Value> ValueOps;
+    typedef Word_t key_type;
+    typedef Value mapped_type;
+    typedef JudyLMapEntry<Value> value_type;
+    typedef JudyLMapIterator<Value, JudyLMap> iterator;
+    typedef JudyLMapIterator<const Value, const JudyLMap> const_iterator;
+
+    JudyLMap()
+        : array(0)
+    {
+    }
+
+    JudyLMap(const JudyLMap & other)
+        : array(0)
+    {
+        for (const_iterator it = other.begin(), end = other.end();
+             it != end;  ++it)
+            insert(it->first, it->second);
+    }
+
+    JudyLMap(JudyLMap && other)
+        : array(other.array)
+    {
+        other.array = 0;
+    }
+
+    ~JudyLMap()
+    {
+        clear();
+    }
+
+    JudyLMap & operator = (const JudyLMap & other)
+    {
+        JudyLMap new_me(other);
+        swap(new_me);
+        return *this;
+    }
+
+    JudyLMap & operator = (JudyLMap && other)
+    {
+        JudyLMap new_me(std::move(other));
+        swap(new_me);
+        return *this;
+    }
+
+    void swap(JudyLMap & other)
+    {
+        std::swap(array, other.array);
+    }
+
+    /** Number of entries.  Note that this is O(log n), not O(1). */
+    size_t size() const
+    {
+        return JudyLCount(array, 0, -1, PJE0);
+    }
+
+    bool empty() const
+    {
+        return array == 0;
+    }
+
+    void clear()
+    {
+        if (!array) return;
+        destroy_values(typename boost::integral_constant<bool, isInline()>());
+        JudyLFreeArray(&array, PJE0);
+    }
+
+    /** Number of bytes of memory used by the JudyL array (not including out
+        of line values). */
+    size_t memusage() const
+    {
+        return JudyLMemUsed(array);
+    }
+
+    iterator begin() { return first(0); }
+    const_iterator begin() const { return first(0); }
+
+    iterator end() { return iterator(this, 0, 0); }
+    const_iterator end() const { return const_iterator(this, 0, 0); }
+
+    iterator find(Word_t key)
+    {
+        return iterator(this, key, get(key));
+    }
+
+    const_iterator find(Word_t key) const
+    {
+        return const_iterator(this, key, get(key));
+    }
+
+    size_t count(Word_t key) const
+    {
+        return get(key) != 0;
+    }
+
+    /** First entry with a key greater than or equal to the given key. */
+    iterator lower_bound(Word_t key) { return first(key); }
+    const_iterator lower_bound(Word_t key) const { return first(key); }
+
+    /** First entry with a key greater than the given key. */
+    iterator upper_bound(Word_t key)
+    {
+        Word_t * slot = (Word_t *)JudyLNext(array, &key, PJE0);
+        return iterator(this, key, slot);
+    }
+
+    const_iterator upper_bound(Word_t key) const
+    {
+        Word_t * slot = (Word_t *)JudyLNext(array, &key, PJE0);
+        return const_iterator(this, key, slot);
+    }
+
+    /** Insert the value if the key is not already there.  Returns an
+        iterator to the entry and whether it was inserted. */
+    std::pair<iterator, bool> insert(Word_t key, const Value & value)
+    {
+        Word_t * slot = get(key);
+        if (slot) return std::make_pair(iterator(this, key, slot), false);
+        slot = ins(key);
+        ValueOps::init(*slot, value);
+        return std::make_pair(iterator(this, key, slot), true);
+    }
+
+    Value & operator [] (Word_t key)
+    {
+        Word_t * slot = get(key);
+        if (!slot) {
+            slot = ins(key);
+            ValueOps::init(*slot, Value());
+        }
+        return ValueOps::get(*slot);
+    }
+
+    /** Remove the key.  Returns the number of entries removed. */
+    size_t erase(Word_t key)
+    {
+        Word_t * slot = get(key);
+        if (!slot) return 0;
+        ValueOps::destroy(*slot);
+        JError_t error;
+        if (JudyLDel(&array, key, &error) == JERR)
+            throw Exception("JudyLDel: error %d", JU_ERRNO(&error));
+        return 1;
+    }
+
+    void erase(const iterator & it)
+    {
+        erase(it.getKey());
+    }
+
+    /** Replace the contents with the (key, value) pairs in [first, last),
+        which must be in strictly ascending order of key.  The array is
+        built directly from the bottom up in one pass over the range,
+        which is much faster than inserting the keys one at a time and
+        doesn't need the whole range in memory at once. */
+    template<typename Iterator>
+    void assign_sorted(Iterator first, Iterator last)
+    {
+        JudyLMap new_me;
+        JError_t error;
+        PJudyLBuild_t build = JudyLBuildInit(&error);
+        if (!build)
+            throw Exception("JudyLBuildInit: error %d", JU_ERRNO(&error));
+
+        try {
+            for (;  first != last;  ++first) {
+                Word_t slot;
+                ValueOps::init(slot, first->second);
+                if (JudyLBuildIns(build, first->first, slot, PJE0) == (int)JERR) {
+                    ValueOps::destroy(slot);
+                    break;
+                }
+            }
+        } catch (...) {
+            JudyLBuildFinish(build, &new_me.array, PJE0);
+            throw;
+        }
+
+        if (JudyLBuildFinish(build, &new_me.array, &error) == (int)JERR)
+            throw Exception("JudyLMap::assign_sorted(): error %d%s",
+                            JU_ERRNO(&error),
+                            JU_ERRNO(&error) == JU_ERRNO_UNSORTED
+                            ? " (keys not in ascending order)" : "");
+        swap(new_me);
+    }
+
+    /** Number of keys in the (inclusive) range [key1, key2]. */
+    size_t count_range(Word_t key1, Word_t key2) const
+    {
+        if (key1 > key2) return 0;
+        return JudyLCount(array, key1, key2, PJE0);
+    }
+
+    /** Rank: number of keys that are strictly less than the given key. */
+    size_t rank(Word_t key) const
+    {
+        if (key == 0) return 0;
+        return JudyLCount(array, 0, key - 1, PJE0);
+    }
+
+    /** Select: iterator to the entry with the given (zero based) rank in
+        key order, or end() if there are not that many entries. */
+    iterator select(size_t n)
+    {
+        Word_t key = 0;
+        Word_t * slot = (Word_t *)JudyLByCount(array, n + 1, &key, PJE0);
+        return iterator(this, key, slot);
+    }
+
+    const_iterator select(size_t n) const
+    {
+        Word_t key = 0;
+        Word_t * slot = (Word_t *)JudyLByCount(array, n + 1, &key, PJE0);
+        return const_iterator(this, key, slot);
+    }
+
+    /** The underlying JudyL array, for passing to the C interface. */
+    Pvoid_t judy() const { return array; }
+
+private:
+    template<typename V2, typename M2> friend class JudyLMapIterator;
+
+    Pvoid_t array;
+
+    static constexpr bool isInline()
+    {
+        return sizeof(Value) <= sizeof(Word_t)
+            && boost::has_trivial_copy<Value>::value
+            && boost::has_trivial_destructor<Value>::value;
+    }
+
+    Word_t * get(Word_t key) const
+    {
+        return (Word_t *)JudyLGet(array, key, PJE0);
+    }
+
+    Word_t * ins(Word_t key)
+    {
+        JError_t error;
+        Word_t * slot = (Word_t *)JudyLIns(&array, key, &error);
+        if (slot == (Word_t *)PPJERR)
+            throw Exception("JudyLIns: error %d", JU_ERRNO(&error));
+        return slot;
+    }
+
+    iterator first(Word_t key)
+    {
+        Word_t * slot = (Word_t *)JudyLFirst(array, &key, PJE0);
+        return iterator(this, key, slot);
+    }
+
+    const_iterator first(Word_t key) const
+    {
+        Word_t * slot = (Word_t *)JudyLFirst(array, &key, PJE0);
+        return const_iterator(this, key, slot);
+    }
+
+    void destroy_values(boost::true_type)
+    {
+    }
+
+    void destroy_values(boost::false_type)
+    {
+        Word_t key = 0;
+        for (Word_t * slot = (Word_t *)JudyLFirst(array, &key, PJE0);
+             slot;  slot = (Word_t *)JudyLNext(array, &key, PJE0))
+            ValueOps::destroy(*slot);
+    }
+};
+
+} // namespace ML
+
+#endif /* __jml__judy__judyl_map_h__ */
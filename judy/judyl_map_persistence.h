@@ -0,0 +1,95 @@
+/* judyl_map_persistence.h                                         -*- C++ -*-
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Serialization of JudyLMap to and from DB archives.  Kept out of
+   judyl_map.h so that the judy library doesn't depend on db.
+*/
+
+#ifndef __jml__judy__judyl_map_persistence_h__
+#define __jml__judy__judyl_map_persistence_h__
+
+#include "jml/judy/judyl_map.h"
+#include "jml/db/compact_size_types.h"
+
+namespace ML {
+
+/*****************************************************************************/
+/* PERSISTENCE                                                               */
+/*****************************************************************************/
+
+/** Reads the entries of a serialized JudyLMap from the archive as they are
+    asked for, so that they can be passed straight to assign_sorted(). */
+template<typename Value>
+struct JudyLMapReadIterator {
+    JudyLMapReadIterator(DB::Store_Reader * store, size_t remaining)
+        : store(store), remaining(remaining), loaded(false)
+    {
+        entry.first = 0;
+    }
+
+    const std::pair<Word_t, Value> * operator -> ()
+    {
+        if (!loaded) {
+            entry.first += DB::reconstitute_compact_size(*store);
+            *store >> entry.second;
+            loaded = true;
+        }
+        return &entry;
+    }
+
+    JudyLMapReadIterator & operator ++ ()
+    {
+        operator -> ();
+        --remaining;
+        loaded = false;
+        return *this;
+    }
+
+    bool operator != (const JudyLMapReadIterator & other) const
+    {
+        return remaining != other.remaining;
+    }
+
+private:
+    DB::Store_Reader * store;
+    size_t remaining;
+    bool loaded;
+    std::pair<Word_t, Value> entry;
+};
+
+/** Serialize as the number of entries followed by the entries in key order,
+    with each key stored as the difference from the one before. */
+template<typename Value>
+DB::Store_Writer &
+operator << (DB::Store_Writer & store, const JudyLMap<Value> & map)
+{
+    DB::serialize_compact_size(store, 0);  // version
+    DB::serialize_compact_size(store, map.size());
+    Word_t last = 0;
+    for (auto it = map.begin(), end = map.end();  it != end;  ++it) {
+        DB::serialize_compact_size(store, it->first - last);
+        store << it->second;
+        last = it->first;
+    }
+    return store;
+}
+
+/** Reconstitute, building the array in one pass with assign_sorted(). */
+template<typename Value>
+DB::Store_Reader &
+operator >> (DB::Store_Reader & store, JudyLMap<Value> & map)
+{
+    unsigned long long version = DB::reconstitute_compact_size(store);
+    if (version != 0)
+        throw Exception("unknown JudyLMap serialization version %lld",
+                        version);
+    unsigned long long size = DB::reconstitute_compact_size(store);
+    map.assign_sorted(JudyLMapReadIterator<Value>(&store, size),
+                      JudyLMapReadIterator<Value>(&store, 0));
+    return store;
+}
+
+} // namespace ML
+
+#endif /* __jml__judy__judyl_map_persistence_h__ */
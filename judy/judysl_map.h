@@ -0,0 +1,411 @@
+/* judysl_map.h                                                    -*- C++ -*-
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   C++ ordered map interface to a JudySL (string keyed) array.
+*/
+
+#ifndef __jml__judy__judysl_map_h__
+#define __jml__judy__judysl_map_h__
+
+#include "jml/judy/judyl_map.h"
+#include <string>
+#include <vector>
+#include <string.h>
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* JUDYSL MAP ITERATOR                                                       */
+/*****************************************************************************/
+
+/** Entry that a JudySLMap iterator points to.  The key points into the
+    iterator, and is only valid until it is moved. */
+template<typename Value>
+struct JudySLMapEntry {
+    JudySLMapEntry(const char * first, Value & second)
+        : first(first), second(second)
+    {
+    }
+
+    const char * first;
+    Value & second;
+};
+
+template<typename Value, typename Map>
+struct JudySLMapIterator
+    : public boost::iterator_facade<JudySLMapIterator<Value, Map>,
+                                    JudySLMapEntry<Value>,
+                                    boost::bidirectional_traversal_tag,
+                                    JudySLMapEntry<Value> > {
+
+    JudySLMapIterator()
+        : map(0), slot(0)
+    {
+    }
+
+    JudySLMapIterator(Map * map, const std::string & key, Word_t * slot)
+        : map(map), key(key), slot(slot)
+    {
+    }
+
+    template<typename V2, typename M2>
+    JudySLMapIterator(const JudySLMapIterator<V2, M2> & other)
+        : map(other.map), key(other.key), slot(other.slot)
+    {
+    }
+
+    const std::string & getKey() const { return key; }
+
+    /** Pointer to the value slot; null means the end. */
+    Word_t * getSlot() const { return slot; }
+
+private:
+    friend class boost::iterator_core_access;
+    template<typename V2, typename M2> friend class JudySLMapIterator;
+
+    Map * map;
+    std::string key;
+    Word_t * slot;
+
+    template<typename V2, typename M2>
+    bool equal(const JudySLMapIterator<V2, M2> & other) const
+    {
+        if (map != other.map)
+            throw Exception("comparing JudySLMap iterators from different maps");
+        if (!slot || !other.slot)
+            return slot == other.slot;
+        return key == other.key;
+    }
+
+    JudySLMapEntry<Value> dereference() const
+    {
+        if (!slot)
+            throw Exception("dereferencing JudySLMap end iterator");
+        return JudySLMapEntry<Value>(key.c_str(), Map::ValueOps::get(*slot));
+    }
+
+    void increment()
+    {
+        if (!slot)
+            throw Exception("incrementing JudySLMap end iterator");
+        slot = map->search(key, JudySLNext);
+    }
+
+    void decrement()
+    {
+        if (!slot) {
+            key = std::string(map->maxKeyLength, '\xff');
+            slot = map->search(key, JudySLLast);
+        }
+        else slot = map->search(key, JudySLPrev);
+
+        if (!slot)
+            throw Exception("decrementing JudySLMap begin iterator");
+    }
+};
+
+
+/*****************************************************************************/
+/* JUDYSL MAP                                                                */
+/*****************************************************************************/
+
+/** Ordered map from strings to values, implemented with a JudySL array.
+    The keys are stored as a trie, so keys with common prefixes (URLs,
+    feature names, ...) share the storage for them, and iterating over all
+    of the keys with a given prefix is cheap.
+
+    Keys can't contain null characters.  Iterators are invalidated by any
+    insertion or deletion.
+*/
+
+template<typename Value>
+struct JudySLMap {
+
+    typedef JudyLValueOps<Value> ValueOps;
+    typedef std::string key_type;
+    typedef Value mapped_type;
+    typedef JudySLMapEntry<Value> value_type;
+    typedef JudySLMapIterator<Value, JudySLMap> iterator;
+    typedef JudySLMapIterator<const Value, const JudySLMap> const_iterator;
+
+    JudySLMap()
+        : array(0), size_(0), maxKeyLength(0)
+    {
+    }
+
+    JudySLMap(const JudySLMap & other)
+        : array(0), size_(0), maxKeyLength(0)
+    {
+        for (const_iterator it = other.begin(), end = other.end();
+             it != end;  ++it)
+            insert(it->first, it->second);
+    }
+
+    JudySLMap(JudySLMap && other)
+        : array(other.array), size_(other.size_),
+          maxKeyLength(other.maxKeyLength)
+    {
+        other.array = 0;
+        other.size_ = 0;
+        other.maxKeyLength = 0;
+    }
+
+    ~JudySLMap()
+    {
+        clear();
+    }
+
+    JudySLMap & operator = (const JudySLMap & other)
+    {
+        JudySLMap new_me(other);
+        swap(new_me);
+        return *this;
+    }
+
+    JudySLMap & operator = (JudySLMap && other)
+    {
+        JudySLMap new_me(std::move(other));
+        swap(new_me);
+        return *this;
+    }
+
+    void swap(JudySLMap & other)
+    {
+        std::swap(array, other.array);
+        std::swap(size_, other.size_);
+        std::swap(maxKeyLength, other.maxKeyLength);
+    }
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    void clear()
+    {
+        if (!array) return;
+        destroy_values(typename boost::integral_constant<bool, isInline()>());
+        JudySLFreeArray(&array, PJE0);
+        size_ = 0;
+        maxKeyLength = 0;
+    }
+
+    /** Number of bytes of memory used by the array, including the keys
+        (but not out of line values). */
+    size_t memusage() const
+    {
+        return JudySLMemUsed(array);
+    }
+
+    iterator begin() { return lower_bound(""); }
+    const_iterator begin() const { return lower_bound(""); }
+
+    iterator end() { return iterator(this, std::string(), 0); }
+    const_iterator end() const
+    {
+        return const_iterator(this, std::string(), 0);
+    }
+
+    iterator find(const std::string & key)
+    {
+        return iterator(this, key, get(key));
+    }
+
+    const_iterator find(const std::string & key) const
+    {
+        return const_iterator(this, key, get(key));
+    }
+
+    size_t count(const std::string & key) const
+    {
+        return get(key) != 0;
+    }
+
+    /** First entry with a key greater than or equal to the given key. */
+    iterator lower_bound(const std::string & key)
+    {
+        std::string found = key;
+        Word_t * slot = search(found, JudySLFirst);
+        return iterator(this, found, slot);
+    }
+
+    const_iterator lower_bound(const std::string & key) const
+    {
+        std::string found = key;
+        Word_t * slot = search(found, JudySLFirst);
+        return const_iterator(this, found, slot);
+    }
+
+    /** First entry with a key greater than the given key. */
+    iterator upper_bound(const std::string & key)
+    {
+        std::string found = key;
+        Word_t * slot = search(found, JudySLNext);
+        return iterator(this, found, slot);
+    }
+
+    const_iterator upper_bound(const std::string & key) const
+    {
+        std::string found = key;
+        Word_t * slot = search(found, JudySLNext);
+        return const_iterator(this, found, slot);
+    }
+
+    /** Range of entries whose keys start with the given prefix. */
+    std::pair<iterator, iterator> prefix_range(const std::string & prefix)
+    {
+        return std::make_pair(lower_bound(prefix), prefix_end(prefix));
+    }
+
+    std::pair<const_iterator, const_iterator>
+    prefix_range(const std::string & prefix) const
+    {
+        return std::make_pair(lower_bound(prefix), prefix_end(prefix));
+    }
+
+    /** Insert the value if the key is not already there.  Returns an
+        iterator to the entry and whether it was inserted. */
+    std::pair<iterator, bool>
+    insert(const std::string & key, const Value & value)
+    {
+        Word_t * slot = get(key);
+        if (slot) return std::make_pair(iterator(this, key, slot), false);
+        slot = ins(key);
+        ValueOps::init(*slot, value);
+        return std::make_pair(iterator(this, key, slot), true);
+    }
+
+    Value & operator [] (const std::string & key)
+    {
+        Word_t * slot = get(key);
+        if (!slot) {
+            slot = ins(key);
+            ValueOps::init(*slot, Value());
+        }
+        return ValueOps::get(*slot);
+    }
+
+    /** Remove the key.  Returns the number of entries removed. */
+    size_t erase(const std::string & key)
+    {
+        Word_t * slot = get(key);
+        if (!slot) return 0;
+        ValueOps::destroy(*slot);
+        JError_t error;
+        if (JudySLDel(&array, (const uint8_t *)key.c_str(), &error)
+            == (int)JERR)
+            throw Exception("JudySLDel: error %d", JU_ERRNO(&error));
+        --size_;
+        return 1;
+    }
+
+    void erase(const iterator & it)
+    {
+        erase(it.getKey());
+    }
+
+    /** The underlying JudySL array, for passing to the C interface. */
+    Pvoid_t judy() const { return array; }
+
+private:
+    template<typename V2, typename M2> friend class JudySLMapIterator;
+
+    Pvoid_t array;
+    size_t size_;
+    size_t maxKeyLength;   ///< Longest key inserted; for iteration buffers
+
+    static constexpr bool isInline()
+    {
+        return sizeof(Value) <= sizeof(Word_t)
+            && boost::has_trivial_copy<Value>::value
+            && boost::has_trivial_destructor<Value>::value;
+    }
+
+    static void checkKey(const std::string & key)
+    {
+        if (memchr(key.c_str(), 0, key.length()))
+            throw Exception("JudySLMap keys can't contain null characters");
+    }
+
+    /** Keys with an embedded null can't have been inserted; without the
+        check JudySL would look up the part before the null instead. */
+    Word_t * get(const std::string & key) const
+    {
+        if (memchr(key.c_str(), 0, key.length()))
+            return 0;
+        return (Word_t *)JudySLGet(array, (const uint8_t *)key.c_str(), PJE0);
+    }
+
+    Word_t * ins(const std::string & key)
+    {
+        checkKey(key);
+        JError_t error;
+        Word_t * slot = (Word_t *)JudySLIns(&array,
+                                            (const uint8_t *)key.c_str(),
+                                            &error);
+        if (slot == (Word_t *)PPJERR)
+            throw Exception("JudySLIns: error %d", JU_ERRNO(&error));
+        ++size_;
+        maxKeyLength = std::max(maxKeyLength, key.length());
+        return slot;
+    }
+
+    /** Call one of the JudySL search functions, starting from key and
+        replacing it with the key found. */
+    Word_t * search(std::string & key,
+                    PPvoid_t (*fn) (Pcvoid_t, uint8_t *, PJError_t)) const
+    {
+        size_t len = std::max(maxKeyLength, key.length()) + 1;
+        uint8_t stackBuf[256];
+        std::vector<uint8_t> heapBuf;
+        uint8_t * buf = stackBuf;
+        if (len > sizeof(stackBuf)) {
+            heapBuf.resize(len);
+            buf = &heapBuf[0];
+        }
+
+        memcpy(buf, key.c_str(), key.length() + 1);
+        Word_t * slot = (Word_t *)fn(array, buf, PJE0);
+        if (slot) key.assign((const char *)buf);
+        return slot;
+    }
+
+    /** Smallest string after all of those that start with prefix. */
+    template<typename Iterator>
+    Iterator prefix_end_impl(const std::string & prefix) const
+    {
+        std::string next = prefix;
+        while (!next.empty() && (unsigned char)next.back() == 0xff)
+            next.resize(next.size() - 1);
+        if (next.empty())
+            return Iterator(const_cast<JudySLMap *>(this), std::string(), 0);
+        next.back() = next.back() + 1;
+        Word_t * slot = search(next, JudySLFirst);
+        return Iterator(const_cast<JudySLMap *>(this), next, slot);
+    }
+
+    iterator prefix_end(const std::string & prefix)
+    {
+        return prefix_end_impl<iterator>(prefix);
+    }
+
+    const_iterator prefix_end(const std::string & prefix) const
+    {
+        return prefix_end_impl<const_iterator>(prefix);
+    }
+
+    void destroy_values(boost::true_type)
+    {
+    }
+
+    void destroy_values(boost::false_type)
+    {
+        for (iterator it = begin(), e = end();  it != e;  ++it)
+            ValueOps::destroy(*it.getSlot());
+    }
+};
+
+} // namespace ML
+
+#endif /* __jml__judy__judysl_map_h__ */
@@ -0,0 +1,110 @@
+/* concurrent_judyl_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Lookup throughput of ConcurrentJudyL versus a JudyLMap behind a mutex
+   as the number of reader threads grows, and the cost of a commit.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/judy/concurrent_judyl.h"
+#include "jml/arch/atomic_ops.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <iostream>
+#include <mutex>
+
+using namespace ML;
+using namespace std;
+
+enum { NKEYS = 1000000, NLOOKUPS = 2000000 };
+
+template<typename Lookup>
+void lookupThread(const Lookup & lookup, int n, size_t & total)
+{
+    uint64_t r = (uint64_t)&r;
+    size_t found = 0;
+    for (unsigned i = 0;  i < n;  ++i) {
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        found += lookup((r >> 40) % (2 * NKEYS));
+    }
+    atomic_add(total, found);
+}
+
+/** Nanoseconds of wall time per lookup with the given number of
+    threads. */
+template<typename Lookup>
+double timeLookups(const Lookup & lookup, int nthreads)
+{
+    size_t total = 0;
+    Timer timer;
+    boost::thread_group tg;
+    for (unsigned i = 0;  i < nthreads;  ++i)
+        tg.create_thread(boost::bind(lookupThread<Lookup>, boost::cref(lookup),
+                                     NLOOKUPS / nthreads, boost::ref(total)));
+    tg.join_all();
+    BOOST_CHECK_NE(total, 0);
+    return timer.elapsed_wall() * 1e9 / NLOOKUPS;
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_concurrent_judyl)
+{
+    ConcurrentJudyL<uint64_t> concurrent;
+    JudyLMap<uint64_t> locked;
+    std::mutex lock;
+
+    ConcurrentJudyL<uint64_t>::Batch batch;
+    for (unsigned i = 0;  i < NKEYS;  ++i) {
+        batch.insert(i * 2, i);
+        locked[i * 2] = i;
+    }
+    Timer timer;
+    concurrent.update(batch);
+    cerr << format("loading %d keys in one batch: %.1fms, %zd shards",
+                   (int)NKEYS, timer.elapsed_wall() * 1000,
+                   concurrent.numShards())
+         << endl;
+
+    auto concurrentLookup = [&] (Word_t key) -> int
+        {
+            return concurrent.count(key);
+        };
+    auto lockedLookup = [&] (Word_t key) -> int
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            return locked.count(key);
+        };
+
+    cerr << "threads  concurrent ns  mutex ns" << endl;
+    for (int nthreads: { 1, 2, 4, 8 }) {
+        cerr << format("%7d  %13.1f  %8.1f", nthreads,
+                       timeLookups(concurrentLookup, nthreads),
+                       timeLookups(lockedLookup, nthreads))
+             << endl;
+    }
+
+    // Commits of single changes and of batches
+    cerr << "batch size  us/commit  ns/change" << endl;
+    for (int n: { 1, 100, 10000 }) {
+        int ncommits = n == 1 ? 10000 : 100;
+        uint64_t r = n;
+        timer.restart();
+        for (unsigned i = 0;  i < ncommits;  ++i) {
+            ConcurrentJudyL<uint64_t>::Batch batch;
+            for (unsigned j = 0;  j < n;  ++j) {
+                r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+                batch.insert((r >> 40) % (2 * NKEYS), j);
+            }
+            concurrent.update(batch);
+        }
+        double elapsed = timer.elapsed_wall();
+        cerr << format("%10d  %9.1f  %9.1f", n, elapsed * 1e6 / ncommits,
+                       elapsed * 1e9 / ncommits / n)
+             << endl;
+    }
+}
@@ -0,0 +1,193 @@
+/* concurrent_judyl_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test program for the read-mostly concurrent JudyL map.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/judy/concurrent_judyl.h"
+#include "jml/arch/atomic_ops.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <iostream>
+#include <vector>
+#include <map>
+
+using namespace ML;
+using namespace std;
+
+void checkSame(const ConcurrentJudyL<uint64_t> & m,
+               const map<Word_t, uint64_t> & expected)
+{
+    BOOST_REQUIRE_EQUAL(m.size(), expected.size());
+
+    for (auto & e: expected) {
+        uint64_t val = 0;
+        BOOST_REQUIRE(m.find(e.first, val));
+        BOOST_REQUIRE_EQUAL(val, e.second);
+    }
+
+    auto snapshot = m.snapshot();
+    auto it = expected.begin();
+    snapshot.forEach([&] (Word_t key, uint64_t val)
+                     {
+                         BOOST_REQUIRE(it != expected.end());
+                         BOOST_REQUIRE_EQUAL(key, it->first);
+                         BOOST_REQUIRE_EQUAL(val, it->second);
+                         ++it;
+                     });
+    BOOST_REQUIRE(it == expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_judyl_basics)
+{
+    // Small shards, so that there is lots of splitting and emptying
+    ConcurrentJudyL<uint64_t> m(4);
+    map<Word_t, uint64_t> expected;
+
+    BOOST_CHECK(m.empty());
+    BOOST_CHECK_EQUAL(m.count(0), 0);
+
+    uint64_t r = 1;
+    for (unsigned i = 0;  i < 5000;  ++i) {
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        Word_t key = (r >> 40) % 2000;
+        if ((r >> 20) % 3 == 0) {
+            m.erase(key);
+            expected.erase(key);
+        }
+        else {
+            m.insert(key, i);
+            expected[key] = i;
+        }
+        if (i % 500 == 0) checkSame(m, expected);
+    }
+    checkSame(m, expected);
+    BOOST_CHECK_GT(m.numShards(), 10);
+
+    // Ranges; the snapshot must be gone before we write again
+    {
+        auto snapshot = m.snapshot();
+        size_t n = 0;
+        snapshot.forEach([&] (Word_t key, uint64_t val)
+                         {
+                             BOOST_CHECK(key >= 500 && key <= 600);
+                             ++n;
+                         }, 500, 600);
+        BOOST_CHECK_EQUAL(n, std::distance(expected.lower_bound(500),
+                                           expected.upper_bound(600)));
+    }
+
+    // Extreme keys
+    m.insert(0, 1);
+    m.insert(-1, 2);
+    uint64_t val;
+    BOOST_CHECK(m.find(0, val) && val == 1);
+    BOOST_CHECK(m.find(-1, val) && val == 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_judyl_batch)
+{
+    ConcurrentJudyL<uint64_t> m(16);
+    map<Word_t, uint64_t> expected;
+
+    ConcurrentJudyL<uint64_t>::Batch batch;
+    for (unsigned i = 0;  i < 10000;  ++i) {
+        batch.insert(i * 7, i);
+        expected[i * 7] = i;
+    }
+
+    // Later changes to the same key win
+    batch.insert(14, 100);
+    batch.erase(21);
+    batch.insert(28, 1);
+    batch.erase(28);
+    batch.insert(28, 2);
+    expected[14] = 100;
+    expected.erase(21);
+    expected[28] = 2;
+
+    m.update(batch);
+    checkSame(m, expected);
+
+    ConcurrentJudyL<uint64_t>::Batch eraseAll;
+    for (auto & e: expected)
+        eraseAll.erase(e.first);
+    m.update(eraseAll);
+    checkSame(m, map<Word_t, uint64_t>());
+    BOOST_CHECK_EQUAL(m.numShards(), 1);
+}
+
+/** Readers look up keys the writer is changing; the writer only ever
+    stores 3 * key for a key, so anything else means that a reader saw a
+    freed or half built shard. */
+void readerThread(const ConcurrentJudyL<uint64_t> & m,
+                  volatile bool & finished, int & errors, int & reads)
+{
+    uint64_t r = (uint64_t)&r;
+    int myErrors = 0, myReads = 0;
+    // At least one pass, even if the writer is done before we're scheduled
+    do {
+        for (unsigned i = 0;  i < 100;  ++i, ++myReads) {
+            r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+            Word_t key = (r >> 40) % 100000;
+            uint64_t val;
+            if (m.find(key, val) && val != 3 * key)
+                ++myErrors;
+        }
+
+        // The snapshot must be in order and consistent with itself
+        auto snapshot = m.snapshot();
+        Word_t last = 0;
+        size_t n = 0;
+        snapshot.forEach([&] (Word_t key, uint64_t val)
+                         {
+                             if (val != 3 * key || (n && key <= last))
+                                 ++myErrors;
+                             last = key;
+                             ++n;
+                         }, 1000, 2000);
+    } while (!finished);
+
+    atomic_add(errors, myErrors);
+    atomic_add(reads, myReads);
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_judyl_multithreaded)
+{
+    int nthreads = 4;
+    ConcurrentJudyL<uint64_t> m(64);
+    volatile bool finished = false;
+    int errors = 0, reads = 0;
+
+    boost::thread_group tg;
+    for (unsigned i = 0;  i < nthreads;  ++i)
+        tg.create_thread(boost::bind(readerThread, boost::cref(m),
+                                     boost::ref(finished),
+                                     boost::ref(errors),
+                                     boost::ref(reads)));
+
+    uint64_t r = 1;
+    for (unsigned i = 0;  i < 200;  ++i) {
+        ConcurrentJudyL<uint64_t>::Batch batch;
+        for (unsigned j = 0;  j < 500;  ++j) {
+            r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+            Word_t key = (r >> 40) % 100000;
+            if (j % 4 == 0) batch.erase(key);
+            else batch.insert(key, 3 * key);
+        }
+        m.update(batch);
+    }
+
+    finished = true;
+    tg.join_all();
+
+    cerr << reads << " reads, " << m.numShards() << " shards" << endl;
+    BOOST_CHECK_EQUAL(errors, 0);
+    BOOST_CHECK_GT(reads, 0);
+}
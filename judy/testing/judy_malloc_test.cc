@@ -0,0 +1,136 @@
+/* judy_malloc_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test program for the slab allocator behind JudyMalloc.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/judy/judyl_map.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/bind.hpp>
+#include <iostream>
+
+using namespace ML;
+using namespace std;
+
+JudyMallocStats_t getStats()
+{
+    JudyMallocStats_t stats;
+    JudyMallocStats(&stats);
+    return stats;
+}
+
+BOOST_AUTO_TEST_CASE(test_judy_malloc_sizes)
+{
+    // Every slab size class and some large ones must give usable, word
+    // aligned memory
+    vector<pair<Word_t *, Word_t> > blocks;
+    for (Word_t words = 1;  words <= 2000;  words += 7) {
+        for (unsigned i = 0;  i < 10;  ++i) {
+            Word_t * p = (Word_t *)JudyMalloc(words);
+            BOOST_REQUIRE(p);
+            BOOST_CHECK_EQUAL((size_t)p % sizeof(Word_t), 0);
+            for (unsigned j = 0;  j < words;  ++j)
+                p[j] = words + j;
+            blocks.push_back(make_pair(p, words));
+        }
+    }
+
+    for (unsigned i = 0;  i < blocks.size();  ++i) {
+        Word_t words = blocks[i].second;
+        for (unsigned j = 0;  j < words;  ++j)
+            BOOST_REQUIRE_EQUAL(blocks[i].first[j], words + j);
+        JudyFree(blocks[i].first, words);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_judy_malloc_stats)
+{
+    JudyMallocStats_t before = getStats();
+
+    JudyLMap<uint64_t> m;
+    for (unsigned i = 0;  i < 1000000;  ++i)
+        m[i * 1237] = i;
+
+    JudyMallocStats_t during = getStats();
+    cerr << "reserved " << during.jms_BytesReserved
+         << " in use " << during.jms_BytesInUse
+         << " cached " << during.jms_BytesCached
+         << " large " << during.jms_BytesLarge
+         << " array " << m.memusage() << endl;
+
+    BOOST_CHECK_GE(during.jms_BytesInUse + during.jms_BytesLarge
+                   - before.jms_BytesInUse - before.jms_BytesLarge,
+                   m.memusage());
+    BOOST_CHECK_EQUAL(during.jms_BytesInUse + during.jms_BytesCached,
+                      during.jms_BytesReserved);
+
+    m.clear();
+
+    JudyMallocStats_t after = getStats();
+
+    // Everything comes back, and the empty chunks go back to the system
+    BOOST_CHECK_EQUAL(after.jms_BytesInUse, before.jms_BytesInUse);
+    BOOST_CHECK_EQUAL(after.jms_BytesLarge, before.jms_BytesLarge);
+    BOOST_CHECK_LT(after.jms_BytesReserved, during.jms_BytesReserved / 4);
+
+    // Building it again shouldn't need any more memory than the first time
+    for (unsigned i = 0;  i < 1000000;  ++i)
+        m[i * 1237] = i;
+    BOOST_CHECK_LE(getStats().jms_BytesReserved, during.jms_BytesReserved);
+}
+
+BOOST_AUTO_TEST_CASE(test_judy_malloc_no_per_thread)
+{
+    JudyMallocSetPerThread(false);
+
+    {
+        JudyLMap<uint64_t> m;
+        for (unsigned i = 0;  i < 100000;  ++i)
+            m[i * 7919] = i;
+        BOOST_CHECK_EQUAL(m.size(), 100000);
+    }
+
+    JudyMallocStats_t stats = getStats();
+    BOOST_CHECK_EQUAL(stats.jms_BytesInUse, 0);
+
+    JudyMallocSetPerThread(true);
+}
+
+void runThread(boost::barrier & barrier, int thread, int niter)
+{
+    barrier.wait();
+
+    for (unsigned iter = 0;  iter < 5;  ++iter) {
+        JudyLMap<uint64_t> m;
+        for (unsigned i = 0;  i < niter;  ++i)
+            m[i * 104729 + thread] = i;
+        BOOST_REQUIRE_EQUAL(m.size(), niter);
+        for (unsigned i = 0;  i < niter;  i += 2)
+            m.erase(i * 104729 + thread);
+        BOOST_REQUIRE_EQUAL(m.size(), niter / 2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_judy_malloc_threads)
+{
+    int nthreads = 8, niter = 50000;
+
+    boost::barrier barrier(nthreads);
+    boost::thread_group tg;
+    for (unsigned i = 0;  i < nthreads;  ++i)
+        tg.create_thread(boost::bind(runThread, boost::ref(barrier),
+                                     i, niter));
+    tg.join_all();
+
+    // Thread caches are given back when the threads exit
+    JudyMallocStats_t stats = getStats();
+    BOOST_CHECK_EQUAL(stats.jms_BytesInUse, 0);
+    BOOST_CHECK_LE(stats.jms_NumThreadCaches, 1);
+}
@@ -0,0 +1,129 @@
+/* judy_set_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Memory and speed of JudySet versus Lightweight_Hash_Set on sets of 64 bit
+   ids, including intersecting two sets.  The random pattern shows where
+   JudySet shouldn't be used: every id has a block to itself.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/judy/judy_set.h"
+#include "jml/utils/lightweight_hash.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <vector>
+
+using namespace ML;
+using namespace std;
+
+/** std::hash is the identity on integers, which makes runs of ids collide
+    in the hash table; mix the bits so that it's a fair comparison. */
+struct Mix_Hash {
+    size_t operator () (uint64_t key) const
+    {
+        key *= 0x9e3779b97f4a7c15ULL;
+        return key ^ (key >> 32);
+    }
+};
+
+typedef Lightweight_Hash_Set<uint64_t, Mix_Hash> Hash_Set;
+
+/** Ids for a set; dense is half of a range of sequential ids, clustered is
+    runs of ids allocated in blocks, and random is scattered over 64 bits.
+    The second set of a pair shares about half of its ids with the first. */
+vector<uint64_t> makeKeys(size_t n, const string & pattern, int which)
+{
+    vector<uint64_t> result;
+    uint64_t r = 1;
+    for (unsigned i = 0;  result.size() < n;  ++i) {
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        bool inSet = which == 0 ? (r >> 62) < 2 : ((r >> 62) & 1);
+        if (pattern == "dense") {
+            if (inSet) result.push_back(i + 1);
+        }
+        else if (pattern == "clustered") {
+            uint64_t start = (r >> 16) << 12;
+            int len = (r >> 2) % 200;
+            for (int j = 0;  j < len && result.size() < n;  ++j)
+                if (inSet || j % 2) result.push_back(start + j);
+        }
+        else if (inSet) result.push_back((r >> 1) | 1);
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_judy_set)
+{
+    cerr << "        n    pattern  judy B/key  hash B/key"
+         << "  judy ins/tst ns  hash ins/tst ns  judy/hash and ms" << endl;
+
+    for (size_t n: { 1000000, 10000000 }) {
+        for (string pattern: { "dense", "clustered", "random" }) {
+            vector<uint64_t> keys1 = makeKeys(n, pattern, 0);
+            vector<uint64_t> keys2 = makeKeys(n, pattern, 1);
+            double ns = 1e9 / n;
+            size_t total = 0;
+
+            JudySet judy1, judy2;
+            Timer timer;
+            for (uint64_t k: keys1)
+                judy1.insert(k);
+            double judyIns = timer.elapsed_wall();
+            for (uint64_t k: keys2)
+                judy2.insert(k);
+
+            timer.restart();
+            for (uint64_t k: keys2)
+                total += judy1.count(k);
+            double judyTest = timer.elapsed_wall();
+
+            timer.restart();
+            JudySet judyAnd = set_intersection(judy1, judy2);
+            double judyIntersect = timer.elapsed_wall();
+            size_t judyMem = judy1.memusage();
+            size_t judySize = judy1.size();
+            judy1.clear();
+            judy2.clear();
+
+            Hash_Set hash1, hash2;
+            timer.restart();
+            for (uint64_t k: keys1)
+                hash1.insert(k);
+            double hashIns = timer.elapsed_wall();
+            for (uint64_t k: keys2)
+                hash2.insert(k);
+
+            timer.restart();
+            for (uint64_t k: keys2)
+                total += hash1.count(k);
+            double hashTest = timer.elapsed_wall();
+
+            timer.restart();
+            Hash_Set hashAnd;
+            for (auto it = hash2.begin(), end = hash2.end();  it != end;  ++it)
+                if (hash1.count(*it))
+                    hashAnd.insert(*it);
+            double hashIntersect = timer.elapsed_wall();
+            size_t hashMem = hash1.capacity() * sizeof(uint64_t);
+
+            BOOST_CHECK_EQUAL(judySize, hash1.size());
+            BOOST_CHECK_EQUAL(judyAnd.size(), hashAnd.size());
+            BOOST_CHECK_NE(total, 0);
+
+            cerr << format("%9zd  %9s  %10.2f  %10.2f  %7.1f/%7.1f"
+                           "  %7.1f/%7.1f  %7.1f/%7.1f",
+                           n, pattern.c_str(),
+                           1.0 * judyMem / judySize,
+                           1.0 * hashMem / judySize,
+                           judyIns * ns, judyTest * ns,
+                           hashIns * ns, hashTest * ns,
+                           judyIntersect * 1000, hashIntersect * 1000)
+                 << endl;
+        }
+    }
+}
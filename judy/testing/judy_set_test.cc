@@ -0,0 +1,264 @@
+/* judy_set_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test program for Judy1 arrays and the JudySet wrapper.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/judy/judy_set.h"
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <vector>
+#include <set>
+
+using namespace ML;
+using namespace std;
+
+/** Keys in runs of random lengths and strides at random places, so that
+    there are full, partial and single key blocks. */
+vector<Word_t> randomKeys(size_t n, uint64_t seed)
+{
+    vector<Word_t> result;
+    uint64_t r = seed;
+    while (result.size() < n) {
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        Word_t start = r >> ((r >> 10) % 48);
+        int len = (r >> 4) % 200, stride = (r >> 20) % 5 + 1;
+        for (int i = 0;  i < len;  ++i)
+            result.push_back(start + i * stride);
+    }
+    result.push_back(0);
+    result.push_back(-1);
+    return result;
+}
+
+void checkSame(Pvoid_t array, const set<Word_t> & expected)
+{
+    BOOST_REQUIRE_EQUAL(Judy1Count(array, 0, -1, PJE0), expected.size());
+
+    Word_t key = 0;
+    auto it = expected.begin();
+    for (int res = Judy1First(array, &key, PJE0);  res == 1;
+         res = Judy1Next(array, &key, PJE0), ++it) {
+        BOOST_REQUIRE(it != expected.end());
+        BOOST_REQUIRE_EQUAL(key, *it);
+        BOOST_REQUIRE_EQUAL(Judy1Test(array, key, PJE0), 1);
+    }
+    BOOST_REQUIRE(it == expected.end());
+
+    key = -1;
+    auto rit = expected.rbegin();
+    for (int res = Judy1Last(array, &key, PJE0);  res == 1;
+         res = Judy1Prev(array, &key, PJE0), ++rit) {
+        BOOST_REQUIRE(rit != expected.rend());
+        BOOST_REQUIRE_EQUAL(key, *rit);
+    }
+    BOOST_REQUIRE(rit == expected.rend());
+}
+
+BOOST_AUTO_TEST_CASE(test_judy1_basics)
+{
+    Pvoid_t array = 0;
+    set<Word_t> expected;
+
+    Word_t key = 0;
+    BOOST_CHECK_EQUAL(Judy1First(array, &key, PJE0), 0);
+    BOOST_CHECK_EQUAL(Judy1Test(array, 0, PJE0), 0);
+    BOOST_CHECK_EQUAL(Judy1Unset(&array, 0, PJE0), 0);
+
+    // Around the block boundaries and the ends
+    Word_t keys[] = { 0, 1, 62, 63, 64, 65, 127, 128, 1000, (Word_t)-65,
+                      (Word_t)-64, (Word_t)-2, (Word_t)-1 };
+    for (Word_t k: keys) {
+        BOOST_CHECK_EQUAL(Judy1Set(&array, k, PJE0), 1);
+        BOOST_CHECK_EQUAL(Judy1Set(&array, k, PJE0), 0);
+        expected.insert(k);
+        checkSame(array, expected);
+    }
+
+    BOOST_CHECK_EQUAL(Judy1Count(array, 1, 64, PJE0), 4);
+    BOOST_CHECK_EQUAL(Judy1Count(array, 2, 62, PJE0), 1);
+    BOOST_CHECK_EQUAL(Judy1Count(array, 64, 64, PJE0), 1);
+    BOOST_CHECK_EQUAL(Judy1Count(array, 66, 126, PJE0), 0);
+    BOOST_CHECK_EQUAL(Judy1Count(array, 10, 5, PJE0), 0);
+
+    key = 2;
+    BOOST_CHECK_EQUAL(Judy1First(array, &key, PJE0), 1);
+    BOOST_CHECK_EQUAL(key, 62);
+    key = 129;
+    BOOST_CHECK_EQUAL(Judy1Prev(array, &key, PJE0), 1);
+    BOOST_CHECK_EQUAL(key, 128);
+    key = -1;
+    BOOST_CHECK_EQUAL(Judy1Next(array, &key, PJE0), 0);
+    key = 0;
+    BOOST_CHECK_EQUAL(Judy1Prev(array, &key, PJE0), 0);
+
+    for (Word_t k: keys) {
+        BOOST_CHECK_EQUAL(Judy1Unset(&array, k, PJE0), 1);
+        BOOST_CHECK_EQUAL(Judy1Unset(&array, k, PJE0), 0);
+        expected.erase(k);
+        checkSame(array, expected);
+    }
+    BOOST_CHECK(array == 0);
+
+    JError_t error;
+    BOOST_CHECK_EQUAL(Judy1First(array, 0, &error), (int)JERR);
+    BOOST_CHECK_EQUAL(JU_ERRNO(&error), JU_ERRNO_NULLPINDEX);
+}
+
+BOOST_AUTO_TEST_CASE(test_judy1_random)
+{
+    vector<Word_t> keys = randomKeys(100000, 3);
+    Pvoid_t array = 0;
+    set<Word_t> expected;
+
+    for (Word_t k: keys)
+        BOOST_REQUIRE_EQUAL(Judy1Set(&array, k, PJE0), expected.insert(k).second);
+    checkSame(array, expected);
+
+    // Counts over random ranges
+    uint64_t r = 7;
+    for (unsigned i = 0;  i < 1000;  ++i) {
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        Word_t lo = keys[(r >> 20) % keys.size()] - (r >> 60);
+        Word_t hi = lo + (r >> (16 + (r & 31)));
+        if (hi < lo) hi = -1;
+        size_t n = std::distance(expected.lower_bound(lo),
+                                 expected.upper_bound(hi));
+        BOOST_REQUIRE_EQUAL(Judy1Count(array, lo, hi, PJE0), n);
+    }
+
+    for (unsigned i = 0;  i < keys.size();  i += 3)
+        BOOST_REQUIRE_EQUAL(Judy1Unset(&array, keys[i], PJE0),
+                            expected.erase(keys[i]));
+    checkSame(array, expected);
+
+    cerr << expected.size() << " keys in " << Judy1MemUsed(array)
+         << " bytes" << endl;
+
+    Word_t mem = Judy1MemUsed(array);
+    BOOST_CHECK_EQUAL(Judy1FreeArray(&array, PJE0), mem);
+    BOOST_CHECK(array == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_judy1_union_intersect)
+{
+    for (uint64_t seed: { 1, 2 }) {
+        Pvoid_t array1 = 0, array2 = 0;
+        set<Word_t> set1, set2;
+
+        for (Word_t k: randomKeys(50000, seed)) {
+            Judy1Set(&array1, k, PJE0);
+            set1.insert(k);
+        }
+        for (Word_t k: randomKeys(50000, seed * 10)) {
+            Judy1Set(&array2, k, PJE0);
+            set2.insert(k);
+        }
+
+        // Lots of overlap as well as a little
+        for (Word_t k: randomKeys(20000, seed)) {
+            if (k % 3 == 0) continue;
+            Judy1Set(&array2, k, PJE0);
+            set2.insert(k);
+        }
+
+        set<Word_t> expectedUnion, expectedIntersection;
+        std::set_union(set1.begin(), set1.end(), set2.begin(), set2.end(),
+                       inserter(expectedUnion, expectedUnion.end()));
+        std::set_intersection(set1.begin(), set1.end(),
+                              set2.begin(), set2.end(),
+                              inserter(expectedIntersection,
+                                       expectedIntersection.end()));
+
+        Pvoid_t result = 0;
+        BOOST_REQUIRE_EQUAL(Judy1Union(&result, array1, array2, PJE0), 1);
+        checkSame(result, expectedUnion);
+        Judy1FreeArray(&result, PJE0);
+
+        BOOST_REQUIRE_EQUAL(Judy1Intersect(&result, array1, array2, PJE0), 1);
+        checkSame(result, expectedIntersection);
+        Judy1FreeArray(&result, PJE0);
+
+        // With an empty set
+        BOOST_REQUIRE_EQUAL(Judy1Union(&result, array1, 0, PJE0), 1);
+        checkSame(result, set1);
+        BOOST_CHECK_LE(Judy1MemUsed(result), Judy1MemUsed(array1));
+        Judy1FreeArray(&result, PJE0);
+
+        BOOST_REQUIRE_EQUAL(Judy1Intersect(&result, 0, array2, PJE0), 1);
+        BOOST_CHECK(result == 0);
+
+        // Disjoint
+        Pvoid_t odd = 0;
+        for (Word_t k: set1)
+            if (k & 1) Judy1Set(&odd, k, PJE0);
+        Pvoid_t even = 0;
+        for (Word_t k: set1)
+            if (!(k & 1)) Judy1Set(&even, k, PJE0);
+        BOOST_REQUIRE_EQUAL(Judy1Intersect(&result, odd, even, PJE0), 1);
+        BOOST_CHECK(result == 0);
+        BOOST_REQUIRE_EQUAL(Judy1Union(&result, odd, even, PJE0), 1);
+        checkSame(result, set1);
+
+        // Destination must be empty
+        JError_t error;
+        BOOST_CHECK_EQUAL(Judy1Union(&result, odd, even, &error), (int)JERR);
+        BOOST_CHECK_EQUAL(JU_ERRNO(&error), JU_ERRNO_NONNULLPARRAY);
+        BOOST_CHECK_EQUAL(Judy1Intersect(0, odd, even, &error), (int)JERR);
+        BOOST_CHECK_EQUAL(JU_ERRNO(&error), JU_ERRNO_NULLPPARRAY);
+
+        Judy1FreeArray(&result, PJE0);
+        Judy1FreeArray(&odd, PJE0);
+        Judy1FreeArray(&even, PJE0);
+        Judy1FreeArray(&array1, PJE0);
+        Judy1FreeArray(&array2, PJE0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_judy_set)
+{
+    JudySet s;
+    set<Word_t> expected;
+
+    for (Word_t k: randomKeys(20000, 5)) {
+        BOOST_REQUIRE_EQUAL(s.insert(k).second, expected.insert(k).second);
+    }
+    BOOST_CHECK_EQUAL(s.size(), expected.size());
+
+    BOOST_CHECK(std::equal(s.begin(), s.end(), expected.begin()));
+    auto rit = expected.rbegin();
+    for (auto it = s.end();  it != s.begin();  ++rit)
+        BOOST_REQUIRE_EQUAL(*--it, *rit);
+
+    BOOST_CHECK(s.find(*expected.begin()) == s.begin());
+    BOOST_CHECK(s.find(12345) == s.end() || expected.count(12345));
+    BOOST_CHECK_EQUAL(*s.lower_bound(1000), *expected.lower_bound(1000));
+    BOOST_CHECK_EQUAL(*s.upper_bound(*expected.begin()),
+                      *++expected.begin());
+    BOOST_CHECK_EQUAL(s.count_range(0, -1), expected.size());
+
+    JudySet s2 = s;
+    BOOST_CHECK_EQUAL(s2.size(), s.size());
+    BOOST_CHECK(std::equal(s2.begin(), s2.end(), s.begin()));
+
+    for (Word_t k: expected)
+        if (k % 2) s2.erase(k);
+
+    JudySet u = set_union(s, s2);
+    JudySet i = set_intersection(s, s2);
+    BOOST_CHECK_EQUAL(u.size(), s.size());
+    BOOST_CHECK_EQUAL(i.size(), s2.size());
+    BOOST_CHECK(std::equal(i.begin(), i.end(), s2.begin()));
+
+    s.clear();
+    BOOST_CHECK(s.empty());
+    BOOST_CHECK(s.begin() == s.end());
+    BOOST_CHECK_EQUAL(s.memusage(), 0);
+}
@@ -0,0 +1,14 @@
+$(eval $(call test,judyl_map_test,judy arch,boost))
+$(eval $(call test,judyl_map_benchmark,judy utils arch,boost manual))
+$(eval $(call test,judy_malloc_test,judy arch boost_thread,boost))
+$(eval $(call test,judyl_get_batch_test,judy arch,boost))
+$(eval $(call test,judyl_get_batch_benchmark,judy arch,boost manual))
+$(eval $(call test,judyl_build_test,judy arch,boost))
+$(eval $(call test,judyl_build_benchmark,judy arch,boost manual))
+$(eval $(call test,judysl_map_test,judy arch,boost))
+$(eval $(call test,judysl_map_benchmark,judy utils arch,boost manual))
+$(eval $(call test,judy_set_test,judy arch,boost))
+$(eval $(call test,judy_set_benchmark,judy utils arch,boost manual))
+$(eval $(call test,judyl_serialize_test,judy db utils arch,boost))
+$(eval $(call test,concurrent_judyl_test,judy arch boost_thread,boost))
+$(eval $(call test,concurrent_judyl_benchmark,judy arch boost_thread,boost manual))
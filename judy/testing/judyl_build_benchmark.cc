@@ -0,0 +1,99 @@
+/* judyl_build_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Speed of building a JudyL array from sorted keys with JudyLBuildIns()
+   versus JudyLIns() and JudyLInsArray().
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/judy/judyl_map.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <vector>
+
+using namespace ML;
+using namespace std;
+
+/** Generates the keys on the fly, so that the streaming build doesn't need
+    them in memory. */
+struct KeyGen {
+    KeyGen(int sparseness)
+        : sparseness(sparseness), key(0), rng(1)
+    {
+    }
+
+    Word_t next()
+    {
+        if (sparseness == 0) return key++;
+        rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+        key += 1 + (rng >> (64 - sparseness));
+        return key;
+    }
+
+    int sparseness;
+    Word_t key;
+    uint64_t rng;
+};
+
+BOOST_AUTO_TEST_CASE(benchmark_build)
+{
+    cerr << "     size  gap bits   ins s  array s  build s  vs ins  MB" << endl;
+
+    for (size_t n: { 1000000, 10000000, 50000000 }) {
+        for (int sparseness: { 0, 8, 24, 32 }) {
+
+            double insTime, arrayTime, buildTime;
+            size_t mem;
+
+            {
+                KeyGen gen(sparseness);
+                Pvoid_t array = 0;
+                Timer timer;
+                for (unsigned i = 0;  i < n;  ++i) {
+                    Word_t key = gen.next();
+                    *(Word_t *)JudyLIns(&array, key, PJE0) = key;
+                }
+                insTime = timer.elapsed_wall();
+                JudyLFreeArray(&array, PJE0);
+            }
+
+            {
+                KeyGen gen(sparseness);
+                Pvoid_t array = 0;
+                Timer timer;
+                vector<Word_t> keys(n);
+                for (unsigned i = 0;  i < n;  ++i)
+                    keys[i] = gen.next();
+                JudyLInsArray(&array, n, &keys[0], &keys[0], PJE0);
+                arrayTime = timer.elapsed_wall();
+                JudyLFreeArray(&array, PJE0);
+            }
+
+            {
+                KeyGen gen(sparseness);
+                Pvoid_t array = 0;
+                Timer timer;
+                PJudyLBuild_t build = JudyLBuildInit(PJE0);
+                for (unsigned i = 0;  i < n;  ++i) {
+                    Word_t key = gen.next();
+                    JudyLBuildIns(build, key, key, PJE0);
+                }
+                JudyLBuildFinish(build, &array, PJE0);
+                buildTime = timer.elapsed_wall();
+                mem = JudyLMemUsed(array);
+                BOOST_CHECK_EQUAL(JudyLCount(array, 0, -1, PJE0), n);
+                JudyLFreeArray(&array, PJE0);
+            }
+
+            cerr << format("%9zd  %8d  %6.3f  %7.3f  %7.3f  %5.2fx  %5zd",
+                           n, sparseness, insTime, arrayTime, buildTime,
+                           insTime / buildTime, mem / 1000000)
+                 << endl;
+        }
+    }
+}
@@ -0,0 +1,235 @@
+/* judyl_build_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test program for building JudyL arrays from sorted keys.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/judy/judyl_map.h"
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace ML;
+using namespace std;
+
+Pvoid_t build(const vector<Word_t> & keys)
+{
+    PJudyLBuild_t build = JudyLBuildInit(PJE0);
+    BOOST_REQUIRE(build);
+    for (unsigned i = 0;  i < keys.size();  ++i)
+        BOOST_REQUIRE_EQUAL(JudyLBuildIns(build, keys[i], ~keys[i], PJE0), 1);
+
+    Pvoid_t result = 0;
+    BOOST_REQUIRE_EQUAL(JudyLBuildFinish(build, &result, PJE0), 1);
+    return result;
+}
+
+/** Check that building gives the same array as JudyLInsArray() does, and
+    that it's a valid array that can be modified afterwards. */
+void checkBuild(const vector<Word_t> & keys)
+{
+    Pvoid_t built = build(keys);
+
+    BOOST_REQUIRE_EQUAL(JudyLCount(built, 0, -1, PJE0), keys.size());
+
+    vector<Word_t> values;
+    for (unsigned i = 0;  i < keys.size();  ++i)
+        values.push_back(~keys[i]);
+
+    Pvoid_t expected = 0;
+    if (!keys.empty())
+        BOOST_REQUIRE_EQUAL(JudyLInsArray(&expected, keys.size(), &keys[0],
+                                          &values[0], PJE0), 1);
+    BOOST_CHECK_EQUAL(JudyLMemUsed(built), JudyLMemUsed(expected));
+
+    Word_t key = 0;
+    unsigned i = 0;
+    for (PPvoid_t val = JudyLFirst(built, &key, PJE0);  val;
+         val = JudyLNext(built, &key, PJE0), ++i) {
+        BOOST_REQUIRE_LT(i, keys.size());
+        BOOST_REQUIRE_EQUAL(key, keys[i]);
+        BOOST_REQUIRE_EQUAL(*(Word_t *)val, ~keys[i]);
+    }
+    BOOST_REQUIRE_EQUAL(i, keys.size());
+
+    for (unsigned i = 0;  i < keys.size();  ++i) {
+        PPvoid_t val = JudyLGet(built, keys[i], PJE0);
+        BOOST_REQUIRE(val);
+        BOOST_REQUIRE_EQUAL(*(Word_t *)val, ~keys[i]);
+    }
+
+    // Modify it to make sure that the structure is sound
+    for (unsigned i = 0;  i < keys.size();  i += 2)
+        BOOST_REQUIRE_EQUAL(JudyLDel(&built, keys[i], PJE0), 1);
+    for (unsigned i = 0;  i < keys.size();  i += 2)
+        *(Word_t *)JudyLIns(&built, keys[i], PJE0) = i;
+    BOOST_REQUIRE_EQUAL(JudyLCount(built, 0, -1, PJE0), keys.size());
+
+    JudyLFreeArray(&built, PJE0);
+    JudyLFreeArray(&expected, PJE0);
+}
+
+vector<Word_t> sortedRandom(size_t n, int shift, uint64_t seed = 1)
+{
+    vector<Word_t> result;
+    uint64_t key = seed;
+    for (unsigned i = 0;  i < n;  ++i) {
+        key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+        result.push_back(key >> shift);
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+vector<Word_t> strided(Word_t start, size_t n, Word_t stride)
+{
+    vector<Word_t> result;
+    for (unsigned i = 0;  i < n;  ++i) {
+        Word_t key = start + i * stride;
+        if (i > 0 && key <= result.back()) break;  // wrapped around
+        result.push_back(key);
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(test_build_sizes)
+{
+    // Around the root leaf and buffer sizes
+    size_t sizes[] = { 0, 1, 2, 30, 31, 32, 33, 100, 511, 512, 513,
+                       1023, 1024, 1025, 2048, 5000 };
+
+    for (size_t n: sizes) {
+        checkBuild(strided(0, n, 1));
+        checkBuild(strided(-n, n, 1));
+        checkBuild(sortedRandom(n, 0));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_build_patterns)
+{
+    // Strides that put the keys in the different levels of leaves and
+    // branches, and that narrow pointers are needed for
+    Word_t strides[] = { 1, 2, 3, 7, 255, 256, 257, 65535, 65536, 65537,
+                         1 << 24, 1ULL << 32, (1ULL << 40) + 3,
+                         1ULL << 48, 1ULL << 52 };
+
+    for (Word_t stride: strides) {
+        checkBuild(strided(0, 3000, stride));
+        checkBuild(strided(stride * 1000, 100000 / (stride < 256 ? 1 : 10),
+                           stride));
+    }
+
+    for (int shift = 0;  shift < 56;  shift += 4)
+        checkBuild(sortedRandom(50000, shift, shift + 1));
+}
+
+BOOST_AUTO_TEST_CASE(test_build_clustered)
+{
+    // Dense runs of random lengths at random places; makes lots of
+    // branches be closed and opened at different levels
+    vector<Word_t> starts = sortedRandom(2000, 0, 17);
+    vector<Word_t> keys;
+    uint64_t r = 5;
+    for (unsigned i = 0;  i < starts.size();  ++i) {
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        int len = (r >> 40) % (i % 3 == 0 ? 5000 : 50);
+        for (int j = 0;  j < len;  ++j) {
+            Word_t key = starts[i] + j * ((r >> 20) % 4 + 1);
+            if (key < starts[i]) break;
+            if (i < starts.size() - 1 && key >= starts[i + 1]) break;
+            keys.push_back(key);
+        }
+    }
+
+    checkBuild(keys);
+}
+
+BOOST_AUTO_TEST_CASE(test_build_large)
+{
+    checkBuild(strided(1000, 1000000, 1));
+    checkBuild(sortedRandom(1000000, 8));
+}
+
+BOOST_AUTO_TEST_CASE(test_build_errors)
+{
+    JError_t error;
+
+    // Unsorted; the array has everything before the error
+    for (size_t n: { 10, 1500, 100000 }) {
+        PJudyLBuild_t build = JudyLBuildInit(PJE0);
+        for (unsigned i = 0;  i < n;  ++i)
+            BOOST_CHECK_EQUAL(JudyLBuildIns(build, i * 10, i, PJE0), 1);
+        BOOST_CHECK_EQUAL(JudyLBuildIns(build, 5, 0, &error), (int)JERR);
+        BOOST_CHECK_EQUAL(JU_ERRNO(&error), JU_ERRNO_UNSORTED);
+
+        // Duplicates are errors too, and no more are accepted
+        BOOST_CHECK_EQUAL(JudyLBuildIns(build, n * 20, 0, &error), (int)JERR);
+
+        Pvoid_t array = 0;
+        BOOST_CHECK_EQUAL(JudyLBuildFinish(build, &array, &error), (int)JERR);
+        BOOST_CHECK_EQUAL(JU_ERRNO(&error), JU_ERRNO_UNSORTED);
+        BOOST_CHECK_EQUAL(JudyLCount(array, 0, -1, PJE0), n);
+        BOOST_CHECK(!JudyLGet(array, n * 20, PJE0));
+        JudyLFreeArray(&array, PJE0);
+    }
+
+    {
+        PJudyLBuild_t build = JudyLBuildInit(PJE0);
+        JudyLBuildIns(build, 1, 1, PJE0);
+        BOOST_CHECK_EQUAL(JudyLBuildIns(build, 1, 1, &error), (int)JERR);
+        Pvoid_t array = 0;
+        BOOST_CHECK_EQUAL(JudyLBuildFinish(build, &array, PJE0), (int)JERR);
+        BOOST_CHECK_EQUAL(JudyLCount(array, 0, -1, PJE0), 1);
+        JudyLFreeArray(&array, PJE0);
+    }
+
+    // Non-empty destination
+    {
+        PJudyLBuild_t build = JudyLBuildInit(PJE0);
+        JudyLBuildIns(build, 1, 1, PJE0);
+        Pvoid_t array = 0;
+        JudyLIns(&array, 10, PJE0);
+        BOOST_CHECK_EQUAL(JudyLBuildFinish(build, &array, &error), (int)JERR);
+        BOOST_CHECK_EQUAL(JU_ERRNO(&error), JU_ERRNO_NONNULLPARRAY);
+        BOOST_CHECK_EQUAL(JudyLCount(array, 0, -1, PJE0), 1);
+        JudyLFreeArray(&array, PJE0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_map_assign_sorted)
+{
+    std::map<Word_t, string> source;
+    for (unsigned i = 0;  i < 10000;  ++i)
+        source[i * 7919] = to_string(i);
+
+    JudyLMap<string> m;
+    m[5] = "replaced";
+    m.assign_sorted(source.begin(), source.end());
+
+    BOOST_CHECK_EQUAL(m.size(), source.size());
+    BOOST_CHECK_EQUAL(m.count(5), 0);
+    auto it = m.begin();
+    for (auto & e: source) {
+        BOOST_REQUIRE(it != m.end());
+        BOOST_CHECK_EQUAL(it->first, e.first);
+        BOOST_CHECK_EQUAL(it->second, e.second);
+        ++it;
+    }
+
+    vector<pair<Word_t, int> > unsorted = { { 1, 1 }, { 3, 3 }, { 2, 2 } };
+    JudyLMap<int> m2;
+    m2[10] = 10;
+    BOOST_CHECK_THROW(m2.assign_sorted(unsorted.begin(), unsorted.end()),
+                      ML::Exception);
+    BOOST_CHECK_EQUAL(m2.size(), 1);
+    BOOST_CHECK_EQUAL(m2[10], 10);
+}
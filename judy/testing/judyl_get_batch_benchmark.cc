@@ -0,0 +1,93 @@
+/* judyl_get_batch_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Speed of JudyLGetBatch() versus a loop over JudyLGet().
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/judy/judyl_map.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+using namespace ML;
+using namespace std;
+
+vector<Word_t> randomKeys(size_t n, int shift)
+{
+    vector<Word_t> result;
+    uint64_t key = 1;
+    for (unsigned i = 0;  i < n;  ++i) {
+        key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+        result.push_back(key >> shift);
+    }
+    return result;
+}
+
+double timeSingle(Pcvoid_t array, const vector<Word_t> & keys,
+                  Word_t & total)
+{
+    Timer timer;
+    for (unsigned i = 0;  i < keys.size();  ++i) {
+        PPvoid_t val = JudyLGet(array, keys[i], PJE0);
+        if (val) total += *(Word_t *)val;
+    }
+    return timer.elapsed_wall();
+}
+
+double timeBatch(Pcvoid_t array, const vector<Word_t> & keys,
+                 Word_t & total)
+{
+    // In chunks, as a caller would with a stream of keys
+    enum { CHUNK = 1024 };
+    PPvoid_t values[CHUNK];
+
+    Timer timer;
+    for (unsigned i = 0;  i < keys.size();  i += CHUNK) {
+        size_t n = std::min<size_t>(CHUNK, keys.size() - i);
+        JudyLGetBatch(array, &keys[i], n, values, PJE0);
+        for (unsigned j = 0;  j < n;  ++j)
+            if (values[j]) total += *(Word_t *)values[j];
+    }
+    return timer.elapsed_wall();
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_get_batch)
+{
+    cerr << "    size  shift   order  single ns  batch ns  speedup" << endl;
+
+    for (size_t n = 10000;  n <= 10000000;  n *= 10) {
+        for (int shift = 0;  shift <= 32;  shift += 32) {
+            vector<Word_t> keys = randomKeys(n, shift);
+
+            JudyLMap<Word_t> m;
+            for (unsigned i = 0;  i < keys.size();  ++i)
+                m[keys[i]] = i;
+
+            vector<Word_t> lookups = randomKeys(std::min<size_t>(n, 1000000),
+                                                shift);
+            std::random_shuffle(lookups.begin(), lookups.end());
+
+            for (int sorted = 0;  sorted < 2;  ++sorted) {
+                if (sorted) std::sort(lookups.begin(), lookups.end());
+
+                Word_t total1 = 0, total2 = 0;
+                double single = timeSingle(m.judy(), lookups, total1);
+                double batch = timeBatch(m.judy(), lookups, total2);
+                BOOST_CHECK_EQUAL(total1, total2);
+
+                double ns = 1e9 / lookups.size();
+                cerr << format("%8zd  %5d  %6s  %9.1f  %8.1f  %7.2f",
+                               n, shift, sorted ? "sorted" : "random",
+                               single * ns, batch * ns, single / batch)
+                     << endl;
+            }
+        }
+    }
+}
@@ -0,0 +1,133 @@
+/* judyl_get_batch_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test program for batched JudyL lookups.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/judy/judyl_map.h"
+#define JUDYL 1
+#include "jml/judy/JudyL.h"
+#include "jml/judy/JudyPrivate1L.h"
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+using namespace ML;
+using namespace std;
+
+/** Check that the batch gives the same answers as JudyLGet() one by one. */
+void checkBatch(Pcvoid_t array, const vector<Word_t> & keys)
+{
+    vector<PPvoid_t> values(keys.size(), (PPvoid_t)1);
+    Word_t found = JudyLGetBatch(array, &keys[0], keys.size(), &values[0],
+                                 PJE0);
+
+    Word_t expectedFound = 0;
+    for (unsigned i = 0;  i < keys.size();  ++i) {
+        PPvoid_t expected = JudyLGet(array, keys[i], PJE0);
+        expectedFound += expected != 0;
+        BOOST_REQUIRE_EQUAL(values[i], expected);
+    }
+
+    BOOST_CHECK_EQUAL(found, expectedFound);
+}
+
+vector<Word_t> randomKeys(size_t n, int shift)
+{
+    vector<Word_t> result;
+    uint64_t key = 1;
+    for (unsigned i = 0;  i < n;  ++i) {
+        key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+        result.push_back(key >> shift);
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(test_get_batch_small)
+{
+    JudyLMap<Word_t> m;
+
+    vector<Word_t> keys = { 0, 1, 2, 100, (Word_t)-1 };
+
+    // Empty array
+    checkBatch(m.judy(), keys);
+
+    // Root leaf
+    m[1] = 1;
+    m[100] = 2;
+    checkBatch(m.judy(), keys);
+
+    // Nothing to look up
+    BOOST_CHECK_EQUAL(JudyLGetBatch(m.judy(), 0, 0, 0, PJE0), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_get_batch_large)
+{
+    // Different shifts give different densities and so different node types
+    for (int shift = 0;  shift < 60;  shift += 12) {
+        JudyLMap<Word_t> m;
+        vector<Word_t> keys = randomKeys(200000, shift);
+        for (unsigned i = 0;  i < keys.size();  i += 2)
+            m[keys[i]] = i;
+
+        // Hits and misses, in random order
+        checkBatch(m.judy(), keys);
+
+        // Sorted, which exercises the path reuse
+        std::sort(keys.begin(), keys.end());
+        checkBatch(m.judy(), keys);
+
+        // Dense runs
+        vector<Word_t> dense;
+        for (unsigned i = 0;  i < 1000;  ++i)
+            for (unsigned j = 0;  j < 100;  ++j)
+                dense.push_back(keys[i * 100] + j);
+        checkBatch(m.judy(), dense);
+
+        // Fewer keys than lanes
+        keys.resize(5);
+        checkBatch(m.judy(), keys);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_get_batch_dense)
+{
+    // Dense array, which has bitmap leaves and uncompressed branches
+    JudyLMap<Word_t> m;
+    for (unsigned i = 0;  i < 1000000;  ++i)
+        m[i] = i;
+
+    vector<Word_t> keys = randomKeys(100000, 44);
+    checkBatch(m.judy(), keys);
+    std::sort(keys.begin(), keys.end());
+    checkBatch(m.judy(), keys);
+}
+
+BOOST_AUTO_TEST_CASE(test_get_batch_corrupt)
+{
+    // A bad JP type part way through the batch is reported, not skipped
+    JudyLMap<Word_t> m;
+    for (unsigned i = 0;  i < 400000;  ++i)
+        m[i * 977] = i;
+
+    vector<Word_t> keys = randomKeys(100, 44);
+    vector<PPvoid_t> values(keys.size());
+
+    Pjpm_t Pjpm = P_JPM(m.judy());
+    uint8_t type = Pjpm->jpm_JP.jp_Type;
+    Pjpm->jpm_JP.jp_Type = 0;
+
+    JError_t error;
+    Word_t found = JudyLGetBatch(m.judy(), &keys[0], keys.size(), &values[0],
+                                 &error);
+    Pjpm->jpm_JP.jp_Type = type;
+
+    BOOST_CHECK_EQUAL(found, JERR);
+    BOOST_CHECK_EQUAL(JU_ERRNO(&error), JU_ERRNO_CORRUPT);
+}
@@ -0,0 +1,127 @@
+/* judyl_map_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Memory and speed of JudyLMap versus Lightweight_Hash and std::map on
+   sparse 64 bit keys.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/judy/judyl_map.h"
+#include "jml/utils/lightweight_hash.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <vector>
+#include <map>
+
+using namespace ML;
+using namespace std;
+
+size_t stdMapBytes = 0;
+
+/** Allocator that keeps track of how much memory std::map has asked for. */
+template<typename T>
+struct Counting_Allocator : public std::allocator<T> {
+    template<typename U> struct rebind { typedef Counting_Allocator<U> other; };
+
+    Counting_Allocator() {}
+    template<typename U>
+    Counting_Allocator(const Counting_Allocator<U> &) {}
+
+    T * allocate(size_t n)
+    {
+        stdMapBytes += n * sizeof(T);
+        return std::allocator<T>::allocate(n);
+    }
+
+    void deallocate(T * p, size_t n)
+    {
+        stdMapBytes -= n * sizeof(T);
+        std::allocator<T>::deallocate(p, n);
+    }
+};
+
+typedef std::map<uint64_t, uint64_t, std::less<uint64_t>,
+                 Counting_Allocator<std::pair<const uint64_t, uint64_t> > >
+    Std_Map;
+
+/** Keys that are sparse but clustered, like ids allocated in blocks. */
+vector<uint64_t> makeKeys(size_t n, int spacingBits)
+{
+    vector<uint64_t> result;
+    uint64_t key = 1;
+    for (unsigned i = 0;  i < n;  ++i) {
+        key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+        result.push_back((key >> spacingBits) | 1);
+    }
+    return result;
+}
+
+template<typename Map>
+double timeInsert(Map & map, const vector<uint64_t> & keys)
+{
+    Timer timer;
+    for (unsigned i = 0;  i < keys.size();  ++i)
+        map[keys[i]] = i;
+    return timer.elapsed_wall();
+}
+
+template<typename Map>
+double timeLookup(const Map & map, const vector<uint64_t> & keys,
+                  uint64_t & total)
+{
+    Timer timer;
+    for (unsigned i = 0;  i < keys.size();  ++i)
+        total += map.find(keys[i])->second;
+    return timer.elapsed_wall();
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_judyl_map)
+{
+    cerr << "      n  bits      judy B/key  hash B/key   map B/key"
+         << "  judy ins/lkp ns  hash ins/lkp ns  map ins/lkp ns" << endl;
+
+    for (size_t n = 1000;  n <= 10000000;  n *= 10) {
+        for (int spacingBits = 0;  spacingBits <= 40;  spacingBits += 20) {
+            vector<uint64_t> keys = makeKeys(n, spacingBits);
+            uint64_t total = 0;
+
+            JudyLMap<uint64_t> judy;
+            double judyIns = timeInsert(judy, keys);
+            double judyLkp = timeLookup(judy, keys, total);
+            size_t judyMem = judy.memusage();
+
+            Lightweight_Hash<uint64_t, uint64_t> hash;
+            double hashIns = timeInsert(hash, keys);
+            double hashLkp = timeLookup(hash, keys, total);
+            size_t hashMem = hash.capacity()
+                * sizeof(std::pair<uint64_t, uint64_t>);
+
+            double mapIns, mapLkp;
+            size_t mapMem;
+            {
+                Std_Map map;
+                mapIns = timeInsert(map, keys);
+                mapLkp = timeLookup(map, keys, total);
+                mapMem = stdMapBytes;
+            }
+
+            BOOST_CHECK_EQUAL(judy.size(), hash.size());
+
+            double ns = 1e9 / n;
+            cerr << format("%8zd  %4d  %10.1f  %10.1f  %10.1f"
+                           "  %7.1f/%7.1f  %7.1f/%7.1f  %7.1f/%7.1f",
+                           n, spacingBits,
+                           1.0 * judyMem / n, 1.0 * hashMem / n,
+                           1.0 * mapMem / n,
+                           judyIns * ns, judyLkp * ns,
+                           hashIns * ns, hashLkp * ns,
+                           mapIns * ns, mapLkp * ns)
+                 << endl;
+        }
+    }
+}
@@ -0,0 +1,164 @@
+/* judyl_map_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test program for the JudyL map wrapper.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/judy/judyl_map.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <string>
+#include <map>
+
+using namespace ML;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE(test_judyl_map_basics)
+{
+    JudyLMap<int> m;
+    BOOST_CHECK(m.empty());
+    BOOST_CHECK_EQUAL(m.size(), 0);
+    BOOST_CHECK(m.begin() == m.end());
+    BOOST_CHECK(m.find(1) == m.end());
+
+    m[10] = 1;
+    m[0] = 2;
+    m[(Word_t)-1] = 3;
+
+    BOOST_CHECK(!m.empty());
+    BOOST_CHECK_EQUAL(m.size(), 3);
+    BOOST_CHECK_EQUAL(m.count(10), 1);
+    BOOST_CHECK_EQUAL(m.count(11), 0);
+    BOOST_CHECK_EQUAL(m.find(0)->second, 2);
+
+    auto res = m.insert(10, 100);
+    BOOST_CHECK(!res.second);
+    BOOST_CHECK_EQUAL(res.first->second, 1);
+
+    res = m.insert(20, 4);
+    BOOST_CHECK(res.second);
+    BOOST_CHECK_EQUAL(res.first->first, 20);
+
+    // Iteration is in key order, and works both ways
+    vector<Word_t> keys;
+    for (auto it = m.begin();  it != m.end();  ++it)
+        keys.push_back(it->first);
+    BOOST_REQUIRE_EQUAL(keys.size(), 4);
+    BOOST_CHECK_EQUAL(keys[0], 0);
+    BOOST_CHECK_EQUAL(keys[1], 10);
+    BOOST_CHECK_EQUAL(keys[2], 20);
+    BOOST_CHECK_EQUAL(keys[3], (Word_t)-1);
+
+    auto it = m.end();
+    --it;
+    BOOST_CHECK_EQUAL(it->first, (Word_t)-1);
+    --it;
+    BOOST_CHECK_EQUAL(it->first, 20);
+
+    BOOST_CHECK_EQUAL(m.erase(10), 1);
+    BOOST_CHECK_EQUAL(m.erase(10), 0);
+    BOOST_CHECK_EQUAL(m.size(), 3);
+
+    m.clear();
+    BOOST_CHECK(m.empty());
+    BOOST_CHECK_EQUAL(m.memusage(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_judyl_map_bounds_rank_select)
+{
+    JudyLMap<uint64_t> m;
+    for (unsigned i = 1;  i <= 1000;  ++i)
+        m[i * 1000] = i;
+
+    const JudyLMap<uint64_t> & cm = m;
+
+    BOOST_CHECK_EQUAL(cm.lower_bound(0)->first, 1000);
+    BOOST_CHECK_EQUAL(cm.lower_bound(1000)->first, 1000);
+    BOOST_CHECK_EQUAL(cm.lower_bound(1001)->first, 2000);
+    BOOST_CHECK_EQUAL(cm.upper_bound(1000)->first, 2000);
+    BOOST_CHECK(cm.lower_bound(1000001) == cm.end());
+    BOOST_CHECK(cm.upper_bound(1000000) == cm.end());
+
+    BOOST_CHECK_EQUAL(m.rank(0), 0);
+    BOOST_CHECK_EQUAL(m.rank(1000), 0);
+    BOOST_CHECK_EQUAL(m.rank(1001), 1);
+    BOOST_CHECK_EQUAL(m.rank(500000), 499);
+    BOOST_CHECK_EQUAL(m.rank((Word_t)-1), 1000);
+
+    BOOST_CHECK_EQUAL(m.count_range(1000, 10000), 10);
+    BOOST_CHECK_EQUAL(m.count_range(10000, 1000), 0);
+
+    for (unsigned i = 0;  i < 1000;  ++i) {
+        auto it = m.select(i);
+        BOOST_REQUIRE(it != m.end());
+        BOOST_CHECK_EQUAL(it->first, (i + 1) * 1000);
+        BOOST_CHECK_EQUAL(m.rank(it->first), i);
+    }
+    BOOST_CHECK(m.select(1000) == m.end());
+}
+
+BOOST_AUTO_TEST_CASE(test_judyl_map_out_of_line_values)
+{
+    JudyLMap<string> m;
+    m[1] = "hello";
+    m[2] = string(1000, 'x');
+    m.insert(3, "world");
+
+    BOOST_CHECK_EQUAL(m[1], "hello");
+    BOOST_CHECK_EQUAL(m.find(2)->second.size(), 1000);
+    BOOST_CHECK_EQUAL(m.find(3)->second, "world");
+
+    // Copying is deep
+    JudyLMap<string> m2 = m;
+    m2[1] = "goodbye";
+    BOOST_CHECK_EQUAL(m[1], "hello");
+    BOOST_CHECK_EQUAL(m2[1], "goodbye");
+    BOOST_CHECK_EQUAL(m2.size(), 3);
+
+    // Moving steals the array
+    JudyLMap<string> m3 = std::move(m2);
+    BOOST_CHECK(m2.empty());
+    BOOST_CHECK_EQUAL(m3.size(), 3);
+    BOOST_CHECK_EQUAL(m3[1], "goodbye");
+
+    m3 = m;
+    BOOST_CHECK_EQUAL(m3[1], "hello");
+
+    m.erase(2);
+    BOOST_CHECK_EQUAL(m.size(), 2);
+    BOOST_CHECK_EQUAL(m3.size(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_judyl_map_vs_std_map)
+{
+    JudyLMap<uint64_t> m;
+    std::map<uint64_t, uint64_t> ref;
+
+    uint64_t key = 1;
+    for (unsigned i = 0;  i < 100000;  ++i) {
+        key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t k = key >> (i % 64);
+        if (i % 5 == 4) {
+            BOOST_CHECK_EQUAL(m.erase(k), ref.erase(k));
+        }
+        else {
+            m[k] = i;
+            ref[k] = i;
+        }
+    }
+
+    BOOST_CHECK_EQUAL(m.size(), ref.size());
+
+    auto jt = m.begin();
+    for (auto it = ref.begin();  it != ref.end();  ++it, ++jt) {
+        BOOST_REQUIRE(jt != m.end());
+        BOOST_CHECK_EQUAL(jt->first, it->first);
+        BOOST_CHECK_EQUAL(jt->second, it->second);
+    }
+    BOOST_CHECK(jt == m.end());
+}
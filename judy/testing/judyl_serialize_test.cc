@@ -0,0 +1,201 @@
+/* judyl_serialize_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test of persisting JudyL arrays to archives and flat images.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/judy/judyl_flat_image.h"
+#include "jml/judy/judyl_map_persistence.h"
+#include "jml/db/persistent.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+using namespace ML;
+using namespace ML::DB;
+using namespace std;
+
+template<typename Value>
+void checkSame(const JudyLMap<Value> & m1, const JudyLMap<Value> & m2)
+{
+    BOOST_REQUIRE_EQUAL(m1.size(), m2.size());
+    auto it2 = m2.begin();
+    for (auto it1 = m1.begin();  it1 != m1.end();  ++it1, ++it2) {
+        BOOST_REQUIRE_EQUAL(it1->first, it2->first);
+        BOOST_REQUIRE_EQUAL(it1->second, it2->second);
+    }
+}
+
+template<typename Value>
+string serialize(const JudyLMap<Value> & m)
+{
+    ostringstream stream;
+    {
+        Store_Writer writer(stream);
+        writer << m << string("END");
+    }
+    return stream.str();
+}
+
+template<typename Value>
+void checkRoundTrip(const JudyLMap<Value> & m)
+{
+    string s = serialize(m);
+    Store_Reader reader(s.c_str(), s.size());
+
+    // Loading replaces what was there
+    JudyLMap<Value> m2;
+    m2[12345678] = Value();
+    string end;
+    reader >> m2 >> end;
+    BOOST_CHECK_EQUAL(end, "END");
+    checkSame(m, m2);
+}
+
+JudyLMap<uint64_t> makeMap(size_t n, int shift)
+{
+    JudyLMap<uint64_t> result;
+    uint64_t r = n;
+    for (unsigned i = 0;  i < n;  ++i) {
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        result[r >> shift] = i;
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(test_serialize_reconstitute)
+{
+    checkRoundTrip(JudyLMap<uint64_t>());
+
+    for (int shift: { 0, 20, 40, 60 })
+        for (size_t n: { 1, 10, 1000, 100000 })
+            checkRoundTrip(makeMap(n, shift));
+
+    JudyLMap<string> strings;
+    strings[0] = "zero";
+    strings[-1] = "last";
+    for (unsigned i = 0;  i < 1000;  ++i)
+        strings[i * 1000003] = to_string(i);
+    checkRoundTrip(strings);
+
+    // Dense keys and small values need about two bytes per entry
+    JudyLMap<uint64_t> dense;
+    for (unsigned i = 0;  i < 100000;  ++i)
+        dense[i + 1000000] = i % 100;
+    BOOST_CHECK_LT(serialize(dense).size(), 2 * dense.size() + 20);
+
+    // Corrupt versions throw rather than returning a broken map
+    string s = serialize(dense);
+    s[0] = 5;
+    Store_Reader reader(s.c_str(), s.size());
+    JudyLMap<uint64_t> m;
+    BOOST_CHECK_THROW(reader >> m, std::exception);
+}
+
+void checkImage(const JudyLFlatImage & image, const JudyLMap<uint64_t> & m)
+{
+    BOOST_REQUIRE_EQUAL(image.size(), m.size());
+
+    size_t pos = 0;
+    for (auto it = m.begin();  it != m.end();  ++it, ++pos) {
+        BOOST_REQUIRE_EQUAL(image.key(pos), it->first);
+        BOOST_REQUIRE_EQUAL(image.value(pos), it->second);
+        const Word_t * val = image.find(it->first);
+        BOOST_REQUIRE(val);
+        BOOST_REQUIRE_EQUAL(*val, it->second);
+    }
+
+    // Keys that aren't there
+    uint64_t r = 3;
+    for (unsigned i = 0;  i < 10000;  ++i) {
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        Word_t key = r >> (r & 63);
+        auto it = m.lower_bound(key);
+        size_t pos = image.lower_bound(key);
+        if (it == m.end()) {
+            BOOST_REQUIRE_EQUAL(pos, image.size());
+            continue;
+        }
+        BOOST_REQUIRE_LT(pos, image.size());
+        BOOST_REQUIRE_EQUAL(image.key(pos), it->first);
+        BOOST_REQUIRE_EQUAL(image.count(key), m.count(key));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_flat_image)
+{
+    for (int shift: { 0, 30, 50 }) {
+        for (size_t n: { 0, 1, 63, 64, 65, 1000, 100000 }) {
+            JudyLMap<uint64_t> m = makeMap(n, shift);
+            ostringstream stream;
+            JudyLFlatImage::write(stream, m);
+            string s = stream.str();
+
+            // Copy so that it's aligned
+            vector<Word_t> aligned(s.size() / sizeof(Word_t));
+            memcpy(aligned.data(), s.c_str(), s.size());
+            JudyLFlatImage image(File_Read_Buffer((const char *)aligned.data(),
+                                                  s.size()));
+            checkImage(image, m);
+
+            JudyLMap<uint64_t> loaded;
+            image.load(loaded);
+            checkSame(m, loaded);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_flat_image_file)
+{
+    string filename = "judyl_flat_image_test-"
+        + to_string(getpid()) + ".img";
+
+    JudyLMap<float> m;
+    for (unsigned i = 0;  i < 10000;  ++i)
+        m[i * i] = i / 10.0;
+
+    {
+        ofstream stream(filename.c_str());
+        JudyLFlatImage::write(stream, m);
+    }
+
+    JudyLFlatImage image(filename);
+    unlink(filename.c_str());
+
+    BOOST_CHECK_EQUAL(image.size(), m.size());
+    JudyLMap<float> loaded;
+    image.load(loaded);
+    checkSame(m, loaded);
+
+    // Bad images
+    string s(100, 'x');
+    BOOST_CHECK_THROW(JudyLFlatImage(File_Read_Buffer(s.c_str(), 10)),
+                      ML::Exception);
+    BOOST_CHECK_THROW(JudyLFlatImage(File_Read_Buffer(s.c_str(), 64)),
+                      ML::Exception);
+
+    // Header counts far larger than the file
+    {
+        ostringstream stream;
+        JudyLFlatImage::write(stream, makeMap(100, 0));
+        string s = stream.str();
+        vector<Word_t> aligned(s.size() / sizeof(Word_t));
+        memcpy(aligned.data(), s.c_str(), s.size());
+        JudyLFlatImage::Header * header
+            = (JudyLFlatImage::Header *)aligned.data();
+        header->size = (uint64_t)-1 / 2;
+        header->indexSize = (uint64_t)-1;
+        BOOST_CHECK_THROW(JudyLFlatImage(File_Read_Buffer
+                                         ((const char *)aligned.data(),
+                                          s.size())),
+                          ML::Exception);
+    }
+}
@@ -0,0 +1,156 @@
+/* judysl_map_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Memory and speed of JudySLMap versus std::map and Lightweight_Hash on
+   string keys with lots of shared prefixes.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/judy/judysl_map.h"
+#include "jml/utils/lightweight_hash.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <vector>
+#include <map>
+
+using namespace ML;
+using namespace std;
+
+size_t stdMapBytes = 0;
+
+/** Allocator that keeps track of how much memory std::map and its strings
+    have asked for. */
+template<typename T>
+struct Counting_Allocator : public std::allocator<T> {
+    template<typename U> struct rebind { typedef Counting_Allocator<U> other; };
+
+    Counting_Allocator() {}
+    template<typename U>
+    Counting_Allocator(const Counting_Allocator<U> &) {}
+
+    T * allocate(size_t n)
+    {
+        stdMapBytes += n * sizeof(T);
+        return std::allocator<T>::allocate(n);
+    }
+
+    void deallocate(T * p, size_t n)
+    {
+        stdMapBytes -= n * sizeof(T);
+        std::allocator<T>::deallocate(p, n);
+    }
+};
+
+typedef std::basic_string<char, std::char_traits<char>,
+                          Counting_Allocator<char> > Counted_String;
+
+typedef std::map<Counted_String, uint64_t, std::less<Counted_String>,
+                 Counting_Allocator<std::pair<const Counted_String, uint64_t> > >
+    Std_Map;
+
+/** URLs from a few thousand hosts, or feature names made up of a family,
+    a name and a bucket. */
+vector<string> makeKeys(size_t n, bool urls)
+{
+    vector<string> result;
+    uint64_t r = 1;
+    for (unsigned i = 0;  i < n;  ++i) {
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        unsigned a = (r >> 52), b = (r >> 32) & 0xfffff, c = (r >> 20) & 0xfff;
+        if (urls)
+            result.push_back(format("http://www.site%d.com/section%d/"
+                                    "article%d.html", a % 5000, c % 50, b));
+        else result.push_back(format("user.f%d.bucket%d", a % 200, b));
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_judysl_map)
+{
+    cerr << "        n  keys  judy B/key  hash B/key   map B/key"
+         << "  judy ins/lkp ns  hash ins/lkp ns  map ins/lkp ns" << endl;
+
+    for (size_t n = 1000;  n <= 1000000;  n *= 10) {
+        for (bool urls: { false, true }) {
+            vector<string> keys = makeKeys(n, urls);
+            uint64_t total = 0;
+            double ns = 1e9 / n;
+
+            double judyIns, judyLkp;
+            size_t judyMem, judySize;
+            {
+                JudySLMap<uint64_t> judy;
+                Timer timer;
+                for (unsigned i = 0;  i < n;  ++i)
+                    judy[keys[i]] = i;
+                judyIns = timer.elapsed_wall();
+
+                timer.restart();
+                for (unsigned i = 0;  i < n;  ++i)
+                    total += judy.find(keys[i])->second;
+                judyLkp = timer.elapsed_wall();
+                judyMem = judy.memusage();
+                judySize = judy.size();
+            }
+
+            // Lightweight_Hash can't hold string keys, so it gets the 64 bit
+            // hash of the string and doesn't store the key at all.
+            double hashIns, hashLkp;
+            size_t hashMem;
+            {
+                std::hash<string> hasher;
+                Lightweight_Hash<uint64_t, uint64_t> hash;
+                Timer timer;
+                for (unsigned i = 0;  i < n;  ++i)
+                    hash[hasher(keys[i]) | 1] = i;
+                hashIns = timer.elapsed_wall();
+
+                timer.restart();
+                for (unsigned i = 0;  i < n;  ++i)
+                    total += hash.find(hasher(keys[i]) | 1)->second;
+                hashLkp = timer.elapsed_wall();
+                hashMem = hash.capacity()
+                    * sizeof(std::pair<uint64_t, uint64_t>);
+            }
+
+            double mapIns, mapLkp;
+            size_t mapMem;
+            {
+                vector<Counted_String> mapKeys;
+                for (auto & k: keys)
+                    mapKeys.emplace_back(k.c_str(), k.length());
+                size_t before = stdMapBytes;
+                Std_Map map;
+                Timer timer;
+                for (unsigned i = 0;  i < n;  ++i)
+                    map[mapKeys[i]] = i;
+                mapIns = timer.elapsed_wall();
+
+                timer.restart();
+                for (unsigned i = 0;  i < n;  ++i)
+                    total += map.find(mapKeys[i])->second;
+                mapLkp = timer.elapsed_wall();
+                mapMem = stdMapBytes - before;
+                BOOST_CHECK_EQUAL(judySize, map.size());
+            }
+
+            // Use the lookup results so that they aren't optimized away
+            BOOST_CHECK_NE(total, 0);
+
+            cerr << format("%9zd  %4s  %10.1f  %10.1f  %10.1f"
+                           "  %7.1f/%7.1f  %7.1f/%7.1f  %7.1f/%7.1f",
+                           n, urls ? "url" : "feat",
+                           1.0 * judyMem / n, 1.0 * hashMem / n,
+                           1.0 * mapMem / n,
+                           judyIns * ns, judyLkp * ns,
+                           hashIns * ns, hashLkp * ns,
+                           mapIns * ns, mapLkp * ns)
+                 << endl;
+        }
+    }
+}
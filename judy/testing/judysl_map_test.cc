@@ -0,0 +1,229 @@
+/* judysl_map_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test program for JudySL arrays and the JudySLMap wrapper.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/judy/judysl_map.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace ML;
+using namespace std;
+
+/** Random keys over a small alphabet, with lots of shared prefixes and
+    lengths around the word boundaries. */
+vector<string> randomKeys(size_t n, uint64_t seed)
+{
+    static const char alphabet[] = "ab/\x01\xfe\xff";
+    vector<string> result;
+    uint64_t r = seed;
+    for (unsigned i = 0;  i < n;  ++i) {
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        size_t len = (r >> 58) % 26;
+        string key;
+        for (unsigned j = 0;  j < len;  ++j) {
+            r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+            key += alphabet[(r >> 40) % (sizeof(alphabet) - 1)];
+        }
+        result.push_back(key);
+    }
+    return result;
+}
+
+void checkSame(Pvoid_t array, const map<string, Word_t> & expected)
+{
+    // Forwards
+    uint8_t buf[64];
+    buf[0] = 0;
+    auto it = expected.begin();
+    for (PPvoid_t val = JudySLFirst(array, buf, PJE0);  val;
+         val = JudySLNext(array, buf, PJE0), ++it) {
+        BOOST_REQUIRE(it != expected.end());
+        BOOST_REQUIRE_EQUAL((const char *)buf, it->first);
+        BOOST_REQUIRE_EQUAL(*(Word_t *)val, it->second);
+    }
+    BOOST_REQUIRE(it == expected.end());
+
+    // Backwards
+    memset(buf, 0xff, 63);
+    buf[63] = 0;
+    auto rit = expected.rbegin();
+    for (PPvoid_t val = JudySLLast(array, buf, PJE0);  val;
+         val = JudySLPrev(array, buf, PJE0), ++rit) {
+        BOOST_REQUIRE(rit != expected.rend());
+        BOOST_REQUIRE_EQUAL((const char *)buf, rit->first);
+    }
+    BOOST_REQUIRE(rit == expected.rend());
+
+    for (auto & e: expected) {
+        PPvoid_t val = JudySLGet(array, (const uint8_t *)e.first.c_str(), PJE0);
+        BOOST_REQUIRE(val);
+        BOOST_REQUIRE_EQUAL(*(Word_t *)val, e.second);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_judysl_basics)
+{
+    Pvoid_t array = 0;
+    BOOST_CHECK(!JudySLGet(array, (const uint8_t *)"", PJE0));
+    BOOST_CHECK_EQUAL(JudySLMemUsed(array), 0);
+
+    const char * keys[] = { "", "a", "ab", "abcdefg", "abcdefgh",
+                            "abcdefghi", "abcdefgh1234567", "abcdefgh12345678",
+                            "b", "\xff\xff\xff\xff\xff\xff\xff\xff\xff" };
+    map<string, Word_t> expected;
+    for (unsigned i = 0;  i < sizeof(keys) / sizeof(keys[0]);  ++i) {
+        PPvoid_t val = JudySLIns(&array, (const uint8_t *)keys[i], PJE0);
+        BOOST_REQUIRE(val);
+        BOOST_CHECK_EQUAL(*(Word_t *)val, 0);
+        *(Word_t *)val = i + 1;
+        expected[keys[i]] = i + 1;
+        checkSame(array, expected);
+    }
+
+    // Inserting again gives the same slot
+    BOOST_CHECK_EQUAL(*(Word_t *)JudySLIns(&array, (const uint8_t *)"ab", PJE0),
+                      3);
+
+    // Not there
+    BOOST_CHECK(!JudySLGet(array, (const uint8_t *)"abc", PJE0));
+    BOOST_CHECK(!JudySLGet(array, (const uint8_t *)"abcdefgh1", PJE0));
+    BOOST_CHECK_EQUAL(JudySLDel(&array, (const uint8_t *)"abc", PJE0), 0);
+
+    BOOST_CHECK_GT(JudySLMemUsed(array), 0);
+
+    for (unsigned i = 0;  i < sizeof(keys) / sizeof(keys[0]);  ++i) {
+        BOOST_CHECK_EQUAL(JudySLDel(&array, (const uint8_t *)keys[i], PJE0), 1);
+        expected.erase(keys[i]);
+        checkSame(array, expected);
+    }
+    BOOST_CHECK(array == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_judysl_random)
+{
+    for (uint64_t seed: { 1, 2, 3 }) {
+        vector<string> keys = randomKeys(20000, seed);
+        Pvoid_t array = 0;
+        map<string, Word_t> expected;
+
+        for (unsigned i = 0;  i < keys.size();  ++i) {
+            *(Word_t *)JudySLIns(&array, (const uint8_t *)keys[i].c_str(), PJE0)
+                = i;
+            expected[keys[i]] = i;
+        }
+        checkSame(array, expected);
+
+        // Inclusive and exclusive searches from keys that aren't there
+        for (auto & k: randomKeys(2000, seed + 100)) {
+            uint8_t buf[64];
+            strcpy((char *)buf, k.c_str());
+            PPvoid_t val = JudySLFirst(array, buf, PJE0);
+            auto it = expected.lower_bound(k);
+            BOOST_REQUIRE_EQUAL(val != 0, it != expected.end());
+            if (val) BOOST_REQUIRE_EQUAL((const char *)buf, it->first);
+
+            strcpy((char *)buf, k.c_str());
+            val = JudySLPrev(array, buf, PJE0);
+            it = expected.lower_bound(k);
+            BOOST_REQUIRE_EQUAL(val != 0, it != expected.begin());
+            if (val) BOOST_REQUIRE_EQUAL((const char *)buf, (--it)->first);
+        }
+
+        // Delete half of them
+        for (unsigned i = 0;  i < keys.size();  i += 2) {
+            int res = JudySLDel(&array, (const uint8_t *)keys[i].c_str(), PJE0);
+            BOOST_REQUIRE_EQUAL(res, expected.erase(keys[i]));
+        }
+        checkSame(array, expected);
+
+        Word_t mem = JudySLMemUsed(array);
+        BOOST_CHECK_EQUAL(JudySLFreeArray(&array, PJE0), mem);
+        BOOST_CHECK(array == 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_judysl_map)
+{
+    JudySLMap<string> m;
+    map<string, string> expected;
+
+    for (auto & k: randomKeys(5000, 7)) {
+        m[k] = k + "!";
+        expected[k] = k + "!";
+    }
+
+    BOOST_CHECK_EQUAL(m.size(), expected.size());
+    BOOST_CHECK(!m.insert(expected.begin()->first, "no").second);
+
+    auto it = m.begin();
+    for (auto & e: expected) {
+        BOOST_REQUIRE(it != m.end());
+        BOOST_REQUIRE_EQUAL(it->first, e.first);
+        BOOST_REQUIRE_EQUAL(it->second, e.second);
+        ++it;
+    }
+    BOOST_CHECK(it == m.end());
+
+    // Backwards from the end
+    auto rit = expected.rbegin();
+    for (it = m.end();  it != m.begin();  ++rit) {
+        --it;
+        BOOST_REQUIRE_EQUAL(it->first, rit->first);
+    }
+
+    JudySLMap<string> m2 = m;
+    for (auto & e: expected)
+        m.erase(e.first);
+    BOOST_CHECK(m.empty());
+    BOOST_CHECK(m.begin() == m.end());
+    BOOST_CHECK_EQUAL(m2.size(), expected.size());
+    BOOST_CHECK_EQUAL(m2.find("ab") != m2.end(), expected.count("ab"));
+    BOOST_CHECK_EQUAL(m2.upper_bound("a")->first,
+                      expected.upper_bound("a")->first);
+
+    BOOST_CHECK_THROW(m[string("a\0b", 3)], ML::Exception);
+
+    // Not the same key as its prefix before the null
+    m["a"] = "x";
+    BOOST_CHECK_EQUAL(m.count(string("a\0b", 3)), 0);
+    BOOST_CHECK(m.find(string("a\0b", 3)) == m.end());
+    BOOST_CHECK_EQUAL(m.erase(string("a\0b", 3)), 0);
+    BOOST_CHECK_THROW(m[string("a\0b", 3)], ML::Exception);
+    BOOST_CHECK_EQUAL(m.size(), 1);
+    BOOST_CHECK_EQUAL(m["a"], "x");
+}
+
+BOOST_AUTO_TEST_CASE(test_judysl_map_prefix_range)
+{
+    JudySLMap<int> m;
+    map<string, int> expected;
+    for (auto & k: randomKeys(10000, 11)) {
+        m[k] = k.length();
+        expected[k] = k.length();
+    }
+
+    for (string prefix: { "", "a", "ab", "ab/", "b\xff", "\xff", "\xff\xff",
+                          "aaaaaaaa", "a\x01/b" }) {
+        auto range = m.prefix_range(prefix);
+        auto eit = expected.lower_bound(prefix);
+        size_t n = 0;
+        for (auto it = range.first;  it != range.second;  ++it, ++eit, ++n) {
+            BOOST_REQUIRE(eit != expected.end());
+            BOOST_REQUIRE_EQUAL(it->first, eit->first);
+            BOOST_REQUIRE_EQUAL(eit->first.compare(0, prefix.size(), prefix), 0);
+        }
+        BOOST_CHECK(eit == expected.end()
+                    || eit->first.compare(0, prefix.size(), prefix) != 0);
+        cerr << "prefix " << prefix << ": " << n << " keys" << endl;
+    }
+}
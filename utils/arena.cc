@@ -0,0 +1,134 @@
+/* arena.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Bump pointer arena allocator.
+*/
+
+#include "arena.h"
+#include "jml/arch/exception.h"
+#include <stdlib.h>
+
+
+using namespace std;
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* ARENA                                                                     */
+/*****************************************************************************/
+
+namespace {
+
+__thread Arena * currentArena = 0;
+
+} // file scope
+
+Arena::
+Arena(size_t chunk_size, Huge_Page_Mode mode)
+    : pos(0), end(0), chunk_size(chunk_size), mode(mode),
+      bytes_allocated_(0), bytes_reserved_(0)
+{
+    if (chunk_size == 0)
+        throw Exception("Arena: chunk size must be non-zero");
+}
+
+Arena::
+~Arena()
+{
+    clear();
+}
+
+void
+Arena::
+clear()
+{
+    for (unsigned i = 0;  i < chunks.size();  ++i)
+        free_chunk(chunks[i]);
+    chunks.clear();
+    pos = end = 0;
+    bytes_allocated_ = bytes_reserved_ = 0;
+}
+
+void *
+Arena::
+allocate_slow(size_t bytes, size_t alignment)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+        throw Exception("Arena::allocate(): alignment %zd not a power of 2",
+                        alignment);
+
+    size_t needed = bytes + alignment;
+
+    if (needed > chunk_size / 4) {
+        // Big allocation; give it its own chunk so that we don't waste the
+        // rest of the current one
+        Chunk chunk = new_chunk(needed);
+        // Keep the current chunk at the back so we keep allocating from it
+        chunks.insert(chunks.end() - (chunks.empty() ? 0 : 1), chunk);
+        char * p = (char *)(((size_t)chunk.start + alignment - 1)
+                            & ~(alignment - 1));
+        bytes_allocated_ += bytes;
+        return p;
+    }
+
+    Chunk chunk = new_chunk(chunk_size);
+    chunks.push_back(chunk);
+    pos = chunk.start;
+    end = chunk.start + chunk.size;
+
+    return allocate(bytes, alignment);
+}
+
+Arena::Chunk
+Arena::
+new_chunk(size_t bytes)
+{
+    Chunk result;
+    if (bytes >= huge_page_size) {
+        result.size = huge_page_round(bytes);
+        result.start = (char *)allocate_huge_pages(result.size, mode);
+    }
+    else {
+        result.size = bytes;
+        result.start = (char *)malloc(bytes);
+        if (!result.start)
+            throw std::bad_alloc();
+    }
+
+    bytes_reserved_ += result.size;
+    return result;
+}
+
+void
+Arena::
+free_chunk(const Chunk & chunk)
+{
+    if (chunk.size >= huge_page_size)
+        free_huge_pages(chunk.start, chunk.size);
+    else free(chunk.start);
+}
+
+Arena *
+Arena::
+current()
+{
+    return currentArena;
+}
+
+Arena::Scope::
+Scope(Arena & arena)
+    : old(currentArena)
+{
+    currentArena = &arena;
+}
+
+Arena::Scope::
+~Scope()
+{
+    currentArena = old;
+}
+
+} // namespace ML
@@ -0,0 +1,201 @@
+/* arena.h                                                         -*- C++ -*-
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Bump pointer arena allocator for structures that are freed in bulk.
+*/
+
+#ifndef __jml__utils__arena_h__
+#define __jml__utils__arena_h__
+
+#include "jml/arch/vm.h"
+#include "jml/compiler/compiler.h"
+#include <vector>
+#include <memory>
+#include <new>
+#include <limits>
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* ARENA                                                                     */
+/*****************************************************************************/
+
+/** A bump pointer arena.  Memory is carved sequentially out of large
+    chunks and is never freed individually; it is all released at once by
+    clear() or the destructor.  Chunks of a huge page or more are backed by
+    huge pages.
+
+    Not thread safe: each thread should use its own arena.
+*/
+
+struct Arena {
+    Arena(size_t chunk_size = huge_page_size,
+          Huge_Page_Mode mode = HP_TRANSPARENT);
+
+    ~Arena();
+
+    /** Allocate the given number of bytes with the given alignment, which
+        must be a power of two. */
+    void * allocate(size_t bytes, size_t alignment = 16)
+    {
+        // Folds away for a constant alignment; allocate_slow() throws
+        if (JML_UNLIKELY(alignment == 0 || (alignment & (alignment - 1))))
+            return allocate_slow(bytes, alignment);
+
+        char * p = (char *)(((size_t)pos + alignment - 1) & ~(alignment - 1));
+        if (JML_LIKELY(p + bytes <= end)) {
+            pos = p + bytes;
+            bytes_allocated_ += bytes;
+            return p;
+        }
+        return allocate_slow(bytes, alignment);
+    }
+
+    /** Release all of the memory that was allocated from the arena.  No
+        destructors are run. */
+    void clear();
+
+    size_t bytes_allocated() const { return bytes_allocated_; }
+    size_t bytes_reserved() const { return bytes_reserved_; }
+
+    /** The arena that a default constructed Arena_Allocator uses in this
+        thread, or null if there is none. */
+    static Arena * current();
+
+    /** Make the given arena the current one for this thread until the
+        object goes out of scope. */
+    struct Scope {
+        Scope(Arena & arena);
+        ~Scope();
+
+        Arena * old;
+    };
+
+private:
+    struct Chunk {
+        char * start;
+        size_t size;
+    };
+
+    void * allocate_slow(size_t bytes, size_t alignment);
+    Chunk new_chunk(size_t bytes);
+    void free_chunk(const Chunk & chunk);
+
+    std::vector<Chunk> chunks;
+    char * pos;
+    char * end;
+    size_t chunk_size;
+    Huge_Page_Mode mode;
+    size_t bytes_allocated_;
+    size_t bytes_reserved_;
+
+    Arena(const Arena & other);
+    void operator = (const Arena & other);
+};
+
+
+/*****************************************************************************/
+/* ARENA ALLOCATOR                                                           */
+/*****************************************************************************/
+
+/** Standard allocator that allocates from an Arena.  deallocate() is a
+    no-op; the memory goes away when the arena is cleared or destroyed.
+
+    A default constructed allocator (which is what MemStorage,
+    LogMemStorage and compact_vector use, as they hold a static instance)
+    allocates from Arena::current() at the point of the allocation, so
+    containers that use it need to be filled within an Arena::Scope:
+
+        Arena arena;
+        {
+            Arena::Scope scope(arena);
+            compact_vector<float, 4, uint32_t, true, float *,
+                           Arena_Allocator<float> > v;
+            ...
+        }
+
+    Anything with a non-trivial destructor that lives in the arena must be
+    destroyed before the arena is.
+*/
+
+template<typename T>
+struct Arena_Allocator {
+    typedef T value_type;
+    typedef T * pointer;
+    typedef const T * const_pointer;
+    typedef T & reference;
+    typedef const T & const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<typename U>
+    struct rebind {
+        typedef Arena_Allocator<U> other;
+    };
+
+    Arena_Allocator(Arena * arena = 0)
+        : arena(arena)
+    {
+    }
+
+    template<typename U>
+    Arena_Allocator(const Arena_Allocator<U> & other)
+        : arena(other.arena)
+    {
+    }
+
+    Arena * arena;
+
+    T * allocate(size_t n, const void * hint = 0)
+    {
+        Arena * a = arena ? arena : Arena::current();
+        if (!a)
+            throw std::bad_alloc();
+        if (n > max_size())
+            throw std::bad_alloc();
+        size_t alignment = __alignof__(T) < 16 ? 16 : __alignof__(T);
+        return reinterpret_cast<T *>(a->allocate(n * sizeof(T), alignment));
+    }
+
+    void deallocate(T * p, size_t n)
+    {
+    }
+
+    size_t max_size() const
+    {
+        return std::numeric_limits<size_t>::max() / sizeof(T);
+    }
+
+    T * address(T & x) const { return &x; }
+    const T * address(const T & x) const { return &x; }
+
+    void construct(T * p, const T & val)
+    {
+        new (p) T(val);
+    }
+
+    void destroy(T * p)
+    {
+        p->~T();
+    }
+};
+
+template<typename T1, typename T2>
+bool operator == (const Arena_Allocator<T1> & a1,
+                  const Arena_Allocator<T2> & a2)
+{
+    return a1.arena == a2.arena;
+}
+
+template<typename T1, typename T2>
+bool operator != (const Arena_Allocator<T1> & a1,
+                  const Arena_Allocator<T2> & a2)
+{
+    return a1.arena != a2.arena;
+}
+
+} // namespace ML
+
+#endif /* __jml__utils__arena_h__ */
@@ -12,7 +12,13 @@
 
 #include <vector>
 #include "jml/arch/exception.h"
+#include "jml/arch/bitops.h"
 #include <boost/iterator/iterator_facade.hpp>
+#include <boost/type_traits/has_trivial_copy.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
+#include <iterator>
+#include <utility>
+#include <string.h>
 #include <iostream> // debug
 
 namespace ML {
@@ -164,10 +170,37 @@ private:
 };
 
 
+/** A contiguous run of elements in a circular buffer.  The contents of a
+    circular buffer are covered by at most two of these; see
+    Circular_Buffer::segments().
+*/
+template<typename T>
+struct Circular_Buffer_Segment {
+    Circular_Buffer_Segment(T * data = 0, size_t size = 0)
+        : data(data), size(size)
+    {
+    }
+
+    T * data;
+    size_t size;
+
+    T * begin() const { return data; }
+    T * end() const { return data + size; }
+    bool empty() const { return size == 0; }
+};
+
+/** Circular buffer.
+
+    If PowerOfTwo is true, then the capacity is always rounded up to a power
+    of two and indexes are wrapped with a mask rather than a comparison and
+    subtraction.
+*/
 template<typename T, bool Safe = false,
-         class Allocator = std::allocator<T> >
+         class Allocator = std::allocator<T>,
+         bool PowerOfTwo = false>
 struct Circular_Buffer {
     enum { safe = Safe };
+    enum { power_of_two = PowerOfTwo };
 
     Circular_Buffer(int initial_capacity = 0)
         : vals_(0), start_(0), size_(0), capacity_(0)
@@ -215,6 +248,8 @@ struct Circular_Buffer {
 
         if (new_capacity <= capacity_) return;
         new_capacity = std::max(capacity_ * 2, new_capacity);
+        if (PowerOfTwo)
+            new_capacity = 1 << (highest_bit(new_capacity - 1, -1) + 1);
 
         int nfirst_half = std::min(capacity_ - start_, size_);
         int nsecond_half = std::max(0, size_ - nfirst_half);
@@ -407,6 +442,64 @@ struct Circular_Buffer {
         if (start_ == capacity_) start_ = 0;
     }
 
+    /** Append all elements in the given range.  Elements are written into
+        (at most two) contiguous spans; trivially copyable elements from a
+        pointer range are memcpy'd. */
+    template<typename Iterator>
+    void push_back(Iterator first, Iterator last)
+    {
+        int n = std::distance(first, last);
+        if (n < 0)
+            throw Exception("push_back(): invalid range");
+        if (n == 0) return;
+        if (size_ + n > capacity_)
+            reserve(size_ + n);
+
+        int end = wrap(start_ + size_);
+        int n1 = std::min(n, capacity_ - end);
+        copy_in(vals_ + end, first, n1);
+        size_ += n1;
+        copy_in(vals_, first, n - n1);
+        size_ += n - n1;
+    }
+
+    /** Remove the first n elements. */
+    void pop_front(int n)
+    {
+        if (n < 0 || n > size_)
+            throw Exception("pop_front(): invalid number of elements");
+        if (n == 0) return;
+
+        if (!boost::has_trivial_destructor<T>::value) {
+            for (unsigned i = 0;  i < n;  ++i)
+                element_at(i)->~T();
+        }
+
+        size_ -= n;
+        start_ = size_ == 0 ? 0 : wrap(start_ + n);
+    }
+
+    typedef Circular_Buffer_Segment<T> Segment;
+    typedef Circular_Buffer_Segment<const T> Const_Segment;
+
+    /** Return the (at most two) contiguous segments that hold the contents
+        of the buffer, in order.  The second is empty unless the contents
+        wrap around the end of the storage.  Useful to run vectorized code
+        directly over the buffer. */
+    std::pair<Segment, Segment> segments()
+    {
+        int n1 = std::min(size_, capacity_ - start_);
+        return std::make_pair(Segment(vals_ + start_, n1),
+                              Segment(vals_, size_ - n1));
+    }
+
+    std::pair<Const_Segment, Const_Segment> segments() const
+    {
+        int n1 = std::min(size_, capacity_ - start_);
+        return std::make_pair(Const_Segment(vals_ + start_, n1),
+                              Const_Segment(vals_, size_ - n1));
+    }
+
     void erase_element(int el)
     {
         //cerr << "erase_element: el = " << el << " size = " << size()
@@ -416,8 +509,7 @@ struct Circular_Buffer {
             throw Exception("erase_element(): invalid value");
         if (el < 0) el += size_;
 
-        int offset = (start_ + el);
-        offset -= capacity_ * (offset >= capacity_);
+        int offset = wrap(start_ + el);
 
         erase_element_at(offset);
     }
@@ -510,6 +602,40 @@ private:
     int size_;
     int capacity_;
 
+    /** Wrap an offset in [0, 2 * capacity) back into [0, capacity). */
+    int wrap(int offset) const
+    {
+        if (PowerOfTwo)
+            return offset & (capacity_ - 1);
+        return offset - capacity_ * (offset >= capacity_);
+    }
+
+    template<typename Iterator>
+    static void copy_in(T * dest, Iterator & first, int n)
+    {
+        for (int i = 0;  i < n;  ++i, ++first)
+            new (dest + i) T(*first);
+    }
+
+    static void copy_in(T * dest, const T * & first, int n)
+    {
+        if (boost::has_trivial_copy<T>::value) {
+            memcpy((void *)dest, (const void *)first, n * sizeof(T));
+            first += n;
+        }
+        else {
+            for (int i = 0;  i < n;  ++i, ++first)
+                new (dest + i) T(*first);
+        }
+    }
+
+    static void copy_in(T * dest, T * & first, int n)
+    {
+        const T * cfirst = first;
+        copy_in(dest, cfirst, n);
+        first += n;
+    }
+
     void validate() const
     {
         if (!vals_ && capacity_ != 0)
@@ -536,8 +662,7 @@ private:
 
         if (index < 0) index += size_;
 
-        int offset = (start_ + index);
-        offset -= capacity_ * (offset >= capacity_);
+        int offset = wrap(start_ + index);
 
         //cerr << "  offset " << offset << endl;
 
@@ -554,8 +679,7 @@ private:
 
         index += size_ * (index < 0);
 
-        int offset = (start_ + index);
-        offset -= capacity_ * (offset >= capacity_);
+        int offset = wrap(start_ + index);
 
         //cerr << "  offset " << offset << endl;
 
@@ -598,31 +722,31 @@ private:
     static Allocator allocator;
 };
 
-template<typename T, bool S, class Allocator>
+template<typename T, bool S, class Allocator, bool P>
 Allocator
-Circular_Buffer<T, S, Allocator>::allocator;
+Circular_Buffer<T, S, Allocator, P>::allocator;
 
-template<typename T, bool S, class A>
+template<typename T, bool S, class A, bool P>
 bool
-operator == (const Circular_Buffer<T, S, A> & cb1,
-             const Circular_Buffer<T, S, A> & cb2)
+operator == (const Circular_Buffer<T, S, A, P> & cb1,
+             const Circular_Buffer<T, S, A, P> & cb2)
 {
     return cb1.size() == cb2.size()
         && std::equal(cb1.begin(), cb1.end(), cb2.begin());
 }
 
-template<typename T, bool S, class A>
+template<typename T, bool S, class A, bool P>
 bool
-operator < (const Circular_Buffer<T, S, A> & cb1,
-            const Circular_Buffer<T, S, A> & cb2)
+operator < (const Circular_Buffer<T, S, A, P> & cb1,
+            const Circular_Buffer<T, S, A, P> & cb2)
 {
     return std::lexicographical_compare(cb1.begin(), cb1.end(),
                                         cb2.begin(), cb2.end());
 }
 
-template<typename T, bool S, class A>
+template<typename T, bool S, class A, bool P>
 std::ostream & operator << (std::ostream & stream,
-                            const Circular_Buffer<T, S, A> & buf)
+                            const Circular_Buffer<T, S, A, P> & buf)
 {
     stream << "[";
     for (unsigned i = 0;  i < buf.size();  ++i)
@@ -26,9 +26,26 @@
 #include <utility>
 #include <initializer_list>
 #include <stdint.h>
+#include <string.h>
+#include <boost/type_traits/has_trivial_copy.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
+#include <boost/type_traits/integral_constant.hpp>
 
 namespace ML {
 
+/** Trait that tells if objects of the given type can be moved to a new
+    address with memcpy (and the old copy forgotten about without running
+    its destructor).  This is true for all trivially copyable types; it can
+    be specialized to true for other types that don't hold pointers into
+    themselves.
+*/
+template<typename T>
+struct is_trivially_relocatable
+    : public boost::integral_constant<bool,
+                                      boost::has_trivial_copy<T>::value
+                                      && boost::has_trivial_destructor<T>::value> {
+};
+
 template<typename Data,
          size_t Internal_ = 0,
          typename Size = uint32_t,
@@ -45,6 +62,7 @@ public:
     typedef Data & reference;
     typedef const Data & const_reference;
     enum { Internal = Internal_ };
+    enum { Relocatable = is_trivially_relocatable<Data>::value };
     
     compact_vector()
         : size_(0), is_internal_(true)
@@ -215,10 +233,26 @@ public:
         size_t to_alloc = std::max<size_t>(capacity() * 2, new_capacity);
         to_alloc = std::min<size_t>(to_alloc, max_size());
 
-        compact_vector new_me;
-        // new_me.init_move(begin(), end(), to_alloc);
-        new_me.init_copy(begin(), end(), to_alloc);
-        swap(new_me);
+        reallocate(to_alloc);
+    }
+
+    /** Reserve exactly the given capacity, rather than growing
+        geometrically.  Useful when the final size is known, to avoid
+        wasting memory over large numbers of small vectors. */
+    void reserve_exact(size_t new_capacity)
+    {
+        if (capacity() >= new_capacity) return;
+        if (new_capacity > max_size())
+            throw Exception("compact_vector can't grow that big");
+        reallocate(new_capacity);
+    }
+
+    /** Release any unused capacity, moving back to internal storage if the
+        elements fit. */
+    void shrink_to_fit()
+    {
+        if (is_internal() || size_ == ext.capacity_) return;
+        reallocate(size_);
     }
 
     void resize(size_t new_size, const Data & new_element = Data())
@@ -238,6 +272,12 @@ public:
         // contract
         if  (!is_internal() && new_size <= Internal) {
             // Need to convert to internal representation
+            if (Relocatable) {
+                destroy_tail(new_size);
+                reallocate(new_size);
+                return;
+            }
+
             compact_vector new_me;
             // new_me.init_move((begin(), begin() + new_size, new_size);
             new_me.init_copy(begin(), begin() + new_size, new_size);
@@ -355,6 +395,21 @@ public:
 
         size_t new_size = size_ - n;
 
+        if (Relocatable) {
+            // Destroy the erased elements and slide the rest down over them
+            for (iterator it = first;  it != last;  ++it)
+                it->~Data();
+            memmove((void *)(data() + firstindex),
+                    (const void *)(data() + firstindex + n),
+                    (size_ - firstindex - n) * sizeof(Data));
+            size_ = new_size;
+
+            if (!is_internal() && new_size <= Internal)
+                reallocate(new_size);
+
+            return begin() + firstindex;
+        }
+
         if (!is_internal() && new_size <= Internal) {
             /* If we become small enough to be internal, then we need to copy
                to avoid becoming smaller */
@@ -370,10 +425,7 @@ public:
         std::copy(last, end(), first);
 
         /* Delete those at the end */
-        while (size_ > new_size) {
-            data()[size_ - 1].~Data();
-            --size_;
-        }
+        destroy_tail(new_size);
 
         return begin() + firstindex;
     }
@@ -516,6 +568,53 @@ private:
     }
 #endif
 
+    /** Change the storage to have exactly the given capacity, which must
+        be at least size().  If the capacity fits internally, the internal
+        storage is used. */
+    void reallocate(size_t new_capacity)
+    {
+        if (Safe && new_capacity < size_)
+            throw Exception("compact_vector: reallocate below size");
+
+        if (new_capacity <= Internal && is_internal()) return;
+
+        if (!Relocatable) {
+            compact_vector new_me;
+            // new_me.init_move(begin(), end(), new_capacity);
+            new_me.init_copy(begin(), end(), new_capacity);
+            swap(new_me);
+            return;
+        }
+
+        if (new_capacity <= Internal) {
+            // External to internal.  The internal storage overlaps the
+            // external pointer, so take a copy of it first.
+            Pointer p = ext.pointer_;
+            Size capacity = ext.capacity_;
+            memcpy((void *)internal(), (const void *)&*p,
+                   size_ * sizeof(Data));
+            is_internal_ = true;
+            allocator.deallocate(p, capacity);
+            return;
+        }
+
+        Pointer mem = allocator.allocate(new_capacity);
+        memcpy((void *)&*mem, (const void *)data(), size_ * sizeof(Data));
+        if (!is_internal())
+            allocator.deallocate(ext.pointer_, ext.capacity_);
+        ext.pointer_ = mem;
+        ext.capacity_ = new_capacity;
+        is_internal_ = false;
+    }
+
+    void destroy_tail(size_t new_size)
+    {
+        while (size_ > new_size) {
+            data()[size_ - 1].~Data();
+            --size_;
+        }
+    }
+
     void swap_size(compact_vector & other)
     {
         Size t = size_;
@@ -558,6 +657,18 @@ private:
             cerr << "data() = " << data() << endl;
 #endif
 
+        if (Relocatable) {
+            // Slide the tail up in one go, and default construct the gap
+            // so that the caller can assign into it
+            Data * p = data();
+            memmove((void *)(p + index + n), (const void *)(p + index),
+                    (size_ - index) * sizeof(Data));
+            for (unsigned i = 0;  i < n;  ++i)
+                new (p + index + i) Data();
+            size_ += n;
+            return begin() + index;
+        }
+
         // New element
         for (unsigned i = 0;  i < n;  ++i, ++size_) {
 #if COMPACT_VECTOR_DEBUG
@@ -7,28 +7,31 @@
 
 #include "csv.h"
 #include "parse_context.h"
+#include "find_first_of.h"
 #include "jml/arch/format.h"
+#include <iostream>
 
 using namespace std;
 
 
 namespace ML {
 
-std::string expect_csv_field(Parse_Context & context, bool & another,
-                             char separator)
+namespace {
+
+/** Thrown without a location by expect_csv_field(), as it always has been. */
+const char * const FINISHED_INSIDE_QUOTE = "file finished inside quote";
+
+/** Parse a field onto the end of result.  Errors are recorded in status
+    (with the context left where they were found) rather than thrown, so
+    that this can serve both the expect_ and the match_ functions. */
+bool match_csv_field(Parse_Context & context, std::string & result,
+                     bool & another, char separator, Parse_Status & status)
 {
     bool quoted = false;
-    std::string result;
+    size_t start = result.size();
     another = false;
     
     while (context) {
-        //cerr << "at character '" << *context << "' quoted = " << quoted
-        //     << endl;
-
-        if (context.get_line() == 9723 && false)
-            cerr << "*context = " << *context << " quoted = " << quoted
-                 << " result = " << result << endl;
-        
         if (quoted) {
             if (context.match_literal("\"\"")) {
                 result += "\"";
@@ -39,48 +42,54 @@ std::string expect_csv_field(Parse_Context & context, bool & another,
                     another = true;
                 if (!context || context.match_literal(separator)
                     || *context == '\n' || *context == '\r')
-                    return result;
-                //cerr << "(bool)context = " << (bool)context << endl;
-                //cerr << "*context = " << *context << endl;
-                //cerr << "result = " << result << endl;
-
-                for (unsigned i = 0; i < 20;  ++i)
-                    cerr << *context++;
-
-                context.exception_fmt("invalid end of line: %d %c",
-                                      (int)*context, *context);
+                    return true;
+                return context.fail_at_char(status, "invalid end of line");
             }
         }
         else {
             if (context.match_literal('\"')) {
-                if (result == "") {
+                if (result.size() == start) {
                     quoted = true;
                     continue;
                 }
-                else context.exception("non-quoted string with embedded quote");
+                return context.fail(status,
+                                    "non-quoted string with embedded quote");
             }
             else if (context.match_literal(separator)) {
                 another = true;
-                return result;
+                return true;
             }
             else if (*context == '\n' || *context == '\r')
-                return result;
+                return true;
             
         }
         result += *context++;
     }
 
     if (quoted)
-        throw Exception("file finished inside quote");
+        return context.fail(status, FINISHED_INSIDE_QUOTE);
+
+    return true;
+}
 
+} // file scope
+
+std::string expect_csv_field(Parse_Context & context, bool & another,
+                             char separator)
+{
+    std::string result;
+    Parse_Status status;
+    if (!match_csv_field(context, result, another, separator, status)) {
+        if (status.error == FINISHED_INSIDE_QUOTE)
+            throw Exception(status.error);
+        throw Exception(status.message());
+    }
     return result;
 }
 
 std::vector<std::string>
 expect_csv_row(Parse_Context & context, int length, char separator)
 {
-    //    cerr << "*** parsing" << endl;
-
     context.skip_whitespace();
 
     vector<string> result;
@@ -88,20 +97,188 @@ expect_csv_row(Parse_Context & context, int length, char separator)
         result.reserve(length);
 
     bool another = false;
-    while (another || (context && !context.match_eol())) {
+    while (another || (context && !context.match_eol()))
         result.push_back(expect_csv_field(context, another, separator));
-        //cerr << "read " << result.back() << " another = " << another << endl;
-    }
 
     if (length != -1 && result.size() != length)
         context.exception(format("Wrong CSV length: expected %d, got %zd",
                                  length, result.size()));
     
-    //cerr << "returning result" << endl;
+    return result;
+}
+
+
+/*****************************************************************************/
+/* CSV_ROW                                                                   */
+/*****************************************************************************/
 
+std::ostream & operator << (std::ostream & stream, const Csv_Field & field)
+{
+    return stream.write(field.start, field.length);
+}
+
+std::vector<std::string>
+Csv_Row::
+strings() const
+{
+    vector<string> result;
+    result.reserve(fields.size());
+    for (auto & f: fields)
+        result.push_back(f.str());
     return result;
 }
 
+void
+Csv_Row::
+add_copied(size_t offset)
+{
+    copied.push_back(make_pair(fields.size(), offset));
+    fields.push_back(Csv_Field(0, copies.size() - offset));
+}
+
+void
+Csv_Row::
+finish()
+{
+    for (auto & c: copied)
+        fields[c.first].start = copies.data() + c.second;
+}
+
+/** Parse a row that's entirely within the current buffer, without
+    copying anything but fields with escaped quotes.  Returns false without
+    having touched the context if the row wasn't in one piece or anything
+    unusual (an error, a lone carriage return) was found, in which case
+    the general path deals with it. */
+bool
+Csv_Row::
+match_in_chunk(Parse_Context & context, char separator)
+{
+    const char * start = context.chunk_pos();
+    const char * e = start + context.chunk_available();
+    const char * p = start;
+
+    // Unquoted fields end at a separator or line ending; a quote is an error
+    char ends[4] = { separator, '\n', '\r', '\"' };
+    Find_First_Of field_end(ends, 4);
+
+    if (p == e) return false;
+
+    // An empty line has no fields
+    if (*p != '\n' && *p != '\r') {
+        for (;;) {
+            if (*p == '\"') {
+                const char * field_start = ++p;
+                bool escaped = false;
+                const char * q;
+                for (;;) {
+                    q = (const char *)memchr(p, '\"', e - p);
+                    if (!q || q + 1 == e) return false;
+                    if (q[1] != '\"') break;
+                    escaped = true;
+                    p = q + 2;
+                }
+                p = q + 1;
+                if (*p != separator && *p != '\n' && *p != '\r')
+                    return false;
+
+                if (escaped) {
+                    size_t offset = copies.size();
+                    for (const char * c = field_start;  c != q;  ++c) {
+                        copies += *c;
+                        if (*c == '\"') ++c;
+                    }
+                    add_copied(offset);
+                }
+                else fields.push_back(Csv_Field(field_start,
+                                                    q - field_start));
+            }
+            else {
+                const char * field_start = p;
+                p = field_end(p, e);
+                if (p == e || *p == '\"') return false;
+                fields.push_back(Csv_Field(field_start, p - field_start));
+            }
+
+            if (*p != separator) break;
+            if (++p == e) return false;
+        }
+    }
+
+    // We're at the end of the line.  The line ending needs to be followed
+    // by another character in the same buffer, otherwise moving past it
+    // would move onto the next buffer and free this one.
+    if (*p == '\n') {
+        ++p;
+        if (p != e && *p == '\r') ++p;
+    }
+    else {
+        ++p;
+        if (p == e || *p != '\n') return false;
+        ++p;
+    }
+    if (p == e) return false;
+
+    context.skip_in_chunk(p - start);
+    return true;
+}
+
+bool
+Csv_Row::
+match(Parse_Context & context, char separator, Parse_Status & status)
+{
+    context.skip_whitespace();
+
+    clear();
+
+    if (!match_in_chunk(context, separator)) {
+        clear();
+        bool another = false;
+        while (another || (context && !context.match_eol())) {
+            size_t offset = copies.size();
+            if (!match_csv_field(context, copies, another, separator,
+                                 status))
+                return false;
+            add_copied(offset);
+        }
+    }
+
+    finish();
+    return true;
+}
+
+void expect_csv_row(Parse_Context & context, Csv_Row & row, int length,
+                    char separator)
+{
+    Parse_Status status;
+    if (!row.match(context, separator, status)) {
+        if (status.error == FINISHED_INSIDE_QUOTE)
+            throw Exception(status.error);
+        throw Exception(status.message());
+    }
+
+    if (length != -1 && row.size() != length)
+        context.exception(format("Wrong CSV length: expected %d, got %zd",
+                                 length, row.size()));
+}
+
+bool match_csv_row(Parse_Context & context, Csv_Row & row,
+                   Parse_Status & status, int length, char separator)
+{
+    if (!row.match(context, separator, status)) {
+        // Skip the rest of the bad record
+        row.clear();
+        if (context) context.skip_line();
+        return false;
+    }
+
+    if (length != -1 && row.size() != length) {
+        row.clear();
+        return context.fail(status, "wrong number of CSV fields");
+    }
+
+    return true;
+}
+
 std::string csv_escape(const std::string & s)
 {
     int quote_pos = s.find('"');
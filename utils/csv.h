@@ -10,10 +10,13 @@
 
 #include <string>
 #include <vector>
+#include <iosfwd>
+#include <algorithm>
 
 namespace ML {
 
 struct Parse_Context;
+struct Parse_Status;
 
 /** Expect a CSV field from the given parse context.  Another will be set
     to true if there is still another field in the CSV row. */
@@ -26,6 +29,115 @@ std::string expect_csv_field(Parse_Context & context, bool & another,
 std::vector<std::string>
 expect_csv_row(Parse_Context & context, int length = -1, char separator = ',');
 
+/** A field of a CSV row, as a pointer into the text and a length.  It's
+    not null terminated. */
+struct Csv_Field {
+    Csv_Field(const char * start = 0, size_t length = 0)
+        : start(start), length(length)
+    {
+    }
+
+    const char * start;
+    size_t length;
+
+    const char * begin() const { return start; }
+    const char * end() const { return start + length; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    char operator [] (size_t i) const { return start[i]; }
+
+    std::string str() const { return std::string(start, length); }
+
+    bool operator == (const std::string & other) const
+    {
+        return other.length() == length
+            && std::equal(start, start + length, other.begin());
+    }
+
+    bool operator != (const std::string & other) const
+    {
+        return !operator == (other);
+    }
+};
+
+std::ostream & operator << (std::ostream & stream, const Csv_Field & field);
+
+/** A row of CSV as fields that point into the parsed text, filled in by
+    expect_csv_row().  Reusing the same row for each line means that parsing
+    doesn't allocate once the vectors have grown to the size of a row.
+
+    Most fields point straight into the buffer of the Parse_Context.  Those
+    that had to be changed (with "" unescaped to ") or that weren't in one
+    piece in memory are copied into storage owned by the row.  Either way,
+    the fields are only valid until the row or the context is next used.
+*/
+struct Csv_Row {
+    std::vector<Csv_Field> fields;
+
+    size_t size() const { return fields.size(); }
+    bool empty() const { return fields.empty(); }
+    const Csv_Field & operator [] (size_t i) const { return fields[i]; }
+
+    typedef std::vector<Csv_Field>::const_iterator const_iterator;
+    const_iterator begin() const { return fields.begin(); }
+    const_iterator end() const { return fields.end(); }
+
+    /** Copy all of the fields out into strings. */
+    std::vector<std::string> strings() const;
+
+    void clear()
+    {
+        fields.clear();
+        copies.clear();
+        copied.clear();
+    }
+
+private:
+    friend void expect_csv_row(Parse_Context &, Csv_Row &, int, char);
+    friend bool match_csv_row(Parse_Context &, Csv_Row &, Parse_Status &,
+                              int, char);
+
+    /** Parse a row of any length, recording an error in status rather
+        than throwing. */
+    bool match(Parse_Context & context, char separator,
+               Parse_Status & status);
+
+    /** Parse a row that's entirely within the current buffer of the
+        context. */
+    bool match_in_chunk(Parse_Context & context, char separator);
+
+    /** Add a field that's in the copies string from the given offset to
+        the end. */
+    void add_copied(size_t offset);
+
+    /** Point the copied fields at their text, now that the copies string
+        won't move any more. */
+    void finish();
+
+    std::string copies;                ///< Text of the copied fields
+
+    /// Index and offset in copies of each copied field
+    std::vector<std::pair<size_t, size_t> > copied;
+};
+
+/** Expect a row of CSV from the given parse context, putting it in the
+    given row without copying the fields where possible.  If length is not
+    -1, then the exact number of fields required is given in that parameter.
+    This accepts exactly what the version returning strings does. */
+void expect_csv_row(Parse_Context & context, Csv_Row & row, int length = -1,
+                    char separator = ',');
+
+/** Same as expect_csv_row(), except that a bad row doesn't throw: the error
+    goes into status (see Parse_Status; it's only formatted if asked for),
+    the row is left empty, the rest of the bad record is skipped so that
+    the context is at the start of the next line, and false is returned.
+    For files where bad records are common and are to be skipped, this
+    is much cheaper than catching exceptions.
+*/
+bool match_csv_row(Parse_Context & context, Csv_Row & row,
+                   Parse_Status & status, int length = -1,
+                   char separator = ',');
+
 /** Convert the string to a CSV representation, escaping everything that
     needs to be escaped. */
 std::string csv_escape(const std::string & s);
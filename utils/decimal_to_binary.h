@@ -0,0 +1,72 @@
+/* decimal_to_binary.h                                             -*- C++ -*-
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Exact conversion of decimal numbers to binary floating point.
+*/
+
+#ifndef __utils__decimal_to_binary_h__
+#define __utils__decimal_to_binary_h__
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* DECIMAL NUMBER                                                            */
+/*****************************************************************************/
+
+/** A decimal number as scanned from text, before conversion.  The value is
+    mantissa * 10^exponent, where mantissa holds the first 19 significant
+    digits (which always fit in 64 bits).
+*/
+
+struct Decimal_Number {
+    uint64_t mantissa;     ///< First 19 significant digits
+    int64_t exponent;      ///< Power of ten to multiply mantissa by
+    bool negative;
+    bool truncated;        ///< Non-zero digits didn't fit in mantissa
+    bool is_integer;       ///< No decimal point and no exponent
+    bool overflow;         ///< Integer part doesn't fit in 64 bits
+    uint64_t integer;      ///< Integer part, unless overflow
+};
+
+/** Scan digits[.digits][(e|E)[+|-]digits] from [p, e) (without a sign;
+    that is up to the caller).  Either side of the decimal point may be
+    empty but not both.  An 'e' without any digits after it isn't part of
+    the number.  The result is positive; negative is for the caller to
+    set.  Returns a pointer to the first character after the number,
+    or p if there was no number.  Doesn't allocate or look past e.
+*/
+const char * scan_decimal(const char * p, const char * e,
+                          Decimal_Number & result);
+
+/** Convert to the closest double (ties to even), using the Eisel-Lemire
+    algorithm: the mantissa is multiplied by a 128 bit approximation of
+    the power of ten, which is always enough to get the rounding right
+    unless digits were truncated.
+
+    Returns false when the number was truncated and the digits that were
+    dropped could change the rounding; in that case the caller needs to
+    fall back to a slower conversion (eg, strtod) on the full text.  This
+    is rare: it needs more than 19 significant digits and a value very
+    close to halfway between two doubles.
+*/
+bool decimal_to_double(const Decimal_Number & number, double & result);
+
+/** Same, for the closest float. */
+bool decimal_to_float(const Decimal_Number & number, float & result);
+
+/** Slow but always correctly rounded conversion of the text of a number
+    (as accepted by strtod) in [start, end), for when the functions above
+    return false.
+*/
+double decimal_text_to_double(const char * start, const char * end);
+float decimal_text_to_float(const char * start, const char * end);
+
+} // namespace ML
+
+#endif /* __utils__decimal_to_binary_h__ */
@@ -17,7 +17,8 @@
 
    ---
 
-   Fast inline float parsing routines.
+   Fast inline float parsing routines.  These are correctly rounded: the
+   result is always the closest float or double to the decimal number.
 */
 
 #ifndef __utils__fast_float_parsing_h__
@@ -25,169 +26,130 @@
 
 
 #include "jml/utils/parse_context.h"
+#include "jml/utils/decimal_to_binary.h"
 #include <limits>
-#include <errno.h>
+#include <string>
+#include <math.h>
 
 namespace ML {
 
-double binary_exp10 [10] = {
-    10,
-    100,
-    1e4,
-    1e8,
-    1e16,
-    1e32,
-    1e64,
-    1e128,
-    1e256,
-    INFINITY
-};
-
-double binary_exp10_neg [10] = {
-    0.1,
-    0.01,
-    1e-4,
-    1e-8,
-    1e-16,
-    1e-32,
-    1e-64,
-    1e-128,
-    1e-256,
-    0.0
-};
-
-double
-exp10_int(int val)
+namespace detail {
+
+/** Overloads on the result type, for use from the templates below. */
+inline bool decimal_to_binary(const Decimal_Number & number, double & result)
 {
-    double result = 1.0;
-
-    if (val >= 0) {
-        for (unsigned i = 0;  val;  ++i) {
-            if (i >= 9)
-                return INFINITY;
-            if (val & 1)
-                result *= binary_exp10[i];
-            val >>= 1;
-        }
-    }
-    else {
-        val = -val;
-        for (unsigned i = 0;  val;  ++i) {
-            if (i >= 9)
-                return 0.0;
-            if (val & 1)
-                result *= binary_exp10_neg[i];
-            val >>= 1;
-        }
-    }
+    return decimal_to_double(number, result);
+}
 
-    return result;
+inline bool decimal_to_binary(const Decimal_Number & number, float & result)
+{
+    return decimal_to_float(number, result);
 }
 
-template<typename Float>
-inline bool match_float(Float & result, Parse_Context & c)
+inline void decimal_text_to_binary(const char * start, const char * end,
+                                   double & result)
+{
+    result = decimal_text_to_double(start, end);
+}
+
+inline void decimal_text_to_binary(const char * start, const char * end,
+                                   float & result)
 {
-    Parse_Context::Revert_Token tok(c);
+    result = decimal_text_to_float(start, end);
+}
 
-    unsigned long num = 0;
-    unsigned long den2 = 0;
-    int den2_digits = 0;
-    double sign = 1;
-    int digits = 0;
+} // namespace detail
 
-    if (c.match_literal('+')) ;
-    else if (c.match_literal('-')) sign = -1.0;
+/** Parse a real number from the characters in [p, e), moving p past it.
+    Accepts an optional sign, then nan (in any of the forms nan, naN, Nan
+    or NaN), inf or a decimal number with an optional exponent.  The result
+    is the closest Float to the decimal number (it is correctly rounded).
+    Returns false, leaving p where it was, if there is no number.
 
-    if (c.eof()) return false;
+    This doesn't look past e, and doesn't need the number to be null
+    terminated.
+*/
+template<typename Float>
+inline bool parse_float(const char * & p, const char * e, Float & result)
+{
+    const char * start = p;
+    const char * q = p;
+    bool negative = false;
+    if (q != e && (*q == '+' || *q == '-'))
+        negative = *q++ == '-';
 
-    if (*c == 'n' || *c == 'N') {
-        ++c;
-        if (!c.match_literal("an") && !c.match_literal("aN"))
+    if (q == e) return false;
+
+    if (*q == 'n' || *q == 'N') {
+        if (e - q < 3 || q[1] != 'a' || (q[2] != 'n' && q[2] != 'N'))
             return false;
-        tok.ignore();
-        result = sign * std::numeric_limits<Float>::quiet_NaN();
+        result = std::numeric_limits<Float>::quiet_NaN();
+        if (negative) result = -result;
+        p = q + 3;
         return true;
     }
-    else if (*c == 'i') {
-        ++c;
-        if (!c.match_literal("nf"))
+    else if (*q == 'i') {
+        if (e - q < 3 || q[1] != 'n' || q[2] != 'f')
             return false;
-        tok.ignore();
-        result = sign * INFINITY;
+        result = negative ? -INFINITY : INFINITY;
+        p = q + 3;
         return true;
     }
 
-    while (c) {
-        //std::cerr << "got character " << *c << " num = " << num
-        //          << " den = " << den << " den2 = " << den2
-        //          << " sign = " << sign
-        //          << " digits = " << digits << std::endl;
-
-        if (isdigit(*c)) {
-            int digit = *c - '0';
-            if (digits <= 17) {
-                num = 10*num + digit;
-                den2 *= 10;
-                ++den2_digits;
-            }
-            ++digits;
-        }
-        else if (*c == '.') {
-            if (den2 != 0) break;
-            else {
-                den2 = 1;
-                den2_digits = 0;
-            }
-        }
-        else if (digits && (*c == 'e' || *c == 'E')) {
-            Parse_Context::Revert_Token token(c);
-            ++c;
-            if (c.match_literal('+'));
-            int expi;
-            if (c.match_int(expi)) {
-                sign *= exp10(expi);
-                token.ignore();
-            }
-            break;
-        }
-        else break;
-        ++c;
-    }
-
-    if (!digits) return false;
-
-    if (digits > 15) {
-        // we need to parse using strtod since rounding bites us otherwise
-        size_t ofs = c.get_offset();
-
-        // Go back
-        tok.apply();
+    Decimal_Number number;
+    const char * end = scan_decimal(q, e, number);
+    if (end == q) return false;
+    number.negative = negative;
 
-        size_t ofs0 = c.get_offset();
-        size_t nchars = ofs - ofs0;
-        
-        char buf[nchars + 1];
-
-        for (unsigned i = 0;  i < nchars;  ++i)
-            buf[i] = *c++;
-        buf[nchars] = 0;
+    if (!detail::decimal_to_binary(number, result)) {
+        // More than 19 digits and too close to call; use the whole text
+        detail::decimal_text_to_binary(start, end, result);
+    }
 
-        char * endptr;
-        double parsed = strtod(buf, &endptr);
+    p = end;
+    return true;
+}
 
-        if (endptr != buf + nchars)
-            throw Exception("wrong endptr");
+/** Can the character be part of a number accepted by parse_float()? */
+inline bool is_float_char(char c)
+{
+    return (c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E'
+        || c == '+' || c == '-' || c == 'n' || c == 'N' || c == 'a'
+        || c == 'i' || c == 'f';
+}
 
-        result = parsed;
+/** As parse_float(), but for a Parse_Context.  In the normal case, where
+    the number is completely within the current buffer, it is parsed in
+    place.  Otherwise the characters that could be part of it are copied
+    out first.
+*/
+template<typename Float>
+inline bool match_float(Float & result, Parse_Context & c)
+{
+    const char * start = c.chunk_pos();
+    const char * e = start + c.chunk_available();
+    const char * p = start;
+    if (parse_float(p, e, result)
+        && (c.in_memory() || (p != e && !is_float_char(*p)))) {
+        c.skip_in_chunk(p - start);
         return true;
     }
+    if (c.in_memory())
+        return false;
+
+    std::string text;
+    {
+        Parse_Context::Revert_Token token(c);
+        while (c && is_float_char(*c))
+            text += *c++;
+    }
 
+    p = text.c_str();
+    if (!parse_float(p, p + text.size(), result))
+        return false;
 
-    tok.ignore();  // we are returning true; ignore the token
- 
-    if (den2 == 0) result = sign * num;
-    else result = sign * (double)num / den2;
-
+    for (size_t n = p - text.c_str();  n > 0;  --n)
+        ++c;
     return true;
 }
 
@@ -25,141 +25,167 @@
 
 #include "jml/utils/parse_context.h"
 #include <iostream>
+#include <stdint.h>
+#include <string.h>
 
 using namespace std;
 
 
 namespace ML {
 
-inline bool match_unsigned(unsigned long & val, Parse_Context & c)
+/** Number of leading bytes of the little endian word that are ASCII
+    digits, from 0 to 8.  Each byte is tested separately, without carries
+    between them. */
+inline unsigned leading_digits(uint64_t chars)
 {
-    Parse_Context::Revert_Token tok(c);
+    const uint64_t high = 0x8080808080808080ULL;
+    uint64_t low7 = chars & ~high;
+    uint64_t atLeast0 = (low7 + 0x5050505050505050ULL) & high;
+    uint64_t above9 = (low7 + 0x4646464646464646ULL) & high;
+    uint64_t notDigit = ~(atLeast0 & ~above9 & ~chars) & high;
+    return notDigit ? __builtin_ctzll(notDigit) / 8 : 8;
+}
 
-    val = 0;
-    unsigned digits = 0;
-    
-    while (c) {
-        if (isdigit(*c)) {
-            int digit = *c - '0';
-            val = val * 10 + digit;
-            ++digits;
+/** Value of the eight ASCII digits in the little endian word (the first
+    character being the most significant), in three multiplies. */
+inline uint32_t eight_digits_value(uint64_t chars)
+{
+    chars -= 0x3030303030303030ULL;
+    chars = (chars * 10) + (chars >> 8);
+    chars = (((chars & 0x000000FF000000FFULL) * 0x000F424000000064ULL)
+             + (((chars >> 16) & 0x000000FF000000FFULL)
+                * 0x0000271000000001ULL)) >> 32;
+    return chars;
+}
+
+/** Parse the digits at the start of [p, e) into val, eight at a time
+    where there is room to load them.  As with the loop that this
+    replaces, values that don't fit wrap around.  Returns a pointer
+    to the first character that isn't a digit.  The eight digit words
+    are little endian, so big endian machines only use the loop.
+*/
+template<typename UInt>
+inline const char * parse_digits(const char * p, const char * e, UInt & val)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    static const uint32_t powers_of_ten[8] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000
+    };
+
+    while (e - p >= 8) {
+        uint64_t chars;
+        memcpy(&chars, p, 8);
+        unsigned n = leading_digits(chars);
+        if (n == 8) {
+            val = val * (UInt)100000000 + eight_digits_value(chars);
+            p += 8;
+            continue;
         }
-        else break;
-        
-        ++c;
+        if (n == 0) return p;
+        // Pad on the left with '0's to make eight digits
+        chars = (chars << (8 * (8 - n)))
+            | (0x3030303030303030ULL >> (8 * n));
+        val = val * (UInt)powers_of_ten[n] + eight_digits_value(chars);
+        return p + n;
     }
-    
-    if (!digits) return false;
-    
-    tok.ignore();  // we are returning true; ignore the token
-    
-    return true;
+#endif
+
+    for (;  p != e && (unsigned char)(*p - '0') < 10;  ++p)
+        val = val * 10 + (*p - '0');
+    return p;
 }
 
-inline bool match_int(long int & result, Parse_Context & c)
+/** Match an unsigned integer.  The digits are parsed directly from the
+    current buffer; only digits that run across into the next buffer are
+    taken one at a time.
+*/
+template<typename UInt>
+inline bool match_unsigned_digits(UInt & val, Parse_Context & c)
 {
-    Parse_Context::Revert_Token tok(c);
-
-    int sign = 1;
-    if (c.match_literal('+')) ;
-    else if (c.match_literal('-')) sign = -1;
+    val = 0;
+    const char * start = c.chunk_pos();
+    const char * e = start + c.chunk_available();
+    const char * p = parse_digits(start, e, val);
+    bool any = p != start;
+    if (any) c.skip_in_line(p - start);
+
+    if (p == e) {
+        while (c && isdigit(*c)) {
+            val = val * 10 + (*c - '0');
+            any = true;
+            ++c;
+        }
+    }
 
-    long unsigned mag;
-    if (!match_unsigned(mag, c)) return false;
+    return any;
+}
 
-    result = mag * sign;
+/** Match a signed integer: an optional sign, then digits as for
+    match_unsigned_digits().  When the sign and the first digit are both
+    in the current buffer, which is nearly always, there's nothing that
+    could need to be given back, so no Revert_Token is needed.  Values that
+    don't fit wrap around, as for the unsigned versions.
+*/
+template<typename Int, typename UInt>
+inline bool match_signed_digits(Int & result, Parse_Context & c)
+{
+    const char * start = c.chunk_pos();
+    const char * e = start + c.chunk_available();
+    const char * p = start;
+    bool negative = false;
+    if (p != e && (*p == '+' || *p == '-'))
+        negative = *p++ == '-';
+
+    UInt mag;
+    if (p != e) {
+        if ((unsigned char)(*p - '0') >= 10) return false;
+        c.skip_in_line(p - start);
+        match_unsigned_digits(mag, c);
+    }
+    else {
+        // The sign is the last character in the buffer (or there is none)
+        Parse_Context::Revert_Token tok(c);
+        if (c.match_literal('+')) ;
+        else if (c.match_literal('-')) negative = true;
+        if (!match_unsigned_digits(mag, c)) return false;
+        tok.ignore();
+    }
 
-    tok.ignore();
+    result = (Int)(negative ? -mag : mag);
     return true;
 }
 
+inline bool match_unsigned(unsigned long & val, Parse_Context & c)
+{
+    return match_unsigned_digits(val, c);
+}
+
+inline bool match_int(long int & result, Parse_Context & c)
+{
+    return match_signed_digits<long int, unsigned long>(result, c);
+}
+
 inline bool match_unsigned_long(unsigned long & val,
                                 Parse_Context & c)
 {
-    Parse_Context::Revert_Token tok(c);
-
-    val = 0;
-    int digits = 0;
-    
-    while (c) {
-        if (isdigit(*c)) {
-            int digit = *c - '0';
-            val = val * 10 + digit;
-            ++digits;
-        }
-        else break;
-        
-        ++c;
-    }
-    
-    if (!digits) return false;
-    
-    tok.ignore();  // we are returning true; ignore the token
-    
-    return true;
+    return match_unsigned_digits(val, c);
 }
 
 inline bool match_long(long int & result, Parse_Context & c)
 {
-    Parse_Context::Revert_Token tok(c);
-
-    long sign = 1;
-    if (c.match_literal('+')) ;
-    else if (c.match_literal('-')) sign = -1;
-
-    long unsigned mag;
-    if (!match_unsigned_long(mag, c)) return false;
-    
-    result = (long)mag;
-    result *= sign;
-    
-    tok.ignore();
-    return true;
+    return match_signed_digits<long int, unsigned long>(result, c);
 }
 
 
 inline bool match_unsigned_long_long(unsigned long long & val,
                                      Parse_Context & c)
 {
-    Parse_Context::Revert_Token tok(c);
-
-    val = 0;
-    int digits = 0;
-    
-    while (c) {
-        if (isdigit(*c)) {
-            int digit = *c - '0';
-            val = val * 10 + digit;
-            ++digits;
-        }
-        else break;
-        
-        ++c;
-    }
-    
-    if (!digits) return false;
-    
-    tok.ignore();  // we are returning true; ignore the token
-    
-    return true;
+    return match_unsigned_digits(val, c);
 }
 
 inline bool match_long_long(long long int & result, Parse_Context & c)
 {
-    Parse_Context::Revert_Token tok(c);
-
-    long long sign = 1;
-    if (c.match_literal('+')) ;
-    else if (c.match_literal('-')) sign = -1;
-
-    long long unsigned mag;
-    if (!match_unsigned_long_long(mag, c)) return false;
-
-    result = (long long)mag;
-    result *= sign;
-
-    tok.ignore();
-    return true;
+    return match_signed_digits<long long int, unsigned long long>(result, c);
 }
 
 } // namespace ML
@@ -21,6 +21,7 @@
 */
 
 #include "filter_streams.h"
+#include "filter_streams_registry.h"
 #include <fstream>
 #include <mutex>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -46,6 +47,9 @@ namespace ML {
 const UriHandlerFunction &
 getUriHandler(const std::string & scheme);
 
+const CompressorFunction *
+getCompressor(const std::string & name);
+
 std::pair<std::string, std::string>
 getScheme(const std::string & uri)
 {
@@ -123,6 +127,7 @@ bool ends_with(const std::string & str, const std::string & what)
         && result == str.size() - what.size();
 }
 
+
 void addCompression(streambuf & buf,
                     boost::iostreams::filtering_ostream & stream,
                     const std::string & resource,
@@ -131,7 +136,10 @@ void addCompression(streambuf & buf,
 {
     using namespace boost::iostreams;
 
-    if (compression == "gz" || compression == "gzip"
+    if (const CompressorFunction * compressor = getCompressor(compression)) {
+        (*compressor)(stream, compressionLevel);
+    }
+    else if (compression == "gz" || compression == "gzip"
         || (compression == ""
             && (ends_with(resource, ".gz") || ends_with(resource, ".gz~")))) {
         gzip_compressor compressor;
@@ -434,6 +442,46 @@ getUriHandler(const std::string & scheme)
     return it->second;
 }
 
+namespace {
+
+std::mutex compressorsLock;
+
+/** Compressors are registered from the static initializers of other
+    libraries, which may run before those of this file. */
+std::unordered_map<std::string, CompressorFunction> & getCompressors()
+{
+    static std::unordered_map<std::string, CompressorFunction> compressors;
+    return compressors;
+}
+
+} // file scope
+
+void registerCompressor(const std::string & name,
+                        const CompressorFunction & compressor)
+{
+    if (!compressor)
+        throw ML::Exception("registerCompressor: null compressor passed");
+
+    std::unique_lock<std::mutex> guard(compressorsLock);
+    auto & compressors = getCompressors();
+    auto it = compressors.find(name);
+    if (it != compressors.end())
+        throw ML::Exception("already have a compressor registered for "
+                            + name);
+    compressors[name] = compressor;
+}
+
+const CompressorFunction *
+getCompressor(const std::string & name)
+{
+    std::unique_lock<std::mutex> guard(compressorsLock);
+    auto & compressors = getCompressors();
+    auto it = compressors.find(name);
+    if (it == compressors.end())
+        return 0;
+    return &it->second;
+}
+
 struct RegisterFileHandler {
     static std::pair<std::streambuf *, bool>
     getFileHandler(const std::string & scheme,
@@ -36,7 +36,11 @@ namespace ML {
 
 /** Ostream class that has the following features:
     - It has move semantics so can be passed by reference
-    - It can add filters to compress / decompress
+    - It can add filters to compress / decompress.  The compression is
+      picked from the extension, or given as "gz", "bz2", "xz" or "pigz";
+      the last writes gzip using all of the cores, in the manner of pigz,
+      and needs the parallel_utils library (see parallel_gzip.h).  Other
+      libraries can add compressions with registerCompressor().
     - It can hook into other filesystems (eg s3, ...) based upon an
       extensible API.
 */
@@ -0,0 +1,36 @@
+/* filter_streams_registry.h                                       -*- C++ -*-
+   Jeremy Barnes, 17 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Registration of extra compression filters for filter_ostream.
+*/
+
+#ifndef __utils__filter_streams_registry_h__
+#define __utils__filter_streams_registry_h__
+
+#include <boost/iostreams/filtering_stream.hpp>
+#include <functional>
+#include <string>
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* COMPRESSOR REGISTRY                                                       */
+/*****************************************************************************/
+
+/** Pushes a compression filter onto the stream, at the given compression
+    level (-1 for the default). */
+typedef std::function<void (boost::iostreams::filtering_ostream & stream,
+                            int level)>
+CompressorFunction;
+
+/** Make the compressor available as a compression name to filter_ostream.
+    This lets libraries that can't be dependencies of utils (for example
+    because they use the Worker_Task) add compressions. */
+void registerCompressor(const std::string & name,
+                        const CompressorFunction & compressor);
+
+} // namespace ML
+
+#endif /* __utils__filter_streams_registry_h__ */
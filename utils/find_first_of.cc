@@ -0,0 +1,245 @@
+/* find_first_of.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Vectorized search for the first of a small set of characters.
+*/
+
+#include "find_first_of.h"
+#include "jml/arch/arch.h"
+#include "jml/arch/exception.h"
+#include <string.h>
+
+#if JML_INTEL_ISA
+# include <immintrin.h>
+#endif
+
+
+namespace ML {
+
+namespace {
+
+const char * find_scalar(const char * chars, const char * p, const char * e)
+{
+    for (;  p != e;  ++p) {
+        char c = *p;
+        if (c == chars[0] || c == chars[1] || c == chars[2]
+            || c == chars[3] || c == chars[4] || c == chars[5])
+            return p;
+    }
+    return e;
+}
+
+#if !JML_INTEL_ISA
+const char * find_scalar(const Find_First_Of & finder,
+                         const char * p, const char * e)
+{
+    return find_scalar(finder.chars, p, e);
+}
+#endif
+
+size_t count_scalar(const char * p, const char * e, char c)
+{
+    size_t result = 0;
+    for (;  p != e;  ++p)
+        result += *p == c;
+    return result;
+}
+
+#if JML_INTEL_ISA
+
+/** Mask of the bytes of v that match any of the characters. */
+JML_ALWAYS_INLINE int
+match_mask_sse2(__m128i v, const __m128i * c)
+{
+    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, c[0]),
+                                          _mm_cmpeq_epi8(v, c[1])),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, c[2]),
+                                          _mm_cmpeq_epi8(v, c[3])));
+    m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, c[4]),
+                                     _mm_cmpeq_epi8(v, c[5])));
+    return _mm_movemask_epi8(m);
+}
+
+/** The 16 byte splats out of the finder.  Unaligned loads, as a finder
+    allocated with operator new may not be 16 byte aligned. */
+JML_ALWAYS_INLINE void
+load_splats_sse2(const Find_First_Of & finder, __m128i * c)
+{
+    for (unsigned i = 0;  i < Find_First_Of::MAX_CHARS;  ++i)
+        c[i] = _mm_loadu_si128((const __m128i *)finder.splats[i]);
+}
+
+const char * find_sse2(const Find_First_Of & finder,
+                       const char * p, const char * e)
+{
+    __m128i c[Find_First_Of::MAX_CHARS];
+    load_splats_sse2(finder, c);
+
+    for (;  e - p >= 16;  p += 16) {
+        int mask = match_mask_sse2(_mm_loadu_si128((const __m128i *)p), c);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+
+    return find_scalar(finder.chars, p, e);
+}
+
+__attribute__((__target__("avx2")))
+const char * find_avx2(const Find_First_Of & finder,
+                       const char * p, const char * e)
+{
+    // Unaligned loads, as operator new needn't honour the 32 byte alignment
+    __m256i c[Find_First_Of::MAX_CHARS];
+    for (unsigned i = 0;  i < Find_First_Of::MAX_CHARS;  ++i)
+        c[i] = _mm256_loadu_si256((const __m256i *)finder.splats[i]);
+
+    for (;  e - p >= 32;  p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i m0 = _mm256_or_si256(_mm256_cmpeq_epi8(v, c[0]),
+                                     _mm256_cmpeq_epi8(v, c[1]));
+        __m256i m1 = _mm256_or_si256(_mm256_cmpeq_epi8(v, c[2]),
+                                     _mm256_cmpeq_epi8(v, c[3]));
+        __m256i m2 = _mm256_or_si256(_mm256_cmpeq_epi8(v, c[4]),
+                                     _mm256_cmpeq_epi8(v, c[5]));
+        __m256i m = _mm256_or_si256(_mm256_or_si256(m0, m1), m2);
+        unsigned mask = _mm256_movemask_epi8(m);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+
+    // Less than 32 left; one more vector of 16 and then the stragglers
+    if (e - p >= 16) {
+        __m128i c16[Find_First_Of::MAX_CHARS];
+        load_splats_sse2(finder, c16);
+        int mask = match_mask_sse2(_mm_loadu_si128((const __m128i *)p), c16);
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+
+    return find_scalar(finder.chars, p, e);
+}
+
+size_t count_sse2(const char * p, const char * e, char c)
+{
+    const __m128i splat = _mm_set1_epi8(c);
+    const __m128i zero = _mm_setzero_si128();
+    size_t result = 0;
+
+    while (e - p >= 16) {
+        // Each byte of the accumulator counts up to 255 matches; then they
+        // are added horizontally
+        __m128i counts = zero;
+        for (unsigned i = 0;  i < 255 && e - p >= 16;  ++i, p += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)p);
+            counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(v, splat));
+        }
+        __m128i sums = _mm_sad_epu8(counts, zero);
+        result += _mm_cvtsi128_si64(sums)
+            + _mm_cvtsi128_si64(_mm_unpackhi_epi64(sums, sums));
+    }
+
+    return result + count_scalar(p, e, c);
+}
+
+__attribute__((__target__("avx2")))
+size_t count_avx2(const char * p, const char * e, char c)
+{
+    const __m256i splat = _mm256_set1_epi8(c);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t result = 0;
+
+    while (e - p >= 32) {
+        __m256i counts = zero;
+        for (unsigned i = 0;  i < 255 && e - p >= 32;  ++i, p += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)p);
+            counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(v, splat));
+        }
+        __m256i sums = _mm256_sad_epu8(counts, zero);
+        result += _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1)
+            + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+    }
+
+    return result + count_scalar(p, e, c);
+}
+
+bool detect_avx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+/** Decided on first use, so that finders created by static constructors
+    in other files get it right too. */
+bool has_avx2()
+{
+    static const bool result = detect_avx2();
+    return result;
+}
+
+#endif // JML_INTEL_ISA
+
+} // file scope
+
+
+/*****************************************************************************/
+/* FIND_FIRST_OF                                                             */
+/*****************************************************************************/
+
+Find_First_Of::
+Find_First_Of(const char * chars)
+{
+    init(chars, strlen(chars));
+}
+
+Find_First_Of::
+Find_First_Of(const char * chars, int nchars)
+{
+    init(chars, nchars);
+}
+
+void
+Find_First_Of::
+init(const char * chars, int nchars)
+{
+    if (nchars < 1 || nchars > MAX_CHARS)
+        throw Exception("Find_First_Of: can't find %d characters", nchars);
+
+    for (unsigned i = 0;  i < MAX_CHARS;  ++i) {
+        this->chars[i] = chars[(int)i < nchars ? i : 0];
+        memset(splats[i], this->chars[i], sizeof(splats[i]));
+    }
+    this->nchars = nchars;
+
+#if JML_INTEL_ISA
+    find_ = has_avx2() ? find_avx2 : find_sse2;
+#else
+    find_ = find_scalar;
+#endif
+}
+
+const char *
+Find_First_Of::
+implementation()
+{
+#if JML_INTEL_ISA
+    return has_avx2() ? "avx2" : "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+
+/*****************************************************************************/
+/* COUNT_CHAR                                                                */
+/*****************************************************************************/
+
+size_t count_char(const char * start, const char * end, char c)
+{
+#if JML_INTEL_ISA
+    static const auto count = has_avx2() ? count_avx2 : count_sse2;
+    return count(start, end, c);
+#else
+    return count_scalar(start, end, c);
+#endif
+}
+
+} // namespace ML
@@ -0,0 +1,76 @@
+/* find_first_of.h                                                 -*- C++ -*-
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Vectorized search for the first of a small set of characters.
+*/
+
+#ifndef __utils__find_first_of_h__
+#define __utils__find_first_of_h__
+
+#include "jml/compiler/compiler.h"
+#include <stddef.h>
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* FIND_FIRST_OF                                                             */
+/*****************************************************************************/
+
+/** Finds the first of a set of up to six characters in a block of memory;
+    typically a few delimiters plus newline and quote.  The block is
+    scanned 16 characters at a time with SSE2, or 32 at a time with AVX2
+    on the processors that have it (decided once, at startup), and so is
+    several times faster than a loop over the characters once the runs are
+    more than a few characters long.
+
+    This is the primitive that the parsers use to skip through a buffer to
+    the next character that they need to look at.
+*/
+
+struct Find_First_Of {
+    enum { MAX_CHARS = 6 };
+
+    /** Find any of the characters in the null terminated string. */
+    explicit Find_First_Of(const char * chars);
+
+    /** Find any of the nchars characters starting at chars. */
+    Find_First_Of(const char * chars, int nchars);
+
+    /** Return a pointer to the first of the characters in [start, end), or
+        end if there are none. */
+    const char * operator () (const char * start, const char * end) const
+    {
+        return find_(*this, start, end);
+    }
+
+    /** Name of the implementation in use: "avx2", "sse2" or "scalar". */
+    static const char * implementation();
+
+    /** Characters to look for.  Unused entries repeat the first one, so
+        that every one can be compared against unconditionally. */
+    char chars[MAX_CHARS];
+    int nchars;
+
+    /** Each of the characters repeated over a 32 byte vector, so that
+        searches don't need to set them up each time.  The SSE2 search uses
+        the first half of each. */
+    char splats[MAX_CHARS][32] JML_ALIGNED(32);
+
+private:
+    typedef const char * (* Find_Fn) (const Find_First_Of & finder,
+                                      const char * start, const char * end);
+    Find_Fn find_;
+
+    void init(const char * chars, int nchars);
+};
+
+/** Number of times the character c occurs in [start, end).  Vectorized
+    in the same way as Find_First_Of; used to count newlines. */
+size_t count_char(const char * start, const char * end, char c);
+
+} // namespace ML
+
+#endif /* __utils__find_first_of_h__ */
@@ -87,8 +87,9 @@ public:
     }
 
     explicit
-    fixed_array_base(const boost::detail::multi_array::extent_gen<Dim> & dims)
-        : base_type(dims)
+    fixed_array_base(const boost::detail::multi_array::extent_gen<Dim> & dims,
+                     const Allocator & alloc = Allocator())
+        : base_type(dims, alloc)
     {
     }
 
@@ -131,17 +132,20 @@ public:
     }
 };
 
-template<typename T, size_t Dim>
+template<typename T, size_t Dim,
+         class Allocator = std::allocator<typename boost::remove_const<T>::type > >
 class fixed_array {
 };
 
-template<typename T>
-class fixed_array<T, 1> : public fixed_array_base<T, 1> {
-    typedef fixed_array_base<T, 1> base_type;
+template<typename T, class Allocator>
+class fixed_array<T, 1, Allocator>
+    : public fixed_array_base<T, 1, Allocator> {
+    typedef fixed_array_base<T, 1, Allocator> base_type;
 
 public:
-    fixed_array(int d0 = 0)
-        : base_type(boost::extents[d0])
+    fixed_array(int d0 = 0,
+                const Allocator & alloc = Allocator())
+        : base_type(boost::extents[d0], alloc)
     {
     }
 
@@ -164,12 +168,14 @@ public:
     }
 };
 
-template<typename T>
-class fixed_array<T, 2> : public fixed_array_base<T, 2> {
-    typedef fixed_array_base<T, 2> base_type;
+template<typename T, class Allocator>
+class fixed_array<T, 2, Allocator>
+    : public fixed_array_base<T, 2, Allocator> {
+    typedef fixed_array_base<T, 2, Allocator> base_type;
 public:
-    fixed_array(int d0 = 0, int d1 = 0)
-        : base_type(boost::extents[d0][d1])
+    fixed_array(int d0 = 0, int d1 = 0,
+                const Allocator & alloc = Allocator())
+        : base_type(boost::extents[d0][d1], alloc)
     {
     }
 
@@ -192,13 +198,15 @@ public:
     }
 };
 
-template<typename T>
-class fixed_array<T, 3> : public fixed_array_base<T, 3> {
-    typedef fixed_array_base<T, 3> base_type;
+template<typename T, class Allocator>
+class fixed_array<T, 3, Allocator>
+    : public fixed_array_base<T, 3, Allocator> {
+    typedef fixed_array_base<T, 3, Allocator> base_type;
 
 public:
-    fixed_array(int d0 = 0, int d1 = 0, int d2 = 0)
-        : base_type(boost::extents[d0][d1][d2])
+    fixed_array(int d0 = 0, int d1 = 0, int d2 = 0,
+                const Allocator & alloc = Allocator())
+        : base_type(boost::extents[d0][d1][d2], alloc)
     {
     }
 
@@ -0,0 +1,133 @@
+/* huge_page_allocator.h                                           -*- C++ -*-
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Allocator that backs large allocations with huge pages.
+*/
+
+#ifndef __jml__utils__huge_page_allocator_h__
+#define __jml__utils__huge_page_allocator_h__
+
+#include "jml/arch/vm.h"
+#include <memory>
+#include <new>
+#include <limits>
+#include <stdlib.h>
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* HUGE PAGE ALLOCATOR                                                       */
+/*****************************************************************************/
+
+/** Standard allocator that allocates anything bigger than Threshold bytes
+    directly from the kernel, aligned on a 2MB boundary so that it can be
+    backed by huge pages (see allocate_huge_pages() for the modes).  Smaller
+    allocations go through malloc as usual.
+
+    It is stateless, so it can be used as the allocator for MemStorage,
+    LogMemStorage (and hence Lightweight_Hash), compact_vector and
+    fixed_array, which all keep a static or default constructed instance:
+
+        Lightweight_Hash<uint64_t, float, std::pair<uint64_t, float>,
+                         std::pair<const uint64_t, float>,
+                         PairOps<uint64_t, float>,
+                         LogMemStorage<std::pair<uint64_t, float>,
+                                       Huge_Page_Allocator<std::pair<uint64_t, float> > > >
+
+    Note that an allocation just over Threshold is rounded up to a full huge
+    page, so Threshold shouldn't be set much below the huge page size.
+*/
+
+template<typename T,
+         Huge_Page_Mode Mode = HP_TRANSPARENT,
+         size_t Threshold = huge_page_size>
+struct Huge_Page_Allocator {
+    typedef T value_type;
+    typedef T * pointer;
+    typedef const T * const_pointer;
+    typedef T & reference;
+    typedef const T & const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<typename U>
+    struct rebind {
+        typedef Huge_Page_Allocator<U, Mode, Threshold> other;
+    };
+
+    Huge_Page_Allocator()
+    {
+    }
+
+    template<typename U>
+    Huge_Page_Allocator(const Huge_Page_Allocator<U, Mode, Threshold> &)
+    {
+    }
+
+    static bool is_huge(size_t n)
+    {
+        return n * sizeof(T) >= Threshold;
+    }
+
+    T * allocate(size_t n, const void * hint = 0)
+    {
+        if (n == 0) return 0;
+        if (n > max_size())
+            throw std::bad_alloc();
+
+        void * result;
+        if (is_huge(n))
+            result = allocate_huge_pages(n * sizeof(T), Mode);
+        else result = malloc(n * sizeof(T));
+
+        if (!result)
+            throw std::bad_alloc();
+        return reinterpret_cast<T *>(result);
+    }
+
+    void deallocate(T * p, size_t n)
+    {
+        if (!p) return;
+        if (is_huge(n))
+            free_huge_pages(p, n * sizeof(T));
+        else free(p);
+    }
+
+    size_t max_size() const
+    {
+        return std::numeric_limits<size_t>::max() / sizeof(T);
+    }
+
+    T * address(T & x) const { return &x; }
+    const T * address(const T & x) const { return &x; }
+
+    void construct(T * p, const T & val)
+    {
+        new (p) T(val);
+    }
+
+    void destroy(T * p)
+    {
+        p->~T();
+    }
+};
+
+template<typename T1, typename T2, Huge_Page_Mode M, size_t Th>
+bool operator == (const Huge_Page_Allocator<T1, M, Th> &,
+                  const Huge_Page_Allocator<T2, M, Th> &)
+{
+    return true;
+}
+
+template<typename T1, typename T2, Huge_Page_Mode M, size_t Th>
+bool operator != (const Huge_Page_Allocator<T1, M, Th> &,
+                  const Huge_Page_Allocator<T2, M, Th> &)
+{
+    return false;
+}
+
+} // namespace ML
+
+#endif /* __jml__utils__huge_page_allocator_h__ */
@@ -0,0 +1,1148 @@
+/* json_index.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Two stage JSON parsing.
+*/
+
+#include "json_index.h"
+#include "file_functions.h"
+#include "find_first_of.h"
+#include "jml/arch/arch.h"
+#include "jml/arch/exception.h"
+#include "jml/arch/format.h"
+#include <algorithm>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if JML_INTEL_ISA
+# include <immintrin.h>
+#endif
+
+
+using namespace std;
+
+
+namespace ML {
+
+namespace {
+
+/** Which of the 64 characters of a block are of each class. */
+struct Block_Masks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t structural;    ///< { } [ ] : ,
+    uint64_t whitespace;
+};
+
+typedef void (* Classify_Fn) (const char * p, Block_Masks & masks);
+
+#if !JML_INTEL_ISA
+
+void classify_scalar(const char * p, Block_Masks & masks)
+{
+    masks = Block_Masks{ 0, 0, 0, 0 };
+    for (unsigned i = 0;  i < 64;  ++i) {
+        uint64_t bit = 1ULL << i;
+        switch (p[i]) {
+        case '"':  masks.quote |= bit;  break;
+        case '\\': masks.backslash |= bit;  break;
+        case '{': case '}': case '[': case ']': case ':': case ',':
+            masks.structural |= bit;  break;
+        case ' ': case '\t': case '\n': case '\r':
+            masks.whitespace |= bit;  break;
+        }
+    }
+}
+
+#else // JML_INTEL_ISA
+
+// '{' and '[', and '}' and ']', differ only in the 0x20 bit, so each pair is
+// matched with a single comparison once that bit is set.
+
+void classify_sse2(const char * p, Block_Masks & masks)
+{
+    const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\');
+    const __m128i open = _mm_set1_epi8('{'), close = _mm_set1_epi8('}');
+    const __m128i colon = _mm_set1_epi8(':'), comma = _mm_set1_epi8(',');
+    const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+    const __m128i nl = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+    const __m128i bit20 = _mm_set1_epi8(0x20);
+
+    masks = Block_Masks{ 0, 0, 0, 0 };
+
+    for (unsigned i = 0;  i < 4;  ++i) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * i));
+        __m128i v20 = _mm_or_si128(v, bit20);
+
+        __m128i s = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v20, open),
+                                              _mm_cmpeq_epi8(v20, close)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, colon),
+                                              _mm_cmpeq_epi8(v, comma)));
+        __m128i w = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                              _mm_cmpeq_epi8(v, tab)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, nl),
+                                              _mm_cmpeq_epi8(v, cr)));
+
+        int shift = 16 * i;
+        masks.quote |= (uint64_t)(unsigned)
+            _mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << shift;
+        masks.backslash |= (uint64_t)(unsigned)
+            _mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)) << shift;
+        masks.structural |= (uint64_t)(unsigned)_mm_movemask_epi8(s) << shift;
+        masks.whitespace |= (uint64_t)(unsigned)_mm_movemask_epi8(w) << shift;
+    }
+}
+
+__attribute__((__target__("avx2")))
+void classify_avx2(const char * p, Block_Masks & masks)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i open = _mm256_set1_epi8('{'), close = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':'), comma = _mm256_set1_epi8(',');
+    const __m256i space = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t');
+    const __m256i nl = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r');
+    const __m256i bit20 = _mm256_set1_epi8(0x20);
+
+    masks = Block_Masks{ 0, 0, 0, 0 };
+
+    for (unsigned i = 0;  i < 2;  ++i) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + 32 * i));
+        __m256i v20 = _mm256_or_si256(v, bit20);
+
+        __m256i s
+            = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v20, open),
+                                              _mm256_cmpeq_epi8(v20, close)),
+                              _mm256_or_si256(_mm256_cmpeq_epi8(v, colon),
+                                              _mm256_cmpeq_epi8(v, comma)));
+        __m256i w
+            = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                              _mm256_cmpeq_epi8(v, tab)),
+                              _mm256_or_si256(_mm256_cmpeq_epi8(v, nl),
+                                              _mm256_cmpeq_epi8(v, cr)));
+
+        int shift = 32 * i;
+        masks.quote |= (uint64_t)(uint32_t)
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)) << shift;
+        masks.backslash |= (uint64_t)(uint32_t)
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)) << shift;
+        masks.structural |= (uint64_t)(uint32_t)
+            _mm256_movemask_epi8(s) << shift;
+        masks.whitespace |= (uint64_t)(uint32_t)
+            _mm256_movemask_epi8(w) << shift;
+    }
+}
+
+bool detect_avx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+bool has_avx2()
+{
+    static const bool result = detect_avx2();
+    return result;
+}
+
+#endif // JML_INTEL_ISA
+
+Classify_Fn classifier()
+{
+#if JML_INTEL_ISA
+    return has_avx2() ? classify_avx2 : classify_sse2;
+#else
+    return classify_scalar;
+#endif
+}
+
+/** Bit i of the result is the xor of bits 0 to i of x. */
+JML_ALWAYS_INLINE uint64_t prefix_xor(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/** Write the offsets of the structural characters of [start, end) to out,
+    and return how many there were. */
+size_t index_buffer(const char * start, const char * end, uint32_t * out)
+{
+    Classify_Fn classify = classifier();
+
+    // State carried from one block to the next
+    uint64_t prevEscaped = 0;   ///< First character is escaped
+    uint64_t prevInString = 0;  ///< All ones if the last block ended in one
+    uint64_t prevScalar = 0;    ///< Last character was part of a scalar
+
+    uint32_t * o = out;
+    size_t length = end - start;
+    char last[64];
+
+    for (size_t offset = 0;  offset < length;  offset += 64) {
+        const char * p = start + offset;
+
+        // The last partial block is padded with whitespace, which is
+        // never in the index
+        if (length - offset < 64) {
+            memset(last, ' ', 64);
+            memcpy(last, p, length - offset);
+            p = last;
+        }
+
+        Block_Masks masks;
+        classify(p, masks);
+
+        // Characters escaped by a backslash.  Backslashes are rare enough
+        // outside of escaped text that each one is handled on its own; an
+        // escaped backslash doesn't escape the character after it.
+        uint64_t escaped = prevEscaped;
+        prevEscaped = 0;
+        uint64_t escapes = masks.backslash & ~escaped;
+        while (escapes) {
+            int i = __builtin_ctzll(escapes);
+            if (i == 63) {
+                prevEscaped = 1;
+                break;
+            }
+            escaped |= 2ULL << i;
+            escapes &= ~(3ULL << i);
+        }
+
+        // Within a string is everything from an opening quote up to but
+        // not including the closing one
+        uint64_t quotes = masks.quote & ~escaped;
+        uint64_t inString = prefix_xor(quotes) ^ prevInString;
+        prevInString = (uint64_t)((int64_t)inString >> 63);
+
+        // Scalars are runs of anything else outside of strings; we want
+        // the start of each one
+        uint64_t structural = masks.structural & ~inString;
+        uint64_t scalar = ~(masks.structural | masks.whitespace | quotes
+                            | inString);
+        uint64_t scalarStarts = scalar & ~((scalar << 1) | prevScalar);
+        prevScalar = scalar >> 63;
+
+        uint64_t found = structural | quotes | scalarStarts;
+        while (found) {
+            *o++ = offset + __builtin_ctzll(found);
+            found &= found - 1;
+        }
+    }
+
+    return o - out;
+}
+
+JML_ALWAYS_INLINE bool isDelimiter(char c)
+{
+    switch (c) {
+    case ' ': case '\t': case '\n': case '\r':
+    case '{': case '}': case '[': case ']': case ':': case ',': case '"':
+        return true;
+    default:
+        return false;
+    }
+}
+
+int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+
+/*****************************************************************************/
+/* WALKER                                                                    */
+/*****************************************************************************/
+
+/** Stage two.  The index tells us where everything is, so this never
+    looks at the characters in between, except to unescape strings and
+    convert numbers.  Errors make everything return false with the details
+    left in the walker, so that the same code serves the throwing and the
+    non-throwing interfaces. */
+
+template<typename Handler>
+struct Walker {
+    enum { MAX_DEPTH = 1024 };
+
+    Walker(const JsonStructuralIndex & index, Handler & handler, size_t i)
+        : index(index), handler(handler), buf(index.start),
+          pos(index.positions() + i), posEnd(index.positions() + index.size()),
+          depth(0), errorOffset(0), errorMessage(0)
+    {
+    }
+
+    const JsonStructuralIndex & index;
+    Handler & handler;
+    const char * buf;
+    const uint32_t * pos;
+    const uint32_t * posEnd;
+    int depth;
+    std::string scratch;
+
+    /** Where and what the error was, once one of the functions below has
+        returned false.  The message is always a static string, so that
+        nothing is allocated until somebody wants to see it. */
+    uint32_t errorOffset;
+    const char * errorMessage;
+
+    bool error(uint32_t offset, const char * message)
+    {
+        errorOffset = offset;
+        errorMessage = message;
+        return false;
+    }
+
+    /** Set offset to the next position, or fail with the given message
+        (which says what was expected) if there isn't one. */
+    bool next(uint32_t & offset, const char * message)
+    {
+        if (JML_UNLIKELY(pos == posEnd))
+            return error(index.end - index.start, message);
+        offset = *pos++;
+        return true;
+    }
+
+    char peek() const
+    {
+        return pos == posEnd ? 0 : buf[*pos];
+    }
+
+    bool value()
+    {
+        uint32_t offset;
+        if (!next(offset, "unexpected end of JSON; expected value"))
+            return false;
+        switch (buf[offset]) {
+        case '{':  return object(offset);
+        case '[':  return array(offset);
+        case '"': {
+            const char * str;  size_t length;
+            if (!parseString(offset, str, length)) return false;
+            handler.onString(str, length);
+            return true;
+        }
+        case 't':
+            if (!literal(offset, "true", 4, "expected true")) return false;
+            handler.onBool(true);
+            return true;
+        case 'f':
+            if (!literal(offset, "false", 5, "expected false")) return false;
+            handler.onBool(false);
+            return true;
+        case 'n':
+            if (buf + offset + 1 == index.end || buf[offset + 1] != 'a') {
+                if (!literal(offset, "null", 4, "expected null"))
+                    return false;
+                handler.onNull();
+                return true;
+            }
+            // fall through for nan
+        default:
+            return number(offset);
+        }
+    }
+
+    bool object(uint32_t offset)
+    {
+        if (++depth > MAX_DEPTH)
+            return error(offset, "JSON nested too deeply");
+        handler.onStartObject();
+
+        if (peek() == '}') ++pos;
+        else {
+            for (;;) {
+                uint32_t key;
+                if (!next(key, "unexpected end of JSON; expected string key"))
+                    return false;
+                if (buf[key] != '"')
+                    return error(key, "expected string key");
+                const char * str;  size_t length;
+                if (!parseString(key, str, length)) return false;
+                handler.onKey(str, length);
+
+                uint32_t colon;
+                if (!next(colon, "unexpected end of JSON; expected ':'"))
+                    return false;
+                if (buf[colon] != ':') return error(colon, "expected ':'");
+
+                if (!value()) return false;
+
+                uint32_t sep;
+                if (!next(sep, "unexpected end of JSON; expected ',' or '}'"))
+                    return false;
+                if (buf[sep] == ',') continue;
+                if (buf[sep] == '}') break;
+                return error(sep, "expected ',' or '}'");
+            }
+        }
+
+        handler.onEndObject();
+        --depth;
+        return true;
+    }
+
+    bool array(uint32_t offset)
+    {
+        if (++depth > MAX_DEPTH)
+            return error(offset, "JSON nested too deeply");
+        handler.onStartArray();
+
+        if (peek() == ']') ++pos;
+        else {
+            for (;;) {
+                if (!value()) return false;
+
+                uint32_t sep;
+                if (!next(sep, "unexpected end of JSON; expected ',' or ']'"))
+                    return false;
+                if (buf[sep] == ',') continue;
+                if (buf[sep] == ']') break;
+                return error(sep, "expected ',' or ']'");
+            }
+        }
+
+        handler.onEndArray();
+        --depth;
+        return true;
+    }
+
+    /** Nothing inside of a string is in the index, so the next position
+        is the closing quote. */
+    bool parseString(uint32_t offset, const char * & str, size_t & length)
+    {
+        uint32_t close;
+        if (!next(close, "unexpected end of JSON; expected closing quote"))
+            return false;
+        if (buf[close] != '"') return error(offset, "unterminated string");
+
+        const char * p = buf + offset + 1, * e = buf + close;
+        const char * bs = (const char *)memchr(p, '\\', e - p);
+        if (!bs) {
+            str = p;
+            length = e - p;
+            return true;
+        }
+
+        scratch.assign(p, bs);
+        for (p = bs;  p != e;) {
+            if (*p != '\\') {
+                scratch += *p++;
+                continue;
+            }
+            ++p;   // can't be at e, since the closing quote isn't escaped
+            char c = *p++;
+            switch (c) {
+            case 't': scratch += '\t';  break;
+            case 'n': scratch += '\n';  break;
+            case 'r': scratch += '\r';  break;
+            case 'f': scratch += '\f';  break;
+            case 'b': scratch += '\b';  break;
+            case '/': scratch += '/';   break;
+            case '\\':scratch += '\\';  break;
+            case '"': scratch += '"';   break;
+            case 'u': {
+                unsigned code;
+                if (!unicode(p, e, code)) return false;
+                // Surrogate pair
+                unsigned low;
+                if (code >= 0xd800 && code < 0xdc00 && e - p >= 6
+                    && p[0] == '\\' && p[1] == 'u') {
+                    const char * p2 = p + 2;
+                    if (!unicode(p2, e, low)) return false;
+                    if (low >= 0xdc00 && low < 0xe000) {
+                        code = 0x10000 + ((code - 0xd800) << 10)
+                            + (low - 0xdc00);
+                        p = p2;
+                    }
+                }
+                appendUtf8(scratch, code);
+                break;
+            }
+            default:
+                return error(p - 1 - buf, "invalid escaped char");
+            }
+        }
+
+        str = scratch.c_str();
+        length = scratch.size();
+        return true;
+    }
+
+    bool unicode(const char * & p, const char * e, unsigned & result)
+    {
+        if (e - p < 4) return error(p - buf, "expected four hex digits");
+        result = 0;
+        for (unsigned i = 0;  i < 4;  ++i) {
+            int d = hexDigit(*p++);
+            if (d < 0) return error(p - 1 - buf, "expected four hex digits");
+            result = result * 16 + d;
+        }
+        return true;
+    }
+
+    bool literal(uint32_t offset, const char * text, size_t length,
+                 const char * message)
+    {
+        const char * p = buf + offset;
+        if ((size_t)(index.end - p) < length || memcmp(p, text, length) != 0
+            || (p + length != index.end && !isDelimiter(p[length])))
+            return error(offset, message);
+        return true;
+    }
+
+    bool number(uint32_t offset)
+    {
+        const char * p = buf + offset;
+        JsonNumber result;
+        if (!parseJsonNumber(p, index.end, result)
+            || (p != index.end && !isDelimiter(*p)))
+            return error(offset, "expected number");
+        handler.onNumber(result);
+        return true;
+    }
+};
+
+} // file scope
+
+
+/*****************************************************************************/
+/* JSON STRUCTURAL INDEX                                                     */
+/*****************************************************************************/
+
+JsonStructuralIndex::
+JsonStructuralIndex()
+    : start(0), end(0), filename("<json>"), fileStart(0),
+      size_(0), capacity_(0)
+{
+}
+
+void
+JsonStructuralIndex::
+build(const char * start, const char * end)
+{
+    size_t length = end - start;
+    if (length > UINT_MAX)
+        throw Exception("JsonStructuralIndex: buffer of %zd bytes is too "
+                        "large to index", length);
+
+    // There can't be more positions than characters
+    if (length > capacity_) {
+        positions_.reset(new uint32_t[length]);
+        capacity_ = length;
+    }
+
+    this->start = start;
+    this->end = end;
+    this->fileStart = start;
+    size_ = index_buffer(start, end, positions_.get());
+}
+
+bool
+JsonStructuralIndex::
+fail(Parse_Status & status, size_t offset, const char * message) const
+{
+    const char * p = start + offset;
+    size_t line = 1 + count_char(fileStart, p, '\n');
+    const char * lineStart = p;
+    while (lineStart != fileStart && lineStart[-1] != '\n')
+        --lineStart;
+    size_t col = p - lineStart + 1;
+
+    return status.fail(message, &filename, p - fileStart, line, col);
+}
+
+void
+JsonStructuralIndex::
+exception(size_t offset, const std::string & message) const
+{
+    Parse_Status status;
+    fail(status, offset, "");
+    throw Exception(status.message() + message);
+}
+
+const char *
+JsonStructuralIndex::
+implementation()
+{
+#if JML_INTEL_ISA
+    return has_avx2() ? "avx2" : "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+void walkJson(const JsonStructuralIndex & index, JsonSaxHandler & handler)
+{
+    Walker<JsonSaxHandler> walker(index, handler, 0);
+    while (walker.pos != walker.posEnd)
+        if (!walker.value())
+            index.exception(walker.errorOffset, walker.errorMessage);
+}
+
+
+/*****************************************************************************/
+/* JSON DOCUMENT                                                             */
+/*****************************************************************************/
+
+/** Turns the events from the walker into nodes.  The walker is instantiated
+    directly on this, so there are no virtual calls. */
+struct JsonDocument::Builder {
+    Builder(JsonDocument & doc, const JsonStructuralIndex & index)
+        : doc(doc), nodes(doc.nodes), open(doc.open_), index(index)
+    {
+    }
+
+    JsonDocument & doc;
+    std::vector<Node> & nodes;
+    std::vector<uint32_t> & open;
+    const JsonStructuralIndex & index;
+
+    Node & add(JsonValue::Type type, bool counts = true)
+    {
+        if (counts && !open.empty()
+            && nodes[open.back()].type == JsonValue::ARRAY)
+            ++nodes[open.back()].length;
+        nodes.emplace_back();
+        Node & node = nodes.back();
+        node.type = type;
+        node.escaped = false;
+        node.length = 0;
+        node.next = nodes.size();
+        return node;
+    }
+
+    void addString(const char * str, size_t length, bool counts)
+    {
+        Node & node = add(JsonValue::STRING, counts);
+        node.length = length;
+        if (str >= index.start && str < index.end)
+            node.str = str;
+        else {
+            node.escaped = true;
+            node.offset = doc.strings.size();
+            doc.strings.append(str, length);
+        }
+    }
+
+    void onNull() { add(JsonValue::NULL_VALUE); }
+    void onBool(bool value) { add(JsonValue::BOOLEAN).b = value; }
+    void onNumber(const JsonNumber & value) { add(JsonValue::NUMBER).num = value; }
+    void onString(const char * str, size_t length)
+    {
+        addString(str, length, true);
+    }
+    void onKey(const char * str, size_t length)
+    {
+        ++nodes[open.back()].length;
+        addString(str, length, false);
+    }
+    void onStartObject()
+    {
+        add(JsonValue::OBJECT);
+        open.push_back(nodes.size() - 1);
+    }
+    void onStartArray()
+    {
+        add(JsonValue::ARRAY);
+        open.push_back(nodes.size() - 1);
+    }
+    void onEndObject()
+    {
+        nodes[open.back()].next = nodes.size();
+        open.pop_back();
+    }
+    void onEndArray()
+    {
+        onEndObject();
+    }
+};
+
+size_t
+JsonDocument::
+parse(const JsonStructuralIndex & index, size_t i)
+{
+    Parse_Status status;
+    if (!parse(index, i, status))
+        throw Exception(status.message());
+    return i;
+}
+
+bool
+JsonDocument::
+parse(const JsonStructuralIndex & index, size_t & i, Parse_Status & status)
+{
+    clear();
+    Builder builder(*this, index);
+    Walker<Builder> walker(index, builder, i);
+    if (!walker.value()) {
+        // Don't leave a half built document
+        clear();
+        return index.fail(status, walker.errorOffset, walker.errorMessage);
+    }
+    i = walker.pos - index.positions();
+    return true;
+}
+
+void
+JsonDocument::
+parse(const char * start, const char * end, const std::string & filename)
+{
+    Parse_Status status;
+    if (!parse(start, end, status, filename))
+        throw Exception(status.message());
+}
+
+bool
+JsonDocument::
+parse(const char * start, const char * end, Parse_Status & status,
+      const std::string & filename)
+{
+    index_.filename = filename;
+    index_.build(start, end);
+    size_t i = 0;
+    if (!parse(index_, i, status)) return false;
+    if (i != index_.size()) {
+        clear();
+        return index_.fail(status, index_[i], "expected end of JSON");
+    }
+    return true;
+}
+
+void
+JsonDocument::
+clear()
+{
+    nodes.clear();
+    strings.clear();
+    open_.clear();
+}
+
+
+/*****************************************************************************/
+/* JSON VALUE                                                                */
+/*****************************************************************************/
+
+namespace {
+
+const char * typeName(JsonValue::Type type)
+{
+    switch (type) {
+    case JsonValue::NULL_VALUE: return "null";
+    case JsonValue::BOOLEAN:    return "boolean";
+    case JsonValue::NUMBER:     return "number";
+    case JsonValue::STRING:     return "string";
+    case JsonValue::ARRAY:      return "array";
+    case JsonValue::OBJECT:     return "object";
+    default:                    return "unknown";
+    }
+}
+
+const JsonDocument::Node &
+getNode(const JsonDocument * doc, uint32_t index, JsonValue::Type type)
+{
+    const JsonDocument::Node & node = doc->nodes.at(index);
+    if (node.type != type)
+        throw Exception("JSON value is %s, not %s",
+                        typeName((JsonValue::Type)node.type),
+                        typeName(type));
+    return node;
+}
+
+} // file scope
+
+JsonValue::Type
+JsonValue::
+type() const
+{
+    return (Type)doc->nodes.at(index).type;
+}
+
+bool
+JsonValue::
+asBool() const
+{
+    return getNode(doc, index, BOOLEAN).b;
+}
+
+JsonNumber
+JsonValue::
+asNumber() const
+{
+    return getNode(doc, index, NUMBER).num;
+}
+
+double
+JsonValue::
+asDouble() const
+{
+    JsonNumber num = asNumber();
+    switch (num.type) {
+    case JsonNumber::UNSIGNED_INT:   return num.uns;
+    case JsonNumber::SIGNED_INT:     return num.sgn;
+    case JsonNumber::FLOATING_POINT: return num.fp;
+    default: throw Exception("logic error in JsonValue::asDouble");
+    }
+}
+
+long long
+JsonValue::
+asInt() const
+{
+    JsonNumber num = asNumber();
+    switch (num.type) {
+    case JsonNumber::UNSIGNED_INT:
+        if (num.uns > (unsigned long long)LLONG_MAX)
+            throw Exception("JSON number %llu is too large for an int",
+                            num.uns);
+        return num.uns;
+    case JsonNumber::SIGNED_INT:     return num.sgn;
+    default: throw Exception("JSON number is not an integer");
+    }
+}
+
+unsigned long long
+JsonValue::
+asUInt() const
+{
+    JsonNumber num = asNumber();
+    if (num.type == JsonNumber::UNSIGNED_INT)
+        return num.uns;
+    if (num.type == JsonNumber::SIGNED_INT && num.sgn >= 0)
+        return num.sgn;
+    throw Exception("JSON number is not an unsigned integer");
+}
+
+std::string
+JsonValue::
+asString() const
+{
+    return std::string(stringData(), stringLength());
+}
+
+const char *
+JsonValue::
+stringData() const
+{
+    const JsonDocument::Node & node = getNode(doc, index, STRING);
+    return node.escaped ? doc->strings.data() + node.offset : node.str;
+}
+
+size_t
+JsonValue::
+stringLength() const
+{
+    return getNode(doc, index, STRING).length;
+}
+
+bool
+JsonValue::
+stringEquals(const char * str, size_t length) const
+{
+    return stringLength() == length
+        && memcmp(stringData(), str, length) == 0;
+}
+
+size_t
+JsonValue::
+size() const
+{
+    const JsonDocument::Node & node = doc->nodes.at(index);
+    if (node.type != ARRAY && node.type != OBJECT)
+        throw Exception("JSON value of type %s has no size",
+                        typeName((Type)node.type));
+    return node.length;
+}
+
+JsonValue
+JsonValue::
+operator [] (size_t i) const
+{
+    const JsonDocument::Node & node = getNode(doc, index, ARRAY);
+    if (i >= node.length)
+        throw Exception("JSON array index %zd out of range for size %d",
+                        i, (int)node.length);
+    uint32_t e = index + 1;
+    for (;  i > 0;  --i)
+        e = doc->nodes[e].next;
+    return JsonValue(doc, e);
+}
+
+bool
+JsonValue::
+find(const char * key, size_t length, JsonValue & result) const
+{
+    const JsonDocument::Node & node = getNode(doc, index, OBJECT);
+    uint32_t k = index + 1;
+    for (unsigned i = 0;  i < node.length;  ++i) {
+        JsonValue keyValue(doc, k);
+        if (keyValue.stringEquals(key, length)) {
+            result = JsonValue(doc, k + 1);
+            return true;
+        }
+        k = doc->nodes[k + 1].next;
+    }
+    return false;
+}
+
+bool
+JsonValue::
+has(const std::string & key) const
+{
+    JsonValue result;
+    return find(key.c_str(), key.size(), result);
+}
+
+JsonValue
+JsonValue::
+operator [] (const std::string & key) const
+{
+    JsonValue result;
+    if (!find(key.c_str(), key.size(), result))
+        throw Exception("JSON object has no member '" + key + "'");
+    return result;
+}
+
+JsonValue
+JsonValue::
+operator [] (const char * key) const
+{
+    return operator [] (std::string(key));
+}
+
+JsonValue
+JsonValue::const_iterator::
+operator * () const
+{
+    return JsonValue(doc, object ? index + 1 : index);
+}
+
+JsonValue::const_iterator &
+JsonValue::const_iterator::
+operator ++ ()
+{
+    index = doc->nodes[object ? index + 1 : index].next;
+    return *this;
+}
+
+JsonValue
+JsonValue::const_iterator::
+key() const
+{
+    return JsonValue(doc, index);
+}
+
+JsonValue::const_iterator
+JsonValue::
+begin() const
+{
+    Type t = type();
+    if (t != ARRAY && t != OBJECT)
+        throw Exception("can't iterate over JSON %s", typeName(t));
+    return const_iterator(doc, index + 1, t == OBJECT);
+}
+
+JsonValue::const_iterator
+JsonValue::
+end() const
+{
+    return const_iterator(doc, doc->nodes.at(index).next, type() == OBJECT);
+}
+
+namespace {
+
+void appendJsonString(std::string & out, const char * str, size_t length)
+{
+    out += '"';
+    for (const char * p = str, * e = str + length;  p != e;  ++p) {
+        unsigned char c = *p;
+        switch (c) {
+        case '"':  out += "\\\"";  break;
+        case '\\': out += "\\\\";  break;
+        case '\n': out += "\\n";  break;
+        case '\r': out += "\\r";  break;
+        case '\t': out += "\\t";  break;
+        case '\f': out += "\\f";  break;
+        case '\b': out += "\\b";  break;
+        default:
+            if (c < ' ') out += format("\\u%04x", c);
+            else out += c;
+        }
+    }
+    out += '"';
+}
+
+void appendJson(std::string & out, const JsonValue & value)
+{
+    switch (value.type()) {
+    case JsonValue::NULL_VALUE:  out += "null";  break;
+    case JsonValue::BOOLEAN:  out += value.asBool() ? "true" : "false";  break;
+    case JsonValue::NUMBER: {
+        JsonNumber num = value.asNumber();
+        switch (num.type) {
+        case JsonNumber::UNSIGNED_INT:  out += format("%llu", num.uns);  break;
+        case JsonNumber::SIGNED_INT:  out += format("%lld", num.sgn);  break;
+        default:  out += format("%.17g", num.fp);
+        }
+        break;
+    }
+    case JsonValue::STRING:
+        appendJsonString(out, value.stringData(), value.stringLength());
+        break;
+    case JsonValue::ARRAY: {
+        out += '[';
+        bool first = true;
+        for (auto v: value) {
+            if (!first) out += ',';
+            first = false;
+            appendJson(out, v);
+        }
+        out += ']';
+        break;
+    }
+    case JsonValue::OBJECT: {
+        out += '{';
+        bool first = true;
+        for (auto it = value.begin(), end = value.end();  it != end;  ++it) {
+            if (!first) out += ',';
+            first = false;
+            JsonValue key = it.key();
+            appendJsonString(out, key.stringData(), key.stringLength());
+            out += ':';
+            appendJson(out, *it);
+        }
+        out += '}';
+        break;
+    }
+    }
+}
+
+} // file scope
+
+std::string
+JsonValue::
+toString() const
+{
+    std::string result;
+    appendJson(result, *this);
+    return result;
+}
+
+
+/*****************************************************************************/
+/* JSON LINES                                                                */
+/*****************************************************************************/
+
+namespace {
+
+/** Parse the lines, calling onError (if there is one) for each bad line
+    and carrying on from the next, or throwing if there isn't one.  Line
+    numbers are only counted up to the start of the batch when there is
+    an error to report, so that good files never pay for them. */
+void parseJsonLinesImpl(const char * start, const char * end,
+                        const std::function<void (const JsonValue &)> & onValue,
+                        const std::function<void (const Parse_Status &)> * onError,
+                        const std::string & filename)
+{
+    enum { BATCH_SIZE = 1 << 20 };
+
+    JsonStructuralIndex index;
+    index.filename = filename;
+    JsonDocument doc;
+    Parse_Status status;
+
+    // Newlines before linesCounted
+    const char * linesCounted = start;
+    size_t lines = 0;
+
+    for (const char * p = start;  p != end;) {
+        // Index whole lines, about a batch at a time
+        const char * e = end;
+        if (end - p > BATCH_SIZE) {
+            e = (const char *)memchr(p + BATCH_SIZE, '\n',
+                                     end - p - BATCH_SIZE);
+            e = e ? e + 1 : end;
+        }
+
+        index.build(p, e);
+
+        for (size_t i = 0;  i != index.size();) {
+            size_t recordStart = index[i];
+            if (JML_LIKELY(doc.parse(index, i, status))) {
+                onValue(doc.root());
+                continue;
+            }
+
+            // The position in the status is within the batch
+            lines += count_char(linesCounted, p, '\n');
+            linesCounted = p;
+            status.line += lines;
+            status.offset += p - start;
+
+            if (!onError) throw Exception(status.message());
+            (*onError)(status);
+
+            // Skip to the line after the one the bad value started on
+            const char * nl
+                = (const char *)memchr(index.start + recordStart, '\n',
+                                       index.end - index.start - recordStart);
+            if (!nl) break;
+            uint32_t next = nl + 1 - index.start;
+
+            const uint32_t * pos = index.positions();
+            const uint32_t * found
+                = std::lower_bound(pos + i, pos + index.size(), next);
+
+            // An odd number of quotes means that the index thinks that
+            // the newline is within a string, and so is wrong about
+            // everything after it.  Index the rest of the batch again.
+            size_t quotes = 0;
+            for (const uint32_t * q = pos + i;  q != found;  ++q)
+                quotes += index.start[*q] == '"';
+
+            if (quotes % 2 == 0) {
+                i = found - pos;
+                continue;
+            }
+
+            index.build(nl + 1, e);
+            index.fileStart = p;
+            i = 0;
+        }
+
+        p = e;
+    }
+}
+
+} // file scope
+
+void parseJsonLines(const char * start, const char * end,
+                    const std::function<void (const JsonValue &)> & onValue,
+                    const std::string & filename)
+{
+    parseJsonLinesImpl(start, end, onValue, 0, filename);
+}
+
+void parseJsonLines(const char * start, const char * end,
+                    const std::function<void (const JsonValue &)> & onValue,
+                    const std::function<void (const Parse_Status &)> & onError,
+                    const std::string & filename)
+{
+    parseJsonLinesImpl(start, end, onValue, &onError, filename);
+}
+
+void parseJsonLines(const File_Read_Buffer & buffer,
+                    const std::function<void (const JsonValue &)> & onValue)
+{
+    parseJsonLines(buffer.start(), buffer.end(), onValue, buffer.filename());
+}
+
+} // namespace ML
@@ -0,0 +1,302 @@
+/* json_index.h                                                    -*- C++ -*-
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Two stage JSON parsing: a vectorized pass that finds the structure of a
+   whole buffer, and a walk over that structure that produces SAX events
+   or a document.
+*/
+
+#ifndef __utils__json_index_h__
+#define __utils__json_index_h__
+
+#include "json_parsing.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+namespace ML {
+
+class File_Read_Buffer;
+
+
+/*****************************************************************************/
+/* JSON STRUCTURAL INDEX                                                     */
+/*****************************************************************************/
+
+/** Stage one of parsing: the offset of every character in a buffer of JSON
+    that the parser needs to stop at.  These are the braces, brackets,
+    colons and commas outside of strings, the quotes that start and end
+    each string, and the first character of each number, true, false and
+    null.
+
+    The buffer is classified 64 characters at a time with SSE2 (or AVX2,
+    where available), and escapes and strings are resolved with bit
+    operations on the masks, so there is no per-character branching.  The
+    second stage then only has to look at the characters in the index.
+
+    The positions are 32 bits, so a single index covers up to 4GB.
+*/
+
+struct JsonStructuralIndex {
+    JsonStructuralIndex();
+
+    /** Index the JSON in [start, end).  The memory is reused from the last
+        call. */
+    void build(const char * start, const char * end);
+
+    const char * start;
+    const char * end;
+
+    /** Used for error messages.  Line numbers are counted from fileStart,
+        which is the start of the buffer unless it was set after build()
+        (for when only part of a file is indexed). */
+    std::string filename;
+    const char * fileStart;
+
+    /** Offsets into the buffer of the characters that were found. */
+    const uint32_t * positions() const { return positions_.get(); }
+    size_t size() const { return size_; }
+    uint32_t operator [] (size_t i) const { return positions_[i]; }
+
+    /** Throw an exception with the file, line and column of the given
+        offset into the buffer. */
+    void exception(size_t offset, const std::string & message) const
+        JML_NORETURN;
+
+    /** Record the same thing in status instead, and return false.  The
+        message must be a static string. */
+    bool fail(Parse_Status & status, size_t offset,
+              const char * message) const;
+
+    /** Name of the implementation in use: "avx2" or "sse2". */
+    static const char * implementation();
+
+private:
+    std::unique_ptr<uint32_t[]> positions_;
+    size_t size_;
+    size_t capacity_;
+};
+
+
+/*****************************************************************************/
+/* JSON SAX HANDLER                                                          */
+/*****************************************************************************/
+
+/** Receives the events from walking a structural index.  Strings and keys
+    are passed unescaped; they point into the buffer when they had no
+    escapes, and to a scratch buffer otherwise, and so are only valid for
+    the duration of the call.
+*/
+
+struct JsonSaxHandler {
+    virtual ~JsonSaxHandler() {}
+
+    virtual void onNull() = 0;
+    virtual void onBool(bool value) = 0;
+    virtual void onNumber(const JsonNumber & value) = 0;
+    virtual void onString(const char * str, size_t length) = 0;
+    virtual void onStartObject() = 0;
+    virtual void onKey(const char * str, size_t length) = 0;
+    virtual void onEndObject() = 0;
+    virtual void onStartArray() = 0;
+    virtual void onEndArray() = 0;
+};
+
+/** Stage two: walk the values in the index, calling the handler for each
+    part of them.  There can be several top level values separated by
+    whitespace, as in a file of JSON lines.  Errors are thrown as an
+    exception with the file, line and column.
+*/
+void walkJson(const JsonStructuralIndex & index, JsonSaxHandler & handler);
+
+
+/*****************************************************************************/
+/* JSON DOCUMENT                                                             */
+/*****************************************************************************/
+
+struct JsonDocument;
+
+/** A read-only reference to a value within a JsonDocument.  It's only valid
+    as long as the document (and, for strings, the buffer) is.
+*/
+
+struct JsonValue {
+    enum Type {
+        NULL_VALUE,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    JsonValue()
+        : doc(0), index(0)
+    {
+    }
+
+    JsonValue(const JsonDocument * doc, uint32_t index)
+        : doc(doc), index(index)
+    {
+    }
+
+    Type type() const;
+    bool isNull() const { return type() == NULL_VALUE; }
+    bool isNumber() const { return type() == NUMBER; }
+    bool isString() const { return type() == STRING; }
+    bool isArray() const { return type() == ARRAY; }
+    bool isObject() const { return type() == OBJECT; }
+
+    /** These throw if the value isn't of the right type. */
+    bool asBool() const;
+    JsonNumber asNumber() const;
+    double asDouble() const;
+    long long asInt() const;
+    unsigned long long asUInt() const;
+    std::string asString() const;
+
+    /** The characters of a string, without copying them. */
+    const char * stringData() const;
+    size_t stringLength() const;
+    bool stringEquals(const char * str, size_t length) const;
+
+    /** Number of elements of an array or members of an object. */
+    size_t size() const;
+
+    /** Element of an array (linear in i). */
+    JsonValue operator [] (size_t i) const;
+    JsonValue operator [] (int i) const { return operator [] ((size_t)i); }
+
+    /** Member of an object with the given key; throws if there is none. */
+    JsonValue operator [] (const std::string & key) const;
+    JsonValue operator [] (const char * key) const;
+
+    /** Look for a member of an object. */
+    bool find(const char * key, size_t length, JsonValue & result) const;
+    bool has(const std::string & key) const;
+
+    /** Iterates over the elements of an array or the members of an
+        object.  For objects, key() is the member's key. */
+    struct const_iterator {
+        const_iterator(const JsonDocument * doc, uint32_t index, bool object)
+            : doc(doc), index(index), object(object)
+        {
+        }
+
+        JsonValue operator * () const;
+        const_iterator & operator ++ ();
+        bool operator == (const const_iterator & other) const
+        {
+            return index == other.index;
+        }
+        bool operator != (const const_iterator & other) const
+        {
+            return index != other.index;
+        }
+
+        JsonValue key() const;
+
+    private:
+        const JsonDocument * doc;
+        uint32_t index;     ///< For objects, the index of the key
+        bool object;
+    };
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    /** Convert back to (compact) JSON text. */
+    std::string toString() const;
+
+private:
+    friend struct JsonDocument;
+    const JsonDocument * doc;
+    uint32_t index;
+};
+
+/** The values of a JSON document, laid out in document order in a single
+    array of nodes.  Each array and object records where its contents end
+    so that it can be skipped over in one step.  Strings without escapes
+    point into the parsed buffer; the others are unescaped into the
+    document.  The storage is reused from one document to the next, so
+    parsing line after line into the same document doesn't allocate.
+*/
+
+struct JsonDocument {
+    /** Parse the value that starts at position i of the index, and return
+        the position of the next one. */
+    size_t parse(const JsonStructuralIndex & index, size_t i = 0);
+
+    /** Same, but an error is recorded in status (and false returned)
+        rather than thrown.  On success i is set to the position of the
+        next value.  On failure the document is empty. */
+    bool parse(const JsonStructuralIndex & index, size_t & i,
+               Parse_Status & status);
+
+    /** Parse a whole buffer, which must contain a single value. */
+    void parse(const char * start, const char * end,
+               const std::string & filename = "<json>");
+
+    /** Same, without throwing.  The filename in the status belongs to the
+        document. */
+    bool parse(const char * start, const char * end, Parse_Status & status,
+               const std::string & filename = "<json>");
+
+    JsonValue root() const { return JsonValue(this, 0); }
+
+    void clear();
+
+    struct Node {
+        uint8_t type;
+        uint8_t escaped;        ///< String is in strings, not the buffer
+        uint32_t length;        ///< Elements, members or string length
+        uint32_t next;          ///< Node after this one and its contents
+        union {
+            bool b;
+            const char * str;
+            size_t offset;      ///< Into strings if escaped
+            JsonNumber num;
+        };
+    };
+
+    std::vector<Node> nodes;
+    std::string strings;
+
+private:
+    struct Builder;
+    JsonStructuralIndex index_;
+    std::vector<uint32_t> open_;    ///< Arrays and objects being parsed
+};
+
+/** Parse each of the values in a buffer of JSON lines (or, more generally,
+    of JSON values separated by whitespace), calling onValue for each one.
+    The buffer is indexed a megabyte or so at a time, so that the index
+    stays in cache; since batches end at a newline, values can't contain
+    newlines outside of their strings.  The value is only valid for the
+    duration of the call.
+*/
+void parseJsonLines(const char * start, const char * end,
+                    const std::function<void (const JsonValue &)> & onValue,
+                    const std::string & filename = "<json>");
+
+/** Same, except that instead of throwing on the first bad line, onError is
+    called with where and what the error was and parsing carries on from
+    the line after the one that the bad value started on.  The error isn't
+    formatted unless Parse_Status::message() is called, and the status is
+    only valid for the duration of the call.
+*/
+void parseJsonLines(const char * start, const char * end,
+                    const std::function<void (const JsonValue &)> & onValue,
+                    const std::function<void (const Parse_Status &)> & onError,
+                    const std::string & filename = "<json>");
+
+void parseJsonLines(const File_Read_Buffer & buffer,
+                    const std::function<void (const JsonValue &)> & onValue);
+
+} // namespace ML
+
+#endif /* __utils__json_index_h__ */
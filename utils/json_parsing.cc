@@ -6,6 +6,8 @@
 */
 
 #include "json_parsing.h"
+#include "find_first_of.h"
+#include "decimal_to_binary.h"
 #include "jml/arch/format.h"
 
 
@@ -101,8 +103,20 @@ bool matchJsonString(Parse_Context & context, std::string & str)
 
     std::string result;
 
+    static const Find_First_Of special("\"\\");
+
     while (!context.match_literal('"')) {
         if (context.eof()) return false;
+
+        // Copy runs of plain characters straight out of the buffer
+        const char * p = context.chunk_pos();
+        const char * e = special(p, p + context.chunk_available());
+        if (e != p) {
+            result.append(p, e);
+            context.skip_in_chunk(e - p);
+            continue;
+        }
+
         int c = *context++;
         //if (c < 0 || c >= 127)
         //    context.exception("invalid JSON string character");
@@ -139,6 +153,95 @@ bool matchJsonString(Parse_Context & context, std::string & str)
     return true;
 }
 
+void appendUtf8(std::string & str, unsigned code)
+{
+    if (code < 0x80)
+        str += (char)code;
+    else if (code < 0x800) {
+        str += (char)(0xc0 | (code >> 6));
+        str += (char)(0x80 | (code & 0x3f));
+    }
+    else if (code < 0x10000) {
+        str += (char)(0xe0 | (code >> 12));
+        str += (char)(0x80 | ((code >> 6) & 0x3f));
+        str += (char)(0x80 | (code & 0x3f));
+    }
+    else {
+        str += (char)(0xf0 | (code >> 18));
+        str += (char)(0x80 | ((code >> 12) & 0x3f));
+        str += (char)(0x80 | ((code >> 6) & 0x3f));
+        str += (char)(0x80 | (code & 0x3f));
+    }
+}
+
+static unsigned expectHex4(Parse_Context & context)
+{
+    unsigned result = 0;
+    for (unsigned i = 0;  i < 4;  ++i) {
+        char c = context ? *context : 0;
+        int d;
+        if (c >= '0' && c <= '9') d = c - '0';
+        else if (c >= 'a' && c <= 'f') d = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') d = c - 'A' + 10;
+        else context.exception("expected four hex digits");
+        result = result * 16 + d;
+        ++context;
+    }
+    return result;
+}
+
+JsonKey expectJsonKeySlow(Parse_Context & context, std::string & storage)
+{
+    skipJsonWhitespace(context);
+    context.expect_literal('"');
+
+    storage.clear();
+
+    static const Find_First_Of special("\"\\");
+
+    while (!context.match_literal('"')) {
+        if (context.eof())
+            context.exception("unterminated JSON key");
+
+        const char * p = context.chunk_pos();
+        const char * e = special(p, p + context.chunk_available());
+        if (e != p) {
+            storage.append(p, e);
+            context.skip_in_chunk(e - p);
+            continue;
+        }
+
+        ++context;  // backslash
+        char c = context ? *context++ : 0;
+        switch (c) {
+        case 't': storage += '\t';  break;
+        case 'n': storage += '\n';  break;
+        case 'r': storage += '\r';  break;
+        case 'f': storage += '\f';  break;
+        case 'b': storage += '\b';  break;
+        case '/': storage += '/';   break;
+        case '\\':storage += '\\';  break;
+        case '"': storage += '"';   break;
+        case 'u': {
+            unsigned code = expectHex4(context);
+            if (code >= 0xd800 && code < 0xdc00
+                && context.match_literal("\\u")) {
+                unsigned low = expectHex4(context);
+                if (low < 0xdc00 || low >= 0xe000)
+                    context.exception("invalid UTF-16 surrogate pair");
+                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+            }
+            appendUtf8(storage, code);
+            break;
+        }
+        default:
+            context.exception("invalid escaped char");
+        }
+    }
+
+    return JsonKey(storage.c_str(), storage.size());
+}
+
 std::string expectJsonStringAsciiPermissive(Parse_Context & context, char sub)
 {
     skipJsonWhitespace(context);
@@ -446,103 +549,114 @@ matchJsonObject(Parse_Context & context,
     return true;
 }
 
-JsonNumber expectJsonNumber(Parse_Context & context)
+bool parseJsonNumber(const char * & p, const char * e, JsonNumber & result)
 {
-    JsonNumber result;
-
-    std::string number;
-    number.reserve(32);
-
-    bool negative = false;
-    bool doublePrecision = false;
-
-    if (context.match_literal('-')) {
-        number += '-';
-        negative = true;
-    }
+    const char * start = p;
+    bool negative = p != e && *p == '-';
+    const char * q = p + negative;
 
     // EXTENSION: accept NaN and positive or negative infinity
-    if (context.match_literal('N')) {
-        context.expect_literal("aN");
-        result.fp = negative ? -NAN : NAN;
-        result.type = JsonNumber::FLOATING_POINT;
-        return result;
-    }
-    else if (context.match_literal('n')) {
-        context.expect_literal("an");
+    if (q != e && (*q == 'N' || *q == 'n')) {
+        if (e - q < 3 || q[1] != 'a' || q[2] != *q) return false;
         result.fp = negative ? -NAN : NAN;
         result.type = JsonNumber::FLOATING_POINT;
-        return result;
+        p = q + 3;
+        return true;
     }
-    else if (context.match_literal('I') || context.match_literal('i')) {
-        context.expect_literal("nf");
+    else if (q != e && (*q == 'I' || *q == 'i')) {
+        if (e - q < 3 || q[1] != 'n' || q[2] != 'f') return false;
         result.fp = negative ? -INFINITY : INFINITY;
         result.type = JsonNumber::FLOATING_POINT;
-        return result;
+        p = q + 3;
+        return true;
     }
 
-    while (context && isdigit(*context)) {
-        number += *context++;
-    }
+    Decimal_Number number;
+    const char * end = scan_decimal(q, e, number);
+    if (end == q) return false;
 
-    if (context.match_literal('.')) {
-        doublePrecision = true;
-        number += '.';
+    // scan_decimal() stops before an exponent with no digits; here that's
+    // a malformed number rather than a number followed by an 'e'
+    if (end != e && (*end == 'e' || *end == 'E')) return false;
 
-        while (context && isdigit(*context)) {
-            number += *context++;
+    if (number.is_integer && !number.overflow
+        && (!negative || number.integer <= (1ULL << 63))) {
+        if (negative) {
+            result.sgn = (long long)(0 - number.integer);
+            result.type = JsonNumber::SIGNED_INT;
+        }
+        else {
+            result.uns = number.integer;
+            result.type = JsonNumber::UNSIGNED_INT;
         }
     }
+    else {
+        number.negative = negative;
+        if (!decimal_to_double(number, result.fp)) {
+            // Too many digits to be sure of the rounding
+            result.fp = decimal_text_to_double(start, end);
+        }
+        result.type = JsonNumber::FLOATING_POINT;
+    }
 
-    char sci = context ? *context : '\0';
-    if (sci == 'e' || sci == 'E') {
-        doublePrecision = true;
-        number += *context++;
+    p = end;
+    return true;
+}
 
-        char sign = context ? *context : '\0';
-        if (sign == '+' || sign == '-') {
-            number += *context++;
-        }
+namespace {
 
-        while (context && isdigit(*context)) {
-            number += *context++;
-        }
+bool isJsonNumberChar(char c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.'
+        || c == 'e' || c == 'E' || c == 'N' || c == 'n' || c == 'a'
+        || c == 'I' || c == 'i' || c == 'f';
+}
+
+/** Number in a stream that may carry on into the next buffer (including
+    an exponent that was cut off after the 'e').  The characters that could
+    be part of it are copied out first. */
+bool matchJsonNumberSlow(Parse_Context & context, JsonNumber & result)
+{
+    std::string text;
+    {
+        Parse_Context::Revert_Token token(context);
+        while (context && isJsonNumberChar(*context))
+            text += *context++;
     }
 
-    try {
-        JML_TRACE_EXCEPTIONS(false);
-        if (number.empty())
-            context.exception("expected number");
-
-        if (doublePrecision) {
-            char * endptr = 0;
-            errno = 0;
-            result.fp = strtod(number.c_str(), &endptr);
-            if (errno || endptr != number.c_str() + number.length())
-                context.exception(ML::format("failed to convert '%s' to long long",
-                                             number.c_str()));
-            result.type = JsonNumber::FLOATING_POINT;
-        } else if (negative) {
-            char * endptr = 0;
-            errno = 0;
-            result.sgn = strtol(number.c_str(), &endptr, 10);
-            if (errno || endptr != number.c_str() + number.length())
-                context.exception(ML::format("failed to convert '%s' to long long",
-                                             number.c_str()));
-            result.type = JsonNumber::SIGNED_INT;
-        } else {
-            char * endptr = 0;
-            errno = 0;
-            result.uns = strtoull(number.c_str(), &endptr, 10);
-            if (errno || endptr != number.c_str() + number.length())
-                context.exception(ML::format("failed to convert '%s' to unsigned long long",
-                                             number.c_str()));
-            result.type = JsonNumber::UNSIGNED_INT;
-        }
-    } catch (const std::exception & exc) {
-        context.exception("expected number");
+    const char * p = text.c_str();
+    if (!parseJsonNumber(p, p + text.size(), result))
+        return false;
+
+    for (size_t n = p - text.c_str();  n > 0;  --n)
+        ++context;
+    return true;
+}
+
+} // file scope
+
+bool matchJsonNumber(Parse_Context & context, JsonNumber & result)
+{
+    // Fast path: the whole number is in the current buffer
+    const char * start = context.chunk_pos();
+    const char * e = start + context.chunk_available();
+    const char * p = start;
+    if (parseJsonNumber(p, e, result)
+        && (context.in_memory() || (p != e && !isJsonNumberChar(*p)))) {
+        context.skip_in_chunk(p - start);
+        return true;
     }
+    if (context.in_memory())
+        return false;
+
+    return matchJsonNumberSlow(context, result);
+}
 
+JsonNumber expectJsonNumber(Parse_Context & context)
+{
+    JsonNumber result;
+    if (!matchJsonNumber(context, result))
+        context.exception("expected number");
     return result;
 }
 
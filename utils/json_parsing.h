@@ -12,6 +12,9 @@
 
 #include <string>
 #include <functional>
+#include <iostream>
+#include <string.h>
+#include <stdint.h>
 #include "parse_context.h"
 #include <boost/lexical_cast.hpp>
 
@@ -46,6 +49,9 @@ std::string expectJsonStringAsciiPermissive(Parse_Context & context, char c);
 
 bool matchJsonString(Parse_Context & context, std::string & str);
 
+/** Append the UTF-8 encoding of the given code point to str. */
+void appendUtf8(std::string & str, unsigned code);
+
 bool matchJsonNull(Parse_Context & context);
 
 void
@@ -107,6 +113,226 @@ JsonNumber expectJsonNumber(Parse_Context & context);
 /** Match a JSON number. */
 bool matchJsonNumber(Parse_Context & context, JsonNumber & num);
 
+/** Parse a JSON number from [p, e), moving p past it, or return false if
+    there isn't one.  Integers that fit in 64 bits are returned as such;
+    anything else (including larger integers) is converted to the closest
+    double.  Accepts the same extensions as
+    expectJsonNumber() (NaN, Inf and missing digits on one side of the
+    decimal point).  Doesn't allocate, except to fall back to strtod for
+    the rare numbers with more than 19 digits that can't otherwise be
+    rounded correctly.
+*/
+bool parseJsonNumber(const char * & p, const char * e, JsonNumber & result);
+
+
+/*****************************************************************************/
+/* INLINE OBJECT AND ARRAY PARSING                                           */
+/*****************************************************************************/
+
+/* These do the same as expectJsonObject(), matchJsonObject() and
+   expectJsonArray(), but take the callback as a template parameter so that
+   it's inlined, with no std::function to construct for each object and no
+   indirect call for each member.  The keys are passed as a JsonKey, which
+   points straight into the buffer unless the key had escapes in it or the
+   input is being read from a stream.
+*/
+
+inline constexpr uint64_t jsonKeyHashFrom(const char * str, uint64_t hash)
+{
+    return *str
+        ? jsonKeyHashFrom(str + 1, (hash ^ (unsigned char)*str) * 1099511628211ULL)
+        : hash;
+}
+
+/** Hash of a JSON object key (64 bit FNV-1a).  This version can be computed
+    at compile time, so that hot loops can dispatch on keys with a switch:
+
+        switch (key.hash()) {
+        case jsonKeyHash("id"):  ...
+
+    An unknown key could have the same hash as one of the cases, so the
+    case still needs to check key == "id" before relying on it.
+*/
+inline constexpr uint64_t jsonKeyHash(const char * str)
+{
+    return jsonKeyHashFrom(str, 14695981039346656037ULL);
+}
+
+inline uint64_t jsonKeyHash(const char * str, size_t length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0;  i < length;  ++i)
+        hash = (hash ^ (unsigned char)str[i]) * 1099511628211ULL;
+    return hash;
+}
+
+/** An unescaped JSON object key.  It's only valid for the duration of the
+    callback that it's passed to. */
+struct JsonKey {
+    JsonKey(const char * data = 0, size_t length = 0)
+        : data(data), length(length)
+    {
+    }
+
+    const char * data;
+    size_t length;
+
+    size_t size() const { return length; }
+    std::string str() const { return std::string(data, length); }
+    uint64_t hash() const { return jsonKeyHash(data, length); }
+
+    bool operator == (const char * other) const
+    {
+        return strlen(other) == length && memcmp(data, other, length) == 0;
+    }
+
+    bool operator == (const std::string & other) const
+    {
+        return other.size() == length
+            && memcmp(data, other.c_str(), length) == 0;
+    }
+
+    template<typename Other>
+    bool operator != (const Other & other) const
+    {
+        return !operator == (other);
+    }
+};
+
+inline std::ostream & operator << (std::ostream & stream, const JsonKey & key)
+{
+    return stream.write(key.data, key.length);
+}
+
+/** Out of line part of expectJsonKey(), for keys with escapes, keys that
+    cross a buffer boundary and streams.  The key is unescaped into
+    storage. */
+JsonKey expectJsonKeySlow(Parse_Context & context, std::string & storage);
+
+/** Parse an object key (a string).  Unlike expectJsonStringAscii(), the
+    key may contain any characters. */
+inline JsonKey expectJsonKey(Parse_Context & context, std::string & storage)
+{
+    skipJsonWhitespace(context);
+
+    // Keys are short, so a simple loop beats a vectorized search
+    const char * p = context.chunk_pos();
+    const char * e = p + context.chunk_available();
+    if (JML_LIKELY(p != e && *p == '"' && context.in_memory())) {
+        const char * q = p + 1;
+        while (q != e && *q != '"' && *q != '\\')
+            ++q;
+        if (JML_LIKELY(q != e && *q == '"')) {
+            context.skip_in_chunk(q + 1 - p);
+            return JsonKey(p + 1, q - p - 1);
+        }
+    }
+
+    return expectJsonKeySlow(context, storage);
+}
+
+/** expectJsonArray() with onEntry(int index, Parse_Context & context)
+    inlined. */
+template<typename OnEntry>
+void expectJsonArrayInline(Parse_Context & context, OnEntry && onEntry)
+{
+    skipJsonWhitespace(context);
+
+    if (context.match_literal("null"))
+        return;
+
+    context.expect_literal('[');
+    skipJsonWhitespace(context);
+    if (context.match_literal(']')) return;
+
+    for (int i = 0;  ; ++i) {
+        skipJsonWhitespace(context);
+
+        onEntry(i, context);
+
+        skipJsonWhitespace(context);
+
+        if (!context.match_literal(',')) break;
+    }
+
+    skipJsonWhitespace(context);
+    context.expect_literal(']');
+}
+
+/** expectJsonObject() with onEntry(const JsonKey & key,
+    Parse_Context & context) inlined. */
+template<typename OnEntry>
+void expectJsonObjectInline(Parse_Context & context, OnEntry && onEntry)
+{
+    skipJsonWhitespace(context);
+
+    if (context.match_literal("null"))
+        return;
+
+    context.expect_literal('{');
+
+    skipJsonWhitespace(context);
+
+    if (context.match_literal('}')) return;
+
+    std::string storage;
+
+    for (;;) {
+        JsonKey key = expectJsonKey(context, storage);
+
+        skipJsonWhitespace(context);
+
+        context.expect_literal(':');
+
+        skipJsonWhitespace(context);
+
+        onEntry(key, context);
+
+        skipJsonWhitespace(context);
+
+        if (!context.match_literal(',')) break;
+    }
+
+    skipJsonWhitespace(context);
+    context.expect_literal('}');
+}
+
+/** matchJsonObject() with bool onEntry(const JsonKey & key,
+    Parse_Context & context) inlined. */
+template<typename OnEntry>
+bool matchJsonObjectInline(Parse_Context & context, OnEntry && onEntry)
+{
+    skipJsonWhitespace(context);
+
+    if (context.match_literal("null"))
+        return true;
+
+    if (!context.match_literal('{')) return false;
+    skipJsonWhitespace(context);
+    if (context.match_literal('}')) return true;
+
+    std::string storage;
+
+    for (;;) {
+        JsonKey key = expectJsonKey(context, storage);
+
+        skipJsonWhitespace(context);
+        if (!context.match_literal(':')) return false;
+        skipJsonWhitespace(context);
+
+        if (!onEntry(key, context)) return false;
+
+        skipJsonWhitespace(context);
+
+        if (!context.match_literal(',')) break;
+    }
+
+    skipJsonWhitespace(context);
+    if (!context.match_literal('}')) return false;
+
+    return true;
+}
+
 #ifdef CPPTL_JSON_H_INCLUDED
 
 inline Json::Value
@@ -714,8 +714,9 @@ struct PairOps {
         return Hash()(key) % capacity;
     }
 
+    template<class Allocator>
     static size_t hashKey(Key key, int capacity,
-                          const LogMemStorage<Bucket> & storage)
+                          const LogMemStorage<Bucket, Allocator> & storage)
     {
         uint64_t mask = (1ULL << ((storage.bits_ - 1))) - 1;
         return Hash()(key) & mask;
@@ -950,8 +951,9 @@ struct ScalarOps {
         return Hash()(key) % capacity;
     }
 
+    template<class Allocator>
     static size_t hashKey(Key key, int capacity,
-                          const LogMemStorage<Bucket> & storage)
+                          const LogMemStorage<Bucket, Allocator> & storage)
     {
         uint64_t mask = (1ULL << ((storage.bits_ - 1))) - 1;
         return Hash()(key) & mask;
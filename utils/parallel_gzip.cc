@@ -0,0 +1,254 @@
+/* parallel_gzip.cc
+   Jeremy Barnes, 17 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Gzip compression for filter_ostream using all of the cores.
+*/
+
+#include "parallel_gzip.h"
+#include "filter_streams_registry.h"
+#include "worker_task.h"
+#include "jml/arch/exception.h"
+#include <boost/iostreams/concepts.hpp>
+#include <boost/iostreams/operations.hpp>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string.h>
+#include <zlib.h>
+
+
+using namespace std;
+
+
+namespace ML {
+
+namespace {
+
+/*****************************************************************************/
+/* PARALLEL GZIP COMPRESSOR                                                  */
+/*****************************************************************************/
+
+/** Gzip compression on all of the cores, in the same way as pigz.  The
+    input is cut into blocks that are compressed independently as jobs on
+    the Worker_Task, each one primed with the last 32k of the one before
+    as its dictionary so that little compression is lost.  All but the
+    last block end with a sync flush, so that their output can simply be
+    concatenated into the deflate stream of a single gzip member, and
+    their CRCs are combined in order.  Any gzip decompressor can read the
+    result.
+*/
+
+struct parallel_gzip_compressor
+    : public boost::iostreams::multichar_output_filter {
+
+    enum {
+        BLOCK_SIZE = 128 * 1024,   ///< Input per job, as for pigz
+        DICT_SIZE = 32 * 1024      ///< Size of the deflate window
+    };
+
+    parallel_gzip_compressor(int level = -1)
+        : itl(new Itl(level == -1 ? Z_DEFAULT_COMPRESSION : level))
+    {
+    }
+
+    template<typename Sink>
+    std::streamsize write(Sink & sink, const char * s, std::streamsize n)
+    {
+        for (std::streamsize done = 0;  done < n;) {
+            size_t todo = std::min<size_t>(n - done,
+                                           BLOCK_SIZE - itl->input.size());
+            itl->input.append(s + done, todo);
+            done += todo;
+            if (itl->input.size() == BLOCK_SIZE) {
+                itl->submit(false);
+                itl->write_finished(sink, false);
+            }
+        }
+        return n;
+    }
+
+    template<typename Sink>
+    void close(Sink & sink)
+    {
+        itl->submit(true);
+        itl->write_finished(sink, true);
+
+        unsigned char trailer[8];
+        for (unsigned i = 0;  i < 4;  ++i) {
+            trailer[i] = itl->crc >> (i * 8);
+            trailer[i + 4] = itl->length >> (i * 8);
+        }
+        write_all(sink, (const char *)trailer, 8);
+
+        itl.reset(new Itl(itl->level));
+    }
+
+private:
+    struct Block {
+        Block() : crc(0), last(false), group(-1), done(false) {}
+
+        std::string input;
+        std::string dict;          ///< Input that came just before
+        std::string output;        ///< Raw deflate data
+        uint32_t crc;              ///< Of input
+        bool last;                 ///< Finish the deflate stream
+        Worker_Task::Id group;
+        std::atomic<bool> done;
+
+        void compress(int level)
+        {
+            z_stream stream;
+            memset(&stream, 0, sizeof(stream));
+            if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8,
+                             Z_DEFAULT_STRATEGY) != Z_OK)
+                throw Exception("parallel gzip: deflateInit2 failed");
+            Call_Guard guard([&] () { deflateEnd(&stream); });
+
+            if (!dict.empty()
+                && deflateSetDictionary(&stream, (const Bytef *)dict.data(),
+                                        dict.size()) != Z_OK)
+                throw Exception("parallel gzip: deflateSetDictionary failed");
+
+            // A sync flush adds a few bytes over what deflateBound() allows
+            output.resize(deflateBound(&stream, input.size()) + 16);
+            stream.next_in = (Bytef *)input.data();
+            stream.avail_in = input.size();
+            stream.next_out = (Bytef *)&output[0];
+            stream.avail_out = output.size();
+
+            int res = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+            if (res != (last ? Z_STREAM_END : Z_OK) || stream.avail_in)
+                throw Exception("parallel gzip: deflate failed");
+
+            // A sync flush that filled the buffer may not have finished
+            if (!last && stream.avail_out == 0)
+                throw Exception("parallel gzip: deflate output overflowed");
+
+            output.resize(stream.total_out);
+            crc = crc32(0, (const Bytef *)input.data(), input.size());
+            done = true;
+        }
+    };
+
+    struct Itl {
+        Itl(int level)
+            : level(level),
+              worker(Worker_Task::instance(num_threads() - 1)),
+              crc(crc32(0, 0, 0)), length(0), header_written(false)
+        {
+            input.reserve(BLOCK_SIZE);
+        }
+
+        ~Itl()
+        {
+            // Only if the stream wasn't closed; the output is lost
+            for (auto & b: pending) {
+                try {
+                    worker.run_until_finished(b->group, true);
+                } catch (...) {
+                }
+            }
+        }
+
+        int level;
+        Worker_Task & worker;
+        std::string input;             ///< Block being filled
+        std::string dict;              ///< End of the input so far
+        std::deque<std::shared_ptr<Block> > pending;  ///< Not yet written
+        uint32_t crc;                  ///< Of the blocks written so far
+        uint64_t length;               ///< Of the blocks written so far
+        bool header_written;
+
+        /** Start compressing the current block. */
+        void submit(bool last)
+        {
+            auto block = std::make_shared<Block>();
+            block->input.swap(input);
+            block->dict = dict;
+            block->last = last;
+
+            if (block->input.size() >= DICT_SIZE)
+                dict.assign(block->input.end() - DICT_SIZE,
+                            block->input.end());
+            else {
+                dict += block->input;
+                if (dict.size() > DICT_SIZE)
+                    dict.erase(0, dict.size() - DICT_SIZE);
+            }
+            input.reserve(BLOCK_SIZE);
+
+            int level = this->level;
+            block->group = worker.get_group(NO_JOB, "parallel gzip");
+            worker.add([=] () { block->compress(level); },
+                       "parallel gzip block", block->group);
+            pending.push_back(block);
+        }
+
+        /** Write out the blocks at the front that have finished, waiting
+            for them if too many are outstanding (or for all of them if
+            all is set). */
+        template<typename Sink>
+        void write_finished(Sink & sink, bool all)
+        {
+            size_t max_pending = all ? 0 : 2 * (worker.threads() + 1);
+
+            while (!pending.empty()
+                   && (pending.size() > max_pending
+                       || pending.front()->done)) {
+                std::shared_ptr<Block> block = pending.front();
+                pending.pop_front();
+
+                // Helps with the work until this block is done
+                worker.run_until_finished(block->group, true);
+
+                if (!header_written) {
+                    // No file name or time; OS is unix
+                    static const char header[10]
+                        = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3 };
+                    write_all(sink, header, 10);
+                    header_written = true;
+                }
+
+                write_all(sink, block->output.data(), block->output.size());
+                crc = crc32_combine(crc, block->crc, block->input.size());
+                length += block->input.size();
+            }
+        }
+    };
+
+    template<typename Sink>
+    static void write_all(Sink & sink, const char * s, std::streamsize n)
+    {
+        while (n > 0) {
+            std::streamsize written = boost::iostreams::write(sink, s, n);
+            if (written <= 0)
+                throw Exception("parallel gzip: couldn't write output");
+            s += written;
+            n -= written;
+        }
+    }
+
+    std::shared_ptr<Itl> itl;
+};
+
+struct RegisterParallelGzip {
+    RegisterParallelGzip()
+    {
+        registerCompressor("pigz",
+                           [] (boost::iostreams::filtering_ostream & stream,
+                               int level)
+                           {
+                               stream.push(parallel_gzip_compressor(level));
+                           });
+    }
+
+} registerParallelGzipCompressor;
+
+} // file scope
+
+void registerParallelGzip()
+{
+}
+
+} // namespace ML
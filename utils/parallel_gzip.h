@@ -0,0 +1,26 @@
+/* parallel_gzip.h                                                 -*- C++ -*-
+   Jeremy Barnes, 17 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Gzip compression for filter_ostream using all of the cores.
+*/
+
+#ifndef __utils__parallel_gzip_h__
+#define __utils__parallel_gzip_h__
+
+
+namespace ML {
+
+/** Makes the "pigz" compression available to filter_ostream, which writes
+    ordinary gzip files using all of the cores in the manner of pigz.
+
+    This happens when the parallel_utils library is loaded, so calling this
+    does nothing more than make sure that the library is linked in; a
+    program that only mentions "pigz" as a string to filter_ostream should
+    call it once before opening its streams.
+*/
+void registerParallelGzip();
+
+} // namespace ML
+
+#endif /* __utils__parallel_gzip_h__ */
@@ -0,0 +1,327 @@
+/* parallel_reader.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Parsing of line and CSV files in parallel chunks.
+*/
+
+#include "parallel_reader.h"
+#include "parse_context.h"
+#include "file_functions.h"
+#include "find_first_of.h"
+#include "worker_task.h"
+#include "csv.h"
+#include <exception>
+#include <mutex>
+#include <string.h>
+#include <stdint.h>
+
+
+using namespace std;
+
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* RECORD CHUNKS                                                             */
+/*****************************************************************************/
+
+std::vector<Record_Chunk>
+split_record_chunks(const char * start, const char * end, int numChunks,
+                    bool csvQuotes)
+{
+    numChunks = std::max(numChunks, 1);
+    size_t size = end - start;
+
+    vector<const char *> splits(numChunks + 1);
+    for (unsigned i = 0;  i <= numChunks;  ++i)
+        splits[i] = start + size * i / numChunks;
+
+    // Count the quotes and newlines between the split points, so that we
+    // know whether each one is inside of a quote, and what line it's on
+    vector<size_t> quotes(numChunks), newlines(numChunks);
+
+    auto countChunk = [&] (int i)
+        {
+            quotes[i] = csvQuotes ? count_char(splits[i], splits[i + 1], '"') : 0;
+            newlines[i] = count_char(splits[i], splits[i + 1], '\n');
+        };
+
+    if (numChunks > 1)
+        run_in_parallel(0, numChunks, countChunk);
+
+    // Move each split point forward to the start of the next record
+    Find_First_Of finder(csvQuotes ? "\n\"" : "\n");
+
+    vector<Record_Chunk> result;
+    const char * chunkStart = start;
+    size_t chunkLine = 1;
+    size_t line = 1;
+    bool inQuote = false;
+
+    for (unsigned i = 1;  i < numChunks;  ++i) {
+        line += newlines[i - 1];
+        inQuote ^= csvQuotes && (quotes[i - 1] & 1);
+
+        // The last record went past this split point
+        if (splits[i] < chunkStart) continue;
+
+        const char * p = splits[i];
+        size_t l = line;
+        bool q = inQuote;
+        while ((p = finder(p, end)) != end) {
+            char c = *p++;
+            if (c == '"') q = !q;
+            else {
+                ++l;
+                if (!q) break;
+            }
+        }
+
+        // A '\r' after a '\n' is part of the line ending
+        if (p != end && *p == '\r' && p[-1] == '\n') ++p;
+
+        if (p == end) break;
+
+        result.push_back(Record_Chunk{ chunkStart, p, chunkLine });
+        chunkStart = p;
+        chunkLine = l;
+    }
+
+    if (chunkStart != end || result.empty())
+        result.push_back(Record_Chunk{ chunkStart, end, chunkLine });
+
+    return result;
+}
+
+namespace {
+
+/** Number of chunks to use: a few per thread to even out the load, and at
+    most 16MB each to bound what's held back for ordered delivery. */
+int default_num_chunks(size_t size)
+{
+    return std::max<size_t>(4 * num_threads(), size / (16 << 20) + 1);
+}
+
+/** Collects the results of the chunks as they finish, and delivers them
+    one at a time in the order of the chunks.  Once a delivery throws,
+    nothing more is delivered, and run() rethrows the exception once the
+    chunks have finished. */
+template<typename Result>
+struct In_Order {
+    In_Order(int numChunks)
+        : results(numChunks), done(numChunks), next(0), delivering(false)
+    {
+    }
+
+    std::vector<Result> results;
+    std::vector<bool> done;
+    int next;
+    bool delivering;
+    std::exception_ptr error;   ///< From the first delivery that threw
+    std::mutex lock;
+
+    /** Has a delivery thrown?  Chunks can skip their work if so. */
+    bool failed()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        return error != nullptr;
+    }
+
+    /** Chunk i's result is ready.  Whichever thread finds that the next
+        chunk is ready delivers it and any that follow it, and any that are
+        finished while it does so. */
+    template<typename Deliver>
+    void finished(int i, const Deliver & deliver)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        done[i] = true;
+        if (delivering || error) return;
+        delivering = true;
+
+        try {
+            while (next < done.size() && done[next]) {
+                int n = next++;
+                guard.unlock();
+                deliver(results[n]);
+                results[n] = Result();
+                guard.lock();
+            }
+        } catch (...) {
+            if (!guard.owns_lock()) guard.lock();
+            error = std::current_exception();
+        }
+
+        delivering = false;
+    }
+
+    /** Run doChunk over the chunks on the worker threads, and then rethrow
+        the exception from the delivery that threw, if any. */
+    template<typename DoChunk>
+    void run(int numChunks, const DoChunk & doChunk)
+    {
+        run_in_parallel(0, numChunks, doChunk);
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+
+/** Rows of a chunk of CSV, held for ordered delivery.  Fields are views
+    into the buffer, except for those that the row had to copy, which are
+    copied again here. */
+struct Csv_Rows {
+    std::vector<Csv_Field> fields;
+    std::vector<size_t> rowEnds;              ///< End of each row in fields
+    std::string copies;
+    std::vector<std::pair<size_t, size_t> > copied;  ///< Field, offset
+
+    void add(const Csv_Row & row, const Record_Chunk & chunk)
+    {
+        for (auto & f: row) {
+            if (f.start >= chunk.start && f.end() <= chunk.end)
+                fields.push_back(f);
+            else {
+                copied.push_back(make_pair(fields.size(), copies.size()));
+                copies.append(f.start, f.length);
+                fields.push_back(Csv_Field(0, f.length));
+            }
+        }
+        rowEnds.push_back(fields.size());
+    }
+
+    void finish()
+    {
+        for (auto & c: copied)
+            fields[c.first].start = copies.data() + c.second;
+    }
+};
+
+} // file scope
+
+void parse_in_parallel(const File_Read_Buffer & buffer,
+                       const std::function<void (Parse_Context &, int)>
+                           & parseChunk,
+                       bool csvQuotes,
+                       int numChunks)
+{
+    if (numChunks == -1)
+        numChunks = default_num_chunks(buffer.size());
+
+    vector<Record_Chunk> chunks
+        = split_record_chunks(buffer.start(), buffer.end(), numChunks,
+                              csvQuotes);
+
+    string filename = buffer.filename();
+
+    auto doChunk = [&] (int i)
+        {
+            Parse_Context context(filename, chunks[i].start, chunks[i].end,
+                                  chunks[i].line, 1);
+            parseChunk(context, i);
+        };
+
+    run_in_parallel(0, chunks.size(), doChunk);
+}
+
+void for_each_line_in_parallel(const File_Read_Buffer & buffer,
+                               const std::function<void (const char * line,
+                                                         size_t length)>
+                                   & onLine,
+                               bool ordered,
+                               int numChunks)
+{
+    if (numChunks == -1)
+        numChunks = default_num_chunks(buffer.size());
+
+    vector<Record_Chunk> chunks
+        = split_record_chunks(buffer.start(), buffer.end(), numChunks);
+
+    typedef vector<pair<const char *, size_t> > Lines;
+    In_Order<Lines> inOrder(ordered ? chunks.size() : 0);
+
+    // The same lines as Parse_Context::match_line(), but without copying
+    auto doChunk = [&] (int i)
+        {
+            if (ordered && inOrder.failed()) return;
+
+            const char * p = chunks[i].start, * e = chunks[i].end;
+            Lines * lines = ordered ? &inOrder.results[i] : 0;
+
+            while (p != e) {
+                const char * nl = (const char *)memchr(p, '\n', e - p);
+                const char * lineEnd = nl ? nl : e;
+                if (lines) lines->push_back(make_pair(p, lineEnd - p));
+                else onLine(p, lineEnd - p);
+                if (!nl) break;
+                p = nl + 1;
+                if (p != e && *p == '\r') ++p;
+            }
+
+            if (ordered)
+                inOrder.finished(i, [&] (const Lines & lines)
+                                 {
+                                     for (auto & l: lines)
+                                         onLine(l.first, l.second);
+                                 });
+        };
+
+    inOrder.run(chunks.size(), doChunk);
+}
+
+void for_each_csv_row_in_parallel(const File_Read_Buffer & buffer,
+                                  const std::function<void (const Csv_Row &)>
+                                      & onRow,
+                                  char separator,
+                                  bool ordered,
+                                  int numChunks)
+{
+    if (numChunks == -1)
+        numChunks = default_num_chunks(buffer.size());
+
+    vector<Record_Chunk> chunks
+        = split_record_chunks(buffer.start(), buffer.end(), numChunks, true);
+
+    In_Order<Csv_Rows> inOrder(ordered ? chunks.size() : 0);
+    string filename = buffer.filename();
+
+    auto doChunk = [&] (int i)
+        {
+            const Record_Chunk & chunk = chunks[i];
+            Parse_Context context(filename, chunk.start, chunk.end,
+                                  chunk.line, 1);
+            Csv_Row row;
+
+            if (!ordered) {
+                while (context) {
+                    expect_csv_row(context, row, -1, separator);
+                    onRow(row);
+                }
+                return;
+            }
+
+            if (inOrder.failed()) return;
+
+            Csv_Rows & rows = inOrder.results[i];
+            while (context) {
+                expect_csv_row(context, row, -1, separator);
+                rows.add(row, chunk);
+            }
+            rows.finish();
+
+            inOrder.finished(i, [&] (const Csv_Rows & rows)
+                             {
+                                 size_t start = 0;
+                                 for (size_t end: rows.rowEnds) {
+                                     row.fields.assign(&rows.fields[0] + start,
+                                                       &rows.fields[0] + end);
+                                     onRow(row);
+                                     start = end;
+                                 }
+                             });
+        };
+
+    inOrder.run(chunks.size(), doChunk);
+}
+
+} // namespace ML
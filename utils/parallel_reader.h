@@ -0,0 +1,90 @@
+/* parallel_reader.h                                               -*- C++ -*-
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Parsing of line and CSV files in parallel chunks.
+*/
+
+#ifndef __utils__parallel_reader_h__
+#define __utils__parallel_reader_h__
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+
+namespace ML {
+
+struct Parse_Context;
+struct Csv_Row;
+class File_Read_Buffer;
+
+
+/*****************************************************************************/
+/* RECORD CHUNKS                                                             */
+/*****************************************************************************/
+
+/** A range of a buffer that starts at the beginning of a record (line or
+    CSV row) and ends at the beginning of another, or at the end. */
+struct Record_Chunk {
+    const char * start;
+    const char * end;
+    size_t line;          ///< Line number of the first character
+};
+
+/** Split [start, end) into up to numChunks chunks of roughly equal size,
+    each starting at the beginning of a record.  If csvQuotes is true,
+    newlines inside of quoted CSV fields don't end a record.
+
+    The quotes and newlines before each split point are counted in parallel
+    first, so the splits are exact (not guesses based on what's near the
+    split point) and the line numbers are right.
+*/
+std::vector<Record_Chunk>
+split_record_chunks(const char * start, const char * end, int numChunks,
+                    bool csvQuotes = false);
+
+/** Parse the buffer in chunks on the worker threads.  parseChunk is called
+    once for each chunk, with a Parse_Context covering only that chunk
+    (which has the right filename and line numbers for error messages) and
+    the number of the chunk.  It's called from several threads at once.
+
+    If numChunks is -1, there are enough chunks to keep the threads busy
+    and none is more than 16MB.  An exception thrown from any chunk is
+    rethrown once the others have finished.
+*/
+void parse_in_parallel(const File_Read_Buffer & buffer,
+                       const std::function<void (Parse_Context &, int)>
+                           & parseChunk,
+                       bool csvQuotes = false,
+                       int numChunks = -1);
+
+/** Call onLine for each line of the buffer, without its line ending,
+    parsing in parallel.  If ordered is false, onLine is called from
+    several threads at once, in no particular order.  If ordered is true,
+    calls are made one at a time and in the order of the file, with the
+    lines of chunks that finish early held until it's their turn; if one
+    of those calls throws, no more lines are delivered and the exception
+    is rethrown once the chunks have finished.
+*/
+void for_each_line_in_parallel(const File_Read_Buffer & buffer,
+                               const std::function<void (const char * line,
+                                                         size_t length)>
+                                   & onLine,
+                               bool ordered = false,
+                               int numChunks = -1);
+
+/** Call onRow for each row of the CSV in the buffer, parsing in parallel.
+    The rows are the same as those that expect_csv_row() returns.  Ordering
+    is as for for_each_line_in_parallel. */
+void for_each_csv_row_in_parallel(const File_Read_Buffer & buffer,
+                                  const std::function<void (const Csv_Row &)>
+                                      & onRow,
+                                  char separator = ',',
+                                  bool ordered = false,
+                                  int numChunks = -1);
+
+} // namespace ML
+
+#endif /* __utils__parallel_reader_h__ */
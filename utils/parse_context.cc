@@ -16,7 +16,12 @@
 #include "fast_float_parsing.h"
 #include "jml/utils/file_functions.h"
 #include <cassert>
-#include <boost/scoped_array.hpp>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <string.h>
 
 
 using namespace std;
@@ -25,6 +30,163 @@ using namespace std;
 namespace ML {
 
 
+/*****************************************************************************/
+/* PARSE_STATUS                                                              */
+/*****************************************************************************/
+
+std::string
+Parse_Status::
+message() const
+{
+    if (!error) return "no error";
+    string result = (filename ? *filename : string("<unknown>"))
+        + format(":%zd:%zd: ", line, col) + error;
+    if (has_character)
+        result += format(": %d %c", (int)character, character);
+    return result;
+}
+
+
+/*****************************************************************************/
+/* PARSE_CONTEXT::READAHEAD                                                  */
+/*****************************************************************************/
+
+/** Reads chunks from the stream in a background thread, staying up to
+    READAHEAD_CHUNKS ahead of the parser.  Chunks are handed over in order,
+    and the memory of those that the parser has finished with comes back
+    to be read into again, so once it's going nothing is allocated or
+    copied.  The thread stops at the end of the stream or when it goes bad;
+    after that the parser goes back to reading synchronously, which takes
+    care of reporting those conditions in the same way as before.
+*/
+
+struct Parse_Context::Readahead {
+    Readahead(std::istream & stream, size_t chunk_size)
+        : stream(stream), chunk_size(chunk_size), running(false),
+          finished(false)
+    {
+    }
+
+    ~Readahead()
+    {
+        stop();
+        for (auto & c: full)
+            delete[] c.first;
+        for (char * c: empty)
+            delete[] c;
+    }
+
+    std::istream & stream;
+    size_t chunk_size;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::pair<char *, size_t> > full;  ///< Read but not handed over
+    std::vector<char *> empty;                    ///< To be read into
+    bool running;            ///< Thread should keep going
+    bool finished;           ///< Thread has stopped by itself
+    std::exception_ptr exc;  ///< Thrown by the stream
+    std::thread thread;
+
+    void start()
+    {
+        stop();
+        running = true;
+        finished = false;
+        thread = std::thread([=] () { this->run(); });
+    }
+
+    void stop()
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            running = false;
+        }
+        changed.notify_all();
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+
+        while (running) {
+            if (full.size() >= READAHEAD_CHUNKS) {
+                changed.wait(guard);
+                continue;
+            }
+
+            if (stream.eof() || stream.bad() || stream.fail())
+                break;
+
+            char * data;
+            if (empty.empty())
+                data = new char[chunk_size];
+            else {
+                data = empty.back();
+                empty.pop_back();
+            }
+
+            guard.unlock();
+            size_t read = 0;
+            try {
+                stream.read(data, chunk_size);
+                read = stream.gcount();
+            } catch (...) {
+                guard.lock();
+                empty.push_back(data);
+                exc = std::current_exception();
+                break;
+            }
+            guard.lock();
+
+            if (read) full.push_back(std::make_pair(data, read));
+            else empty.push_back(data);
+            changed.notify_all();
+        }
+
+        finished = true;
+        changed.notify_all();
+    }
+
+    /** Wait for the next chunk.  Returns false once there are no more
+        because the thread has stopped. */
+    bool next(char * & data, size_t & size)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        while (full.empty() && running && !finished)
+            changed.wait(guard);
+        if (full.empty()) return false;
+        data = full.front().first;
+        size = full.front().second;
+        full.pop_front();
+        changed.notify_all();
+        return true;
+    }
+
+    void recycle(char * data)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        empty.push_back(data);
+    }
+
+    /** Is the thread still reading? */
+    bool active()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        return running && !finished;
+    }
+
+    /** Has the thread stopped, with everything it read handed over? */
+    bool drained()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        return (!running || finished) && full.empty() && !exc;
+    }
+};
+
+
 /*****************************************************************************/
 /* PARSE_CONTEXT                                                             */
 /*****************************************************************************/
@@ -33,7 +195,8 @@ Parse_Context::
 Parse_Context()
     : stream_(0), chunk_size_(0), first_token_(0), last_token_(0),
       cur_(0), ebuf_(0),
-      line_(0), col_(0), ofs_(0)
+      line_(0), col_(0), buf_start_(0), buf_ofs_(0),
+      lazy_lines_(false), line_col_ofs_(0)
 {
 }
 
@@ -42,10 +205,12 @@ Parse_Context(const std::string & filename, const char * start,
               const char * end, unsigned line, unsigned col)
     : stream_(0), chunk_size_(0), first_token_(0), last_token_(0),
       filename_(filename), cur_(start), ebuf_(end),
-      line_(line), col_(col), ofs_(0)
+      line_(line), col_(col), buf_start_(0), buf_ofs_(0),
+      lazy_lines_(false), line_col_ofs_(0)
 {
+    buf_start_ = cur_;
     current_ = buffers_.insert(buffers_.end(),
-                               Buffer(0, start, end - start, false));
+                               Buffer(0, start, end - start, 0, line, col));
 
     //cerr << "current buffer has " << current_->size << " chars" << endl;
 }
@@ -55,10 +220,12 @@ Parse_Context(const std::string & filename, const char * start,
               size_t length, unsigned line, unsigned col)
     : stream_(0), chunk_size_(0), first_token_(0), last_token_(0),
       filename_(filename), cur_(start), ebuf_(start + length),
-      line_(line), col_(col), ofs_(0)
+      line_(line), col_(col), buf_start_(0), buf_ofs_(0),
+      lazy_lines_(false), line_col_ofs_(0)
 {
+    buf_start_ = cur_;
     current_ = buffers_.insert(buffers_.end(),
-                               Buffer(0, start, length, false));
+                               Buffer(0, start, length, 0, line, col));
 
     //cerr << "current buffer has " << current_->size << " chars" << endl;
 }
@@ -67,23 +234,27 @@ Parse_Context::
 Parse_Context(const std::string & filename)
     : stream_(0), chunk_size_(0), first_token_(0), last_token_(0),
       filename_(filename),
-      line_(1), col_(1), ofs_(0)
+      line_(1), col_(1), buf_start_(0), buf_ofs_(0),
+      lazy_lines_(false), line_col_ofs_(0)
 {
     buf.reset(new File_Read_Buffer(filename));
     cur_ = buf->start();
     ebuf_ = buf->end();
+    buf_start_ = cur_;
     current_ = buffers_.insert(buffers_.end(),
-                               Buffer(0, cur_, ebuf_ - cur_, false));
+                               Buffer(0, cur_, ebuf_ - cur_, 0));
 }
 
 Parse_Context::
 Parse_Context(const File_Read_Buffer & buf)
     : stream_(0), chunk_size_(0), first_token_(0), last_token_(0),
       filename_(buf.filename()), cur_(buf.start()), ebuf_(buf.end()),
-      line_(1), col_(1), ofs_(0)
+      line_(1), col_(1), buf_start_(0), buf_ofs_(0),
+      lazy_lines_(false), line_col_ofs_(0)
 {
+    buf_start_ = cur_;
     current_ = buffers_.insert(buffers_.end(),
-                               Buffer(0, cur_, ebuf_ - cur_, false));
+                               Buffer(0, cur_, ebuf_ - cur_, 0));
 }
 
 Parse_Context::
@@ -91,12 +262,13 @@ Parse_Context(const std::string & filename, std::istream & stream,
               unsigned line, unsigned col, size_t chunk_size)
     : stream_(&stream), chunk_size_(chunk_size),
       first_token_(0), last_token_(0), filename_(filename), cur_(0), ebuf_(0),
-      line_(line), col_(col), ofs_(0)
+      line_(line), col_(col), buf_start_(0), buf_ofs_(0),
+      lazy_lines_(false), line_col_ofs_(0)
 {
     current_ = read_new_buffer();
 
     if (current_ != buffers_.end()) {
-        cur_ = current_->pos;
+        cur_ = buf_start_ = current_->pos;
         ebuf_ = cur_ + current_->size;
     }
 }
@@ -104,12 +276,18 @@ Parse_Context(const std::string & filename, std::istream & stream,
 Parse_Context::
 ~Parse_Context()
 {
+    readahead_.reset();
+    for (auto & b: buffers_)
+        if (b.capacity) delete[] b.pos;
+    for (char * c: spare_buffers_)
+        delete[] c;
 }
 
 void
 Parse_Context::
 init(const std::string & filename)
 {
+    readahead_.reset();
     stream_ = 0;
     chunk_size_ = 0;
     first_token_ = 0;
@@ -117,36 +295,20 @@ init(const std::string & filename)
     filename_ = filename;
     line_ = 1;
     col_ = 1;
-    ofs_ = 0;
+    buf_ofs_ = 0;
+    lazy_lines_ = false;
+    line_col_ofs_ = 0;
 
     buf.reset(new File_Read_Buffer(filename));
     cur_ = buf->start();
     ebuf_ = buf->end();
+    buf_start_ = cur_;
     current_ = buffers_.insert(buffers_.end(),
-                               Buffer(0, cur_, ebuf_ - cur_, false));
+                               Buffer(0, cur_, ebuf_ - cur_, 0));
 }
 
 namespace {
 
-struct MatchAnyChar {
-    MatchAnyChar(const char * delimiters, int nd)
-    {
-        assert(nd > 0 && nd <= 4);
-        for (unsigned i = 0;  i < nd;  ++i)
-            chars[i] = delimiters[i];
-        for (unsigned i = nd;  i < 4;  ++i)
-            chars[i] = delimiters[0];
-    }
-    
-    char chars[4];
-
-    bool operator () (char c) const
-    {
-        return (c == chars[0] || c == chars[1]
-                || c == chars[2] || c == chars[3]);
-    }
-};
-
 struct MatchAnyCharLots {
     MatchAnyCharLots(const char * delimiters, int nd)
     {
@@ -171,6 +333,25 @@ struct MatchAnyCharLots {
 
 } // file scope
 
+bool
+Parse_Context::
+match_text(std::string & text, char delimiter)
+{
+    text.clear();
+
+    while (!eof()) {
+        const char * found
+            = (const char *)memchr(cur_, delimiter, ebuf_ - cur_);
+        bool in_buffer = found;
+        if (!in_buffer) found = ebuf_;
+        text.append(cur_, found);
+        skip_in_chunk(found - cur_);
+        if (in_buffer) break;
+    }
+
+    return true;
+}
+
 bool
 Parse_Context::
 match_text(std::string & text, const char * delimiters)
@@ -180,10 +361,55 @@ match_text(std::string & text, const char * delimiters)
     if (nd == 0)
         throw Exception("Parse_Context::match_text(): no characters");
 
-    if (nd <= 4) return match_text(text, MatchAnyChar(delimiters, nd));
+    if (nd == 1) return match_text(text, delimiters[0]);
+    else if (nd <= Find_First_Of::MAX_CHARS)
+        return match_text(text, Find_First_Of(delimiters, nd));
     else return match_text(text, MatchAnyCharLots(delimiters, nd));
 }
 
+bool
+Parse_Context::
+match_text(std::string & text, const Find_First_Of & delimiters)
+{
+    text.clear();
+
+    while (!eof()) {
+        const char * found = delimiters(cur_, ebuf_);
+        bool in_buffer = found != ebuf_;
+        text.append(cur_, found);
+        skip_in_chunk(found - cur_);
+        if (in_buffer) break;
+    }
+
+    return true;
+}
+
+void
+Parse_Context::
+skip_to_first_of(const Find_First_Of & delimiters)
+{
+    while (!eof()) {
+        const char * found = delimiters(cur_, ebuf_);
+        bool in_buffer = found != ebuf_;
+        skip_in_chunk(found - cur_);
+        if (in_buffer) break;
+    }
+}
+
+void
+Parse_Context::
+skip_to_char(char delimiter)
+{
+    while (!eof()) {
+        const char * found
+            = (const char *)memchr(cur_, delimiter, ebuf_ - cur_);
+        bool in_buffer = found;
+        if (!in_buffer) found = ebuf_;
+        skip_in_chunk(found - cur_);
+        if (in_buffer) break;
+    }
+}
+
 std::string
 Parse_Context::
 expect_text(char delimiter, bool allow_empty, const char * error)
@@ -382,11 +608,53 @@ expect_double(double min, double max, const char * error)
     return val;
 }
 
+void
+Parse_Context::
+set_lazy_line_tracking(bool lazy)
+{
+    if (first_token_)
+        throw Exception("Parse_Context::set_lazy_line_tracking(): "
+                        "can't change with tokens outstanding");
+    if (lazy_lines_) update_line_col();
+    lazy_lines_ = lazy;
+    line_col_ofs_ = get_offset();
+}
+
+void
+Parse_Context::
+update_line_col() const
+{
+    uint64_t ofs = get_offset();
+    if (line_col_ofs_ == ofs || current_ == buffers_.end())
+        return;
+
+    // Count from where we last were if that's earlier in this buffer, or
+    // otherwise from the start of the buffer
+    const char * start = current_->pos;
+    size_t line = current_->line, col = current_->col;
+    if (line_col_ofs_ >= current_->ofs && line_col_ofs_ < ofs) {
+        start += line_col_ofs_ - current_->ofs;
+        line = line_;
+        col = col_;
+    }
+
+    size_t newlines = count_char(start, cur_, '\n');
+    if (newlines) {
+        line_ = line + newlines;
+        col_ = cur_ - (const char *)memrchr(start, '\n', cur_ - start);
+    }
+    else {
+        line_ = line;
+        col_ = col + (cur_ - start);
+    }
+    line_col_ofs_ = ofs;
+}
+
 std::string
 Parse_Context::
 where() const
 {
-    return filename_ + format(":%zd:%zd", line_, col_);
+    return filename_ + format(":%zd:%zd", get_line(), get_col());
 }
 
 void
@@ -433,6 +701,31 @@ match_literal_str(const char * start, size_t len)
     return (len == 0);
 }
 
+void
+Parse_Context::
+skip_in_chunk(size_t n)
+{
+    if (n > ebuf_ - cur_)
+        throw Exception("Parse_Context::skip_in_chunk(): "
+                        "skipped past end of buffer");
+
+    const char * end = cur_ + n;
+    if (!lazy_lines_) {
+        const char * last_nl = 0;
+        for (const char * p = cur_;
+             (p = (const char *)memchr(p, '\n', end - p));  ++p) {
+            ++line_;
+            last_nl = p;
+        }
+
+        if (last_nl) col_ = end - last_nl;
+        else col_ += n;
+    }
+    cur_ = end;
+    if (cur_ == ebuf_)
+        next_buffer();
+}
+
 void
 Parse_Context::
 next_buffer()
@@ -448,13 +741,18 @@ next_buffer()
                         " at end");
     }
     else {
+        // The next buffer starts where this one finishes; make sure that
+        // we know where that is before this one can be freed
+        if (lazy_lines_) update_line_col();
+
         ++current_;
         
         if (current_ == buffers_.end())
             current_ = read_new_buffer();
         
         if (current_ != buffers_.end()) {
-            cur_ = current_->pos;
+            cur_ = buf_start_ = current_->pos;
+            buf_ofs_ = current_->ofs;
             ebuf_ = cur_ + current_->size;
             //cerr << "got buffer with " << current_->size << " chars"
             //     << endl;
@@ -486,9 +784,10 @@ goto_ofs(uint64_t ofs, size_t line, size_t col)
     //     << " col_ = " << col_ << endl;
     //cerr << buffers_.size() << " buffers" << endl;
 
-    ofs_ = ofs;
-    line_ = line;
-    col_ = col;
+    if (!lazy_lines_) {
+        line_ = line;
+        col_ = col;
+    }
 
     int i = 0, s = buffers_.size();
     /* TODO: be more efficient... */
@@ -502,6 +801,8 @@ goto_ofs(uint64_t ofs, size_t line, size_t col)
             /* In here. */
             cur_ = it->pos + (ofs - it->ofs);
             ebuf_ = it->pos + it->size;
+            buf_start_ = it->pos;
+            buf_ofs_ = it->ofs;
             current_ = it;
             return;
         }
@@ -546,7 +847,7 @@ free_buffers()
             break;  // first token is in this buffer
         std::list<Buffer>::iterator to_erase = it;
         ++it;
-        if (to_erase->del) delete[] (const_cast<char *>(to_erase->pos));
+        release_buffer(*to_erase);
         buffers_.erase(to_erase);
     }
 }
@@ -557,49 +858,82 @@ read_new_buffer()
 {
     if (!stream_) return buffers_.end();
 
-    if (stream_->eof()) return buffers_.end();
+    char * data = 0;
+    size_t read = 0;
+
+    if (readahead_) {
+        if (!readahead_->next(data, read)) {
+            // The thread has stopped and everything it read is used up.
+            // Carry on synchronously, which also reports the end of the
+            // stream or its errors.
+            std::exception_ptr exc = readahead_->exc;
+            if (readahead_->chunk_size == chunk_size_)
+                spare_buffers_.insert(spare_buffers_.end(),
+                                      readahead_->empty.begin(),
+                                      readahead_->empty.end());
+            else for (char * c: readahead_->empty) delete[] c;
+            readahead_->empty.clear();
+            readahead_.reset();
+            if (exc) std::rethrow_exception(exc);
+        }
+    }
 
-    //cerr << "stream is OK" << endl;
+    if (!data) {
+        if (stream_->eof()) return buffers_.end();
 
-    if (stream_->bad() || stream_->fail())
-        exception("stream is bad/has failed 1");
-    
-    static const size_t MAX_STACK_CHUNK_SIZE = 65536;
+        //cerr << "stream is OK" << endl;
 
-    //char tmpbuf_stack[chunk_size_];
-    char tmpbuf_stack[std::min(chunk_size_, MAX_STACK_CHUNK_SIZE)];
-    char * tmpbuf = tmpbuf_stack;
-    boost::scoped_array<char> tmpbuf_dynamic;
+        if (stream_->bad() || stream_->fail())
+            exception("stream is bad/has failed 1");
 
-    if (chunk_size_ > MAX_STACK_CHUNK_SIZE) {
-        tmpbuf_dynamic.reset(new char[chunk_size_]);
-        tmpbuf = tmpbuf_dynamic.get();
-    }
-    
-    stream_->read(tmpbuf, chunk_size_);
-    size_t read = stream_->gcount();
+        // Read straight into the memory of a finished chunk if we have one
+        if (spare_buffers_.empty())
+            data = new char[chunk_size_];
+        else {
+            data = spare_buffers_.back();
+            spare_buffers_.pop_back();
+        }
 
-    //cerr << "read " << read << " bytes" << endl;
+        try {
+            stream_->read(data, chunk_size_);
+        } catch (...) {
+            spare_buffers_.push_back(data);
+            throw;
+        }
+        read = stream_->gcount();
 
-    if (stream_->bad())
-        exception("stream is bad/has failed 2");
-    
-    if (read == 0) return buffers_.end();
+        //cerr << "read " << read << " bytes" << endl;
 
-    uint64_t last_ofs = (buffers_.empty() ? ofs_
+        if (stream_->bad()) {
+            spare_buffers_.push_back(data);
+            exception("stream is bad/has failed 2");
+        }
+
+        if (read == 0) {
+            spare_buffers_.push_back(data);
+            return buffers_.end();
+        }
+    }
+
+    uint64_t last_ofs = (buffers_.empty() ? get_offset()
                          : buffers_.back().ofs + buffers_.back().size);
     
     //cerr << "last_ofs = " << last_ofs << endl;
 
-    list<Buffer>::iterator result
-        = buffers_.insert(buffers_.end(),
-                          Buffer(last_ofs, new char[read], read, true));
-    
-    //cerr << "  now " << buffers_.size() << " buffers active" << endl;
-
-    memcpy(const_cast<char *>(buffers_.back().pos), tmpbuf, read);
+    return buffers_.insert(buffers_.end(),
+                           Buffer(last_ofs, data, read, chunk_size_,
+                                  line_, col_));
+}
 
-    return result;
+void
+Parse_Context::
+release_buffer(const Buffer & buffer)
+{
+    if (!buffer.capacity) return;
+    char * data = const_cast<char *>(buffer.pos);
+    if (buffer.capacity != chunk_size_) delete[] data;
+    else if (readahead_) readahead_->recycle(data);
+    else spare_buffers_.push_back(data);
 }
 
 void
@@ -608,9 +942,51 @@ set_chunk_size(size_t size)
 {
     if (size == 0)
         throw Exception("Parse_Context::chunk_size(): invalid chunk size");
+    if (readahead_) {
+        if (!readahead_->drained())
+            throw Exception("Parse_Context::chunk_size(): can't change with "
+                            "asynchronous readahead");
+        // Nothing left to hand over; go back to reading synchronously
+        spare_buffers_.insert(spare_buffers_.end(),
+                              readahead_->empty.begin(),
+                              readahead_->empty.end());
+        readahead_->empty.clear();
+        readahead_.reset();
+    }
+    if (size != chunk_size_) {
+        for (char * c: spare_buffers_)
+            delete[] c;
+        spare_buffers_.clear();
+    }
     chunk_size_ = size;
 }
 
+void
+Parse_Context::
+set_async_readahead(bool async)
+{
+    if (!stream_ || async == async_readahead()) return;
+
+    if (!async) {
+        // Keep what was already read, to be used up first
+        readahead_->stop();
+        return;
+    }
+
+    if (!readahead_) {
+        readahead_.reset(new Readahead(*stream_, chunk_size_));
+        readahead_->empty.swap(spare_buffers_);
+    }
+    readahead_->start();
+}
+
+bool
+Parse_Context::
+async_readahead() const
+{
+    return readahead_ && readahead_->active();
+}
+
 size_t
 Parse_Context::
 readahead_available() const
@@ -24,12 +24,15 @@
 #define __utils__parse_context_h__
 
 #include "jml/utils/unnamed_bool.h"
+#include "jml/utils/find_first_of.h"
 #include "jml/arch/exception.h"
 #include "jml/compiler/compiler.h"
 #include <cmath>
 #include <string>
 #include <iostream>
 #include <list>
+#include <memory>
+#include <vector>
 #include <limits.h>
 #include <string.h>
 #include <stdint.h>
@@ -43,6 +46,69 @@ namespace ML {
 class File_Read_Buffer;
 
 
+/*****************************************************************************/
+/* PARSE_STATUS                                                              */
+/*****************************************************************************/
+
+/** The outcome of one of the parsing functions that report errors by
+    returning false rather than by throwing.  An error is recorded as a
+    static message and the place it happened; nothing is allocated or
+    formatted unless message() is called, so that skipping over bad
+    records costs about the same as parsing good ones.
+*/
+
+struct Parse_Status {
+    Parse_Status()
+        : error(0), filename(0), offset(0), line(0), col(0),
+          has_character(false), character(0)
+    {
+    }
+
+    const char * error;              ///< Static message; null if no error
+    const std::string * filename;    ///< Belongs to the parser
+    uint64_t offset;                 ///< Characters since the start
+    size_t line;                     ///< Line number of the error
+    size_t col;                      ///< Column number of the error
+    bool has_character;              ///< Message includes character
+    char character;                  ///< Offending character
+
+    bool ok() const { return !error; }
+
+    void clear() { error = 0; }
+
+    /** Record an error and return false. */
+    bool fail(const char * error, const std::string * filename,
+              uint64_t offset, size_t line, size_t col)
+    {
+        this->error = error;
+        this->filename = filename;
+        this->offset = offset;
+        this->line = line;
+        this->col = col;
+        this->has_character = false;
+        return false;
+    }
+
+    /** Record an error about the given character, which the message shows
+        as ": <code> <char>" after the error. */
+    bool fail(const char * error, char character,
+              const std::string * filename,
+              uint64_t offset, size_t line, size_t col)
+    {
+        fail(error, filename, offset, line, col);
+        this->has_character = true;
+        this->character = character;
+        return false;
+    }
+
+    /** The message that the throwing version would have used, as
+        "filename:line:col: error".  The filename belongs to whatever was
+        doing the parsing, so this needs to be called while it exists.
+        Formatting is left until here so that failing stays cheap. */
+    std::string message() const;
+};
+
+
 /*****************************************************************************/
 /* PARSE_CONTEXT                                                             */
 /*****************************************************************************/
@@ -93,12 +159,48 @@ struct Parse_Context {
 
     /** Set the chunk size for the buffers.  Mostly used for testing
         purposes.  Note that this is only useful when initialized from
-        a stream. */
+        a stream, and that it can't be changed while an asynchronous
+        readahead is running or still has chunks that it read ahead
+        waiting to be used. */
     void set_chunk_size(size_t size);
 
     /** Get the chunk size. */
     size_t get_chunk_size() const { return chunk_size_; }
 
+    /** Turn on (or off) lazy line and column tracking.  Normally every
+        character consumed is checked for a newline to keep the line and
+        column up to date.  In lazy mode only the offset is tracked, and
+        the line and column are worked out by counting newlines when
+        they are asked for (by get_line(), get_col(), where() or an
+        exception).  That is faster when they are only needed for error
+        messages, but slow if they are asked for all the time.  It can
+        be changed at any point where there are no tokens outstanding; the
+        results are the same either way.
+    */
+    void set_lazy_line_tracking(bool lazy);
+
+    /** Is lazy line and column tracking on? */
+    bool lazy_line_tracking() const { return lazy_lines_; }
+
+    /** Number of chunks that the readahead thread reads ahead by. */
+    enum { READAHEAD_CHUNKS = 3 };
+
+    /** Turn on (or off) asynchronous readahead, for a context that reads
+        from a stream.  A background thread reads (and, for a compressed
+        filter_istream, decompresses) up to READAHEAD_CHUNKS chunks ahead
+        of the parser, so that reading and parsing overlap and the time
+        taken tends towards the larger of the two rather than their sum.
+        Nothing else may use the stream while it's on.  When it's turned
+        off, the chunks that were already read are used up before the
+        stream is read from again.  It does nothing for a context that
+        doesn't read from a stream.
+    */
+    void set_async_readahead(bool async);
+
+    /** Is asynchronous readahead turned on, with the thread still
+        reading?  It stops by itself at the end of the stream. */
+    bool async_readahead() const;
+
     /** How many characters are available to read ahead from? */
     size_t readahead_available() const;
 
@@ -112,8 +214,10 @@ struct Parse_Context {
     {
         if (eof()) exception("unexpected EOF");
 
-        if (*cur_ == '\n') { ++line_;  col_ = 0; }
-        ofs_ += 1;  col_ += 1;
+        if (!lazy_lines_) {
+            if (*cur_ == '\n') { ++line_;  col_ = 0; }
+            col_ += 1;
+        }
 
         ++cur_;
         if (JML_UNLIKELY(cur_ == ebuf_))
@@ -258,15 +362,23 @@ struct Parse_Context {
         the delimiter is encountered straight away.  The text up to but not
         including the delimiter is returned in text, and the position will be
         at the delimiter.  Always returns true, as the empty string counts as
-        being matched.
+        being matched.  Scans with memchr(), which needs no setup.
     */
-    bool match_text(std::string & text, char delimiter)
-    {
-        return match_text(text, Matches_Char(delimiter));
-    }
+    bool match_text(std::string & text, char delimiter);
 
     bool match_text(std::string & text, const char * delimiters);
 
+    /** Match text up to the first of the characters that the finder looks
+        for, or EOF.  The buffers are scanned a vector at a time. */
+    bool match_text(std::string & text, const Find_First_Of & delimiters);
+
+    /** Move forward to the first of the characters that the finder looks
+        for, or EOF, without copying the text that's passed over. */
+    void skip_to_first_of(const Find_First_Of & delimiters);
+
+    /** Same as skip_to_first_of() for a single character. */
+    void skip_to_char(char delimiter);
+
     std::string expect_text(char delimiter,
                             bool allow_empty = true,
                             const char * error = "expected text");
@@ -445,10 +557,35 @@ struct Parse_Context {
     void exception(const char * message) const JML_NORETURN;
 
     void exception_fmt(const char * message, ...) const JML_NORETURN;
+
+    /** The non-throwing equivalent of exception(): record the error (which
+        must be a static string) at the current position in status, and
+        return false. */
+    bool fail(Parse_Status & status, const char * error) const
+    {
+        return status.fail(error, &filename_, get_offset(), get_line(),
+                           get_col());
+    }
+
+    /** Same, for an error about the character at the current position. */
+    bool fail_at_char(Parse_Status & status, const char * error) const
+    {
+        return status.fail(error, eof() ? '\0' : *cur_, &filename_,
+                           get_offset(), get_line(), get_col());
+    }
     
-    size_t get_offset() const { return ofs_; }
-    size_t get_line() const { return line_; }
-    size_t get_col() const { return col_; }
+    size_t get_offset() const { return buf_ofs_ + (cur_ - buf_start_); }
+    size_t get_line() const
+    {
+        if (lazy_lines_) update_line_col();
+        return line_;
+    }
+
+    size_t get_col() const
+    {
+        if (lazy_lines_) update_line_col();
+        return col_;
+    }
 
     /** Query if we are at the end of file.  This occurs when we can't find
         any more characters. */
@@ -509,12 +646,43 @@ struct Parse_Context {
 
     void skip_line()
     {
-        expect_line();
+        if (eof()) exception("expected line of text");
+        skip_to_char('\n');
+        match_eol();
     }
 
     bool match_literal_str(const char * start, size_t len);
 
-protected: 
+    /** Number of characters from the current position to the end of the
+        current buffer.  These are contiguous in memory, starting at
+        chunk_pos(), and stay where they are until the context moves onto
+        the next buffer.  Zero at EOF. */
+    size_t chunk_available() const { return ebuf_ - cur_; }
+
+    /** Pointer to the current character within the current buffer. */
+    const char * chunk_pos() const { return cur_; }
+
+    /** Skip over n characters, which must all be within the current
+        buffer (n <= chunk_available()).  Equivalent to, but much cheaper
+        than, n increments. */
+    void skip_in_chunk(size_t n);
+
+    /** Same as skip_in_chunk(), for when the caller knows that there are
+        no newlines in the characters skipped over (eg, digits). */
+    void skip_in_line(size_t n)
+    {
+        cur_ += n;
+        if (!lazy_lines_) col_ += n;
+        if (JML_UNLIKELY(cur_ == ebuf_))
+            next_buffer();
+    }
+
+    /** True if the whole of the input is in memory, rather than being read
+        from a stream, in which case pointers into the chunks stay valid for
+        as long as the context does. */
+    bool in_memory() const { return !stream_; }
+
+protected:
     /** This token class allows speculative parsing.  It saves the position
         of the parse context, and will on destruction revert back to that
         position, unless it was ignored.
@@ -530,7 +698,7 @@ protected:
     protected:
         Token(Parse_Context & context)
             : context(&context),
-              ofs(context.ofs_), line(context.line_), col(context.col_),
+              ofs(context.get_offset()), line(context.line_), col(context.col_),
               prev(0), next(0)
         {
             //std::cerr << "creating token " << this
@@ -695,6 +863,10 @@ private:
         necessary. */
     void next_buffer();
 
+    /** In lazy mode, bring line_ and col_ up to date with the current
+        position by counting the newlines since they were last known. */
+    void update_line_col() const;
+
     /** Go to a given offset.  It must be within the current set of buffers. */
     void goto_ofs(uint64_t ofs, size_t line, size_t col);
 
@@ -708,21 +880,31 @@ private:
     /** This contains a single contiguous block of text. */
     struct Buffer {
         Buffer(uint64_t ofs = 0, const char * pos = 0, size_t size = 0,
-               bool del = false)
-            : ofs(ofs), pos(pos), size(size), del(del)
+               size_t capacity = 0, size_t line = 1, size_t col = 1)
+            : ofs(ofs), pos(pos), size(size), capacity(capacity),
+              line(line), col(col)
         {
         }
 
         uint64_t ofs;         ///< Offset of first character
         const char * pos;     ///< First character
         size_t size;          ///< Length
-        bool del;             ///< Do we delete it once finished with?
+        size_t capacity;      ///< Size of our memory; zero if not ours
+        size_t line;          ///< Line number of first character
+        size_t col;           ///< Column number of first character
     };
 
     /** Read a new buffer if possible, and update everything.  Doesn't
         do anything if it fails. */
     std::list<Buffer>::iterator read_new_buffer();
 
+    /** Give back the memory of a buffer that we're finished with, so that
+        another chunk can be read into it. */
+    void release_buffer(const Buffer & buffer);
+
+    /** The background thread for asynchronous readahead. */
+    struct Readahead;
+
     std::istream * stream_;   ///< Stream we read from; zero if none
     size_t chunk_size_;       ///< Size of chunks we read in
 
@@ -737,11 +919,18 @@ private:
     const char * cur_;        ///< Current position (points inside buffer)
     const char * ebuf_;       ///< Position for the end of the buffer
 
-    size_t line_;             ///< Line number at current position
-    size_t col_;              ///< Column number at current position
-    uint64_t ofs_;            ///< Offset of current position (chars since 0)
+    mutable size_t line_;     ///< Line number at current position
+    mutable size_t col_;      ///< Column number at current position
+    const char * buf_start_;  ///< Start of the buffer that cur_ is in
+    uint64_t buf_ofs_;        ///< Offset of buf_start_ (chars since 0)
+
+    bool lazy_lines_;         ///< Only work out line_ and col_ when needed
+    mutable uint64_t line_col_ofs_;  ///< Offset line_ and col_ are for if lazy
 
     std::shared_ptr<const File_Read_Buffer> buf;
+
+    std::unique_ptr<Readahead> readahead_;  ///< Only if async
+    std::vector<char *> spare_buffers_;     ///< Chunks to read into again
 };
 
 } // namespace ML
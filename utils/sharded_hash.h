@@ -0,0 +1,201 @@
+/* sharded_hash.h                                                  -*- C++ -*-
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   A concurrent hash map made of a set of independently locked
+   Lightweight_Hash shards.
+*/
+
+#ifndef __jml__utils__sharded_hash_h__
+#define __jml__utils__sharded_hash_h__
+
+#include "jml/utils/lightweight_hash.h"
+#include "jml/arch/spinlock.h"
+#include "jml/arch/exception.h"
+#include "jml/arch/bitops.h"
+#include "jml/compiler/compiler.h"
+#include <mutex>
+#include <stdlib.h>
+
+namespace ML {
+
+
+/*****************************************************************************/
+/* SHARDED HASH                                                              */
+/*****************************************************************************/
+
+/** A hash map that can be used concurrently from multiple threads.
+
+    The keyspace is split into a power of two number of shards based upon
+    the high bits of the (mixed) hash of the key; each shard is a
+    Lightweight_Hash with its own lock.  Each shard lives in its own cache
+    line(s) so that threads hitting different shards don't contend on the
+    same memory.
+
+    Since a reference into a shard is only valid while its lock is held,
+    values are returned by copy, or accessed from within a callback that is
+    called with the lock held.
+
+    The same restrictions as for Lightweight_Hash apply to the keys (in
+    particular, a key of zero can't be inserted).
+*/
+
+template<typename Key, typename Value, class Hash = std::hash<Key>,
+         class Lock = Spinlock>
+struct Sharded_Hash {
+
+    typedef Lightweight_Hash<Key, Value, std::pair<Key, Value>,
+                             std::pair<const Key, Value>,
+                             PairOps<Key, Value, Hash> > Shard_Map;
+
+    struct Shard {
+        Shard()
+        {
+        }
+
+        mutable Lock lock;
+        Shard_Map map;
+    } JML_ALIGNED(64);
+
+    /** Create with the given number of shards, which will be rounded up to
+        the next power of two. */
+    explicit Sharded_Hash(int numShards = 64)
+        : shards_(0), numShards_(0), shardBits_(0)
+    {
+        if (numShards <= 0)
+            throw Exception("Sharded_Hash: need at least one shard");
+
+        shardBits_ = numShards == 1 ? 0 : highest_bit(numShards - 1, -1) + 1;
+        numShards_ = 1 << shardBits_;
+
+        void * mem = 0;
+        int res = posix_memalign(&mem, 64, numShards_ * sizeof(Shard));
+        if (res != 0)
+            throw Exception("Sharded_Hash: couldn't allocate shards");
+        shards_ = reinterpret_cast<Shard *>(mem);
+
+        for (unsigned i = 0;  i < numShards_;  ++i)
+            new (shards_ + i) Shard();
+    }
+
+    ~Sharded_Hash()
+    {
+        for (unsigned i = 0;  i < numShards_;  ++i)
+            shards_[i].~Shard();
+        free(shards_);
+    }
+
+    size_t num_shards() const { return numShards_; }
+
+    /** Which shard the given key lives in. */
+    size_t shard_of(const Key & key) const
+    {
+        if (shardBits_ == 0) return 0;
+        // Mix so that we're not taking the same bits that the shard uses
+        // to choose its bucket.
+        uint64_t h = Hash()(key) * 0x9E3779B97F4A7C15ULL;
+        return h >> (64 - shardBits_);
+    }
+
+    /** Look up the key, and insert the given value if it wasn't there.
+        Returns the value now in the map and whether it was inserted. */
+    std::pair<Value, bool>
+    find_or_insert(const Key & key, const Value & value)
+    {
+        Shard & shard = shards_[shard_of(key)];
+        std::lock_guard<Lock> guard(shard.lock);
+        auto res = shard.map.insert(std::make_pair(key, value));
+        return std::make_pair(res.first->second, res.second);
+    }
+
+    /** Call fn(value) with the lock for the key's shard held, inserting a
+        default-constructed value first if the key isn't present.  Returns
+        true if the key was inserted. */
+    template<typename Fn>
+    bool update(const Key & key, Fn && fn)
+    {
+        Shard & shard = shards_[shard_of(key)];
+        std::lock_guard<Lock> guard(shard.lock);
+        auto res = shard.map.insert(std::make_pair(key, Value()));
+        fn(res.first->second);
+        return res.second;
+    }
+
+    /** Copy the value for the key into value.  Returns false (leaving value
+        untouched) if the key isn't in the map. */
+    bool find(const Key & key, Value & value) const
+    {
+        const Shard & shard = shards_[shard_of(key)];
+        std::lock_guard<Lock> guard(shard.lock);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) return false;
+        value = it->second;
+        return true;
+    }
+
+    size_t count(const Key & key) const
+    {
+        const Shard & shard = shards_[shard_of(key)];
+        std::lock_guard<Lock> guard(shard.lock);
+        return shard.map.count(key);
+    }
+
+    /** Call fn(shardNum, map) for each of the shards in turn, with that
+        shard's lock held.  The shards are not all locked at once, so this
+        is not a consistent snapshot unless the writers have been stopped. */
+    template<typename Fn>
+    void for_each_shard(Fn && fn)
+    {
+        for (unsigned i = 0;  i < numShards_;  ++i) {
+            std::lock_guard<Lock> guard(shards_[i].lock);
+            fn(i, shards_[i].map);
+        }
+    }
+
+    template<typename Fn>
+    void for_each_shard(Fn && fn) const
+    {
+        for (unsigned i = 0;  i < numShards_;  ++i) {
+            std::lock_guard<Lock> guard(shards_[i].lock);
+            fn(i, static_cast<const Shard_Map &>(shards_[i].map));
+        }
+    }
+
+    size_t size() const
+    {
+        size_t result = 0;
+        for_each_shard([&] (int, const Shard_Map & map)
+                       { result += map.size(); });
+        return result;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    void clear()
+    {
+        for_each_shard([] (int, Shard_Map & map) { map.clear(); });
+    }
+
+    /** Reserve enough space for the given total number of entries, assuming
+        that they are evenly spread over the shards. */
+    void reserve(size_t capacity)
+    {
+        size_t perShard = (capacity + numShards_ - 1) / numShards_;
+        for_each_shard([=] (int, Shard_Map & map) { map.reserve(perShard); });
+    }
+
+private:
+    Shard * shards_;
+    unsigned numShards_;
+    int shardBits_;
+
+    Sharded_Hash(const Sharded_Hash & other);
+    void operator = (const Sharded_Hash & other);
+};
+
+} // namespace ML
+
+#endif /* __jml__utils__sharded_hash_h__ */
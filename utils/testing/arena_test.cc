@@ -0,0 +1,165 @@
+/* arena_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test of the huge page and arena allocators.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/utils/arena.h"
+#include "jml/utils/huge_page_allocator.h"
+#include "jml/utils/lightweight_hash.h"
+#include "jml/utils/compact_vector.h"
+#include "jml/utils/fixed_array.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+
+using namespace ML;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE(test_allocate_huge_pages)
+{
+    for (Huge_Page_Mode mode: { HP_NONE, HP_TRANSPARENT, HP_EXPLICIT }) {
+        size_t bytes = 3 * huge_page_size + 100;
+        char * mem = (char *)allocate_huge_pages(bytes, mode);
+        BOOST_REQUIRE(mem);
+        BOOST_CHECK_EQUAL((size_t)mem % huge_page_size, 0);
+
+        // Zero filled and writable up to the rounded size
+        size_t rounded = huge_page_round(bytes);
+        BOOST_CHECK_EQUAL(rounded, 4 * huge_page_size);
+        BOOST_CHECK_EQUAL(mem[0], 0);
+        BOOST_CHECK_EQUAL(mem[rounded - 1], 0);
+        mem[rounded - 1] = 1;
+
+        free_huge_pages(mem, bytes);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_huge_page_hash)
+{
+    typedef std::pair<uint64_t, uint64_t> Bucket;
+    Lightweight_Hash<uint64_t, uint64_t, Bucket,
+                     std::pair<const uint64_t, uint64_t>,
+                     PairOps<uint64_t, uint64_t>,
+                     LogMemStorage<Bucket, Huge_Page_Allocator<Bucket> > > h;
+
+    // Big enough to go through the huge page path
+    for (uint64_t i = 1;  i <= 200000;  ++i)
+        h[i] = i * 2;
+
+    BOOST_CHECK_EQUAL(h.size(), 200000);
+    BOOST_CHECK(h.capacity() * sizeof(Bucket) >= huge_page_size);
+    for (uint64_t i = 1;  i <= 200000;  ++i)
+        BOOST_CHECK_EQUAL(h[i], i * 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_huge_page_compact_vector_and_fixed_array)
+{
+    compact_vector<float, 4, uint32_t, true, float *,
+                   Huge_Page_Allocator<float> > v;
+    for (unsigned i = 0;  i < 1000000;  ++i)
+        v.push_back(i);
+    BOOST_CHECK_EQUAL(v.size(), 1000000);
+    BOOST_CHECK_EQUAL(v[999999], 999999);
+
+    fixed_array<float, 2, Huge_Page_Allocator<float> > arr(1000, 1000);
+    arr.fill(1.0);
+    BOOST_CHECK_EQUAL((size_t)arr.data() % huge_page_size, 0);
+    BOOST_CHECK_EQUAL(arr[999][999], 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_arena)
+{
+    Arena arena(4096);
+    BOOST_CHECK_EQUAL(arena.bytes_allocated(), 0);
+    BOOST_CHECK_EQUAL(arena.bytes_reserved(), 0);
+
+    char * p1 = (char *)arena.allocate(10);
+    char * p2 = (char *)arena.allocate(10);
+    BOOST_CHECK_EQUAL((size_t)p1 % 16, 0);
+    BOOST_CHECK_EQUAL((size_t)p2 % 16, 0);
+    BOOST_CHECK_EQUAL(p2 - p1, 16);
+    BOOST_CHECK_EQUAL(arena.bytes_allocated(), 20);
+    BOOST_CHECK_EQUAL(arena.bytes_reserved(), 4096);
+
+    char * p3 = (char *)arena.allocate(1, 1);
+    BOOST_CHECK_EQUAL(p3, p2 + 10);
+
+    // Big allocation gets its own chunk, and we keep allocating from the
+    // current one afterwards
+    char * big = (char *)arena.allocate(100000);
+    memset(big, 0, 100000);
+    char * p4 = (char *)arena.allocate(1, 1);
+    BOOST_CHECK_EQUAL(p4, p3 + 1);
+
+    // Fill up lots of chunks
+    for (unsigned i = 0;  i < 10000;  ++i)
+        memset(arena.allocate(100), i, 100);
+
+    arena.clear();
+    BOOST_CHECK_EQUAL(arena.bytes_allocated(), 0);
+    BOOST_CHECK_EQUAL(arena.bytes_reserved(), 0);
+
+    BOOST_CHECK_THROW(arena.allocate(10000, 3), ML::Exception);
+
+    // Also when the request would fit in the current chunk
+    arena.allocate(1);
+    BOOST_CHECK_THROW(arena.allocate(1, 3), ML::Exception);
+    BOOST_CHECK_THROW(arena.allocate(1, 0), ML::Exception);
+    BOOST_CHECK_EQUAL(arena.bytes_allocated(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_arena_allocator_containers)
+{
+    BOOST_CHECK(Arena::current() == 0);
+
+    typedef compact_vector<float, 4, uint32_t, true, float *,
+                           Arena_Allocator<float> > Vec;
+
+    // No current arena means no allocation
+    {
+        Vec v;
+        BOOST_CHECK_THROW(v.resize(100), std::bad_alloc);
+    }
+
+    Arena arena;
+    {
+        Arena::Scope scope(arena);
+        BOOST_CHECK_EQUAL(Arena::current(), &arena);
+
+        std::vector<Vec> vecs(1000);
+        for (unsigned i = 0;  i < vecs.size();  ++i)
+            for (unsigned j = 0;  j < i % 20;  ++j)
+                vecs[i].push_back(j);
+
+        for (unsigned i = 0;  i < vecs.size();  ++i) {
+            BOOST_CHECK_EQUAL(vecs[i].size(), i % 20);
+            if (i % 20)
+                BOOST_CHECK_EQUAL(vecs[i].back(), i % 20 - 1);
+        }
+
+        typedef std::pair<uint64_t, uint64_t> Bucket;
+        Lightweight_Hash<uint64_t, uint64_t, Bucket,
+                         std::pair<const uint64_t, uint64_t>,
+                         PairOps<uint64_t, uint64_t>,
+                         MemStorage<Bucket, Arena_Allocator<Bucket> > > h;
+        for (uint64_t i = 1;  i <= 1000;  ++i)
+            h[i] = i;
+        BOOST_CHECK_EQUAL(h.size(), 1000);
+        BOOST_CHECK_EQUAL(h[500], 500);
+
+        BOOST_CHECK(arena.bytes_allocated() > 0);
+    }
+
+    BOOST_CHECK(Arena::current() == 0);
+
+    // Explicitly passed arena
+    fixed_array<double, 2, Arena_Allocator<double> >
+        arr(10, 10, Arena_Allocator<double>(&arena));
+    arr.fill(2.0);
+    BOOST_CHECK_EQUAL(arr[9][9], 2.0);
+}
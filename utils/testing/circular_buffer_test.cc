@@ -537,3 +537,112 @@ BOOST_AUTO_TEST_CASE( check_resize )
 BOOST_AUTO_TEST_CASE(check_delete_element)
 {
 }
+
+BOOST_AUTO_TEST_CASE( check_power_of_two )
+{
+    constructed = destroyed = 0;
+
+    Circular_Buffer<int, false, std::allocator<int>, true> v1;
+    check_basic_ops_type(v1);
+
+    Circular_Buffer<Obj, false, std::allocator<Obj>, true> v2;
+    check_basic_ops_type(v2);
+    v2.clear();
+
+    BOOST_CHECK_EQUAL(constructed, destroyed);
+
+    Circular_Buffer<int, false, std::allocator<int>, true> buf(5);
+    BOOST_CHECK_EQUAL(buf.capacity(), 8);
+
+    // Slide a window all the way around the buffer several times
+    for (int i = 0;  i < 100;  ++i) {
+        buf.push_back(i);
+        if (buf.size() > 6) buf.pop_front();
+        BOOST_CHECK_EQUAL(buf.back(), i);
+        BOOST_CHECK_EQUAL(buf.front(), std::max(0, i - 5));
+        BOOST_CHECK_EQUAL(buf[-1], i);
+        BOOST_CHECK_EQUAL(buf.end() - buf.begin(), buf.size());
+    }
+
+    BOOST_CHECK_EQUAL(buf.capacity(), 8);
+}
+
+template<class Buffer>
+void check_bulk_ops_type()
+{
+    Buffer buf(8);
+    BOOST_CHECK_EQUAL(buf.capacity(), 8);
+
+    vector<int> vals;
+    for (int i = 0;  i < 100;  ++i)
+        vals.push_back(i);
+
+    const int * p = &vals[0];
+
+    buf.push_back(p, p + 6);
+    BOOST_CHECK_EQUAL(buf.size(), 6);
+    BOOST_CHECK_EQUAL(buf.front(), 0);
+    BOOST_CHECK_EQUAL(buf.back(), 5);
+
+    auto segs = buf.segments();
+    BOOST_CHECK_EQUAL(segs.first.size, 6);
+    BOOST_CHECK_EQUAL(segs.second.size, 0);
+
+    buf.pop_front(4);
+    BOOST_CHECK_EQUAL(buf.size(), 2);
+    BOOST_CHECK_EQUAL(buf.front(), 4);
+
+    // This one wraps around the end of the storage
+    buf.push_back(p + 6, p + 10);
+    BOOST_CHECK_EQUAL(buf.size(), 6);
+    BOOST_CHECK_EQUAL(buf.capacity(), 8);
+    for (int i = 0;  i < 6;  ++i)
+        BOOST_CHECK_EQUAL(buf[i], i + 4);
+
+    segs = buf.segments();
+    BOOST_CHECK_EQUAL(segs.first.size, 4);
+    BOOST_CHECK_EQUAL(segs.second.size, 2);
+
+    vector<int> joined(segs.first.begin(), segs.first.end());
+    joined.insert(joined.end(), segs.second.begin(), segs.second.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(joined.begin(), joined.end(),
+                                  buf.begin(), buf.end());
+
+    // Non-pointer iterators
+    std::set<int> s(vals.begin() + 10, vals.begin() + 15);
+    buf.push_back(s.begin(), s.end());
+    BOOST_CHECK_EQUAL(buf.size(), 11);
+    BOOST_CHECK(buf.capacity() >= 11);
+    for (int i = 0;  i < 11;  ++i)
+        BOOST_CHECK_EQUAL(buf[i], i + 4);
+
+    const Buffer & cbuf = buf;
+    auto csegs = cbuf.segments();
+    BOOST_CHECK_EQUAL(csegs.first.size + csegs.second.size, 11);
+
+    buf.pop_front(11);
+    BOOST_CHECK(buf.empty());
+    BOOST_CHECK_EQUAL(buf.start(), 0);
+
+    {
+        Set_Trace_Exceptions guard(false);
+        BOOST_CHECK_THROW(buf.pop_front(1), ML::Exception);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( check_bulk_ops )
+{
+    check_bulk_ops_type<Circular_Buffer<int> >();
+    check_bulk_ops_type<Circular_Buffer<int, false, std::allocator<int>, true> >();
+
+    constructed = destroyed = 0;
+    {
+        Circular_Buffer<Obj> buf;
+        vector<Obj> objs(10);
+        const Obj * p = &objs[0];
+        buf.push_back(p, p + 10);
+        buf.pop_front(5);
+        BOOST_CHECK_EQUAL(buf.size(), 5);
+    }
+    BOOST_CHECK_EQUAL(constructed, destroyed);
+}
@@ -566,3 +566,128 @@ BOOST_AUTO_TEST_CASE( check_c11_ops )
 
     BOOST_CHECK_EQUAL(constructed, destroyed);
 }
+
+// Has a non-trivial copy constructor but can be moved with memcpy
+struct Reloc {
+    Reloc(int val = 0)
+        : val(val)
+    {
+    }
+
+    Reloc(const Reloc & other)
+        : val(other.val)
+    {
+        ++copied;
+    }
+
+    int val;
+
+    bool operator == (const Reloc & other) const
+    {
+        return val == other.val;
+    }
+};
+
+std::ostream & operator << (std::ostream & stream, const Reloc & r)
+{
+    return stream << r.val;
+}
+
+namespace ML {
+template<>
+struct is_trivially_relocatable<Reloc> : public boost::true_type {
+};
+} // namespace ML
+
+BOOST_AUTO_TEST_CASE( check_relocatable )
+{
+    BOOST_CHECK((compact_vector<float, 4>::Relocatable));
+    BOOST_CHECK((compact_vector<Reloc, 4>::Relocatable));
+    BOOST_CHECK(!(compact_vector<Obj, 4>::Relocatable));
+
+    copied = 0;
+
+    compact_vector<Reloc, 2, unsigned> v;
+    for (unsigned i = 0;  i < 100;  ++i)
+        v.emplace_back(i);
+
+    // Growing and spilling from internal to external don't copy
+    BOOST_CHECK_EQUAL(copied, 0);
+    BOOST_CHECK_EQUAL(v.size(), 100);
+    for (unsigned i = 0;  i < 100;  ++i)
+        BOOST_CHECK_EQUAL(v[i].val, i);
+
+    v.erase(v.begin() + 10, v.begin() + 90);
+    BOOST_CHECK_EQUAL(copied, 0);
+    BOOST_CHECK_EQUAL(v.size(), 20);
+    BOOST_CHECK_EQUAL(v[9].val, 9);
+    BOOST_CHECK_EQUAL(v[10].val, 90);
+    BOOST_CHECK_EQUAL(v[19].val, 99);
+
+    auto it = v.insert(v.begin() + 1, 3, Reloc(-1));
+    BOOST_CHECK(it == v.begin() + 1);
+    BOOST_CHECK_EQUAL(v.size(), 23);
+    BOOST_CHECK_EQUAL(v[0].val, 0);
+    BOOST_CHECK_EQUAL(v[1].val, -1);
+    BOOST_CHECK_EQUAL(v[3].val, -1);
+    BOOST_CHECK_EQUAL(v[4].val, 1);
+    BOOST_CHECK_EQUAL(v[22].val, 99);
+
+    // Erasing down to internal size moves back to internal storage
+    v.erase(v.begin() + 1, v.end());
+    BOOST_CHECK_EQUAL(v.size(), 1);
+    BOOST_CHECK_EQUAL(v.capacity(), 2);
+    BOOST_CHECK_EQUAL(v[0].val, 0);
+
+    v.resize(10);
+    v.resize(1);
+    BOOST_CHECK_EQUAL(v.capacity(), 2);
+    BOOST_CHECK_EQUAL(v[0].val, 0);
+}
+
+template<class Vector>
+void check_reserve_exact_type()
+{
+    Vector v;
+    v.reserve_exact(3);
+    BOOST_CHECK_EQUAL(v.capacity(), 4);  // internal
+
+    v.reserve_exact(7);
+    BOOST_CHECK_EQUAL(v.capacity(), 7);
+    BOOST_CHECK_EQUAL(v.size(), 0);
+
+    for (unsigned i = 0;  i < 7;  ++i)
+        v.push_back(i);
+    BOOST_CHECK_EQUAL(v.capacity(), 7);
+
+    v.push_back(7);
+    BOOST_CHECK_EQUAL(v.capacity(), 14);
+
+    v.shrink_to_fit();
+    BOOST_CHECK_EQUAL(v.capacity(), 8);
+    BOOST_CHECK_EQUAL(v.size(), 8);
+    for (unsigned i = 0;  i < 8;  ++i)
+        BOOST_CHECK_EQUAL(v[i], i);
+
+    v.pop_back();
+    v.pop_back();
+    v.pop_back();
+    v.pop_back();
+    BOOST_CHECK_EQUAL(v.capacity(), 8);
+    v.shrink_to_fit();
+    BOOST_CHECK_EQUAL(v.capacity(), 4);
+    BOOST_CHECK_EQUAL(v.size(), 4);
+    for (unsigned i = 0;  i < 4;  ++i)
+        BOOST_CHECK_EQUAL(v[i], i);
+
+    v.shrink_to_fit();
+    BOOST_CHECK_EQUAL(v.capacity(), 4);
+}
+
+BOOST_AUTO_TEST_CASE( check_reserve_exact )
+{
+    constructed = destroyed = 0;
+    check_reserve_exact_type<compact_vector<float, 4, unsigned> >();
+    check_reserve_exact_type<compact_vector<Obj, 4, unsigned> >();
+    BOOST_CHECK_EQUAL(constructed, destroyed);
+}
@@ -0,0 +1,162 @@
+/* csv_parsing_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Throughput of parsing CSV rows into strings versus into views, and of
+   skipping bad rows with exceptions versus with a Parse_Status.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/csv.h"
+#include "jml/utils/parse_context.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include "jml/arch/exception_handler.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <sstream>
+
+using namespace ML;
+using namespace std;
+
+/** Rows of a feature dump: an id, a label, some numeric features and a
+    quoted text field, one in ten of which has escaped quotes. */
+string makeCsv(size_t bytes)
+{
+    string result;
+    result.reserve(bytes + 1000);
+    uint64_t r = 1;
+    for (unsigned i = 0;  result.size() < bytes;  ++i) {
+        result += format("%u,label%d", i, i % 7);
+        for (unsigned j = 0;  j < 20;  ++j) {
+            r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+            result += format(",%.4f", (r >> 40) / 1000000.0);
+        }
+        if (i % 10 == 0)
+            result += ",\"some \"\"quoted\"\" text, with a comma\"\n";
+        else result += ",\"some text, with a comma\"\n";
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_csv_rows)
+{
+    string text = makeCsv(50000000);
+    double mb = text.size() / 1000000.0;
+
+    size_t total1 = 0, total2 = 0, total3 = 0, total4 = 0;
+
+    Timer timer;
+    {
+        Parse_Context context("text", text.c_str(), text.size());
+        while (context) {
+            vector<string> row = expect_csv_row(context);
+            for (auto & f: row)
+                total1 += f.size();
+        }
+    }
+    double strings = timer.elapsed_wall();
+
+    timer.restart();
+    {
+        Parse_Context context("text", text.c_str(), text.size());
+        Csv_Row row;
+        while (context) {
+            expect_csv_row(context, row);
+            for (auto & f: row)
+                total2 += f.size();
+        }
+    }
+    double views = timer.elapsed_wall();
+
+    timer.restart();
+    {
+        istringstream stream(text);
+        Parse_Context context("text", stream);
+        Csv_Row row;
+        while (context) {
+            expect_csv_row(context, row);
+            for (auto & f: row)
+                total3 += f.size();
+        }
+    }
+    double viewsStream = timer.elapsed_wall();
+
+    timer.restart();
+    {
+        Parse_Context context("text", text.c_str(), text.size());
+        context.set_lazy_line_tracking(true);
+        Csv_Row row;
+        while (context) {
+            expect_csv_row(context, row);
+            for (auto & f: row)
+                total4 += f.size();
+        }
+    }
+    double viewsLazy = timer.elapsed_wall();
+
+    BOOST_CHECK_EQUAL(total1, total2);
+    BOOST_CHECK_EQUAL(total1, total3);
+    BOOST_CHECK_EQUAL(total1, total4);
+
+    cerr << format("%.1fMB: strings %.1fMB/s, views %.1fMB/s, "
+                   "views from stream %.1fMB/s, views with lazy lines %.1fMB/s",
+                   mb, mb / strings, mb / views, mb / viewsStream,
+                   mb / viewsLazy)
+         << endl;
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_csv_bad_rows)
+{
+    // One row in five has an unescaped quote in the middle of a field
+    string text = makeCsv(20000000);
+    size_t line = 0;
+    for (size_t i = 0;  i < text.size();  ++i) {
+        if (text[i] != '\n') continue;
+        if (++line % 5 == 0 && i + 3 < text.size())
+            text[i + 3] = '"';
+    }
+    double mb = text.size() / 1000000.0;
+
+    size_t good1 = 0, bad1 = 0, good2 = 0, bad2 = 0;
+
+    Timer timer;
+    {
+        JML_TRACE_EXCEPTIONS(false);
+        Parse_Context context("text", text.c_str(), text.size());
+        Csv_Row row;
+        while (context) {
+            try {
+                expect_csv_row(context, row);
+                ++good1;
+            } catch (const std::exception & exc) {
+                ++bad1;
+                context.skip_line();
+            }
+        }
+    }
+    double exceptions = timer.elapsed_wall();
+
+    timer.restart();
+    {
+        Parse_Context context("text", text.c_str(), text.size());
+        Csv_Row row;
+        Parse_Status status;
+        while (context) {
+            if (match_csv_row(context, row, status)) ++good2;
+            else ++bad2;
+        }
+    }
+    double statuses = timer.elapsed_wall();
+
+    BOOST_CHECK_EQUAL(good1, good2);
+    BOOST_CHECK_EQUAL(bad1, bad2);
+    BOOST_CHECK(bad2 > 0);
+
+    cerr << format("%.1fMB with %zd bad rows: exceptions %.1fMB/s, "
+                   "status %.1fMB/s",
+                   mb, bad2, mb / exceptions, mb / statuses)
+         << endl;
+}
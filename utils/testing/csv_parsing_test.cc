@@ -12,9 +12,11 @@
 #include "jml/utils/csv.h"
 #include "jml/utils/vector_utils.h"
 #include "jml/utils/parse_context.h"
+#include "jml/arch/exception_handler.h"
 
 #include <sstream>
 #include <fstream>
+#include <memory>
 
 using namespace std;
 using namespace ML;
@@ -42,3 +44,188 @@ BOOST_AUTO_TEST_CASE (test1)
     testCsvLine("\"\",", {"",""});
     testCsvLine("\"\",\"\"", {"",""});
 }
+
+/** Parse the text as rows with both versions of expect_csv_row, checking
+    that they agree. */
+void testCsvRows(const std::string & text, size_t chunkSize = 0)
+{
+    ML::Parse_Context context1(text, text.c_str(), text.c_str() + text.size());
+    istringstream stream(text);
+    std::shared_ptr<ML::Parse_Context> context2;
+    if (chunkSize)
+        context2.reset(new ML::Parse_Context(text, stream, 1, 1, chunkSize));
+    else context2.reset(new ML::Parse_Context(text, text.c_str(),
+                                              text.c_str() + text.size()));
+
+    Csv_Row row;
+    while (context1) {
+        BOOST_REQUIRE(*context2);
+        vector<string> expected = expect_csv_row(context1);
+        expect_csv_row(*context2, row);
+        BOOST_REQUIRE_EQUAL(row.strings(), expected);
+        BOOST_REQUIRE_EQUAL(context2->get_offset(), context1.get_offset());
+        BOOST_REQUIRE_EQUAL(context2->get_line(), context1.get_line());
+        BOOST_REQUIRE_EQUAL(context2->get_col(), context1.get_col());
+    }
+    BOOST_CHECK(!*context2);
+}
+
+BOOST_AUTO_TEST_CASE (test_csv_row_views)
+{
+    string text = "a,b,c\n"
+        "\n"
+        "1,\"two\",\"th\"\"r\"\"ee\"\n"
+        ",,\n"
+        "\"multi\nline\",x\r\n"
+        "  leading,\"\"\"\",\"\"\n"
+        "last,\"row\"";
+
+    for (size_t chunkSize: { 0, 1, 2, 3, 5, 7, 16, 1000 })
+        testCsvRows(text, chunkSize);
+
+    // Unescaped fields in a memory buffer point straight into it
+    ML::Parse_Context context(text, text.c_str(), text.c_str() + text.size());
+    Csv_Row row;
+    expect_csv_row(context, row, 3);
+    BOOST_CHECK_EQUAL(row[0].start, text.c_str());
+    BOOST_CHECK_EQUAL(row[2].start, text.c_str() + 4);
+    BOOST_CHECK(row[1] == "b");
+
+    expect_csv_row(context, row);
+    BOOST_CHECK(row.empty());
+
+    expect_csv_row(context, row, 3);
+    BOOST_CHECK_EQUAL(row[1].start, text.c_str() + 10);
+    BOOST_CHECK(row[2] == "th\"r\"ee");
+    BOOST_CHECK_THROW(expect_csv_row(context, row, 4), ML::Exception);
+
+    // Errors are the same as before
+    for (string bad: { "a\"b,c\n", "\"a\"b,c\n", "\"unfinished\n" }) {
+        ML::Parse_Context context(bad, bad.c_str(), bad.c_str() + bad.size());
+        BOOST_CHECK_THROW(expect_csv_row(context, row), ML::Exception);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (test_csv_row_random)
+{
+    // Random rows made of awkward characters, streamed in odd sized chunks
+    const char chars[] = "ab,\"\n ";
+    string text;
+    uint64_t r = 1;
+    for (unsigned i = 0;  i < 2000;  ++i) {
+        vector<string> row;
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        int nfields = (r >> 60) % 5;
+        for (int j = 0;  j < nfields;  ++j) {
+            string field;
+            r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+            int len = (r >> 60) % 6;
+            for (int k = 0;  k < len;  ++k)
+                field += chars[(r >> (k * 5)) % 6];
+            row.push_back(field);
+        }
+        for (unsigned j = 0;  j < row.size();  ++j)
+            text += (j ? "," : "") + csv_escape(row[j]);
+        text += (r & 1 ? "\n" : "\r\n");
+    }
+
+    for (size_t chunkSize: { 0, 1, 13, 64, 4096 })
+        testCsvRows(text, chunkSize);
+}
+
+BOOST_AUTO_TEST_CASE (test_match_csv_row)
+{
+    string text = "a,b,c\n"
+        "bad\"quote,x,y\n"
+        "1,2,3\n"
+        "\"bad\"end,x\n"
+        "short,row\n"
+        "\"multi\nline\",two,three\n"
+        "\"unfinished";
+
+    for (size_t chunkSize: { 0, 1, 3, 1000 }) {
+        istringstream stream(text);
+        std::shared_ptr<ML::Parse_Context> context;
+        if (chunkSize)
+            context.reset(new ML::Parse_Context("rows.csv", stream, 1, 1,
+                                                chunkSize));
+        else context.reset(new ML::Parse_Context("rows.csv", text.c_str(),
+                                                 text.c_str() + text.size()));
+
+        vector<vector<string> > rows;
+        vector<string> errors;
+        Csv_Row row;
+        Parse_Status status;
+        while (*context) {
+            if (match_csv_row(*context, row, status, 3)) {
+                BOOST_CHECK(status.ok());
+                rows.push_back(row.strings());
+            }
+            else {
+                BOOST_CHECK(row.empty());
+                errors.push_back(status.message());
+                status.clear();
+            }
+        }
+
+        vector<vector<string> > expectedRows
+            = { { "a", "b", "c" }, { "1", "2", "3" },
+                { "multi\nline", "two", "three" } };
+        vector<string> expectedErrors
+            = { "rows.csv:2:5: non-quoted string with embedded quote",
+                "rows.csv:4:6: invalid end of line: 101 e",
+                "rows.csv:6:1: wrong number of CSV fields",
+                "rows.csv:8:12: file finished inside quote" };
+
+        BOOST_CHECK(rows == expectedRows);
+        BOOST_CHECK_EQUAL(errors, expectedErrors);
+    }
+
+    // The throwing version has the same message
+    ML::Parse_Context context("rows.csv", text.c_str(),
+                              text.c_str() + text.size());
+    Csv_Row row;
+    expect_csv_row(context, row);
+    string error;
+    try {
+        JML_TRACE_EXCEPTIONS(false);
+        expect_csv_row(context, row);
+    } catch (const std::exception & exc) {
+        error = exc.what();
+    }
+    BOOST_CHECK_EQUAL(error,
+                      "rows.csv:2:5: non-quoted string with embedded quote");
+
+    // As do the field by field versions; running out inside a quote has
+    // never had a location
+    auto fieldError = [] (const string & text)
+        {
+            ML::Parse_Context context("rows.csv", text.c_str(),
+                                      text.c_str() + text.size());
+            try {
+                JML_TRACE_EXCEPTIONS(false);
+                bool another;
+                while (context) expect_csv_field(context, another);
+            } catch (const std::exception & exc) {
+                return string(exc.what());
+            }
+            return string();
+        };
+
+    BOOST_CHECK_EQUAL(fieldError("\"bad\"end"),
+                      "rows.csv:1:6: invalid end of line: 101 e");
+    BOOST_CHECK_EQUAL(fieldError("\"unfinished"),
+                      "file finished inside quote");
+
+    ML::Parse_Context context2("rows.csv",
+                               text.c_str() + text.rfind('\n') + 1,
+                               text.c_str() + text.size());
+    error.clear();
+    try {
+        JML_TRACE_EXCEPTIONS(false);
+        expect_csv_row(context2, row);
+    } catch (const std::exception & exc) {
+        error = exc.what();
+    }
+    BOOST_CHECK_EQUAL(error, "file finished inside quote");
+}
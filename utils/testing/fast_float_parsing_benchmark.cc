@@ -0,0 +1,83 @@
+/* fast_float_parsing_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Speed of float parsing against strtod.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/fast_float_parsing.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <string.h>
+
+using namespace ML;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE( benchmark_float_parsing )
+{
+    // Numbers like the ones in our data files, and random bit patterns
+    vector<string> typical, random;
+    uint64_t state = 1;
+    for (unsigned i = 0;  i < 1000000;  ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        typical.push_back(format("%.*f", (int)(state >> 60) % 6,
+                                 (state >> 20) % 10000000 / 1000.0));
+        double d;
+        uint64_t bits = state ^ (state >> 29) * 0x9e3779b97f4a7c15ULL;
+        memcpy(&d, &bits, sizeof(d));
+        if (!std::isfinite(d)) d = i;
+        random.push_back(format("%.17g", d));
+    }
+
+    for (auto * numbers: { &typical, &random }) {
+        size_t bytes = 0;
+        for (auto & s: *numbers)
+            bytes += s.size();
+        double mb = bytes / 1000000.0;
+
+        Timer timer;
+        double total1 = 0;
+        for (auto & s: *numbers)
+            total1 += strtod(s.c_str(), 0);
+        double strtodTime = timer.elapsed_wall();
+
+        timer.restart();
+        double total2 = 0;
+        for (auto & s: *numbers) {
+            const char * p = s.c_str();
+            double d;
+            parse_float(p, p + s.size(), d);
+            total2 += d;
+        }
+        double parseTime = timer.elapsed_wall();
+
+        timer.restart();
+        double total3 = 0;
+        for (auto & s: *numbers) {
+            Parse_Context context("num", s.c_str(), s.size());
+            total3 += context.expect_double();
+        }
+        double contextTime = timer.elapsed_wall();
+
+        BOOST_CHECK_EQUAL(total1, total2);
+        BOOST_CHECK_EQUAL(total1, total3);
+
+        cerr << (numbers == &typical ? "typical" : "random bits") << endl;
+        cerr << format("strtod          %8.1f MB/s %6.1f ns/number",
+                       mb / strtodTime, strtodTime * 1e9 / numbers->size())
+             << endl;
+        cerr << format("parse_float     %8.1f MB/s %6.1f ns/number",
+                       mb / parseTime, parseTime * 1e9 / numbers->size())
+             << endl;
+        cerr << format("expect_double   %8.1f MB/s %6.1f ns/number",
+                       mb / contextTime, contextTime * 1e9 / numbers->size())
+             << endl;
+    }
+}
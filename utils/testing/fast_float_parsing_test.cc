@@ -0,0 +1,152 @@
+/* fast_float_parsing_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test that float parsing is correctly rounded.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/utils/fast_float_parsing.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <sstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <string.h>
+
+using namespace ML;
+using namespace std;
+
+uint64_t rngState = 1;
+
+uint64_t random64()
+{
+    rngState = rngState * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint64_t high = rngState >> 32;
+    rngState = rngState * 6364136223846793005ULL + 1442695040888963407ULL;
+    return high << 32 | rngState >> 32;
+}
+
+template<typename Float>
+Float parseSpan(const string & s)
+{
+    const char * p = s.c_str();
+    Float result;
+    BOOST_REQUIRE(parse_float(p, p + s.size(), result));
+    BOOST_REQUIRE_EQUAL(p, s.c_str() + s.size());
+    return result;
+}
+
+template<typename Float, typename Bits>
+Float fromBits(Bits bits)
+{
+    Float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE( test_round_trip_doubles )
+{
+    for (unsigned i = 0;  i < 1000000;  ++i) {
+        double d = fromBits<double>(random64());
+        if (!std::isfinite(d)) continue;
+
+        // Shortest representations round trip exactly
+        string s = format("%.17g", d);
+        BOOST_REQUIRE_EQUAL(parseSpan<double>(s), d);
+
+        // Others need to give the same answer as strtod
+        s = format("%.*g", (int)(random64() % 25), d);
+        BOOST_REQUIRE_EQUAL(parseSpan<double>(s), strtod(s.c_str(), 0));
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_round_trip_floats )
+{
+    for (unsigned i = 0;  i < 1000000;  ++i) {
+        float f = fromBits<float>((uint32_t)random64());
+        if (!std::isfinite(f)) continue;
+
+        string s = format("%.9g", f);
+        BOOST_REQUIRE_EQUAL(parseSpan<float>(s), f);
+
+        s = format("%.*g", (int)(random64() % 25), f);
+        BOOST_REQUIRE_EQUAL(parseSpan<float>(s), strtof(s.c_str(), 0));
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_hard_cases )
+{
+    // Halfway between two doubles; needs more than 19 digits to decide
+    BOOST_CHECK_EQUAL(parseSpan<double>("9007199254740993"), 9007199254740992.0);
+    BOOST_CHECK_EQUAL(parseSpan<double>("9007199254740993.0000000000000000001"),
+                      9007199254740994.0);
+    BOOST_CHECK_EQUAL(parseSpan<double>("2.4703282292062327e-324"), 0.0);
+    BOOST_CHECK_EQUAL(parseSpan<double>("2.4703282292062328e-324"), 4.9e-324);
+    BOOST_CHECK_EQUAL(parseSpan<double>("1.7976931348623158e308"),
+                      1.7976931348623157e308);
+    BOOST_CHECK_EQUAL(parseSpan<double>("1.7976931348623159e308"), INFINITY);
+    BOOST_CHECK_EQUAL(parseSpan<float>("3.4028235e38"), 3.4028235e38f);
+    BOOST_CHECK_EQUAL(parseSpan<float>("1e-46"), 0.0f);
+    BOOST_CHECK_EQUAL(parseSpan<float>("1.00000005960464477539062500001"),
+                      1.0000001f);
+    BOOST_CHECK_EQUAL(parseSpan<float>("1.000000059604644775390625"), 1.0f);
+    BOOST_CHECK(signbit(parseSpan<double>("-0.0")));
+    BOOST_CHECK(isnan(parseSpan<double>("-nan")));
+    BOOST_CHECK_EQUAL(parseSpan<float>("+inf"), INFINITY);
+
+    // Not numbers; p stays where it was
+    for (string s: { "", "-", ".", "+.", "e5", "nax", "in", "Inf" }) {
+        const char * p = s.c_str();
+        double d;
+        BOOST_CHECK(!parse_float(p, p + s.size(), d));
+        BOOST_CHECK_EQUAL(p, s.c_str());
+    }
+
+    // Stops at the end of the number
+    string s = "1.5e3e4";
+    const char * p = s.c_str();
+    double d;
+    BOOST_CHECK(parse_float(p, p + s.size(), d));
+    BOOST_CHECK_EQUAL(d, 1500.0);
+    BOOST_CHECK_EQUAL(p - s.c_str(), 5);
+}
+
+BOOST_AUTO_TEST_CASE( test_parse_context )
+{
+    string text;
+    vector<double> expected;
+    for (unsigned i = 0;  i < 20000;  ++i) {
+        double d = fromBits<double>(random64());
+        if (!std::isfinite(d)) continue;
+        string s = format("%.*g", (int)(random64() % 20), d);
+        expected.push_back(strtod(s.c_str(), 0));
+        text += s + " ";
+    }
+
+    // Numbers split across buffers give the same result
+    for (size_t chunkSize: { 0, 1, 3, 16, 4096 }) {
+        istringstream stream(text);
+        std::unique_ptr<Parse_Context> context;
+        if (chunkSize == 0)
+            context.reset(new Parse_Context("test", text.c_str(), text.size()));
+        else context.reset(new Parse_Context("test", stream, 1, 1, chunkSize));
+
+        for (unsigned i = 0;  i < expected.size();  ++i) {
+            BOOST_REQUIRE_EQUAL(context->expect_double(), expected[i]);
+            context->expect_literal(' ');
+        }
+        BOOST_CHECK(context->eof());
+    }
+
+    string bad = "-x";
+    Parse_Context context("test", bad.c_str(), bad.size());
+    float f;
+    BOOST_CHECK(!context.match_float(f));
+    BOOST_CHECK_EQUAL(*context, '-');
+}
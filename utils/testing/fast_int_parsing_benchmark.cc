@@ -0,0 +1,72 @@
+/* fast_int_parsing_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Speed of parsing tab separated integer IDs.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/parse_context.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace ML;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE( benchmark_int_parsing )
+{
+    // Lines of a timestamp, two 64 bit IDs and a couple of small counts
+    string text;
+    uint64_t state = 1;
+    unsigned lines = 0;
+    while (text.size() < 100000000) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        text += format("%d\t%llu\t%llu\t%d\t%d\n",
+                       1381900000 + lines / 100,
+                       (unsigned long long)state,
+                       (unsigned long long)(state >> 24),
+                       (int)(state >> 60), (int)(state >> 50) % 1000);
+        ++lines;
+    }
+    double mb = text.size() / 1000000.0;
+
+    auto parse = [&] (Parse_Context & context)
+        {
+            unsigned long long total = 0;
+            while (context) {
+                total += context.expect_int();
+                context.expect_literal('\t');
+                total += context.expect_unsigned_long_long();
+                context.expect_literal('\t');
+                total += context.expect_unsigned_long_long();
+                context.expect_literal('\t');
+                total += context.expect_unsigned();
+                context.expect_literal('\t');
+                total += context.expect_long_long();
+                context.expect_eol();
+            }
+            return total;
+        };
+
+    Timer timer;
+    Parse_Context context("ids", text.c_str(), text.size());
+    unsigned long long total1 = parse(context);
+    double memory = timer.elapsed_wall();
+
+    timer.restart();
+    istringstream stream(text);
+    Parse_Context streamContext("ids", stream);
+    unsigned long long total2 = parse(streamContext);
+    double streamed = timer.elapsed_wall();
+
+    BOOST_CHECK_EQUAL(total1, total2);
+
+    cerr << format("memory          %8.1f MB/s", mb / memory) << endl;
+    cerr << format("stream          %8.1f MB/s", mb / streamed) << endl;
+}
@@ -0,0 +1,154 @@
+/* fast_int_parsing_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test of integer parsing, eight digits at a time.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/utils/fast_int_parsing.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+using namespace ML;
+using namespace std;
+
+uint64_t rngState = 1;
+
+uint64_t random64()
+{
+    rngState = rngState * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint64_t high = rngState >> 32;
+    rngState = rngState * 6364136223846793005ULL + 1442695040888963407ULL;
+    return high << 32 | rngState >> 32;
+}
+
+BOOST_AUTO_TEST_CASE( test_leading_digits )
+{
+    for (unsigned i = 0;  i < 100000;  ++i) {
+        uint64_t chars = random64();
+        // Mostly digits, with the occasional neighbour of one
+        for (unsigned j = 0;  j < 8;  ++j) {
+            static const unsigned char options[]
+                = { '0', '5', '9', '/', ':', 0xb0, 0xb9, 0 };
+            unsigned char c = random64() % 4 ? '0' + random64() % 10
+                : options[random64() % 8];
+            chars = (chars & ~(0xffULL << (8 * j))) | ((uint64_t)c << (8 * j));
+        }
+
+        unsigned expected = 0;
+        while (expected < 8
+               && isdigit((unsigned char)(chars >> (8 * expected))))
+            ++expected;
+        BOOST_REQUIRE_EQUAL(leading_digits(chars), expected);
+
+        if (expected == 8) {
+            char buf[9];
+            memcpy(buf, &chars, 8);
+            buf[8] = 0;
+            BOOST_REQUIRE_EQUAL(eight_digits_value(chars), strtoul(buf, 0, 10));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_parse_digits )
+{
+    // Every length, with something after it and without
+    for (unsigned len = 1;  len <= 20;  ++len) {
+        for (unsigned i = 0;  i < 1000;  ++i) {
+            string s;
+            for (unsigned j = 0;  j < len;  ++j)
+                s += '0' + random64() % 10;
+            unsigned long long expected = strtoull(s.c_str(), 0, 10);
+            if (len == 20) {
+                // Wraps around, like the digit by digit loop
+                expected = 0;
+                for (char c: s) expected = expected * 10 + (c - '0');
+            }
+            string suffix = i % 2 ? "" : string(1, "\t,x \n"[i % 5])
+                + string(random64() % 10, '7');
+
+            string text = s + suffix;
+            unsigned long long val = 0;
+            const char * p = parse_digits(text.c_str(),
+                                          text.c_str() + text.size(), val);
+            BOOST_REQUIRE_EQUAL(p - text.c_str(), s.size());
+            BOOST_REQUIRE_EQUAL(val, expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_parse_context_ints )
+{
+    string text;
+    vector<long long> expected;
+    for (unsigned i = 0;  i < 20000;  ++i) {
+        long long val = (long long)(random64() >> (random64() % 64));
+        if (random64() % 2) val = -val;
+        expected.push_back(val);
+        text += (random64() % 4 == 0 && val >= 0 ? "+" : "")
+            + to_string(val) + (i % 3 ? "\t" : "\n");
+    }
+
+    // Numbers split across buffers give the same result
+    for (size_t chunkSize: { 0, 1, 3, 9, 4096 }) {
+        istringstream stream(text);
+        std::unique_ptr<Parse_Context> context;
+        if (chunkSize == 0)
+            context.reset(new Parse_Context("test", text.c_str(), text.size()));
+        else context.reset(new Parse_Context("test", stream, 1, 1, chunkSize));
+
+        for (unsigned i = 0;  i < expected.size();  ++i) {
+            BOOST_REQUIRE_EQUAL(context->expect_long_long(), expected[i]);
+            context->expect_literal(i % 3 ? '\t' : '\n');
+        }
+        BOOST_CHECK(context->eof());
+        BOOST_CHECK_EQUAL(context->get_offset(), text.size());
+        BOOST_CHECK_EQUAL(context->get_line(), 1 + (expected.size() + 2) / 3);
+    }
+
+    string line = "123 4567890123456 -17 x";
+    Parse_Context context("test", line.c_str(), line.size());
+    BOOST_CHECK_EQUAL(context.expect_unsigned(), 123);
+    BOOST_CHECK_EQUAL(context.get_col(), 4);
+    context.expect_whitespace();
+    BOOST_CHECK_EQUAL(context.expect_unsigned_long_long(), 4567890123456ULL);
+    BOOST_CHECK_EQUAL(context.get_col(), 18);
+    context.expect_whitespace();
+    unsigned u;
+    BOOST_CHECK(!context.match_unsigned(u));
+    BOOST_CHECK_EQUAL(context.expect_int(), -17);
+    context.expect_whitespace();
+    int i;
+    BOOST_CHECK(!context.match_int(i));
+    BOOST_CHECK_EQUAL(*context, 'x');
+
+    // A sign without digits is left where it is, wherever the buffer ends
+    string signs = "-x+ -";
+    for (size_t chunkSize: { 0, 1, 2, 3 }) {
+        istringstream stream(signs);
+        std::unique_ptr<Parse_Context> context;
+        if (chunkSize == 0)
+            context.reset(new Parse_Context("test", signs.c_str(),
+                                            signs.size()));
+        else context.reset(new Parse_Context("test", stream, 1, 1, chunkSize));
+
+        long long val;
+        BOOST_CHECK(!context->match_long_long(val));
+        BOOST_CHECK_EQUAL(context->get_offset(), 0);
+        context->expect_literal("-x");
+        BOOST_CHECK(!context->match_long_long(val));
+        context->expect_literal("+ ");
+        BOOST_CHECK(!context->match_long_long(val));
+        context->expect_literal('-');
+        BOOST_CHECK(context->eof());
+    }
+}
@@ -0,0 +1,54 @@
+/* filter_streams_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Speed of writing gzip with the single threaded compressor versus the
+   parallel one.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/filter_streams.h"
+#include "jml/utils/parallel_gzip.h"
+#include "jml/utils/file_functions.h"
+#include "jml/utils/worker_task.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace ML;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE( benchmark_parallel_gzip )
+{
+    string text;
+    for (unsigned i = 0;  text.size() < 100000000;  ++i)
+        text += format("user=u%d;count=%d;path=/a/b/%d;ok=%d\n",
+                       i * 7, i % 100, i, i % 2);
+    double mb = text.size() / 1000000.0;
+
+    string filename = format("/tmp/filter_streams_benchmark-%d.gz", getpid());
+
+    cerr << num_threads() << " threads" << endl;
+    registerParallelGzip();
+
+    for (string compression: { "gz", "pigz" }) {
+        Timer timer;
+        {
+            filter_ostream stream(filename, ios::out, compression);
+            stream.write(text.c_str(), text.size());
+        }
+        double elapsed = timer.elapsed_wall();
+        size_t size = get_file_size(filename);
+
+        cerr << format("%-5s %7.1f MB/s  %10zd bytes",
+                       compression.c_str(), mb / elapsed, size)
+             << endl;
+    }
+
+    unlink(filename.c_str());
+}
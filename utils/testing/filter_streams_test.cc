@@ -10,7 +10,9 @@
 
 #include "jml/utils/file_functions.h"
 #include "jml/utils/filter_streams.h"
+#include "jml/utils/parallel_gzip.h"
 #include "jml/arch/exception.h"
+#include "jml/arch/format.h"
 #include "jml/arch/exception_handler.h"
 
 #include <boost/filesystem.hpp>
@@ -21,6 +23,7 @@
 #include <vector>
 #include <stdint.h>
 #include <iostream>
+#include <iterator>
 #include <fcntl.h>
 
 #include "jml/utils/guard.h"
@@ -251,3 +254,39 @@ BOOST_AUTO_TEST_CASE( test_empty_gzip )
         }
     }
 }
+
+/* parallel gzip gives ordinary gzip files, whatever the size */
+BOOST_AUTO_TEST_CASE( test_parallel_gzip )
+{
+    fs::create_directories("build/x86_64/tmp");
+    string filename = "build/x86_64/tmp/parallel.gz";
+    string plain = "build/x86_64/tmp/parallel";
+    FileCleanup cleanup1(filename), cleanup2(plain);
+
+    // Text that compresses, crossing block boundaries in various places
+    string text;
+    for (unsigned i = 0;  text.size() < 3000000;  ++i)
+        text += format("line %d of the parallel gzip test %d\n", i, i % 17);
+
+    registerParallelGzip();
+
+    for (size_t size: { 0, 1, 1000, 131072, 131073, 3000000 }) {
+        string data(text, 0, size);
+        {
+            ML::filter_ostream stream(filename, ios::out, "pigz", 9);
+            // Written in odd sized pieces
+            for (size_t i = 0;  i < size;  i += 9999)
+                stream.write(data.c_str() + i, std::min<size_t>(9999, size - i));
+        }
+
+        // Both gzip and our own stream can read it back
+        system("gzip -t " + filename);
+        system("gzip -dc " + filename + " > " + plain);
+        BOOST_CHECK_EQUAL(get_file_size(plain), size);
+
+        ML::filter_istream stream(filename);
+        string read((std::istreambuf_iterator<char>(stream)),
+                    std::istreambuf_iterator<char>());
+        BOOST_CHECK(read == data);
+    }
+}
@@ -0,0 +1,118 @@
+/* find_first_of_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Speed of the vectorized character search against a loop over the
+   characters, and of reading lines with Parse_Context.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/find_first_of.h"
+#include "jml/utils/parse_context.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <string>
+
+using namespace ML;
+using namespace std;
+
+/** Text with the delimiter every runLength characters. */
+string makeText(size_t bytes, int runLength)
+{
+    string result(bytes, 'x');
+    for (size_t i = runLength;  i < bytes;  i += runLength + 1)
+        result[i] = i % 2 ? ',' : '\n';
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_find_first_of)
+{
+    cerr << "using " << Find_First_Of::implementation() << endl;
+    cerr << "run length  scalar GB/s  vector GB/s" << endl;
+
+    Find_First_Of finder(",\n\"\r");
+
+    for (int runLength: { 4, 16, 64, 256, 4096 }) {
+        string text = makeText(100000000, runLength);
+        const char * start = text.c_str(), * end = start + text.size();
+        size_t n1 = 0, n2 = 0;
+
+        Timer timer;
+        for (const char * p = start;  p != end;  ++p, ++n1) {
+            while (p != end && *p != ',' && *p != '\n' && *p != '"'
+                   && *p != '\r')
+                ++p;
+            if (p == end) break;
+        }
+        double scalar = timer.elapsed_wall();
+
+        timer.restart();
+        for (const char * p = start;  p != end;  ++p, ++n2) {
+            p = finder(p, end);
+            if (p == end) break;
+        }
+        double vector = timer.elapsed_wall();
+
+        BOOST_CHECK_EQUAL(n1, n2);
+
+        cerr << format("%10d  %11.2f  %11.2f", runLength,
+                       text.size() / scalar / 1e9, text.size() / vector / 1e9)
+             << endl;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_parse_context_lines)
+{
+    cerr << "line length  predicate MB/s  match_line MB/s  skip_line MB/s"
+         << endl;
+
+    for (int lineLength: { 16, 100, 1000 }) {
+        string text;
+        while (text.size() < 100000000)
+            text += string(lineLength, 'x') + '\n';
+        double mb = text.size() / 1000000.0;
+        size_t n1 = 0, n2 = 0, n3 = 0;
+
+        Timer timer;
+        {
+            Parse_Context context("text", text.c_str(), text.size());
+            string line;
+            while (context) {
+                context.match_text(line, Parse_Context::Matches_Char('\n'));
+                context.match_eol();
+                n1 += line.size();
+            }
+        }
+        double predicate = timer.elapsed_wall();
+
+        timer.restart();
+        {
+            Parse_Context context("text", text.c_str(), text.size());
+            string line;
+            while (context.match_line(line))
+                n2 += line.size();
+        }
+        double matchLine = timer.elapsed_wall();
+
+        timer.restart();
+        {
+            Parse_Context context("text", text.c_str(), text.size());
+            while (context) {
+                context.skip_line();
+                ++n3;
+            }
+        }
+        double skipLine = timer.elapsed_wall();
+
+        BOOST_CHECK_EQUAL(n1, n2);
+        BOOST_CHECK_EQUAL(n3 * lineLength, n2);
+
+        cerr << format("%11d  %14.1f  %15.1f  %14.1f", lineLength,
+                       mb / predicate, mb / matchLine, mb / skipLine)
+             << endl;
+    }
+}
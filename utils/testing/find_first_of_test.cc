@@ -0,0 +1,127 @@
+/* find_first_of_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test of the vectorized character search, and of the parsing functions
+   that use it.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/utils/find_first_of.h"
+#include "jml/utils/parse_context.h"
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace ML;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE(test_find_first_of)
+{
+    cerr << "using " << Find_First_Of::implementation() << endl;
+
+    const char * sets[] = { "\n", ",\n", ",\n\"", "\t|\n\r", "ab\n\r\"\xff",
+                            "\x80" };
+
+    // Every length and alignment up to a few vectors, with the match in
+    // every position
+    char buf[256];
+    uint64_t r = 1;
+    for (const char * set: sets) {
+        Find_First_Of finder(set);
+        BOOST_CHECK_EQUAL(finder.nchars, strlen(set));
+
+        for (unsigned len = 0;  len < 100;  ++len) {
+            for (unsigned align = 0;  align < 33;  ++align) {
+                char * start = buf + align;
+                for (unsigned i = 0;  i < len;  ++i)
+                    start[i] = 'A' + i % 20;
+                BOOST_REQUIRE_EQUAL(finder(start, start + len), start + len);
+
+                for (unsigned pos = 0;  pos < len;  ++pos) {
+                    r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+                    start[pos] = set[(r >> 40) % strlen(set)];
+                    // A second one later on mustn't matter
+                    if (pos + 3 < len) start[pos + 3] = set[0];
+                    BOOST_REQUIRE_EQUAL(finder(start, start + len),
+                                        start + pos);
+                    start[pos] = 'A' + pos % 20;
+                    if (pos + 3 < len) start[pos + 3] = 'A' + (pos + 3) % 20;
+                }
+            }
+        }
+    }
+
+    // The null character can be looked for too
+    string s("abc\0def", 7);
+    BOOST_CHECK_EQUAL(Find_First_Of("", 1)(s.c_str(), s.c_str() + 7) - s.c_str(),
+                      3);
+
+    BOOST_CHECK_THROW(Find_First_Of(""), ML::Exception);
+    BOOST_CHECK_THROW(Find_First_Of("1234567"), ML::Exception);
+}
+
+BOOST_AUTO_TEST_CASE(test_parse_context_scanning)
+{
+    string text;
+    for (unsigned i = 0;  i < 1000;  ++i)
+        text += string(i % 97, 'x') + (i % 3 ? "|y\n" : "\n");
+
+    for (size_t chunkSize: { 1, 3, 16, 100, 65536 }) {
+        istringstream stream1(text), stream2(text);
+        Parse_Context context1("text", stream1, 1, 1, chunkSize);
+        Parse_Context context2("text", stream2, 1, 1, chunkSize);
+
+        for (unsigned i = 0;  context1;  ++i) {
+            BOOST_REQUIRE(context2);
+            if (i % 3 == 0) {
+                string line = context1.expect_line();
+                BOOST_REQUIRE_EQUAL(line.size() % 97, i % 97 + (i % 3 ? 2 : 0));
+                context2.skip_line();
+            }
+            else {
+                // Predicate version versus vectorized version
+                string text1, text2;
+                context1.match_text(text1, Parse_Context::Matches_Char('|'));
+                context2.match_text(text2, "|\n");
+                BOOST_REQUIRE_EQUAL(text1, text2);
+                context1.expect_literal('|');
+                context2.expect_literal('|');
+                context1.skip_line();
+                context2.skip_line();
+            }
+
+            BOOST_REQUIRE_EQUAL(context1.get_offset(), context2.get_offset());
+            BOOST_REQUIRE_EQUAL(context1.get_line(), context2.get_line());
+            BOOST_REQUIRE_EQUAL(context1.get_col(), context2.get_col());
+        }
+        BOOST_CHECK(!context2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_count_char)
+{
+    // Long enough for the per-byte counters to need flushing
+    string text(20000, 'x');
+    uint64_t r = 1;
+    for (auto & c: text) {
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        if ((r >> 40) % 3 == 0) c = '\n';
+    }
+
+    for (unsigned start: { 0, 1, 17, 31 }) {
+        for (size_t len: { 0, 1, 15, 16, 33, 100, 8160, 8161, 19000 }) {
+            const char * p = text.c_str() + start;
+            BOOST_REQUIRE_EQUAL(count_char(p, p + len, '\n'),
+                                std::count(p, p + len, '\n'));
+        }
+    }
+
+    BOOST_CHECK_EQUAL(count_char(text.c_str(), text.c_str() + text.size(), 'y'),
+                      0);
+}
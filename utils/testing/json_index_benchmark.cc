@@ -0,0 +1,133 @@
+/* json_index_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Speed of parsing lines of JSON events with the two stage parser against
+   the Parse_Context based functions.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/json_index.h"
+#include "jml/utils/json_parsing.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <string>
+
+using namespace ML;
+using namespace std;
+
+/** Lines that look like the events in our logs. */
+string makeEvents(size_t bytes)
+{
+    string result;
+    for (unsigned i = 0;  result.size() < bytes;  ++i) {
+        result += format("{\"id\":%d,\"timestamp\":%d.%03d,\"type\":\"%s\","
+                         "\"user\":{\"id\":\"u%08x\",\"segments\":[%d,%d,%d],"
+                         "\"geo\":{\"lat\":%.4f,\"lon\":%.4f}},"
+                         "\"price\":%.2f,\"url\":\"http:\\/\\/example.com\\/p%d\","
+                         "\"flags\":[true,false,null]}\n",
+                         i, 1381900000 + i / 100, i % 1000,
+                         i % 3 ? "impression" : "click",
+                         i * 2654435761U, i % 17, i % 101, i % 1009,
+                         45.0 + (i % 1000) / 1000.0, -73.0 - (i % 777) / 1000.0,
+                         (i % 10000) / 100.0, i);
+    }
+    return result;
+}
+
+/** Add up the numbers, so that nothing can be skipped. */
+double sumNumbers(Parse_Context & context)
+{
+    skipJsonWhitespace(context);
+    double total = 0;
+    if (*context == '{') {
+        expectJsonObject(context, [&] (string key, Parse_Context & context)
+                         {
+                             total += sumNumbers(context);
+                         });
+    }
+    else if (*context == '[') {
+        expectJsonArray(context, [&] (int i, Parse_Context & context)
+                        {
+                            total += sumNumbers(context);
+                        });
+    }
+    else if (*context == '"') {
+        string s;
+        matchJsonString(context, s);
+    }
+    else if (context.match_literal("true") || context.match_literal("false")
+             || context.match_literal("null")) {
+    }
+    else {
+        JsonNumber num = expectJsonNumber(context);
+        total += num.type == JsonNumber::FLOATING_POINT ? num.fp : num.uns;
+    }
+    return total;
+}
+
+double sumNumbers(const JsonValue & value)
+{
+    double total = 0;
+    switch (value.type()) {
+    case JsonValue::NUMBER: {
+        JsonNumber num = value.asNumber();
+        return num.type == JsonNumber::FLOATING_POINT ? num.fp : num.uns;
+    }
+    case JsonValue::ARRAY:
+    case JsonValue::OBJECT:
+        for (auto v: value)
+            total += sumNumbers(v);
+        return total;
+    default:
+        return 0;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_json_lines)
+{
+    string text = makeEvents(100000000);
+    double mb = text.size() / 1000000.0;
+    cerr << "using " << JsonStructuralIndex::implementation() << endl;
+
+    Timer timer;
+    double total1 = 0;
+    {
+        Parse_Context context("events", text.c_str(), text.size());
+        while (context) {
+            total1 += sumNumbers(context);
+            context.expect_eol();
+        }
+    }
+    double parseContext = timer.elapsed_wall();
+
+    timer.restart();
+    JsonStructuralIndex index;
+    size_t positions = 0;
+    for (size_t i = 0;  i < text.size();  i += 1 << 20) {
+        const char * start = text.c_str() + i;
+        index.build(start, start + std::min<size_t>(1 << 20, text.size() - i));
+        positions += index.size();
+    }
+    double indexOnly = timer.elapsed_wall();
+
+    timer.restart();
+    double total2 = 0;
+    parseJsonLines(text.c_str(), text.c_str() + text.size(),
+                   [&] (const JsonValue & value)
+                   {
+                       total2 += sumNumbers(value);
+                   });
+    double twoStage = timer.elapsed_wall();
+
+    BOOST_CHECK_EQUAL(total1, total2);
+    BOOST_CHECK(positions > 0);
+
+    cerr << format("Parse_Context   %8.1f MB/s", mb / parseContext) << endl;
+    cerr << format("index only      %8.1f MB/s", mb / indexOnly) << endl;
+    cerr << format("two stage       %8.1f MB/s", mb / twoStage) << endl;
+}
@@ -0,0 +1,355 @@
+/* json_index_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test of the two stage JSON parser.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/utils/json_index.h"
+#include "jml/utils/json_parsing.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <limits.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace ML;
+using namespace std;
+
+string reparse(const string & json)
+{
+    JsonDocument doc;
+    doc.parse(json.c_str(), json.c_str() + json.size());
+    return doc.root().toString();
+}
+
+string parseError(const string & json)
+{
+    // The non-throwing version needs to say the same thing
+    JsonDocument doc;
+    Parse_Status status;
+    string noThrow;
+    if (!doc.parse(json.c_str(), json.c_str() + json.size(), status)) {
+        BOOST_CHECK_EQUAL(doc.nodes.size(), 0);
+        noThrow = status.message();
+    }
+
+    try {
+        JML_TRACE_EXCEPTIONS(false);
+        reparse(json);
+    } catch (const std::exception & exc) {
+        BOOST_CHECK_EQUAL(noThrow, exc.what());
+        return exc.what();
+    }
+    BOOST_CHECK_EQUAL(noThrow, "");
+    return "";
+}
+
+/** The same compact form as JsonValue::toString(), but with the
+    Parse_Context based parser. */
+string reference(Parse_Context & context)
+{
+    skipJsonWhitespace(context);
+    if (*context == '{') {
+        string result = "{";
+        expectJsonObject(context, [&] (string key, Parse_Context & context)
+                         {
+                             if (result.size() > 1) result += ',';
+                             result += '"' + key + "\":" + reference(context);
+                         });
+        return result + "}";
+    }
+    else if (*context == '[') {
+        string result = "[";
+        expectJsonArray(context, [&] (int i, Parse_Context & context)
+                        {
+                            if (i > 0) result += ',';
+                            result += reference(context);
+                        });
+        return result + "]";
+    }
+    else if (*context == '"') {
+        string s;
+        BOOST_REQUIRE(matchJsonString(context, s));
+        return '"' + s + '"';
+    }
+    else if (context.match_literal("true")) return "true";
+    else if (context.match_literal("false")) return "false";
+    else if (context.match_literal("null")) return "null";
+
+    JsonNumber num = expectJsonNumber(context);
+    switch (num.type) {
+    case JsonNumber::UNSIGNED_INT: return format("%llu", num.uns);
+    case JsonNumber::SIGNED_INT: return format("%lld", num.sgn);
+    default: return format("%.17g", num.fp);
+    }
+}
+
+uint64_t rngState = 1;
+
+unsigned random(unsigned n)
+{
+    rngState = rngState * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (rngState >> 33) % n;
+}
+
+/** Random JSON with random whitespace, and strings without escapes (which
+    the reference parser handles differently). */
+string randomJson(int depth)
+{
+    static const char * ws[] = { "", "", "", " ", "\n", "\t ", "\r\n  " };
+    string w = ws[random(7)];
+
+    switch (depth > 4 ? random(5) : random(7)) {
+    case 0: return w + to_string(random(1000000));
+    case 1: return w + "-" + to_string(random(1000)) + "." + to_string(random(100))
+            + (random(2) ? "e" + to_string(random(20)) : "");
+    case 2: return w + string(random(2) ? "true" : "false");
+    case 3: return w + "null";
+    case 4: {
+        string s(random(100), 'a');
+        for (auto & c: s) c = "ab,:{}[] x"[random(10)];
+        return w + '"' + s + '"';
+    }
+    case 5: {
+        string result = w + "[";
+        for (unsigned i = 0, n = random(6);  i < n;  ++i)
+            result += (i ? "," : "") + randomJson(depth + 1) + ws[random(7)];
+        return result + ws[random(7)] + "]";
+    }
+    default: {
+        string result = w + "{";
+        for (unsigned i = 0, n = random(6);  i < n;  ++i)
+            result += (i ? "," : "") + string(ws[random(7)])
+                + "\"k" + to_string(i) + "\"" + ws[random(7)] + ":"
+                + randomJson(depth + 1);
+        return result + ws[random(7)] + "}";
+    }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_json_index)
+{
+    cerr << "using " << JsonStructuralIndex::implementation() << endl;
+
+    string json = " {\"a\": [1, -2, 3.5e2, true, false, null],\"b\\\"\":\"x,{y}\"}";
+    JsonStructuralIndex index;
+    index.build(json.c_str(), json.c_str() + json.size());
+
+    string found;
+    for (unsigned i = 0;  i < index.size();  ++i)
+        found += json[index[i]];
+    BOOST_CHECK_EQUAL(found, "{\"\":[1,-,3,t,f,n],\"\":\"\"}");
+}
+
+BOOST_AUTO_TEST_CASE(test_json_document)
+{
+    BOOST_CHECK_EQUAL(reparse("{}"), "{}");
+    BOOST_CHECK_EQUAL(reparse(" [ ] "), "[]");
+    BOOST_CHECK_EQUAL(reparse("[1,2,[3,[]],{\"a\":{}}]"), "[1,2,[3,[]],{\"a\":{}}]");
+    BOOST_CHECK_EQUAL(reparse("-12"), "-12");
+    BOOST_CHECK_EQUAL(reparse("18446744073709551615"), "18446744073709551615");
+    BOOST_CHECK_EQUAL(reparse("-9223372036854775808"), "-9223372036854775808");
+    BOOST_CHECK_EQUAL(reparse("\"a\\\"b\\\\c\\/\\n\""), "\"a\\\"b\\\\c/\\n\"");
+    BOOST_CHECK_EQUAL(reparse("\"\\u00e9\\ud83d\\ude00\""), "\"\xc3\xa9\xf0\x9f\x98\x80\"");
+
+    string json = "{\"name\": \"bob\", \"age\": 42, \"scores\": [1.5, -2, 3],"
+        " \"esc\\\\aped\": \"t\\tab\", \"nested\": {\"ok\": true, \"no\": null}}";
+    JsonDocument doc;
+    doc.parse(json.c_str(), json.c_str() + json.size());
+    JsonValue root = doc.root();
+
+    BOOST_CHECK(root.isObject());
+    BOOST_CHECK_EQUAL(root.size(), 5);
+    BOOST_CHECK_EQUAL(root["name"].asString(), "bob");
+    BOOST_CHECK_EQUAL(root["age"].asInt(), 42);
+    BOOST_CHECK_EQUAL(root["age"].asNumber().type, JsonNumber::UNSIGNED_INT);
+    BOOST_CHECK_EQUAL(root["scores"].size(), 3);
+    BOOST_CHECK_EQUAL(root["scores"][0].asDouble(), 1.5);
+    BOOST_CHECK_EQUAL(root["scores"][1].asInt(), -2);
+    BOOST_CHECK_EQUAL(root["scores"][2].asUInt(), 3);
+    BOOST_CHECK_EQUAL(root["esc\\aped"].asString(), "t\tab");
+    BOOST_CHECK_EQUAL(root["nested"]["ok"].asBool(), true);
+    BOOST_CHECK(root["nested"]["no"].isNull());
+    BOOST_CHECK(!root.has("missing"));
+
+    // Unescaped strings point into the buffer
+    BOOST_CHECK_EQUAL(root["name"].stringData(), json.c_str() + 10);
+
+    vector<string> keys;
+    for (auto it = root.begin();  it != root.end();  ++it)
+        keys.push_back(it.key().asString());
+    BOOST_CHECK_EQUAL(keys.size(), 5);
+    BOOST_CHECK_EQUAL(keys[4], "nested");
+
+    JML_TRACE_EXCEPTIONS(false);
+    BOOST_CHECK_THROW(root["missing"], ML::Exception);
+    BOOST_CHECK_THROW(root["name"].asInt(), ML::Exception);
+    BOOST_CHECK_THROW(root["scores"][3], ML::Exception);
+
+    // The most negative integer must not overflow on negation
+    JsonDocument limits;
+    string minimum = "[-9223372036854775808,18446744073709551615]";
+    limits.parse(minimum.c_str(), minimum.c_str() + minimum.size());
+    BOOST_CHECK_EQUAL(limits.root()[0].asNumber().type, JsonNumber::SIGNED_INT);
+    BOOST_CHECK_EQUAL(limits.root()[0].asNumber().sgn, LLONG_MIN);
+    BOOST_CHECK_EQUAL(limits.root()[1].asNumber().uns, ULLONG_MAX);
+}
+
+BOOST_AUTO_TEST_CASE(test_json_errors)
+{
+    BOOST_CHECK_EQUAL(parseError("{\"a\":1,\n \"b\" 2}"),
+                      "<json>:2:6: expected ':'");
+    BOOST_CHECK_EQUAL(parseError("[1,2"),
+                      "<json>:1:5: unexpected end of JSON; expected ',' or ']'");
+    BOOST_CHECK_EQUAL(parseError("[1 2]"), "<json>:1:4: expected ',' or ']'");
+    BOOST_CHECK_EQUAL(parseError("{1:2}"), "<json>:1:2: expected string key");
+    BOOST_CHECK_EQUAL(parseError("[tru]"), "<json>:1:2: expected true");
+    BOOST_CHECK_EQUAL(parseError("[nullx]"), "<json>:1:2: expected null");
+    BOOST_CHECK_EQUAL(parseError("[1.2.3]"), "<json>:1:2: expected number");
+    BOOST_CHECK_EQUAL(parseError("[-]"), "<json>:1:2: expected number");
+    BOOST_CHECK_EQUAL(parseError("\"abc"),
+                      "<json>:1:5: unexpected end of JSON; expected closing quote");
+    BOOST_CHECK_EQUAL(parseError("\"\\q\""), "<json>:1:3: invalid escaped char");
+    BOOST_CHECK_EQUAL(parseError("1 2"), "<json>:1:3: expected end of JSON");
+    BOOST_CHECK_EQUAL(parseError(""),
+                      "<json>:1:1: unexpected end of JSON; expected value");
+    BOOST_CHECK_EQUAL(parseError(string(2000, '[')),
+                      "<json>:1:1025: JSON nested too deeply");
+}
+
+BOOST_AUTO_TEST_CASE(test_json_escapes_across_blocks)
+{
+    // Runs of backslashes ending at every position relative to the 64
+    // character blocks
+    for (unsigned pad = 0;  pad < 70;  ++pad) {
+        for (unsigned n = 0;  n < 6;  ++n) {
+            string s = string(pad, 'x') + string(2 * n, '\\') + "\\\"";
+            string json = "[\"" + s + "\",\"" + s + "\"]";
+            JsonDocument doc;
+            doc.parse(json.c_str(), json.c_str() + json.size());
+            string expected = string(pad, 'x') + string(n, '\\') + "\"";
+            BOOST_REQUIRE_EQUAL(doc.root().size(), 2);
+            BOOST_REQUIRE_EQUAL(doc.root()[1].asString(), expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_json_random)
+{
+    for (unsigned i = 0;  i < 2000;  ++i) {
+        string json = randomJson(0);
+        Parse_Context context("ref", json.c_str(), json.size());
+        string expected = reference(context);
+        BOOST_REQUIRE_EQUAL(reparse(json), expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_json_lines)
+{
+    string text;
+    vector<string> expected;
+    for (unsigned i = 0;  text.size() < 3000000;  ++i) {
+        string json = "{\"i\":" + to_string(i) + ",\"v\":" + randomJson(2) + "}";
+        std::replace(json.begin(), json.end(), '\n', ' ');
+        expected.push_back(reparse(json));
+        text += json + "\n";
+    }
+
+    vector<string> lines;
+    parseJsonLines(text.c_str(), text.c_str() + text.size(),
+                   [&] (const JsonValue & value)
+                   {
+                       lines.push_back(value.toString());
+                   });
+    BOOST_REQUIRE(lines == expected);
+
+    // SAX events for the same thing
+    struct Counter: public JsonSaxHandler {
+        Counter() : objects(0), scalars(0) {}
+        size_t objects, scalars;
+        virtual void onNull() { ++scalars; }
+        virtual void onBool(bool) { ++scalars; }
+        virtual void onNumber(const JsonNumber &) { ++scalars; }
+        virtual void onString(const char *, size_t) { ++scalars; }
+        virtual void onStartObject() { ++objects; }
+        virtual void onKey(const char *, size_t) {}
+        virtual void onEndObject() {}
+        virtual void onStartArray() {}
+        virtual void onEndArray() {}
+    } counter;
+
+    JsonStructuralIndex index;
+    string some = "{\"a\":[1,\"x\",null]}\n{\"b\":{}}\n";
+    index.build(some.c_str(), some.c_str() + some.size());
+    walkJson(index, counter);
+    BOOST_CHECK_EQUAL(counter.objects, 3);
+    BOOST_CHECK_EQUAL(counter.scalars, 3);
+
+    // Errors have the line number in the file, not the batch
+    text += "{\"i\":}\n";
+    string error;
+    try {
+        JML_TRACE_EXCEPTIONS(false);
+        parseJsonLines(text.c_str(), text.c_str() + text.size(),
+                       [] (const JsonValue &) {}, "lines.json");
+    } catch (const std::exception & exc) {
+        error = exc.what();
+    }
+    BOOST_CHECK_EQUAL(error, format("lines.json:%zd:6: expected number",
+                                    expected.size() + 1));
+}
+
+BOOST_AUTO_TEST_CASE(test_json_lines_errors)
+{
+    // Bad lines, including unterminated strings that upset the index,
+    // scattered through several batches
+    const char * bad[] = { "{\"i\":}", "{\"i\":\"open}", "[1,2",
+                           "{\"i\":\"a\\q\"}", "{\"i\" 1}", "[\"x" };
+    string text;
+    vector<string> expected;
+    vector<size_t> badLines;
+    size_t line = 1;
+    for (unsigned i = 0;  text.size() < 3000000;  ++i, ++line) {
+        if (i % 97 == 13) {
+            text += string(bad[i % 6]) + "\n";
+            badLines.push_back(line);
+            continue;
+        }
+        string json = "{\"i\":" + to_string(i) + ",\"v\":" + randomJson(2) + "}";
+        std::replace(json.begin(), json.end(), '\n', ' ');
+        expected.push_back(reparse(json));
+        text += json + "\n";
+    }
+
+    vector<string> lines;
+    vector<size_t> errorLines;
+    parseJsonLines(text.c_str(), text.c_str() + text.size(),
+                   [&] (const JsonValue & value)
+                   {
+                       lines.push_back(value.toString());
+                   },
+                   [&] (const Parse_Status & status)
+                   {
+                       BOOST_CHECK(!status.ok());
+                       BOOST_CHECK_EQUAL(status.message().find("lines.json:"
+                                                               + to_string(status.line)
+                                                               + ":"), 0);
+                       errorLines.push_back(status.line);
+                   },
+                   "lines.json");
+    BOOST_CHECK_EQUAL(lines.size(), expected.size());
+    BOOST_REQUIRE(lines == expected);
+
+    // An unterminated string is only found to be wrong on the next line
+    BOOST_REQUIRE_EQUAL(errorLines.size(), badLines.size());
+    for (unsigned i = 0;  i < badLines.size();  ++i)
+        BOOST_CHECK(errorLines[i] == badLines[i]
+                    || errorLines[i] == badLines[i] + 1);
+}
@@ -0,0 +1,124 @@
+/* json_parsing_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Speed of parsing JSON objects with std::function callbacks against the
+   inlined versions that dispatch on key hashes.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/json_parsing.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <string>
+
+using namespace ML;
+using namespace std;
+
+struct Event {
+    unsigned long long id;
+    unsigned long long user;
+    long long segments;
+    std::string type;
+};
+
+BOOST_AUTO_TEST_CASE(benchmark_json_objects)
+{
+    string text;
+    for (unsigned i = 0;  text.size() < 50000000;  ++i)
+        text += format("{\"id\":%d,\"type\":\"%s\",\"user\":{\"id\":%d,"
+                       "\"segments\":[%d,%d,%d]},\"flags\":{\"a\":1,\"b\":2}}\n",
+                       i, i % 3 ? "impression" : "click", i * 7,
+                       i % 17, i % 101, i % 1009);
+    double mb = text.size() / 1000000.0;
+
+    unsigned long long total1 = 0, total2 = 0;
+
+    Timer timer;
+    {
+        Parse_Context context("events", text.c_str(), text.size());
+        Event event;
+        while (context) {
+            expectJsonObject(context, [&] (string key, Parse_Context & context)
+                {
+                    if (key == "id") event.id = context.expect_unsigned_long_long();
+                    else if (key == "type") event.type = expectJsonStringAscii(context);
+                    else if (key == "user") {
+                        expectJsonObject(context, [&] (string key, Parse_Context & context)
+                            {
+                                if (key == "id")
+                                    event.user = context.expect_unsigned_long_long();
+                                else if (key == "segments") {
+                                    expectJsonArray(context, [&] (int, Parse_Context & context)
+                                                    {
+                                                        event.segments += context.expect_int();
+                                                    });
+                                }
+                            });
+                    }
+                    else {
+                        expectJsonObject(context, [&] (string key, Parse_Context & context)
+                                         {
+                                             context.expect_int();
+                                         });
+                    }
+                });
+            total1 += event.id + event.user + event.type.size();
+            context.expect_eol();
+        }
+        total1 += event.segments;
+    }
+    double functions = timer.elapsed_wall();
+
+    timer.restart();
+    {
+        Parse_Context context("events", text.c_str(), text.size());
+        Event event;
+        while (context) {
+            expectJsonObjectInline(context, [&] (const JsonKey & key, Parse_Context & context)
+                {
+                    switch (key.hash()) {
+                    case jsonKeyHash("id"):
+                        if (key != "id") break;
+                        event.id = context.expect_unsigned_long_long();
+                        return;
+                    case jsonKeyHash("type"):
+                        if (key != "type") break;
+                        event.type = expectJsonStringAscii(context);
+                        return;
+                    case jsonKeyHash("user"):
+                        if (key != "user") break;
+                        expectJsonObjectInline(context, [&] (const JsonKey & key, Parse_Context & context)
+                            {
+                                if (key == "id")
+                                    event.user = context.expect_unsigned_long_long();
+                                else if (key == "segments") {
+                                    expectJsonArrayInline(context, [&] (int, Parse_Context & context)
+                                                          {
+                                                              event.segments += context.expect_int();
+                                                          });
+                                }
+                            });
+                        return;
+                    }
+                    expectJsonObjectInline(context, [&] (const JsonKey & key, Parse_Context & context)
+                                           {
+                                               context.expect_int();
+                                           });
+                });
+            total2 += event.id + event.user + event.type.size();
+            context.expect_eol();
+        }
+        total2 += event.segments;
+    }
+    double inlined = timer.elapsed_wall();
+
+    BOOST_CHECK_EQUAL(total1, total2);
+
+    cerr << format("std::function  %8.1f MB/s", mb / functions) << endl;
+    cerr << format("inlined        %8.1f MB/s", mb / inlined) << endl;
+}
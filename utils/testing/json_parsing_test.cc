@@ -10,10 +10,15 @@
 
 #include "jml/utils/json_parsing.h"
 #include "jml/utils/info.h"
+#include "jml/arch/format.h"
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/auto_unit_test.hpp>
 #include <math.h>
+#include <string.h>
+#include <memory>
+#include <sstream>
+#include <vector>
 
 using namespace ML;
 
@@ -71,3 +76,171 @@ BOOST_AUTO_TEST_CASE( test1 )
     BOOST_CHECK_THROW(testFp("3e", 0.1), std::exception);
     BOOST_CHECK_THROW(testFp("3.1aade", 0.1), std::exception);
 }
+
+BOOST_AUTO_TEST_CASE( test_inline_object_parsing )
+{
+    static_assert(jsonKeyHash("id") != jsonKeyHash("di"),
+                  "key hash must be usable at compile time");
+
+    std::string json = "{ \"id\" : 12, \"na\\u00efve\\n\":\"x\",\"list\":[1, 2 ,3],"
+        "\"obj\": {\"a\\\"b\": null, \"\": {}}, \"last\": -1.5 }";
+
+    std::vector<std::string> expected
+        = { "id", "na\xc3\xafve\n", "list", "obj", "last" };
+
+    // The same whatever the size of the buffers
+    for (size_t chunkSize: { 0, 1, 2, 3, 7, 1000 }) {
+        std::istringstream stream(json);
+        std::unique_ptr<Parse_Context> context;
+        if (chunkSize == 0)
+            context.reset(new Parse_Context("test", json.c_str(), json.size()));
+        else context.reset(new Parse_Context("test", stream, 1, 1, chunkSize));
+
+        std::vector<std::string> keys;
+        long long id = 0;
+        int numElements = 0;
+        double last = 0;
+
+        expectJsonObjectInline(*context, [&] (const JsonKey & key,
+                                              Parse_Context & context)
+            {
+                keys.push_back(key.str());
+
+                switch (key.hash()) {
+                case jsonKeyHash("id"):
+                    BOOST_CHECK(key == "id");
+                    id = expectJsonNumber(context).uns;
+                    return;
+                case jsonKeyHash("list"):
+                    expectJsonArrayInline(context, [&] (int i, Parse_Context & c)
+                                          {
+                                              BOOST_CHECK_EQUAL(i, numElements++);
+                                              c.expect_int();
+                                          });
+                    return;
+                case jsonKeyHash("obj"):
+                    BOOST_CHECK(matchJsonObjectInline(context, [&] (const JsonKey & key,
+                                                                    Parse_Context & c)
+                        {
+                            if (key == "a\"b") return matchJsonNull(c);
+                            BOOST_CHECK_EQUAL(key.size(), 0);
+                            return matchJsonObjectInline(c, [] (const JsonKey &,
+                                                                Parse_Context &)
+                                                         { return false; });
+                        }));
+                    return;
+                case jsonKeyHash("last"):
+                    last = expectJsonNumber(context).fp;
+                    return;
+                default:
+                    expectJsonStringAscii(context);
+                }
+            });
+
+        BOOST_CHECK(!*context);
+        BOOST_CHECK(keys == expected);
+        BOOST_CHECK_EQUAL(id, 12);
+        BOOST_CHECK_EQUAL(numElements, 3);
+        BOOST_CHECK_EQUAL(last, -1.5);
+    }
+
+    // Keys are views into memory buffers
+    std::string simple = "{\"key\":1}";
+    Parse_Context context("test", simple.c_str(), simple.size());
+    expectJsonObjectInline(context, [&] (const JsonKey & key, Parse_Context & c)
+                           {
+                               BOOST_CHECK_EQUAL(key.data, simple.c_str() + 2);
+                               c.expect_int();
+                           });
+
+    JML_TRACE_EXCEPTIONS(false);
+    std::string bad = "{\"a\":1,\"unterminated}";
+    Parse_Context badContext("test", bad.c_str(), bad.size());
+    BOOST_CHECK_THROW(expectJsonObjectInline(badContext, [] (const JsonKey &,
+                                                             Parse_Context & c)
+                                             { c.expect_int(); }),
+                      std::exception);
+}
+
+BOOST_AUTO_TEST_CASE( test_json_number_conversion )
+{
+    testUnsigned("18446744073709551615", 18446744073709551615ULL);
+    testSigned("-9223372036854775808", -9223372036854775807LL - 1);
+    testFp("18446744073709551616", 18446744073709551616.0);
+    testFp("-9223372036854775809", -9223372036854775809.0);
+    testFp("2.2250738585072011e-308", 2.2250738585072011e-308);
+    testFp("4.9e-324", 4.9e-324);
+    testFp("1e-400", 0.0);
+    testFp("1.7976931348623157e308", 1.7976931348623157e308);
+    testFp("1e400", INFINITY);
+    // Needs all of the digits to round correctly
+    testFp("9007199254740993.00000000000000000000001", 9007199254740994.0);
+    testFp("9007199254740993.00000000000000000000000", 9007199254740992.0);
+
+    // Same as strtod, wherever the buffers split the number
+    uint64_t state = 1;
+    auto random = [&] () -> uint64_t
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            return state >> 11;
+        };
+
+    std::string text;
+    std::vector<double> expected;
+    for (unsigned i = 0;  i < 20000;  ++i) {
+        std::string number;
+        if (i % 2 == 0) {
+            uint64_t bits = random() << 11 | random() % 2048;
+            double d;
+            memcpy(&d, &bits, sizeof(d));
+            if (!std::isfinite(d)) continue;
+            number = ML::format("%.*g", (int)(1 + random() % 17), d);
+        }
+        else {
+            number = std::to_string(random() % 1000000000) + "."
+                + std::to_string(random()) + "e"
+                + std::to_string((int)(random() % 40) - 20);
+        }
+        expected.push_back(strtod(number.c_str(), 0));
+        text += number + ",";
+    }
+
+    for (size_t chunkSize: { 0, 1, 5, 64, 4096 }) {
+        std::istringstream stream(text);
+        std::unique_ptr<Parse_Context> context;
+        if (chunkSize == 0)
+            context.reset(new Parse_Context("test", text.c_str(), text.size()));
+        else context.reset(new Parse_Context("test", stream, 1, 1, chunkSize));
+
+        for (unsigned i = 0;  i < expected.size();  ++i) {
+            JsonNumber num = expectJsonNumber(*context);
+            double value = num.fp;
+            if (num.type == JsonNumber::UNSIGNED_INT) value = num.uns;
+            else if (num.type == JsonNumber::SIGNED_INT) value = num.sgn;
+            BOOST_REQUIRE_EQUAL(value, expected[i]);
+            context->expect_literal(',');
+        }
+        BOOST_CHECK(context->eof());
+    }
+
+    JsonNumber num;
+    std::string notNumber = "-x";
+    Parse_Context context("test", notNumber.c_str(), notNumber.size());
+    BOOST_CHECK(!matchJsonNumber(context, num));
+    BOOST_CHECK_EQUAL(*context, '-');
+
+    // An exponent needs digits, even if something else follows it
+    for (std::string bad: { "1e", "1e+", "-1E-", "1.5e,", "1e+]" }) {
+        for (size_t chunkSize: { 0, 1, 2 }) {
+            std::istringstream stream(bad);
+            std::unique_ptr<Parse_Context> context;
+            if (chunkSize == 0)
+                context.reset(new Parse_Context("test", bad.c_str(),
+                                                bad.size()));
+            else context.reset(new Parse_Context("test", stream, 1, 1,
+                                                 chunkSize));
+            BOOST_CHECK_MESSAGE(!matchJsonNumber(*context, num), bad);
+            BOOST_CHECK_EQUAL(**context, bad[0]);
+        }
+    }
+}
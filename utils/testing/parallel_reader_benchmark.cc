@@ -0,0 +1,88 @@
+/* parallel_reader_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Speed of reading CSV rows and lines in parallel chunks against reading
+   them with a single Parse_Context.  Set NUM_THREADS to vary the number
+   of threads.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/parallel_reader.h"
+#include "jml/utils/parse_context.h"
+#include "jml/utils/file_functions.h"
+#include "jml/utils/worker_task.h"
+#include "jml/utils/csv.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include "jml/arch/atomic_ops.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <string>
+
+using namespace ML;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE(benchmark_parallel_reader)
+{
+    string text;
+    for (unsigned i = 0;  text.size() < 200000000;  ++i)
+        text += format("%d,\"field %d\",%f,some text here,\"quoted, with \"\"quotes\"\"\"\n",
+                       i, i * 7, i * 0.5);
+    double mb = text.size() / 1000000.0;
+
+    File_Read_Buffer buffer(text.c_str(), text.size(), "text");
+
+    cerr << "threads " << num_threads() << endl;
+
+    size_t n1 = 0;
+    Timer timer;
+    {
+        Parse_Context context("text", text.c_str(), text.size());
+        Csv_Row row;
+        while (context) {
+            expect_csv_row(context, row);
+            n1 += row.size();
+        }
+    }
+    double sequential = timer.elapsed_wall();
+
+    size_t n2 = 0;
+    timer.restart();
+    for_each_csv_row_in_parallel(buffer,
+                                 [&] (const Csv_Row & row)
+                                 {
+                                     atomic_add(n2, row.size());
+                                 });
+    double unordered = timer.elapsed_wall();
+
+    size_t n3 = 0;
+    timer.restart();
+    for_each_csv_row_in_parallel(buffer,
+                                 [&] (const Csv_Row & row)
+                                 {
+                                     n3 += row.size();
+                                 },
+                                 ',', true);
+    double ordered = timer.elapsed_wall();
+
+    size_t n4 = 0;
+    timer.restart();
+    for_each_line_in_parallel(buffer,
+                              [&] (const char * line, size_t length)
+                              {
+                                  atomic_add(n4, 1);
+                              });
+    double lines = timer.elapsed_wall();
+
+    BOOST_CHECK_EQUAL(n1, n2);
+    BOOST_CHECK_EQUAL(n1, n3);
+    BOOST_CHECK_EQUAL(n4 * 5, n1);
+
+    cerr << format("sequential rows %8.1f MB/s", mb / sequential) << endl;
+    cerr << format("unordered rows  %8.1f MB/s", mb / unordered) << endl;
+    cerr << format("ordered rows    %8.1f MB/s", mb / ordered) << endl;
+    cerr << format("unordered lines %8.1f MB/s", mb / lines) << endl;
+}
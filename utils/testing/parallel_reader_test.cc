@@ -0,0 +1,247 @@
+/* parallel_reader_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test of parsing line and CSV files in parallel chunks.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/utils/parallel_reader.h"
+#include "jml/utils/parse_context.h"
+#include "jml/utils/file_functions.h"
+#include "jml/utils/csv.h"
+#include "jml/arch/exception.h"
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace ML;
+using namespace std;
+
+/** CSV with quoted newlines, separators and quotes, CRLF line endings and
+    empty fields, where the splits can land anywhere. */
+string makeCsv(int numRows)
+{
+    string result;
+    for (int i = 0;  i < numRows;  ++i) {
+        result += to_string(i) + ",";
+        switch (i % 5) {
+        case 0: result += "plain,text";  break;
+        case 1: result += "\"quoted\nnewline\",\"two\n\nnewlines\"";  break;
+        case 2: result += "\"a \"\"quote\"\"\",";  break;
+        case 3: result += "\"sep,\"\"\n\",x";  break;
+        case 4: result += ",";  break;
+        }
+        result += i % 7 == 0 ? "\r\n" : "\n";
+    }
+    return result;
+}
+
+vector<vector<string> > sequentialRows(const string & text)
+{
+    vector<vector<string> > result;
+    Parse_Context context("text", text.c_str(), text.size());
+    while (context)
+        result.push_back(expect_csv_row(context));
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(test_split_record_chunks)
+{
+    string text = makeCsv(100);
+    const char * start = text.c_str(), * end = start + text.size();
+
+    for (int numChunks = 1;  numChunks < 60;  ++numChunks) {
+        auto chunks = split_record_chunks(start, end, numChunks, true);
+        BOOST_REQUIRE(!chunks.empty());
+        BOOST_REQUIRE(chunks.size() <= numChunks);
+        BOOST_CHECK_EQUAL(chunks.front().start, start);
+        BOOST_CHECK_EQUAL(chunks.back().end, end);
+
+        for (unsigned i = 0;  i < chunks.size();  ++i) {
+            BOOST_REQUIRE(chunks[i].start < chunks[i].end);
+            if (i > 0)
+                BOOST_REQUIRE_EQUAL(chunks[i].start, chunks[i - 1].end);
+            BOOST_REQUIRE_EQUAL(chunks[i].line,
+                                1 + std::count(start, chunks[i].start, '\n'));
+        }
+    }
+
+    // Empty buffer gives one empty chunk
+    auto chunks = split_record_chunks(start, start, 10);
+    BOOST_CHECK_EQUAL(chunks.size(), 1);
+    BOOST_CHECK_EQUAL(chunks[0].start, chunks[0].end);
+}
+
+BOOST_AUTO_TEST_CASE(test_csv_rows_in_parallel)
+{
+    string text = makeCsv(1000);
+    auto expected = sequentialRows(text);
+    File_Read_Buffer buffer(text.c_str(), text.size(), "text");
+
+    for (int numChunks: { 1, 2, 3, 7, 16, 50, 333, -1 }) {
+        // Ordered: same rows in the same order
+        vector<vector<string> > rows;
+        for_each_csv_row_in_parallel(buffer,
+                                     [&] (const Csv_Row & row)
+                                     {
+                                         rows.push_back(row.strings());
+                                     },
+                                     ',', true, numChunks);
+        BOOST_REQUIRE(rows == expected);
+
+        // Unordered: same rows in any order
+        rows.clear();
+        std::mutex lock;
+        for_each_csv_row_in_parallel(buffer,
+                                     [&] (const Csv_Row & row)
+                                     {
+                                         std::unique_lock<std::mutex>
+                                             guard(lock);
+                                         rows.push_back(row.strings());
+                                     },
+                                     ',', false, numChunks);
+        BOOST_REQUIRE_EQUAL(rows.size(), expected.size());
+        auto sortedExpected = expected;
+        std::sort(rows.begin(), rows.end());
+        std::sort(sortedExpected.begin(), sortedExpected.end());
+        BOOST_REQUIRE(rows == sortedExpected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_lines_in_parallel)
+{
+    string text;
+    for (unsigned i = 0;  i < 2000;  ++i)
+        text += string(i % 37, 'a' + i % 26) + (i % 11 ? "\n" : "\n\r");
+    text += "no newline at the end";
+
+    vector<string> expected;
+    {
+        Parse_Context context("text", text.c_str(), text.size());
+        string line;
+        while (context.match_line(line))
+            expected.push_back(line);
+    }
+
+    File_Read_Buffer buffer(text.c_str(), text.size(), "text");
+
+    for (int numChunks: { 1, 2, 5, 64, 1000, -1 }) {
+        vector<string> lines;
+        for_each_line_in_parallel(buffer,
+                                  [&] (const char * line, size_t length)
+                                  {
+                                      lines.push_back(string(line, length));
+                                  },
+                                  true, numChunks);
+        BOOST_REQUIRE(lines == expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_ordered_delivery_errors)
+{
+    string text;
+    for (unsigned i = 0;  i < 10000;  ++i)
+        text += to_string(i) + "\n";
+
+    File_Read_Buffer buffer(text.c_str(), text.size(), "text");
+
+    // Once a callback throws, nothing more is delivered and the same
+    // exception comes out
+    struct Stop {
+        int line;
+    };
+
+    for (int numChunks: { 1, 2, 7, 100 }) {
+        vector<int> lines;
+        int stoppedAt = -1;
+        try {
+            for_each_line_in_parallel(buffer,
+                                      [&] (const char * line, size_t length)
+                                      {
+                                          int n = stoi(string(line, length));
+                                          lines.push_back(n);
+                                          if (n == 5000)
+                                              throw Stop{ n };
+                                      },
+                                      true, numChunks);
+        } catch (const Stop & stop) {
+            stoppedAt = stop.line;
+        }
+        BOOST_CHECK_EQUAL(stoppedAt, 5000);
+        BOOST_REQUIRE_EQUAL(lines.size(), 5001);
+        for (unsigned i = 0;  i < lines.size();  ++i)
+            BOOST_REQUIRE_EQUAL(lines[i], i);
+    }
+
+    string csv = makeCsv(1000);
+    File_Read_Buffer csvBuffer(csv.c_str(), csv.size(), "csv");
+    for (int numChunks: { 1, 5, 100 }) {
+        int rows = 0;
+        BOOST_CHECK_THROW(for_each_csv_row_in_parallel
+                              (csvBuffer,
+                               [&] (const Csv_Row & row)
+                               {
+                                   if (++rows == 300)
+                                       throw Stop{ rows };
+                               },
+                               ',', true, numChunks),
+                          Stop);
+        BOOST_CHECK_EQUAL(rows, 300);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_parse_in_parallel_errors)
+{
+    // Errors say which line they're on, whichever chunk they're in
+    string text = makeCsv(500);
+    size_t line = 1 + std::count(text.begin(), text.end(), '\n');
+    text += "bad\n" + makeCsv(100);
+    size_t numLines = std::count(text.begin(), text.end(), '\n');
+
+    File_Read_Buffer buffer(text.c_str(), text.size(), "text");
+
+    for (int numChunks: { 1, 4, 100 }) {
+        vector<size_t> lines(numChunks);
+        string error;
+        try {
+            parse_in_parallel(buffer,
+                              [&] (Parse_Context & context, int chunk)
+                              {
+                                  while (context) {
+                                      if (context.match_literal("bad"))
+                                          context.exception("bad row");
+                                      context.skip_line();
+                                      ++lines.at(chunk);
+                                  }
+                              },
+                              false, numChunks);
+        } catch (const std::exception & exc) {
+            error = exc.what();
+        }
+        BOOST_CHECK_NE(error.find("text:" + to_string(line) + ":4: bad row"),
+                       string::npos);
+
+        // Each chunk sees only its own part of the buffer
+        lines.clear();
+        lines.resize(numChunks);
+        parse_in_parallel(buffer,
+                          [&] (Parse_Context & context, int chunk)
+                          {
+                              while (context) {
+                                  context.skip_line();
+                                  ++lines.at(chunk);
+                              }
+                          },
+                          false, numChunks);
+        size_t total = 0;
+        for (auto n: lines) total += n;
+        BOOST_CHECK_EQUAL(total, numLines);
+    }
+}
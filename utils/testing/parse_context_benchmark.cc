@@ -0,0 +1,115 @@
+/* parse_context_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Speed of character at a time parsing, with the line and column tracked
+   on every character or worked out lazily, and of parsing a compressed
+   stream with and without asynchronous readahead.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/parse_context.h"
+#include "jml/utils/filter_streams.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+using namespace ML;
+using namespace std;
+
+/** A hand written parser for key=value;key=value lines, as many of ours
+    are, that looks at every character. */
+size_t parseLines(Parse_Context & context)
+{
+    size_t total = 0;
+    while (context) {
+        while (!context.match_eol()) {
+            while (*context != '=') {
+                total += *context;
+                ++context;
+            }
+            context.expect_literal('=');
+            int value;
+            if (context.match_int(value)) total += value;
+            else {
+                while (context && *context != ';' && *context != '\n')
+                    ++context;
+            }
+            context.match_literal(';');
+        }
+    }
+    return total;
+}
+
+BOOST_AUTO_TEST_CASE( benchmark_line_tracking )
+{
+    string text;
+    for (unsigned i = 0;  text.size() < 50000000;  ++i)
+        text += format("user=u%d;count=%d;path=/a/b/%d;ok=%d\n",
+                       i * 7, i % 100, i, i % 2);
+    double mb = text.size() / 1000000.0;
+
+    for (bool stream: { false, true }) {
+        double times[2];
+        size_t totals[2];
+        for (bool lazy: { false, true }) {
+            istringstream in(text);
+            std::unique_ptr<Parse_Context> context;
+            if (stream) context.reset(new Parse_Context("text", in));
+            else context.reset(new Parse_Context("text", text.c_str(),
+                                                 text.size()));
+            context->set_lazy_line_tracking(lazy);
+
+            Timer timer;
+            totals[lazy] = parseLines(*context);
+            times[lazy] = timer.elapsed_wall();
+        }
+
+        BOOST_CHECK_EQUAL(totals[0], totals[1]);
+        cerr << format("%-6s  eager %7.1f MB/s  lazy %7.1f MB/s",
+                       stream ? "stream" : "memory",
+                       mb / times[0], mb / times[1])
+             << endl;
+    }
+}
+
+BOOST_AUTO_TEST_CASE( benchmark_async_readahead )
+{
+    string filename = format("/tmp/parse_context_benchmark-%d.gz", getpid());
+    size_t bytes = 0;
+    {
+        filter_ostream out(filename);
+        for (unsigned i = 0;  bytes < 50000000;  ++i) {
+            string line = format("user=u%d;count=%d;path=/a/b/%d;ok=%d\n",
+                                 i * 7, i % 100, i, i % 2);
+            out << line;
+            bytes += line.size();
+        }
+    }
+    double mb = bytes / 1000000.0;
+
+    double times[2];
+    size_t totals[2];
+    for (bool async: { false, true }) {
+        Timer timer;
+        filter_istream in(filename);
+        Parse_Context context(filename, in);
+        context.set_lazy_line_tracking(true);
+        context.set_async_readahead(async);
+        totals[async] = parseLines(context);
+        times[async] = timer.elapsed_wall();
+    }
+
+    unlink(filename.c_str());
+
+    BOOST_CHECK_EQUAL(totals[0], totals[1]);
+    cerr << format("gzip    sync  %7.1f MB/s  async %7.1f MB/s",
+                   mb / times[0], mb / times[1])
+         << endl;
+}
@@ -21,6 +21,8 @@
 #include <boost/bind.hpp>
 #include <sstream>
 #include <fstream>
+#include <memory>
+#include <thread>
 
 using namespace ML;
 using namespace std;
@@ -614,3 +616,152 @@ BOOST_AUTO_TEST_CASE(test_dodgy_float_parsing5)
     BOOST_CHECK(!c1.match_double(d));
     BOOST_CHECK_EQUAL(d, -1.0);
 }
+
+BOOST_AUTO_TEST_CASE(test_lazy_line_tracking)
+{
+    string text;
+    for (unsigned i = 0;  i < 2000;  ++i)
+        text += format("%d,%s\n", i, string(i % 37, 'a').c_str())
+            + (i % 5 ? "" : "\n");
+
+    auto where = [] (Parse_Context & context)
+        {
+            try {
+                JML_TRACE_EXCEPTIONS(false);
+                context.exception("here");
+            } catch (const std::exception & exc) {
+                return string(exc.what());
+            }
+            return string();
+        };
+
+    for (size_t chunkSize: { 0, 1, 7, 100, 65536 }) {
+        istringstream stream1(text), stream2(text);
+        std::unique_ptr<Parse_Context> eager, lazy;
+        if (chunkSize == 0) {
+            eager.reset(new Parse_Context("text", text.c_str(), text.size()));
+            lazy.reset(new Parse_Context("text", text.c_str(), text.size(),
+                                         10, 5));
+            lazy->set_lazy_line_tracking(true);
+            BOOST_CHECK_EQUAL(lazy->get_line(), 10);
+            BOOST_CHECK_EQUAL(lazy->get_col(), 5);
+            lazy.reset(new Parse_Context("text", text.c_str(), text.size()));
+        }
+        else {
+            eager.reset(new Parse_Context("text", stream1, 1, 1, chunkSize));
+            lazy.reset(new Parse_Context("text", stream2, 1, 1, chunkSize));
+        }
+        lazy->set_lazy_line_tracking(true);
+
+        for (unsigned i = 0;  *eager;  ++i) {
+            BOOST_REQUIRE(*lazy);
+            // Some characters at a time, some skipped over and some
+            // speculative matches that fail and revert
+            int n1, n2;
+            BOOST_REQUIRE_EQUAL(eager->match_int(n1), lazy->match_int(n2));
+            BOOST_CHECK(!eager->match_literal("aaaaaaaaaaaaaaab"));
+            BOOST_CHECK(!lazy->match_literal("aaaaaaaaaaaaaaab"));
+            if (i % 7 == 0) {
+                eager->skip_line();
+                lazy->skip_line();
+            }
+            else {
+                ++*eager;
+                ++*lazy;
+            }
+
+            // Only looked at now and again, as in real use
+            if (i % 11 == 0 || !*eager) {
+                BOOST_REQUIRE_EQUAL(lazy->get_offset(), eager->get_offset());
+                BOOST_REQUIRE_EQUAL(lazy->get_line(), eager->get_line());
+                BOOST_REQUIRE_EQUAL(lazy->get_col(), eager->get_col());
+                BOOST_REQUIRE_EQUAL(where(*lazy), where(*eager));
+            }
+
+            // Switching modes keeps the position
+            if (i % 1000 == 500) {
+                lazy->set_lazy_line_tracking(false);
+                BOOST_REQUIRE_EQUAL(lazy->get_line(), eager->get_line());
+                lazy->set_lazy_line_tracking(true);
+            }
+        }
+        BOOST_CHECK(!*lazy);
+        BOOST_CHECK_EQUAL(lazy->get_line(), eager->get_line());
+        BOOST_CHECK_EQUAL(lazy->get_col(), eager->get_col());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_async_readahead)
+{
+    string text;
+    for (unsigned i = 0;  i < 20000;  ++i)
+        text += format("%d,%s\n", i, string(i % 37, 'a').c_str());
+
+    for (size_t chunkSize: { 1, 7, 100, 65536 }) {
+        istringstream stream(text);
+        Parse_Context context("text", stream, 1, 1, chunkSize);
+        context.set_async_readahead(true);
+        BOOST_CHECK(context.async_readahead());
+        BOOST_CHECK_THROW(context.set_chunk_size(chunkSize + 1),
+                          ML::Exception);
+
+        Parse_Context reference("text", text.c_str(), text.size());
+
+        for (unsigned i = 0;  reference;  ++i) {
+            BOOST_REQUIRE(context);
+
+            // Tokens keep chunks from being recycled until they're done
+            {
+                Parse_Context::Revert_Token token(context);
+                BOOST_CHECK(!context.match_literal("0,aaaaaaaaaaaaaaaaaaab"));
+            }
+
+            int n1, n2;
+            BOOST_REQUIRE(context.match_int(n1));
+            BOOST_REQUIRE(reference.match_int(n2));
+            BOOST_REQUIRE_EQUAL(n1, n2);
+            context.skip_line();
+            reference.skip_line();
+            BOOST_REQUIRE_EQUAL(context.get_offset(), reference.get_offset());
+            BOOST_REQUIRE_EQUAL(context.get_line(), reference.get_line());
+
+            // It can be turned off and on again part way through
+            if (i == 5000) {
+                context.set_async_readahead(false);
+                BOOST_CHECK(!context.async_readahead());
+            }
+            if (i == 10000)
+                context.set_async_readahead(true);
+        }
+        BOOST_CHECK(!context);
+    }
+
+    {
+        // Once the thread has stopped by itself and its chunks are used up
+        // the chunk size can be changed again
+        string text(250, 'x');
+        for (unsigned i = 0;  i < text.size();  ++i)
+            text[i] = 'a' + i % 26;
+        istringstream stream(text);
+        Parse_Context context("text", stream, 1, 1, 100);
+        context.set_async_readahead(true);
+        while (context.async_readahead())
+            std::this_thread::yield();
+
+        BOOST_CHECK_THROW(context.set_chunk_size(10), ML::Exception);
+        for (unsigned i = 0;  i < 200;  ++i)
+            ++context;
+        context.set_chunk_size(10);
+        BOOST_CHECK_EQUAL(context.get_chunk_size(), 10);
+
+        string rest;
+        while (context)
+            rest += *context++;
+        BOOST_CHECK_EQUAL(rest, text.substr(200));
+    }
+
+    // Turning it on does nothing for a memory buffer
+    Parse_Context context("text", text.c_str(), text.size());
+    context.set_async_readahead(true);
+    BOOST_CHECK(!context.async_readahead());
+}
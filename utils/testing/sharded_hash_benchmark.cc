@@ -0,0 +1,93 @@
+/* sharded_hash_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Scaling benchmark for the sharded hash versus a Lightweight_Hash behind
+   a single lock.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/sharded_hash.h"
+#include "jml/arch/timers.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/bind.hpp>
+#include <iostream>
+
+using namespace ML;
+using namespace std;
+
+typedef Lightweight_Hash<uint64_t, uint64_t> Locked_Map;
+
+struct Single_Lock_Hash {
+    void update(uint64_t key)
+    {
+        std::lock_guard<Spinlock> guard(lock);
+        map[key] += 1;
+    }
+
+    Spinlock lock;
+    Locked_Map map;
+};
+
+// Each thread hits a spread of keys that overlaps with the other threads,
+// like an aggregation would.
+inline uint64_t benchKey(int thread, int i)
+{
+    return ((uint64_t)(i * 7919 + thread * 104729) % 1000000) + 1;
+}
+
+void runSharded(Sharded_Hash<uint64_t, uint64_t> & h,
+                boost::barrier & barrier, int thread, int niter)
+{
+    barrier.wait();
+    for (unsigned i = 0;  i < niter;  ++i)
+        h.update(benchKey(thread, i), [] (uint64_t & v) { v += 1; });
+}
+
+void runSingle(Single_Lock_Hash & h,
+               boost::barrier & barrier, int thread, int niter)
+{
+    barrier.wait();
+    for (unsigned i = 0;  i < niter;  ++i)
+        h.update(benchKey(thread, i));
+}
+
+template<typename Map, typename Fn>
+double runThreads(Map & map, Fn fn, int nthreads, int niter)
+{
+    boost::barrier barrier(nthreads + 1);
+    boost::thread_group tg;
+    for (unsigned i = 0;  i < nthreads;  ++i)
+        tg.create_thread(boost::bind(fn, boost::ref(map), boost::ref(barrier),
+                                     i, niter));
+    barrier.wait();
+    Timer timer;
+    tg.join_all();
+    return timer.elapsed_wall();
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_sharded_hash_scaling)
+{
+    int niter = 2000000;
+
+    cerr << "threads   single lock Mops/s   sharded Mops/s" << endl;
+
+    for (int nthreads = 1;  nthreads <= 16;  nthreads *= 2) {
+        Single_Lock_Hash single;
+        double singleTime = runThreads(single, runSingle, nthreads, niter);
+
+        Sharded_Hash<uint64_t, uint64_t> sharded(256);
+        double shardedTime = runThreads(sharded, runSharded, nthreads, niter);
+
+        BOOST_CHECK_EQUAL(single.map.size(), sharded.size());
+
+        double nops = 1.0 * nthreads * niter / 1000000.0;
+        cerr << format("%7d   %20.2f   %14.2f", nthreads,
+                       nops / singleTime, nops / shardedTime)
+             << endl;
+    }
+}
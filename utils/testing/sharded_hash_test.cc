@@ -0,0 +1,133 @@
+/* sharded_hash_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test program for the sharded concurrent hash.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/utils/sharded_hash.h"
+#include "jml/arch/atomic_ops.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/bind.hpp>
+#include <iostream>
+#include <vector>
+
+using namespace ML;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE(test_sharded_hash_basics)
+{
+    Sharded_Hash<int, int> h(5);
+    BOOST_CHECK_EQUAL(h.num_shards(), 8);
+    BOOST_CHECK_EQUAL(h.size(), 0);
+    BOOST_CHECK(h.empty());
+
+    auto r = h.find_or_insert(1, 10);
+    BOOST_CHECK_EQUAL(r.first, 10);
+    BOOST_CHECK_EQUAL(r.second, true);
+
+    r = h.find_or_insert(1, 20);
+    BOOST_CHECK_EQUAL(r.first, 10);
+    BOOST_CHECK_EQUAL(r.second, false);
+
+    int val = 0;
+    BOOST_CHECK(h.find(1, val));
+    BOOST_CHECK_EQUAL(val, 10);
+    BOOST_CHECK(!h.find(2, val));
+    BOOST_CHECK_EQUAL(val, 10);
+
+    BOOST_CHECK(h.update(2, [] (int & v) { v += 3; }));
+    BOOST_CHECK(!h.update(2, [] (int & v) { v += 3; }));
+    BOOST_CHECK(h.find(2, val));
+    BOOST_CHECK_EQUAL(val, 6);
+
+    BOOST_CHECK_EQUAL(h.count(1), 1);
+    BOOST_CHECK_EQUAL(h.count(3), 0);
+    BOOST_CHECK_EQUAL(h.size(), 2);
+
+    // Guard value can't be inserted
+    BOOST_CHECK_THROW(h.find_or_insert(0, 1), ML::Exception);
+
+    h.clear();
+    BOOST_CHECK_EQUAL(h.size(), 0);
+    BOOST_CHECK_EQUAL(h.count(1), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_sharded_hash_one_shard)
+{
+    Sharded_Hash<int, int> h(1);
+    BOOST_CHECK_EQUAL(h.num_shards(), 1);
+    for (unsigned i = 1;  i <= 1000;  ++i)
+        h.find_or_insert(i, i);
+    BOOST_CHECK_EQUAL(h.size(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(test_sharded_hash_for_each_shard)
+{
+    Sharded_Hash<uint64_t, int> h(16);
+    h.reserve(10000);
+
+    for (uint64_t i = 1;  i <= 10000;  ++i)
+        h.find_or_insert(i, 1);
+
+    size_t total = 0;
+    int nonEmpty = 0;
+    h.for_each_shard([&] (int shard, const Sharded_Hash<uint64_t, int>::Shard_Map & map)
+                     {
+                         for (auto it = map.begin(); it != map.end(); ++it)
+                             BOOST_CHECK_EQUAL(h.shard_of(it->first), shard);
+                         total += map.size();
+                         nonEmpty += !map.empty();
+                     });
+
+    BOOST_CHECK_EQUAL(total, 10000);
+    BOOST_CHECK_EQUAL(nonEmpty, 16);
+}
+
+void test_sharded_hash_thread(Sharded_Hash<uint64_t, uint64_t> & h,
+                              boost::barrier & barrier,
+                              int & inserted, int niter)
+{
+    barrier.wait();
+
+    int my_inserted = 0;
+    for (unsigned i = 1;  i <= niter;  ++i)
+        my_inserted += h.update(i, [] (uint64_t & v) { v += 1; });
+
+    atomic_add(inserted, my_inserted);
+}
+
+BOOST_AUTO_TEST_CASE(test_sharded_hash_multithreaded)
+{
+    int nthreads = 8, niter = 100000;
+
+    Sharded_Hash<uint64_t, uint64_t> h;
+    boost::barrier barrier(nthreads);
+    int inserted = 0;
+
+    boost::thread_group tg;
+    for (unsigned i = 0;  i < nthreads;  ++i)
+        tg.create_thread(boost::bind(test_sharded_hash_thread,
+                                     boost::ref(h),
+                                     boost::ref(barrier),
+                                     boost::ref(inserted),
+                                     niter));
+    tg.join_all();
+
+    // Each key inserted exactly once, and updated once by each thread
+    BOOST_CHECK_EQUAL(inserted, niter);
+    BOOST_CHECK_EQUAL(h.size(), niter);
+
+    int errors = 0;
+    for (unsigned i = 1;  i <= niter;  ++i) {
+        uint64_t val = 0;
+        errors += !h.find(i, val) || val != nthreads;
+    }
+    BOOST_CHECK_EQUAL(errors, 0);
+}
@@ -0,0 +1,59 @@
+/* sorted_vector_benchmark.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Benchmark of lookups in the sorted_vector search layouts.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "jml/utils/sorted_vector.h"
+#include "jml/arch/timers.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+
+using namespace ML;
+using namespace std;
+
+template<class Layout>
+double time_lookups(const vector<pair<uint64_t, uint32_t> > & entries,
+                    const vector<uint64_t> & queries, uint64_t & total)
+{
+    sorted_vector<uint64_t, uint32_t, std::less<uint64_t>, Layout>
+        v(entries.begin(), entries.end());
+
+    Timer timer;
+    for (unsigned i = 0;  i < queries.size();  ++i) {
+        auto it = v.lower_bound(queries[i]);
+        if (it != v.end()) total += it->second;
+    }
+    return timer.elapsed_wall();
+}
+
+BOOST_AUTO_TEST_CASE( benchmark_layouts )
+{
+    int nqueries = 5000000;
+
+    cerr << "entries     sorted Mlookups/s   eytzinger Mlookups/s" << endl;
+
+    for (int n = 1000;  n <= 10000000;  n *= 10) {
+        vector<pair<uint64_t, uint32_t> > entries;
+        for (unsigned i = 0;  i < n;  ++i)
+            entries.push_back(make_pair(random() * 65536ULL + random(), i));
+
+        vector<uint64_t> queries;
+        for (unsigned i = 0;  i < nqueries;  ++i)
+            queries.push_back(random() * 65536ULL + random());
+
+        uint64_t total1 = 0, total2 = 0;
+        double t1 = time_lookups<Sorted_Layout>(entries, queries, total1);
+        double t2 = time_lookups<Eytzinger_Layout>(entries, queries, total2);
+
+        BOOST_CHECK_EQUAL(total1, total2);
+
+        cerr << format("%9d   %18.2f   %20.2f", n,
+                       nqueries / t1 / 1000000.0, nqueries / t2 / 1000000.0)
+             << endl;
+    }
+}
@@ -0,0 +1,87 @@
+/* sorted_vector_test.cc
+   Jeremy Barnes, 16 October 2013
+   Copyright (c) 2013 Jeremy Barnes.  All rights reserved.
+
+   Test of the sorted vector class and its search layouts.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#undef NDEBUG
+
+#include "jml/utils/sorted_vector.h"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <map>
+
+using namespace ML;
+using namespace std;
+
+template<class Layout>
+void check_layout(int n)
+{
+    // Even keys only, so that we can search for the missing odd ones
+    vector<pair<int, int> > entries;
+    for (int i = 0;  i < n;  ++i)
+        entries.push_back(make_pair(i * 2, i));
+    std::random_shuffle(entries.begin(), entries.end());
+
+    typedef sorted_vector<int, int, std::less<int>, Layout> Vec;
+    const Vec v(entries.begin(), entries.end());
+
+    BOOST_REQUIRE_EQUAL(v.size(), n);
+    BOOST_CHECK_EQUAL(v.empty(), n == 0);
+
+    int i = 0;
+    for (auto it = v.begin();  it != v.end();  ++it, ++i) {
+        BOOST_CHECK_EQUAL(it->first, i * 2);
+        BOOST_CHECK_EQUAL(it->second, i);
+    }
+
+    int errors = 0;
+    for (int k = -1;  k <= n * 2;  ++k) {
+        auto lb = v.lower_bound(k);
+        auto ub = v.upper_bound(k);
+        auto f = v.find(k);
+
+        size_t elb = k < 0 ? 0 : std::min((k + 1) / 2, n);
+        size_t eub = k < 0 ? 0 : std::min(k / 2 + 1, n);
+        bool found = k >= 0 && k % 2 == 0 && k < n * 2;
+
+        errors += (lb - v.begin()) != elb;
+        errors += (ub - v.begin()) != eub;
+        if (found)
+            errors += f == v.end() || f->first != k || f->second != k / 2;
+        else errors += f != v.end();
+    }
+
+    BOOST_CHECK_EQUAL(errors, 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_sorted_layout )
+{
+    for (int n: { 0, 1, 2, 3, 4, 7, 8, 9, 15, 16, 17, 100, 1000, 4095 })
+        check_layout<Sorted_Layout>(n);
+}
+
+BOOST_AUTO_TEST_CASE( test_eytzinger_layout )
+{
+    for (int n: { 0, 1, 2, 3, 4, 7, 8, 9, 15, 16, 17, 100, 1000, 4095 })
+        check_layout<Eytzinger_Layout>(n);
+}
+
+BOOST_AUTO_TEST_CASE( test_eytzinger_duplicates )
+{
+    vector<pair<int, int> > entries;
+    for (int i = 0;  i < 100;  ++i)
+        entries.push_back(make_pair(i / 10, i));
+
+    sorted_vector<int, int, std::less<int>, Eytzinger_Layout>
+        v(entries.begin(), entries.end());
+
+    for (int k = 0;  k < 10;  ++k) {
+        BOOST_CHECK_EQUAL(v.lower_bound(k) - v.begin(), k * 10);
+        BOOST_CHECK_EQUAL(v.upper_bound(k) - v.begin(), k * 10 + 10);
+        BOOST_CHECK_EQUAL(v.find(k)->first, k);
+    }
+}
@@ -1,11 +1,30 @@
 $(eval $(call test,parse_context_test,utils arch,boost))
+$(eval $(call test,parse_context_benchmark,utils arch,boost manual))
 $(eval $(call test,configuration_test,utils arch,boost))
 $(eval $(call test,environment_test,utils arch,boost))
 $(eval $(call test,compact_vector_test,arch,boost))
 $(eval $(call test,circular_buffer_test,arch,boost))
 $(eval $(call test,lightweight_hash_test,arch utils,boost))
-$(eval $(call test,filter_streams_test,arch utils boost_filesystem boost_system,boost))
+$(eval $(call test,filter_streams_test,arch utils parallel_utils boost_filesystem boost_system,boost))
+$(eval $(call test,filter_streams_benchmark,arch utils parallel_utils worker_task,boost manual))
 $(eval $(call test,csv_parsing_test,arch utils,boost))
+$(eval $(call test,csv_parsing_benchmark,arch utils,boost manual))
+$(eval $(call test,find_first_of_test,utils arch,boost))
+$(eval $(call test,find_first_of_benchmark,utils arch,boost manual))
+$(eval $(call test,parallel_reader_test,parallel_utils utils worker_task arch,boost))
+$(eval $(call test,parallel_reader_benchmark,parallel_utils utils worker_task arch,boost manual))
+$(eval $(call test,fast_float_parsing_test,utils arch,boost))
+$(eval $(call test,fast_float_parsing_benchmark,utils arch,boost manual))
+$(eval $(call test,fast_int_parsing_test,utils arch,boost))
+$(eval $(call test,fast_int_parsing_benchmark,utils arch,boost manual))
 
 $(eval $(call test,worker_task_test,worker_task ACE arch boost_thread pthread,boost manual))
 $(eval $(call test,json_parsing_test,utils arch,boost))
+$(eval $(call test,json_parsing_benchmark,utils arch,boost manual))
+$(eval $(call test,json_index_test,utils arch,boost))
+$(eval $(call test,json_index_benchmark,utils arch,boost manual))
+$(eval $(call test,arena_test,utils arch,boost))
+$(eval $(call test,sharded_hash_test,utils arch boost_thread,boost))
+$(eval $(call test,sharded_hash_benchmark,utils arch boost_thread,boost manual))
+$(eval $(call test,sorted_vector_test,arch,boost))
+$(eval $(call test,sorted_vector_benchmark,arch,boost manual))
@@ -6,12 +6,16 @@ LIBUTILS_SOURCES := \
         parse_context.cc \
 	configuration.cc \
 	csv.cc \
+	find_first_of.cc \
+	arena.cc \
 	exc_check.cc \
 	exc_assert.cc \
 	hex_dump.cc \
 	lzma.cc \
 	floating_point.cc \
 	json_parsing.cc \
+	json_index.cc \
+	decimal_to_binary.cc \
 	rng.cc \
 	hash.cc \
 	abort.cc
@@ -21,8 +25,18 @@ LIBUTILS_LINK :=	ACE arch boost_iostreams lzma boost_thread cryptopp
 $(eval $(call library,utils,$(LIBUTILS_SOURCES),$(LIBUTILS_LINK)))
 
 LIBWORKER_TASK_SOURCES := worker_task.cc
-LIBWORKER_TASK_LINK    := ACE arch pthread
+LIBWORKER_TASK_LINK    := ACE arch utils pthread
 
 $(eval $(call library,worker_task,$(LIBWORKER_TASK_SOURCES),$(LIBWORKER_TASK_LINK)))
 
+# Utilities that run on the Worker_Task, which can't go in utils as the
+# worker_task library itself depends on utils
+LIBPARALLEL_UTILS_SOURCES := \
+	parallel_reader.cc \
+	parallel_gzip.cc
+
+LIBPARALLEL_UTILS_LINK := utils worker_task arch boost_iostreams z
+
+$(eval $(call library,parallel_utils,$(LIBPARALLEL_UTILS_SOURCES),$(LIBPARALLEL_UTILS_LINK)))
+
 $(eval $(call include_sub_make,utils_testing,testing))